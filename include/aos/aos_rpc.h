@@ -33,6 +33,7 @@
 #define AOS_RPC_SDMA_EP    1 << 29  // ID for get SDMA endpoint requests.
 #define AOS_RPC_LIGHT_LED  1 << 4  // ID for light_led requests.
 #define AOS_RPC_SPAWN_ARGS 1 << 8  // ID for memtest requests.
+#define AOS_RPC_SPAWN_FRAME 1 << 9 // ID for spawn from args frame requests.
 
 struct aos_rpc {
     struct lmp_chan lc;
@@ -58,6 +59,8 @@ errval_t aos_rpc_process_spawn_send_handler(void* void_args);
 errval_t aos_rpc_process_spawn_recv_handler(void* void_args);
 errval_t aos_rpc_process_spawn_args_send_handler(void* void_args);
 errval_t aos_rpc_process_spawn_args_recv_handler(void* void_args);
+errval_t aos_rpc_process_spawn_frame_send_handler(void* void_args);
+errval_t aos_rpc_process_spawn_frame_recv_handler(void* void_args);
 errval_t aos_rpc_process_get_name_send_handler(void* void_args);
 errval_t aos_rpc_process_get_name_recv_handler(void* void_args);
 errval_t aos_rpc_process_get_process_list_send_handler(void* void_args);
@@ -129,6 +132,25 @@ errval_t aos_rpc_process_spawn(struct aos_rpc *chan, char *name,
 errval_t aos_rpc_process_spawn_args(struct aos_rpc *chan, char *name,
                                     coreid_t core, domainid_t *newpid);
 
+/**
+ * \brief Builds a frame holding a struct spawn_domain_params followed by the
+ * given argument and environment strings, ready for
+ * aos_rpc_process_spawn_frame. envp may be NULL.
+ */
+errval_t aos_rpc_args_frame_create(int argc, char *argv[], char *envp[],
+        struct capref *frame);
+
+/**
+ * \brief Request process manager to start a new process on the given core from
+ * an argument frame built by aos_rpc_args_frame_create. argv[0] names the
+ * binary. init copies the arguments out of the frame once, and the caller's
+ * copy of the cap is destroyed on success.
+ * \arg core the core to spawn the process on
+ * \arg newpid the process id of the newly spawned process
+ */
+errval_t aos_rpc_process_spawn_frame(struct aos_rpc *chan,
+        struct capref frame, coreid_t core, domainid_t *newpid);
+
 /**
  * \brief Get name of process with id pid.
  * \arg pid the process id to lookup
@@ -57,7 +57,11 @@ errval_t ram_forge(struct capref dest, genpaddr_t base, gensize_t bytes,
                    coreid_t coreid);
 errval_t frame_forge(struct capref dest, genpaddr_t base, gensize_t bytes,
                      coreid_t coreid);
+errval_t frames_forge(struct capref dest, struct frame_identity *frames,
+                      size_t count, coreid_t coreid);
 errval_t frame_alloc(struct capref *dest, size_t bytes, size_t *retbytes);
+errval_t frame_alloc_aligned(struct capref *dest, size_t bytes,
+                             size_t alignment, size_t *retbytes);
 errval_t devframe_type(struct capref *dest, struct capref src, uint8_t bits);
 errval_t dispatcher_create(struct capref dest);
 
@@ -135,10 +135,21 @@ static inline errval_t invoke_cnode_delete(struct capref root, capaddr_t cap,
     return cap_invoke3(root, CNodeCmd_Delete, cap, level).error;
 }
 
+/**
+ * \brief Revoke a cap, or continue revoking it
+ *
+ * \param ret_progress Returns the ctes processed by this revoke so far,
+ *                     may be NULL
+ */
 static inline errval_t invoke_cnode_revoke(struct capref root, capaddr_t cap,
-                                           enum cnode_type level)
+                                           enum cnode_type level,
+                                           size_t *ret_progress)
 {
-    return cap_invoke3(root, CNodeCmd_Revoke, cap, level).error;
+    struct sysret sysret = cap_invoke3(root, CNodeCmd_Revoke, cap, level);
+    if (ret_progress != NULL) {
+        *ret_progress = sysret.value;
+    }
+    return sysret.error;
 }
 
 static inline errval_t invoke_cnode_get_state(struct capref root, capaddr_t cap,
@@ -43,6 +43,24 @@ invoke_monitor_create_cap(uint64_t *raw, capaddr_t caddr, int level,
                        owner, (uintptr_t)raw).error;
 }
 
+/**
+ * \brief Create capabilities in consecutive slots
+ *
+ * \param raw        Array of "count" raw capability structs.
+ * \param caddr      The CNode into which to create them.
+ * \param level      The CNode depth (1 or 2).
+ * \param slot       The slot within the CNode of the first capability
+ * \param owner      The owning core
+ * \param count      Number of capabilities in "raw"
+ */
+static inline errval_t
+invoke_monitor_create_caps(struct capability *raw, capaddr_t caddr, int level,
+                           capaddr_t slot, coreid_t owner, size_t count)
+{
+    return cap_invoke7(cap_kernel, KernelCmd_Create_caps, caddr, level, slot,
+                       owner, (uintptr_t)raw, count).error;
+}
+
 /**
  * \brief Duplicate ARMv7 core_data into the supplied frame.
  *
@@ -0,0 +1,182 @@
+/**
+ * \file
+ * \brief Shared-memory request rings kicked over LMP, and the server side
+ *        they have in common
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _AOS_LMP_RING_H_
+#define _AOS_LMP_RING_H_
+
+#include <aos/aos.h>
+
+/*
+ * Each client shares one frame with a service. The frame starts with a
+ * submission and a completion queue of slot indices; what follows, the slots
+ * and their data areas, is up to the service.
+ *
+ * A client connects by sending LMP_RING_CONNECT with its endpoint to the
+ * endpoint the service registered with the nameserver, and gets the endpoint
+ * of a channel private to it back with LMP_RING_OK. It then sends the frame
+ * with LMP_RING_SETUP on that channel.
+ *
+ * From then on a client fills in a free slot, pushes its index to the
+ * submission queue and rings the doorbell with an LMP_RING_KICK message. The
+ * service drains the submission queue, stores the results in the slots,
+ * pushes their indices to the completion queue and kicks the client back.
+ * Kicks carry no state, so one that fails because the receiver's LMP buffer
+ * is full can be dropped: the pending kick will make it look at both queues.
+ *
+ * The service trusts nothing in the frame: it keeps its own queue indices and
+ * drops a client whose queues make no sense or that can no longer be kicked.
+ */
+
+/// Entries in a queue, and so most slots a ring can have; a power of two
+#define LMP_RING_QUEUE_SIZE     16
+
+/// LMP messages between client and service
+#define LMP_RING_CONNECT        1   ///< client endpoint to the service ep
+#define LMP_RING_SETUP          2   ///< ring frame on the client's channel
+#define LMP_RING_KICK           3   ///< queues need looking at
+#define LMP_RING_OK             4   ///< reply to CONNECT and SETUP
+#define LMP_RING_FAIL           5   ///< SETUP was refused
+
+/**
+ * @brief a queue of slot indices, producer and consumer on different sides
+ */
+struct lmp_ring_queue {
+    volatile uint32_t head;     ///< next index to consume
+    volatile uint32_t tail;     ///< next index to produce
+    uint32_t entries[LMP_RING_QUEUE_SIZE];
+};
+
+/**
+ * \brief Appends a slot index to a queue. There is always room, as no more
+ * than LMP_RING_QUEUE_SIZE slots exist.
+ */
+static inline void lmp_ring_push(struct lmp_ring_queue *q, uint32_t slot)
+{
+    q->entries[q->tail % LMP_RING_QUEUE_SIZE] = slot;
+    // the slot and its index must be visible before the new tail
+    __asm volatile ("dmb");
+    q->tail++;
+}
+
+/**
+ * \brief Takes the next slot index off a queue, returns false if it is empty.
+ * Only for queues whose producer is trusted, see lmp_ring_conn_pop.
+ */
+static inline bool lmp_ring_pop(struct lmp_ring_queue *q, uint32_t *slot)
+{
+    if (q->head == q->tail) {
+        return false;
+    }
+    __asm volatile ("dmb");
+    *slot = q->entries[q->head % LMP_RING_QUEUE_SIZE];
+    q->head++;
+    return true;
+}
+
+/**
+ * \brief Sends a kick down a ring channel.
+ */
+static inline errval_t lmp_ring_kick(struct lmp_chan *lc)
+{
+    errval_t err;
+    do {
+        err = lmp_chan_send1(lc, LMP_FLAG_SYNC, NULL_CAP, LMP_RING_KICK);
+    } while (err_no(err) == SYS_ERR_LMP_TARGET_DISABLED);
+
+    // only kicks are queued once the ring is set up, so the receiver will
+    // see one of those
+    if (err_no(err) == SYS_ERR_LMP_BUF_OVERFLOW) {
+        return SYS_ERR_OK;
+    }
+    return err;
+}
+
+/*
+ * Server side
+ */
+
+struct lmp_ring_conn;
+
+/**
+ * @brief what a service built on rings does for its clients
+ */
+struct lmp_ring_service {
+    size_t frame_size;          ///< size of the ring frame
+    int map_flags;              ///< VREGION_FLAGS_* to map it with
+
+    /// the client's ring is mapped; sets up conn->st, *ok_arg goes back to
+    /// the client with LMP_RING_OK
+    errval_t (*setup)(struct lmp_ring_conn *conn, uintptr_t *ok_arg);
+    /// the client kicked, serve its submission queue
+    void (*drain)(struct lmp_ring_conn *conn);
+    /// the client is gone or broken; frees conn->st and calls
+    /// lmp_ring_conn_free once nothing refers to the ring any more
+    void (*drop)(struct lmp_ring_conn *conn);
+};
+
+/**
+ * @brief a connected client
+ */
+struct lmp_ring_conn {
+    struct lmp_chan lc;                 ///< channel private to the client
+    const struct lmp_ring_service *svc;
+    void *ring;                         ///< shared frame, NULL until set up
+    struct capref frame;                ///< cap of the shared frame
+    genpaddr_t ring_base;               ///< physical address of the frame
+    uint32_t sq_head;                   ///< our submission queue head
+    uint32_t cq_tail;                   ///< our completion queue tail
+    bool broken;                        ///< client is to be dropped
+    bool dropped;                       ///< svc->drop has been called
+    void *st;                           ///< service state for the client
+};
+
+/**
+ * \brief Registers service with the nameserver and serves ring clients on the
+ * default waitset. Only one service per domain.
+ */
+errval_t lmp_ring_serve(const char *service,
+                        const struct lmp_ring_service *svc);
+
+/**
+ * \brief Takes the next slot index off a client's submission queue q, keeping
+ * the head to ourselves. Returns false once the queue is empty, or marks the
+ * client broken if the queue or the index makes no sense.
+ */
+bool lmp_ring_conn_pop(struct lmp_ring_conn *conn, struct lmp_ring_queue *q,
+                       uint32_t *slot);
+
+/**
+ * \brief Appends a slot index to a client's completion queue q, keeping the
+ * tail to ourselves.
+ */
+void lmp_ring_conn_push(struct lmp_ring_conn *conn, struct lmp_ring_queue *q,
+                        uint32_t slot);
+
+/**
+ * \brief Kicks a client, marking it broken if that fails.
+ */
+void lmp_ring_conn_kick(struct lmp_ring_conn *conn);
+
+/**
+ * \brief Stops listening to a client and hands it to svc->drop, once.
+ */
+void lmp_ring_conn_drop(struct lmp_ring_conn *conn);
+
+/**
+ * \brief Unmaps the ring of a dropped client and frees the connection.
+ */
+void lmp_ring_conn_free(struct lmp_ring_conn *conn);
+
+#endif /* _AOS_LMP_RING_H_ */
@@ -19,6 +19,7 @@
 #include <errors/errno.h>
 #include <aos/capabilities.h>
 #include <aos/slab.h>
+#include <aos/thread_sync.h>
 #include <barrelfish_kpi/paging_arm_v7.h>
 
 typedef int paging_flags_t;
@@ -57,11 +58,20 @@ enum nodetype {
     NodeType_Parent
 };
 
+// Mapping of (part of) a frame into one L2 pagetable.
+struct paging_mapping {
+    struct capref cap;   ///< Mapping cap returned by vnode_map().
+    uint16_t l2_index;   ///< L1 slot of the L2 pagetable mapped into.
+    bool section;        ///< Mapped as 1MB sections straight into the L1.
+    struct paging_mapping* next;
+};
+
 // Metadata about {free, allocated} vregions.
 struct paging_node {
     lvaddr_t base;       ///< Start of this vregion area.
     size_t size;         ///< Size of this vregion area.
     enum nodetype type;  ///< Type of this vregion area in {free, allocated}.
+    struct paging_mapping* mappings; ///< Mappings of an allocated vregion.
 
     struct paging_node* prev;
     struct paging_node* next;
@@ -82,6 +92,8 @@ struct paging_state {
     struct paging_node* head;
     // Slabs for paging_node's.
     struct slab_allocator slabs;
+    // Slabs for paging_mapping's.
+    struct slab_allocator mapping_slabs;
 
     // Cap to the L1 pagetable of the owner process.
     struct capref l1_pagetable;
@@ -89,6 +101,10 @@ struct paging_state {
     // Callbacks for child processes' caps.
     mapping_cb_t mapping_cb;
     void* mapping_state;
+
+    // Serializes vregion list and pagetable updates between threads. Taken
+    // nested, as the slab refills may fault back into the same state.
+    struct thread_mutex mutex;
 };
 
 struct thread;
@@ -146,6 +162,23 @@ errval_t paging_map_frame_attr(struct paging_state *st, void **buf,
 
 // Whether the paging_node containing vaddr is of type NodeType_Claimed.
 bool is_vregion_claimed(struct paging_state* st, lvaddr_t vaddr);
+/// Bytes from vaddr to the end of its claimed vregion, 0 if not claimed.
+size_t paging_claimed_size(struct paging_state* st, lvaddr_t vaddr);
+/// Claim [vaddr, vaddr + bytes) without mapping it, so it is faulted in.
+errval_t paging_claim_fixed(struct paging_state *st, lvaddr_t vaddr,
+                            size_t bytes);
+/// Free the claimed vregions inside [vaddr, vaddr + bytes) again.
+errval_t paging_unclaim(struct paging_state *st, lvaddr_t vaddr,
+                        size_t bytes);
+
+/**
+ * Zero-initialised objects marked LAZY_BSS end up in the binary's lazy_bss
+ * section. spawn leaves the pages wholly inside it unmapped and paging_init()
+ * claims them, so they are only backed by memory once touched. The trailing
+ * '@' turns the flags gcc appends into an assembler comment.
+ */
+#define LAZY_BSS __attribute__((section("lazy_bss,\"aw\",%nobits@")))
+#define LAZY_BSS_SECTION "lazy_bss"
 
 /// Map user provided frame at user provided VA with given flags.
 errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
@@ -158,9 +191,8 @@ errval_t slab_refill_no_pagefault(struct slab_allocator *slabs,
                                   struct capref frame, size_t minbytes);
 
 /**
- * \brief unmap region starting at address `region`.
- * NOTE: this function is currently here to make libbarrelfish compile. As
- * noted on paging_region_unmap we ignore unmap requests right now.
+ * \brief unmap region starting at address `region`, which must have been
+ * mapped by paging_map_frame_attr() or paging_map_fixed_attr().
  */
 errval_t paging_unmap(struct paging_state *st, const void *region);
 
@@ -433,6 +433,7 @@ enum kernel_cmd {
     KernelCmd_Remove_kcb,         ///< remove kcb from scheduling ring
     KernelCmd_Suspend_kcb_sched,  ///< suspend/resume kcb scheduler
     KernelCmd_Get_platform,       ///< Get architecture platform
+    KernelCmd_Create_caps,        ///< Create several caps in consecutive slots
     KernelCmd_Count
 };
 
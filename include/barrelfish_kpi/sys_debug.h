@@ -34,7 +34,18 @@ enum debug_message {
     DEBUG_FEIGN_FRAME_CAP,
     DEBUG_TRACE_PMEM_CTRL,
     DEBUG_GET_APIC_ID,
-    DEBUG_CREATE_IRQ_SRC_CAP
+    DEBUG_CREATE_IRQ_SRC_CAP,
+    DEBUG_REVOKE_STAT_READ,
+};
+
+/// Per-core revoke counters, read with DEBUG_REVOKE_STAT_READ
+enum revoke_stat {
+    REVOKE_STAT_STARTED,        ///< Revokes started in the kernel
+    REVOKE_STAT_COMPLETED,      ///< Revokes completed in the kernel
+    REVOKE_STAT_STEPS,          ///< Revoke invocations
+    REVOKE_STAT_CTES,           ///< ctes deleted or cleaned up by revokes
+    REVOKE_STAT_TICKS,          ///< Hardware timer ticks spent in revokes
+    REVOKE_STAT_COUNT
 };
 
 #endif //BARRELFISH_KPI_SYS_DEBUG_H
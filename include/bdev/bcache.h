@@ -0,0 +1,53 @@
+/**
+ * \file
+ * \brief Block cache in front of a block device.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _BDEV_BCACHE_H_
+#define _BDEV_BCACHE_H_
+
+#include <bdev/bdev.h>
+
+/// Blocks cached by default
+#define BCACHE_DEFAULT_BLOCKS   2048    // 1MB
+/// Most blocks read ahead of a sequential reader
+#define BCACHE_READAHEAD_MAX    128
+/// Most blocks moved by one request to the device below
+#define BCACHE_BATCH_BLOCKS     128
+
+struct bcache_stats {
+    size_t hits;                ///< blocks read from the cache
+    size_t misses;              ///< blocks read from the device for a reader
+    size_t readahead;           ///< blocks read from the device in advance
+    size_t writebacks;          ///< dirty blocks written to the device
+    size_t write_requests;      ///< requests those were written with
+    size_t evictions;
+};
+
+/**
+ * \brief Creates a cache of nblocks blocks in front of lower.
+ *
+ * Blocks are replaced least recently used first. Reads that continue where
+ * the previous one ended grow a read-ahead window, up to
+ * BCACHE_READAHEAD_MAX blocks. Writes only dirty the cache; dirty blocks are
+ * written back by bdev_flush(), when half the cache is dirty, or when one of
+ * them is to be evicted, in LBA order and merged into runs.
+ */
+errval_t bcache_create(struct bdev *lower, size_t nblocks,
+                       struct bdev **retdev);
+
+/**
+ * \brief Returns the counters of a cache created with bcache_create().
+ */
+void bcache_get_stats(struct bdev *dev, struct bcache_stats *stats);
+
+#endif /* _BDEV_BCACHE_H_ */
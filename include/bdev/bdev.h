@@ -0,0 +1,141 @@
+/**
+ * \file
+ * \brief Block device interface.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _BDEV_BDEV_H_
+#define _BDEV_BDEV_H_
+
+#include <aos/aos.h>
+
+/// Size of a block, the unit of all block device transfers
+#define BDEV_BLOCK_SIZE     512
+
+/// Blocks in a RAM disk created with bdev_open("ramdisk")
+#define BDEV_RAMDISK_DEFAULT_BLOCKS  (8192)    // 4MB
+
+enum bdev_op {
+    BDEV_READ,
+    BDEV_WRITE,
+};
+
+struct bdev;
+struct bdev_req;
+
+/**
+ * \brief Called once all blocks of a request have been transferred, or the
+ * transfer failed.
+ */
+typedef void (*bdev_done_fn)(struct bdev_req *req, errval_t err);
+
+/**
+ * \brief A transfer of count blocks starting at lba, to or from buf. The
+ * request and the buffer belong to the device until done has been called.
+ */
+struct bdev_req {
+    enum bdev_op op;
+    size_t lba;
+    size_t count;
+    void *buf;
+    genpaddr_t paddr;           ///< physical address of buf for DMA, or 0
+    bdev_done_fn done;
+    void *arg;                  ///< for the submitter
+
+    // used by the device while the request is in flight
+    size_t issued;              ///< blocks handed to the backend so far
+    size_t pending;             ///< parts not yet completed
+    errval_t err;               ///< first error of any part
+    struct bdev_req *next;
+};
+
+struct bdev_ops {
+    /// starts a request, which may complete before this returns
+    errval_t (*submit)(struct bdev *dev, struct bdev_req *req);
+    /// runs completions, waiting for one if block is set and any is due
+    errval_t (*poll)(struct bdev *dev, bool block);
+    /// writes back buffered blocks, optional
+    errval_t (*flush)(struct bdev *dev);
+    /// releases the device and frees it, optional
+    void (*close)(struct bdev *dev);
+};
+
+struct bdev {
+    const struct bdev_ops *ops;
+    size_t nblocks;             ///< size of the device in blocks
+    size_t inflight;            ///< requests submitted but not completed
+};
+
+/**
+ * \brief Starts a request; req->done is called once it has completed, from
+ * bdev_submit() itself or from a later bdev_poll().
+ */
+errval_t bdev_submit(struct bdev *dev, struct bdev_req *req);
+
+/**
+ * \brief Runs the callbacks of completed requests. If block is set and
+ * requests are in flight, waits until at least one has completed.
+ */
+errval_t bdev_poll(struct bdev *dev, bool block);
+
+/**
+ * \brief Reads count blocks starting at lba into buf, waiting for them.
+ */
+errval_t bdev_read(struct bdev *dev, size_t lba, size_t count, void *buf);
+
+/**
+ * \brief Writes count blocks from buf starting at lba, waiting for them.
+ */
+errval_t bdev_write(struct bdev *dev, size_t lba, size_t count,
+                    const void *buf);
+
+/**
+ * \brief Writes back blocks that dev buffers, waiting for them.
+ */
+errval_t bdev_flush(struct bdev *dev);
+
+/**
+ * \brief Releases dev, which must have no requests in flight. Blocks still
+ * buffered in dev are dropped, bdev_flush() first to keep them. A cache does not
+ * close the device below it.
+ */
+void bdev_close(struct bdev *dev);
+
+/**
+ * \brief Opens a block device by name: "ramdisk" creates a RAM disk private
+ * to this domain, anything else connects to the block device service of
+ * that name.
+ */
+errval_t bdev_open(const char *name, struct bdev **retdev);
+
+/**
+ * \brief Creates a zero-filled RAM disk of nblocks blocks.
+ */
+errval_t bdev_ramdisk_create(size_t nblocks, struct bdev **retdev);
+
+/**
+ * \brief Connects to the block device service registered as service.
+ */
+errval_t bdev_connect(const char *service, struct bdev **retdev);
+
+/**
+ * \brief Serves dev to other domains as service, registered with the
+ * nameserver. Requests are handled on the default waitset.
+ */
+errval_t bdev_serve(const char *service, struct bdev *dev);
+
+/**
+ * \brief Completes part of a request; for backends. Calls req->done once
+ * the last part has been completed.
+ */
+void bdev_req_complete(struct bdev *dev, struct bdev_req *req, errval_t err);
+
+#endif /* _BDEV_BDEV_H_ */
@@ -0,0 +1,61 @@
+/**
+ * \file
+ * \brief Shared-memory request ring between a block device service and its
+ *        clients.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _BDEV_BDEV_RING_H_
+#define _BDEV_BDEV_RING_H_
+
+#include <aos/aos.h>
+#include <aos/lmp_ring.h>
+#include <bdev/bdev.h>
+
+/*
+ * A request ring (see aos/lmp_ring.h) with a data area per slot. The service
+ * answers LMP_RING_SETUP with the number of blocks. The service transfers
+ * straight to and from the data areas, so a backend that can do DMA into
+ * the frame never copies the data. As devices do not snoop the caches,
+ * both sides map the frame uncached.
+ */
+
+/// Number of request slots
+#define BDEV_RING_SLOTS         LMP_RING_QUEUE_SIZE
+/// Blocks transferred by one slot at most
+#define BDEV_RING_SLOT_BLOCKS   32
+#define BDEV_RING_DATA_SIZE     (BDEV_RING_SLOT_BLOCKS * BDEV_BLOCK_SIZE)
+#define BDEV_RING_DATA_OFFSET   BASE_PAGE_SIZE
+#define BDEV_RING_FRAME_SIZE \
+    (BDEV_RING_DATA_OFFSET + BDEV_RING_SLOTS * BDEV_RING_DATA_SIZE)
+
+struct bdev_ring_slot {
+    uint32_t op;                ///< enum bdev_op
+    uint32_t lba;
+    uint32_t count;             ///< at most BDEV_RING_SLOT_BLOCKS
+    errval_t err;               ///< result, set by the service
+};
+
+struct bdev_ring {
+    struct lmp_ring_queue sq;   ///< submissions, produced by the client
+    struct lmp_ring_queue cq;   ///< completions, produced by the service
+    struct bdev_ring_slot slots[BDEV_RING_SLOTS];
+};
+
+STATIC_ASSERT(sizeof(struct bdev_ring) <= BDEV_RING_DATA_OFFSET,
+              "bdev_ring header must fit in front of the data areas");
+
+static inline void *bdev_ring_data(struct bdev_ring *ring, uint32_t slot)
+{
+    return (uint8_t *)ring + BDEV_RING_DATA_OFFSET + slot * BDEV_RING_DATA_SIZE;
+}
+
+#endif /* _BDEV_BDEV_RING_H_ */
@@ -792,6 +792,8 @@ void elf32_relocate(genvaddr_t dst, genvaddr_t src,
                     struct Elf32_Sym * symtab, size_t symsize,
                     genvaddr_t start, void *vbase);
 
+/// Segment allocator. Setting *ret to NULL on success tells the loader the
+/// segment is already populated, so it is neither copied nor relocated.
 typedef errval_t (*elf_allocator_fn)(void *state, genvaddr_t base,
                                      size_t size, uint32_t flags, void **ret);
 
@@ -0,0 +1,42 @@
+/**
+ * \file
+ * \brief FAT32 file system on a block device.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef FS_FAT32_H_
+#define FS_FAT32_H_
+
+#include <fs/fs.h>
+#include <bdev/bdev.h>
+
+typedef void *fat32_mount_t;
+
+/**
+ * \brief Mounts the FAT32 volume on dev.
+ *
+ * If block 0 of dev is a FAT32 boot sector, dev holds a single volume and
+ * partition must be 0. Otherwise block 0 is taken as an MBR and the volume is
+ * the partition-th entry of its partition table.
+ *
+ * The whole FAT is kept in memory, as is every directory once it has been
+ * looked into. Changes reach dev when a file that was written is closed and
+ * after each directory operation; dev should be a block cache, since the
+ * backend issues many small requests.
+ */
+errval_t fat32_mount(struct bdev *dev, size_t partition, fat32_mount_t *retst);
+
+/**
+ * \brief Writes an empty FAT32 file system, without partition table, on dev.
+ */
+errval_t fat32_format(struct bdev *dev, const char *label);
+
+#endif /* FS_FAT32_H_ */
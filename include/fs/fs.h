@@ -42,6 +42,10 @@ struct fs_fileinfo {
  * @return SYS_ERR_OK on success
  *         errval on failure
  *
+ * The root is mounted from the file system server init starts on core 0,
+ * "fsserver://ramfs/", so files are shared between domains. If it cannot be
+ * reached, the domain gets a private ramfs instead.
+ *
  * NOTE: This has to be called before any access to the files
  */
 errval_t filesystem_init(void);
@@ -55,10 +59,58 @@ errval_t filesystem_init(void);
  * @return SYS_ERR_OK on success
  *         errval on error
  *
- * This mounts the uri at a given, existing path.
+ * This mounts the uri at a given, existing path. If the file system type
+ * after "://" is "fat32", the part before names a block device as given to
+ * bdev_open(), e.g. "mmchs://fat32/0" for the first partition of the SD card
+ * or "ramdisk://fat32/" for a freshly formatted RAM disk. Otherwise it names
+ * the backend: "ramfs" mounts a fresh ramfs private to the domain, anything
+ * else is the nameserver name of a file system server, e.g.
+ * "fsserver://ramfs/" for the one init starts on core 0.
  */
 errval_t filesystem_mount(const char *path, const char *uri);
 
+/**
+ * @brief maps part of an open file into the address space
+ *
+ * @param fd      file descriptor of the file, e.g. fileno() of a FILE
+ * @param offset  page aligned offset into the file
+ * @param bytes   number of bytes to map
+ * @param flags   VREGION_FLAGS_* to map the data with
+ * @param retbuf  returns the address of the mapping
+ *
+ * @return SYS_ERR_OK on success
+ *         errval on error
+ *
+ * The file data is not copied; with VREGION_FLAGS_WRITE, stores to the mapping
+ * change the file.
+ */
+errval_t fs_mmap(int fd, size_t offset, size_t bytes, int flags,
+                 void **retbuf);
+
+/**
+ * @brief removes a mapping created by fs_mmap
+ */
+errval_t fs_munmap(void *buf);
+
+/// Size of the buffer of a file descriptor, unless changed with fs_setbuf
+#define FS_FDBUF_DEFAULT_SIZE   (16 * 1024)
+
+/**
+ * @brief sets the size of the buffer of an open file
+ *
+ * @param fd     file descriptor of the file
+ * @param bytes  new buffer size, 0 to pass every read and write on
+ *
+ * @return SYS_ERR_OK on success
+ *         errval on error
+ *
+ * Reads smaller than the buffer fetch a whole buffer from the backend, and
+ * small writes are collected until the buffer is full, the file is read,
+ * seeked away from the end of them, mapped or closed. Other handles of the
+ * file do not see buffered writes before that.
+ */
+errval_t fs_setbuf(int fd, size_t bytes);
+
 
 /*
  * ===========================================================================
@@ -0,0 +1,93 @@
+/**
+ * \file fs_ring.h
+ * \brief Shared-memory request ring between the file system server and its
+ *        clients
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef FS_FS_RING_H_
+#define FS_FS_RING_H_
+
+#include <aos/aos.h>
+#include <aos/lmp_ring.h>
+
+/*
+ * A request ring (see aos/lmp_ring.h) whose first page holds the queues and
+ * the request slots, followed by one data page per slot for paths, file data
+ * and directory entry names. The server copies each slot before looking at
+ * it.
+ *
+ * A read or write split over several slots marks all but the first part as
+ * chained (arg1). The server skips a chained part, failing it with
+ * FS_ERR_SKIPPED, once the part before it failed or came up short, so the
+ * file is not touched past the point the transfer stopped at.
+ */
+
+/// Name the server registers with the nameserver
+#define FS_RING_SERVICE         "fsserver"
+
+/// Number of request slots
+#define FS_RING_SLOTS           LMP_RING_QUEUE_SIZE
+/// Size of the data page of each slot
+#define FS_RING_DATA_SIZE       BASE_PAGE_SIZE
+/// Offset of the data page of the first slot
+#define FS_RING_DATA_OFFSET     BASE_PAGE_SIZE
+/// Size of the frame shared with the server
+#define FS_RING_FRAME_SIZE \
+    (FS_RING_DATA_OFFSET + FS_RING_SLOTS * FS_RING_DATA_SIZE)
+
+enum fs_ring_op {
+    FS_RING_OP_OPEN,            ///< data: path, ret0: handle
+    FS_RING_OP_CREATE,          ///< data: path, ret0: handle
+    FS_RING_OP_REMOVE,          ///< data: path
+    FS_RING_OP_READ,            ///< arg0: bytes, arg1: chained,
+                                ///< ret0: bytes read into data
+    FS_RING_OP_WRITE,           ///< arg0: bytes in data, arg1: chained,
+                                ///< ret0: bytes written
+    FS_RING_OP_TRUNCATE,        ///< arg0: new size
+    FS_RING_OP_SEEK,            ///< arg0: whence, arg1: offset, ret0: position
+    FS_RING_OP_STAT,            ///< ret0: type, ret1: size
+    FS_RING_OP_CLOSE,
+    FS_RING_OP_OPENDIR,         ///< data: path, ret0: handle
+    FS_RING_OP_READDIR,         ///< data: name, ret0: type, ret1: size
+    FS_RING_OP_CLOSEDIR,
+    FS_RING_OP_MKDIR,           ///< data: path
+    FS_RING_OP_RMDIR,           ///< data: path
+};
+
+/**
+ * @brief a request and, once completed, its result
+ */
+struct fs_ring_slot {
+    uint32_t op;                ///< enum fs_ring_op
+    uint32_t handle;            ///< server handle the request refers to
+    uint32_t arg0;
+    uint32_t arg1;
+    errval_t err;               ///< result of the request
+    uint32_t ret0;
+    uint32_t ret1;
+};
+
+struct fs_ring {
+    struct lmp_ring_queue sq;   ///< submissions, produced by the client
+    struct lmp_ring_queue cq;   ///< completions, produced by the server
+    struct fs_ring_slot slots[FS_RING_SLOTS];
+};
+
+STATIC_ASSERT(sizeof(struct fs_ring) <= FS_RING_DATA_OFFSET,
+              "fs_ring header must fit in front of the data pages");
+
+static inline void *fs_ring_data(struct fs_ring *ring, uint32_t slot)
+{
+    return (uint8_t *)ring + FS_RING_DATA_OFFSET + slot * FS_RING_DATA_SIZE;
+}
+
+#endif /* FS_FS_RING_H_ */
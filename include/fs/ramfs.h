@@ -24,9 +24,33 @@ errval_t ramfs_remove(void *st, const char *path);
 errval_t ramfs_read(void *st, ramfs_handle_t handle, void *buffer, size_t bytes,
                     size_t *bytes_read);
 
+/**
+ * \brief Returns the file data at the current position without copying it,
+ * up to the end of the page it is in, and advances the position past it.
+ * The span stays valid until the file is written, truncated or removed.
+ */
+errval_t ramfs_read_span(void *st, ramfs_handle_t handle, const void **retbuf,
+                         size_t *bytes_read);
+
 errval_t ramfs_write(void *st, ramfs_handle_t handle, const void *buffer,
                      size_t bytes, size_t *bytes_written);
 
+/**
+ * \brief Maps the file data at [offset, offset + bytes) into the vspace, with
+ * the VREGION_FLAGS_* given in flags. The mapping shares the pages of the
+ * file, so writes through a writable mapping are seen by ramfs_read and the
+ * other way round. The offset must be page aligned and the range must not
+ * extend beyond the last page of the file. While mapped, the file can neither
+ * be removed nor truncated below its size.
+ */
+errval_t ramfs_mmap(void *st, ramfs_handle_t handle, size_t offset,
+                    size_t bytes, int flags, void **retbuf);
+
+/**
+ * \brief Unmaps a mapping returned by ramfs_mmap.
+ */
+errval_t ramfs_munmap(void *st, void *buf);
+
 errval_t ramfs_truncate(void *st, ramfs_handle_t handle, size_t bytes);
 
 errval_t ramfs_tell(void *st, ramfs_handle_t handle, size_t *pos);
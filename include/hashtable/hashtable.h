@@ -60,6 +60,11 @@ struct hashtable* create_hashtable2(int capacity, int loadFactor);
  */
 struct hashtable* create_hashtable(void);
 
+/**
+ * \brief free a hashtable and its entries, but not the keys or values
+ */
+void hashtable_destroy(struct hashtable *ht);
+
 void print_hashtable(FILE *stream, struct hashtable *ht);
 
 __END_DECLS
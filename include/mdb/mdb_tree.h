@@ -94,6 +94,11 @@ int mdb_check_invariants(void);
 // Insert a cap into the tree. An error (MDB_DUPLICATE_ENTRY) is returned iff
 // the cap is already present in the tree.
 errval_t mdb_insert(struct cte *new_node);
+// Insert an array of count caps. If they are sorted, and there are enough of
+// them compared to the size of the tree, the tree is rebuilt balanced in a
+// single pass instead of rebalancing after each insert. Caps already present
+// are skipped and reported with MDB_DUPLICATE_ENTRY.
+errval_t mdb_insert_bulk(struct cte *nodes, size_t count);
 // Remove a cap from the tree. An error (MDB_ENTRY_NOTFOUND) is returned iff
 // the cap is not present in the tree.
 errval_t mdb_remove(struct cte *node);
@@ -114,6 +119,10 @@ struct cte *mdb_find_less(struct capability *cap, bool equal_ok);
 // @param equal_ok If true, will return a copy of the passed cap if it is
 //        present.
 struct cte *mdb_find_greater(struct capability *cap, bool equal_ok);
+// Find the smallest cap in the tree that is later in the ordering than a cte
+// at address pos holding cap. pos does not need to be in the tree (anymore),
+// so this can resume a walk at a cte that has since been removed.
+struct cte *mdb_find_after(struct capability *cap, struct cte *pos);
 
 // Find a cap in the given range.
 // @param root indicates which type tree root to search through (usually
@@ -16,4 +16,11 @@ struct mem_region *multiboot_find_module(struct bootinfo *bi, const char *name);
 // Return module name
 const char *multiboot_module_name(struct mem_region *region);
 
+// Map a module's frame in my vspace, sharing the mapping between users
+errval_t multiboot_module_map(struct mem_region *module, void **ret_vaddr,
+                              size_t *ret_bytes);
+
+// Drop a mapping taken with multiboot_module_map(), unmapping on the last
+errval_t multiboot_module_unmap(struct mem_region *module);
+
 #endif
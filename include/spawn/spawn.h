@@ -17,11 +17,13 @@
 
 #include "aos/slot_alloc.h"
 #include "aos/paging.h"
+#include <barrelfish_kpi/domain_params.h>
 
 struct spawninfo {
 
     // Information about the binary
     char * binary_name;     // Name of the binary
+    struct mem_region *module;  // Multiboot module the binary comes from
 
     // Cap for L1Cnode.
     struct capref l1_cnode_cap;
@@ -41,6 +43,7 @@ struct spawninfo {
     // Child's dispatcher.
     struct capref dispatcher;
     struct capref dispatcher_frame;
+    // My mapping of the dispatcher frame, released when the child is started.
     dispatcher_handle_t disp_handle;
     arch_registers_state_t* enabled_area;
 
@@ -49,6 +52,23 @@ struct spawninfo {
     genvaddr_t entry_point;
 };
 
+/// Maximum number of (page-aligned) ELF segments in a spawn template
+#define SPAWN_TEMPLATE_SEGMENTS 8
+
+/// Most of a client's argument frame that is copied and looked at
+#define SPAWN_ARGS_FRAME_MAX (16 * BASE_PAGE_SIZE)
+
+/// A binary loaded once from its module, from which instances are cloned
+struct spawn_template;
+
+// Get the template for a binary, loading it on first use.
+errval_t spawn_template_get(const char *binary_name,
+        struct spawn_template **ret);
+
+// Start a new instance of a loaded binary. Fills in si
+errval_t spawn_clone_template(struct spawn_template *tmpl,
+        struct spawninfo *si, coreid_t core_id, char *extra_args);
+
 // Start a child process by binary name. Fills in si
 errval_t spawn_load_by_name(void * binary_name, struct spawninfo * si,
         coreid_t core_id);
@@ -56,16 +76,43 @@ errval_t spawn_load_by_name(void * binary_name, struct spawninfo * si,
 errval_t spawn_load_by_name_args(void * binary_name, struct spawninfo * si,
         coreid_t core_id, char* extra_args);
 
+/**
+ * A client-built argument block, copied into a frame of its own that becomes
+ * the child's arguments page. Only spawn writes to that frame, so the block
+ * is checked in place.
+ */
+struct spawn_args {
+    struct capref frame;
+    struct spawn_domain_params* params;  // frame in my vspace, NULL once given
+    size_t bytes;                        // length of the block in use
+    size_t envc;
+};
+
+// Copy bytes of a client-built argument block from src into a new frame and
+// check it there. Nothing is left to free if this fails.
+errval_t spawn_args_copy(const void* src, size_t bytes,
+        struct spawn_args* args);
+
+// Release an argument block that did not make it into a child.
+void spawn_args_free(struct spawn_args* args);
+
+// Start a child process from an argument block copied by spawn_args_copy,
+// whose argv[0] names the binary. Fills in si; the caller frees
+// si->binary_name and the block with spawn_args_free if this fails.
+errval_t spawn_load_args(struct spawn_args* args, struct spawninfo * si,
+        coreid_t core_id);
+
 errval_t setup_cspace(struct spawninfo *si);
 errval_t mapping_cb(void* mapping_state, struct capref cap);
 errval_t setup_vspace(struct spawninfo *si);
-errval_t setup_elf(struct spawninfo* si, lvaddr_t vaddr, size_t bytes);
-errval_t elf_alloc_section(void* sate, genvaddr_t base, size_t bytes,
+errval_t setup_elf(struct spawninfo* si, struct spawn_template* tmpl);
+errval_t elf_alloc_section(void* state, genvaddr_t base, size_t bytes,
         uint32_t flags, void** ret);
 errval_t setup_dispatcher(struct spawninfo *si, coreid_t core_id);
 errval_t elf_section_allocate(void *state, genvaddr_t base, size_t size,
                               uint32_t flags, void **ret);
 errval_t setup_args(struct spawninfo* si, struct mem_region* mr);
 errval_t setup_args_extra(struct spawninfo* si, struct mem_region* mr, char *extra);
+errval_t setup_args_frame(struct spawninfo* si, struct spawn_args* args);
 
 #endif /* _INIT_SPAWN_H_ */
@@ -244,6 +244,8 @@ int          isatty(int fd);
 int          link(const char *oldpath, const char *newpath);
 off_t        lseek(int fd, off_t offset, int whence);
 int          pipe(int pipefd[2]);
+ssize_t      pread(int fd, void *buf, size_t len, off_t offset);
+ssize_t      pwrite(int fd, const void *buf, size_t len, off_t offset);
 int          read(int fd, void *buf, size_t len);
 ssize_t      readlink(const char *path, char *buf, size_t bufsize);
 int          rmdir(const char*pathname);
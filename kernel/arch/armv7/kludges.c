@@ -22,11 +22,13 @@ void dbg_break(void)
 #endif
 }
 
+#ifndef CONFIG_MICROBENCHMARKS
 extern void arch_benchmarks(void);
 void arch_benchmarks(void) { dbg_break(); }
 
 extern void arch_benchmarks_size(void);
 void arch_benchmarks_size(void) { dbg_break(); }
+#endif
 
 extern void conio_putchar(void);
 void conio_putchar(void) { /* Don't break here yet! */ }
@@ -0,0 +1,173 @@
+/**
+ * \file
+ * \brief ARMv7-specific microbenchmarks.
+ *
+ * Page table and context switch benchmarks, run after the generic ones in
+ * kernel/microbenchmarks.c on the same set of benchmark objects.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr. 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <kernel.h>
+#include <string.h>
+#include <barrelfish_kpi/paging_arch.h>
+#include <capabilities.h>
+#include <cp15.h>
+#include <dispatch.h>
+#include <microbenchmarks.h>
+#include <paging_kernel_arch.h>
+#include <platform.h>
+#include <startup_arch.h>
+
+/// Arch fixtures in the benchmark CNode
+enum armv7_microbench_slot {
+    ARMV7_MB_SLOT_PTABLE = MICROBENCH_SLOT_ARCH, ///< Floating L2 page table
+    ARMV7_MB_SLOT_MAPPING,                       ///< Mapping of the frame
+};
+
+/// Slot in the floating L2 page table that the map benchmarks use
+#define ARMV7_MB_PTE_SLOT   0
+
+/**
+ * \brief Benchmark clock: the global timer, as exposed to user space.
+ */
+uint64_t microbench_timestamp(void)
+{
+    return timestamp_read();
+}
+
+static struct cte *armv7_microbench_ptable(void)
+{
+    struct cte *ptable = microbench_slot(ARMV7_MB_SLOT_PTABLE);
+    if (ptable->cap.type == ObjType_Null) {
+        size_t bytes = vnode_objsize(ObjType_VNode_ARM_l2);
+        errval_t err = caps_create_new(ObjType_VNode_ARM_l2,
+                                       microbench_alloc(bytes, bytes),
+                                       bytes, 0, my_core_id, ptable);
+        if (err_is_fail(err)) {
+            return NULL;
+        }
+    }
+    return ptable;
+}
+
+static int vnode_map_benchmark(struct microbench *mb)
+{
+    struct cte *ptable = armv7_microbench_ptable();
+    struct cte *frame = microbench_slot(MICROBENCH_SLOT_FRAME);
+    struct cte *mapping = microbench_slot(ARMV7_MB_SLOT_MAPPING);
+    if (ptable == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_copy_to_vnode(ptable, ARMV7_MB_PTE_SLOT, frame,
+                                          KPI_PAGING_FLAGS_READ |
+                                          KPI_PAGING_FLAGS_WRITE,
+                                          0, 1, mapping);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err) ||
+            err_is_fail(page_mappings_unmap(&ptable->cap, mapping)) ||
+            err_is_fail(caps_delete(mapping))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int vnode_unmap_benchmark(struct microbench *mb)
+{
+    struct cte *ptable = armv7_microbench_ptable();
+    struct cte *frame = microbench_slot(MICROBENCH_SLOT_FRAME);
+    struct cte *mapping = microbench_slot(ARMV7_MB_SLOT_MAPPING);
+    if (ptable == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        errval_t err = caps_copy_to_vnode(ptable, ARMV7_MB_PTE_SLOT, frame,
+                                          KPI_PAGING_FLAGS_READ |
+                                          KPI_PAGING_FLAGS_WRITE,
+                                          0, 1, mapping);
+        if (err_is_fail(err)) {
+            return -1;
+        }
+        uint64_t start = microbench_timestamp();
+        err = page_mappings_unmap(&ptable->cap, mapping);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err) || err_is_fail(caps_delete(mapping))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int retype_vnode_l1_benchmark(struct microbench *mb)
+{
+    return microbench_retype(mb, ObjType_VNode_ARM_l1,
+                             vnode_objsize(ObjType_VNode_ARM_l1));
+}
+
+static int retype_vnode_l2_benchmark(struct microbench *mb)
+{
+    return microbench_retype(mb, ObjType_VNode_ARM_l2,
+                             vnode_objsize(ObjType_VNode_ARM_l2));
+}
+
+/**
+ * \brief Switch address spaces back and forth between the two fake
+ * dispatchers.
+ *
+ * Each sample is one switch A -> B -> A, including the TLB and cache
+ * maintenance that paging_context_switch() does without ASIDs.
+ */
+static int context_switch_benchmark(struct microbench *mb)
+{
+    struct dcb *a = microbench_dcb(MICROBENCH_SLOT_DISP_A);
+    struct dcb *b = microbench_dcb(MICROBENCH_SLOT_DISP_B);
+
+    // Empty user address spaces; the kernel lives in TTBR1
+    if (a->vspace == 0) {
+        a->vspace = microbench_alloc(INIT_L1_BYTES, ARM_L1_ALIGN);
+        memset((void *)local_phys_to_mem(a->vspace), 0, INIT_L1_BYTES);
+    }
+    if (b->vspace == 0) {
+        b->vspace = microbench_alloc(INIT_L1_BYTES, ARM_L1_ALIGN);
+        memset((void *)local_phys_to_mem(b->vspace), 0, INIT_L1_BYTES);
+    }
+
+    lpaddr_t old_ttbr = cp15_read_ttbr0();
+    uint64_t old_csc = dispatch_get_csc();
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        context_switch(b);
+        context_switch(a);
+        microbench_sample(mb, microbench_timestamp() - start);
+    }
+
+    paging_context_switch(old_ttbr);
+    context_switch_counter = old_csc;
+
+    return 0;
+}
+
+struct microbench arch_benchmarks[] = {
+    { .name = "vnode_map",          .run_func = vnode_map_benchmark },
+    { .name = "vnode_unmap",        .run_func = vnode_unmap_benchmark },
+    { .name = "retype_vnode_l1",    .run_func = retype_vnode_l1_benchmark },
+    { .name = "retype_vnode_l2",    .run_func = retype_vnode_l2_benchmark },
+    { .name = "context_switch",     .run_func = context_switch_benchmark },
+};
+
+size_t arch_benchmarks_size = ARRAY_LENGTH(arch_benchmarks);
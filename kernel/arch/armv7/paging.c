@@ -392,6 +392,9 @@ caps_map_l1(struct capability* dest,
             entry->raw = 0;
 
             entry->section.type = L1_TYPE_SECTION_ENTRY;
+            /* Same memory attributes as paging_set_flags() gives pages. */
+            entry->section.tex = 1;
+            entry->section.shareable = 1;
             entry->section.bufferable = 1;
             entry->section.cacheable = (kpi_paging_flags & KPI_PAGING_FLAGS_NOCACHE)? 0: 1;
             entry->section.ap10 = (kpi_paging_flags & KPI_PAGING_FLAGS_READ)? 2:0;
@@ -399,14 +402,14 @@ caps_map_l1(struct capability* dest,
             entry->section.ap2 = 0;
             entry->section.base_address = (src_lpaddr + i * BYTES_PER_SECTION) >> 20;
 
-            entry++;
-
             /* Clean the modified entry to L2 cache. */
             clean_to_pou(entry);
 
-            debug(SUBSYS_PAGING, "L2 mapping %08"PRIxLVADDR"[%"PRIuCSLOT
+            debug(SUBSYS_PAGING, "L1 section mapping %08"PRIxLVADDR"[%"PRIuCSLOT
                                  "] @%p = %08"PRIx32"\n",
-                   dest_lvaddr, slot, entry, entry->raw);
+                   dest_lvaddr, slot + i, entry, entry->raw);
+
+            entry++;
         }
 
         // Flush TLB if remapping.
@@ -30,6 +30,9 @@
 #include <global.h>
 #include <kcb.h>
 #include <gic.h>
+#ifdef CONFIG_MICROBENCHMARKS
+#include <microbenchmarks.h>
+#endif
 
 #define CNODE(cte)              get_address(&cte->cap)
 #define UNUSED(x)               (x) = (x)
@@ -641,6 +644,14 @@ spawn_bsp_init(const char *name,
     disp_arm->disabled_save_area.named.cpsr = ARM_MODE_USR | CPSR_F_MASK;
     disp_arm->disabled_save_area.named.r9   = got_base;
 
+#ifdef CONFIG_MICROBENCHMARKS
+    /* Run the benchmarks on memory that is never handed to init. */
+    MSG("Running microbenchmarks\n");
+    microbenchmarks_run_all(alloc_phys_aligned(MICROBENCH_SCRATCH_BYTES,
+                                               MICROBENCH_SCRATCH_ALIGN),
+                            MICROBENCH_SCRATCH_BYTES);
+#endif
+
     /* Create caps for init to use */
     create_module_caps(&spawn_state);
     lpaddr_t init_alloc_end = alloc_phys(0); // XXX
@@ -312,7 +312,11 @@ handle_revoke(
     capaddr_t cptr = (capaddr_t)sa->arg2;
     int     level = (int)sa->arg3;
 
-    return sys_revoke(root, cptr, level);
+    uint64_t start = timestamp_read();
+    struct sysret r = sys_revoke(root, cptr, level);
+    caps_revoke_stats[REVOKE_STAT_TICKS] += timestamp_read() - start;
+
+    return r;
 }
 
 static struct sysret
@@ -743,6 +747,83 @@ monitor_create_cap(
                                             slot, owner, src));
 }
 
+/**
+ * \brief Create an array of capabilities in consecutive slots of one CNode.
+ * Like monitor_create_cap, but a secondary core can forge all of its module
+ * caps with a single invocation.
+ */
+static struct sysret
+monitor_create_caps(
+    struct capability *kernel_cap,
+    arch_registers_state_t* context,
+    int argc
+    )
+{
+    assert(8 == argc);
+
+    struct registers_arm_syscall_args* sa = &context->syscall_args;
+
+    capaddr_t cnode_cptr = sa->arg2;
+    int cnode_level      = sa->arg3;
+    size_t slot          = sa->arg4;
+    coreid_t owner       = sa->arg5;
+    struct capability *src =
+        (struct capability*)sa->arg6;
+    size_t count         = sa->arg7;
+
+    if (count > SIZE_MAX / sizeof(struct capability) ||
+        !access_ok(ACCESS_READ, sa->arg6, count * sizeof(struct capability))) {
+        return SYSRET(SYS_ERR_INVALID_USER_BUFFER);
+    }
+
+    struct capability *cnode;
+    errval_t err = caps_lookup_cap(&dcb_current->cspace.cap, cnode_cptr,
+                                   cnode_level, &cnode, CAPRIGHTS_READ_WRITE);
+    if (err_is_fail(err)) {
+        return SYSRET(err_push(err, SYS_ERR_SLOT_LOOKUP_FAIL));
+    }
+    if (cnode->type != ObjType_L1CNode && cnode->type != ObjType_L2CNode) {
+        return SYSRET(SYS_ERR_CNODE_TYPE);
+    }
+    if (count > cnode_get_slots(cnode) ||
+        slot > cnode_get_slots(cnode) - count) {
+        return SYSRET(SYS_ERR_SLOTS_INVALID);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        /* Same restrictions as for a single cap */
+        if (src[i].type == ObjType_Null) {
+            return SYSRET(SYS_ERR_ILLEGAL_DEST_TYPE);
+        }
+        if ((src[i].type == ObjType_EndPoint
+             || src[i].type == ObjType_Dispatcher
+             || src[i].type == ObjType_Kernel
+             || src[i].type == ObjType_IRQTable)
+            && owner == my_core_id)
+        {
+            return SYSRET(SYS_ERR_ILLEGAL_DEST_TYPE);
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        err = caps_create_from_existing(&dcb_current->cspace.cap,
+                                        cnode_cptr, cnode_level,
+                                        slot + i, owner, &src[i]);
+        if (err_is_fail(err)) {
+            /* All or nothing: drop the caps created so far */
+            while (i-- > 0) {
+                struct cte *cte = caps_locate_slot(get_address(cnode),
+                                                   slot + i);
+                remove_mapping(cte);
+                memset(cte, 0, sizeof(*cte));
+            }
+            return SYSRET(err);
+        }
+    }
+
+    return SYSRET(SYS_ERR_OK);
+}
+
 INVOCATION_HANDLER(monitor_get_platform)
 {
     INVOCATION_PRELUDE(3);
@@ -1033,6 +1114,7 @@ static invocation_t invocations[ObjType_Num][CAP_MAX_CMD] = {
         [KernelCmd_Clear_step]        = monitor_handle_clear_step,
         [KernelCmd_Copy_existing]     = monitor_copy_existing,
         [KernelCmd_Create_cap]        = monitor_create_cap,
+        [KernelCmd_Create_caps]       = monitor_create_caps,
         [KernelCmd_Delete_foreigns]   = monitor_handle_delete_foreigns,
         [KernelCmd_Delete_last]       = monitor_handle_delete_last,
         [KernelCmd_Delete_step]       = monitor_handle_delete_step,
@@ -1167,7 +1249,15 @@ handle_invoke(arch_registers_state_t *context, int argc)
                         assert(context == &disp->enabled_save_area);
                         context->named.r0 = r.error;
                     }
-                    dispatch(listener);
+                    if (sync && err_is_ok(r.error)) {
+                        lmp_handoff(dcb_current, listener);
+                    } else {
+                        dispatch(listener);
+                    }
+                } else if (err_is_ok(r.error)
+                           && dcb_current->lmp_donor == listener) {
+                    // an asynchronous reply also ends the donation
+                    lmp_donation_clear(dcb_current);
                 }
             }
             else {
@@ -1200,7 +1290,7 @@ handle_invoke(arch_registers_state_t *context, int argc)
     return r;
 }
 
-static struct sysret handle_debug_syscall(int msg)
+static struct sysret handle_debug_syscall(int msg, uintptr_t arg)
 {
     struct sysret retval = { .error = SYS_ERR_OK };
     switch (msg) {
@@ -1239,6 +1329,14 @@ static struct sysret handle_debug_syscall(int msg)
             retval.value = (uint32_t)(timestamp_read() >> 32);
             break;
 
+        case DEBUG_REVOKE_STAT_READ:
+            if (arg < REVOKE_STAT_COUNT) {
+                retval.value = caps_revoke_stats[arg];
+            } else {
+                retval.error = SYS_ERR_ILLEGAL_SYSCALL;
+            }
+            break;
+
         default:
             printk(LOG_ERR, "invalid sys_debug msg type %d\n", msg);
             retval.error = err_push(retval.error, SYS_ERR_ILLEGAL_SYSCALL);
@@ -1318,8 +1416,8 @@ void sys_syscall(arch_registers_state_t* context,
             break;
 
         case SYSCALL_DEBUG:
-            if (argc == 2) {
-                r = handle_debug_syscall(sa->arg1);
+            if (argc == 2 || argc == 3) {
+                r = handle_debug_syscall(sa->arg1, argc == 3 ? sa->arg2 : 0);
             }
             break;
 
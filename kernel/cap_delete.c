@@ -28,16 +28,18 @@
 #include <mdb/mdb_tree.h>
 #include <wakeup.h>
 
-struct cte *clear_head, *clear_tail;
-struct cte *delete_head, *delete_tail;
+/// Delete and clear lists of the delete cascades driven by the monitor
+static struct delete_queue delete_queue, clear_queue;
 
 static errval_t caps_try_delete(struct cte *cte);
 static errval_t cleanup_copy(struct cte *cte);
 static errval_t cleanup_last(struct cte *cte, struct cte *ret_ram_cap);
 static void caps_mark_revoke_copy(struct cte *cte);
-static void caps_mark_revoke_generic(struct cte *cte);
-static void clear_list_prepend(struct cte *cte);
+static void caps_mark_revoke_generic(struct cte *cte, struct delete_queue *dq);
+static void clear_list_prepend(struct delete_queue *cq, struct cte *cte);
 static errval_t caps_copyout_last(struct cte *target, struct cte *ret_cte);
+static errval_t delete_last(struct cte *cte, struct cte *ret_ram_cap,
+                            struct delete_queue *dq, struct delete_queue *cq);
 
 /**
  * \brief Try a "simple" delete of a cap. If this fails, the monitor needs to
@@ -71,6 +73,16 @@ static errval_t caps_try_delete(struct cte *cte)
  *      propagated to (remote) immediate descendants.
  */
 errval_t caps_delete_last(struct cte *cte, struct cte *ret_ram_cap)
+{
+    return delete_last(cte, ret_ram_cap, &delete_queue, &clear_queue);
+}
+
+/**
+ * \brief Delete the last copy of a cap, queueing the contents of CNodes and
+ * dispatchers on the given delete list and the cap itself on the clear list.
+ */
+static errval_t delete_last(struct cte *cte, struct cte *ret_ram_cap,
+                            struct delete_queue *dq, struct delete_queue *cq)
 {
     errval_t err;
     assert(!has_copies(cte));
@@ -103,12 +115,12 @@ errval_t caps_delete_last(struct cte *cte, struct cte *ret_ram_cap)
         // Mark all non-Null slots for deletion
         for (cslot_t i = 0; i < cnode_get_slots(&cte->cap); i++) {
             struct cte *slot = caps_locate_slot(get_address(&cte->cap), i);
-            caps_mark_revoke_generic(slot);
+            caps_mark_revoke_generic(slot, dq);
         }
 
-        assert(cte->delete_node.next == NULL || delete_head == cte);
+        assert(cte->delete_node.next == NULL || dq->head == cte);
         cte->delete_node.next = NULL;
-        clear_list_prepend(cte);
+        clear_list_prepend(cq, cte);
 
         return SYS_ERR_OK;
     }
@@ -118,8 +130,11 @@ errval_t caps_delete_last(struct cte *cte, struct cte *ret_ram_cap)
         struct capability *cap = &cte->cap;
         struct dcb *dcb = cap->u.dispatcher.dcb;
 
-        // Remove from queue
+        // Remove from queue and drop any timeslice donation
         scheduler_remove(dcb);
+        lmp_donation_clear(dcb);
+        // Nobody is left to continue the revokes it started
+        caps_revoke_orphan(dcb);
         // Reset current if it was deleted
         if (dcb_current == dcb) {
             dcb_current = NULL;
@@ -142,11 +157,11 @@ errval_t caps_delete_last(struct cte *cte, struct cte *ret_ram_cap)
             assert(err_is_ok(err));
         }
 
-        caps_mark_revoke_generic(&dcb->cspace);
-        caps_mark_revoke_generic(&dcb->disp_cte);
-        assert(cte->delete_node.next == NULL || delete_head == cte);
+        caps_mark_revoke_generic(&dcb->cspace, dq);
+        caps_mark_revoke_generic(&dcb->disp_cte, dq);
+        assert(cte->delete_node.next == NULL || dq->head == cte);
         cte->delete_node.next = NULL;
-        clear_list_prepend(cte);
+        clear_list_prepend(cq, cte);
 
         return SYS_ERR_OK;
     }
@@ -190,6 +205,10 @@ cleanup_copy(struct cte *cte)
     if (err_is_fail(err)) {
         return err;
     }
+    if (cap->type == ObjType_L1CNode || cap->type == ObjType_L2CNode) {
+        // Cached LMP receive slots may resolve through this cnode
+        lmp_recv_cache_invalidate();
+    }
     TRACE_CAP_MSG("cleaned up copy", cte);
     assert(!mdb_reachable(cte));
     memset(cte, 0, sizeof(*cte));
@@ -323,7 +342,7 @@ static void caps_mark_revoke_copy(struct cte *cte)
     }
 }
 
-static void caps_mark_revoke_generic(struct cte *cte)
+static void caps_mark_revoke_generic(struct cte *cte, struct delete_queue *dq)
 {
     errval_t err;
 
@@ -347,16 +366,16 @@ static void caps_mark_revoke_generic(struct cte *cte)
         //cte->delete_node.next_slot = 0;
 
         // insert into delete list
-        if (!delete_tail) {
-            assert(!delete_head);
-            delete_head = delete_tail = cte;
+        if (!dq->tail) {
+            assert(!dq->head);
+            dq->head = dq->tail = cte;
             cte->delete_node.next = NULL;
         }
         else {
-            assert(delete_head);
-            assert(!delete_tail->delete_node.next);
-            delete_tail->delete_node.next = cte;
-            delete_tail = cte;
+            assert(dq->head);
+            assert(!dq->tail->delete_node.next);
+            dq->tail->delete_node.next = cte;
+            dq->tail = cte;
             cte->delete_node.next = NULL;
         }
         TRACE_CAP_MSG("inserted into delete list", cte);
@@ -364,8 +383,10 @@ static void caps_mark_revoke_generic(struct cte *cte)
         // because the monitors will perform a 2PC that deletes all foreign
         // copies before starting the delete steps, and because the in_delete
         // bit marks this cap as "busy" (see distcap_get_state), we can clear
-        // the remote copies bit.
-        cte->mdbnode.remote_copies = 0;
+        // the remote copies bit. Kernel revokes run no such protocol.
+        if (dq == &delete_queue) {
+            cte->mdbnode.remote_copies = 0;
+        }
     }
     else if (err_is_fail(err)) {
         // some serious mojo went down in the cleanup voodoo
@@ -492,7 +513,7 @@ errval_t caps_mark_revoke(struct capability *base, struct cte *revoked)
          next && is_ancestor(&next->cap, base);
          next = mdb_successor(prev))
     {
-        caps_mark_revoke_generic(next);
+        caps_mark_revoke_generic(next, &delete_queue);
         if (next->cap.type) {
             // the cap has not been deleted, so we must use it as the new prev
             prev = next;
@@ -507,7 +528,7 @@ errval_t caps_mark_revoke(struct capability *base, struct cte *revoked)
             // due to early termination the condition, prev must be a
             // descendant
             assert(is_ancestor(&prev->cap, base));
-            caps_mark_revoke_generic(prev);
+            caps_mark_revoke_generic(prev, &delete_queue);
         }
     }
 
@@ -518,21 +539,21 @@ errval_t caps_mark_revoke(struct capability *base, struct cte *revoked)
  * Sweep phase
  */
 
-static void clear_list_prepend(struct cte *cte)
+static void clear_list_prepend(struct delete_queue *cq, struct cte *cte)
 {
     // make sure we don't break delete list by inserting cte that hasn't been
     // removed from delete list into clear list
     assert(cte->delete_node.next == NULL);
 
-    if (!clear_tail) {
-        assert(!clear_head);
-        clear_head = clear_tail = cte;
+    if (!cq->tail) {
+        assert(!cq->head);
+        cq->head = cq->tail = cte;
         cte->delete_node.next = NULL;
     }
     else {
-        assert(clear_head);
-        cte->delete_node.next = clear_head;
-        clear_head = cte;
+        assert(cq->head);
+        cte->delete_node.next = cq->head;
+        cq->head = cte;
     }
     TRACE_CAP_MSG("inserted into clear list", cte);
 }
@@ -544,14 +565,14 @@ errval_t caps_delete_step(struct cte *ret_next)
     assert(ret_next);
     assert(ret_next->cap.type == ObjType_Null);
 
-    if (!delete_head) {
-        assert(!delete_tail);
+    if (!delete_queue.head) {
+        assert(!delete_queue.tail);
         return SYS_ERR_CAP_NOT_FOUND;
     }
-    assert(delete_head->mdbnode.in_delete == true);
+    assert(delete_queue.head->mdbnode.in_delete == true);
 
-    TRACE_CAP_MSG("performing delete step", delete_head);
-    struct cte *cte = delete_head, *next = cte->delete_node.next;
+    TRACE_CAP_MSG("performing delete step", delete_queue.head);
+    struct cte *cte = delete_queue.head, *next = cte->delete_node.next;
     if (cte->mdbnode.locked) {
         err = SYS_ERR_CAP_LOCKED;
     }
@@ -562,9 +583,9 @@ errval_t caps_delete_step(struct cte *ret_next)
         err = caps_copyout_last(cte, ret_next);
         if (err_is_ok(err)) {
             if (next) {
-                delete_head = next;
+                delete_queue.head = next;
             } else {
-                delete_head = delete_tail = NULL;
+                delete_queue.head = delete_queue.tail = NULL;
             }
             err = SYS_ERR_DELETE_LAST_OWNED;
         }
@@ -583,9 +604,9 @@ errval_t caps_delete_step(struct cte *ret_next)
 
     if (err_is_ok(err)) {
         if (next) {
-            delete_head = next;
+            delete_queue.head = next;
         } else {
-            delete_head = delete_tail = NULL;
+            delete_queue.head = delete_queue.tail = NULL;
         }
     }
     return err;
@@ -594,16 +615,16 @@ errval_t caps_delete_step(struct cte *ret_next)
 errval_t caps_clear_step(struct cte *ret_ram_cap)
 {
     errval_t err;
-    assert(!delete_head);
-    assert(!delete_tail);
+    assert(!delete_queue.head);
+    assert(!delete_queue.tail);
 
-    if (!clear_head) {
-        assert(!clear_tail);
+    if (!clear_queue.head) {
+        assert(!clear_queue.tail);
         return SYS_ERR_CAP_NOT_FOUND;
     }
-    assert((clear_head == clear_tail) == (!clear_head->delete_node.next));
+    assert((clear_queue.head == clear_queue.tail) == (!clear_queue.head->delete_node.next));
 
-    struct cte *cte = clear_head;
+    struct cte *cte = clear_queue.head;
 
 #ifndef NDEBUG
     // some sanity checks
@@ -642,10 +663,10 @@ errval_t caps_clear_step(struct cte *ret_ram_cap)
     err = cleanup_last(cte, ret_ram_cap);
     if (err_is_ok(err)) {
         if (after) {
-            clear_head = after;
+            clear_queue.head = after;
         }
         else {
-            clear_head = clear_tail = NULL;
+            clear_queue.head = clear_queue.tail = NULL;
         }
     }
     return err;
@@ -692,13 +713,391 @@ errval_t caps_delete(struct cte *cte)
     return err;
 }
 
-errval_t caps_revoke(struct cte *cte)
+/*
+ * Incremental revoke
+ *
+ * Revokes of caps without remote relations are performed by the kernel
+ * itself, with a bounded amount of work per invocation. Each revoke has its
+ * own delete and clear lists, so independent revokes interleave and do not
+ * hold up the delete cascades driven by the monitor.
+ */
+
+/// State of an incremental revoke
+struct revoke_op {
+    bool                used;
+    struct cte          *target;        ///< Revoked cap, NULL once orphaned
+    struct dcb          *owner;         ///< Invoking dispatcher, NULL if gone
+    struct capability   base;           ///< Copy of the revoked cap
+    enum revoke_phase {
+        REVOKE_PHASE_MARK,              ///< Deleting copies and descendants
+        REVOKE_PHASE_DELETE,            ///< Working through delete list
+        REVOKE_PHASE_CLEAR,             ///< Working through clear list
+    } phase;
+    struct cte          *cursor;        ///< Last cte the mark walk passed
+    struct capability   cursor_cap;     ///< What that cte held at the time
+    bool                skipped;        ///< Mark pass left locked caps behind
+    struct delete_queue deletes, clears;
+    size_t              progress;       ///< ctes processed so far
+};
+
+static struct revoke_op revoke_ops[CAPS_REVOKE_MAX];
+
+/// Per-core revoke counters, indexed by enum revoke_stat
+uint64_t caps_revoke_stats[REVOKE_STAT_COUNT];
+
+static struct revoke_op *revoke_op_lookup(struct cte *target)
+{
+    for (int i = 0; i < CAPS_REVOKE_MAX; i++) {
+        if (revoke_ops[i].used && revoke_ops[i].target == target) {
+            return &revoke_ops[i];
+        }
+    }
+    return NULL;
+}
+
+static struct revoke_op *revoke_op_alloc(struct cte *target)
+{
+    struct revoke_op *op = NULL;
+    for (int i = 0; i < CAPS_REVOKE_MAX; i++) {
+        if (!revoke_ops[i].used) {
+            op = &revoke_ops[i];
+            break;
+        }
+    }
+    if (op == NULL) {
+        return NULL;
+    }
+
+    memset(op, 0, sizeof(*op));
+    op->used = true;
+    op->target = target;
+    op->owner = dcb_current;
+    op->base = target->cap;
+    op->phase = REVOKE_PHASE_MARK;
+
+    // Keep the target from being deleted, moved or revoked again meanwhile
+    target->mdbnode.locked = true;
+    caps_revoke_stats[REVOKE_STAT_STARTED]++;
+
+    return op;
+}
+
+static void revoke_op_free(struct revoke_op *op)
+{
+    if (op->target) {
+        assert(op->target->mdbnode.locked);
+        op->target->mdbnode.locked = false;
+    }
+    op->used = false;
+}
+
+/**
+ * \brief Take the caps queued by the mark phase off the delete list again,
+ * leaving them in place.
+ */
+static void revoke_unqueue(struct revoke_op *op)
+{
+    assert(op->phase == REVOKE_PHASE_MARK && !op->clears.head);
+
+    struct cte *cte = op->deletes.head;
+    while (cte) {
+        struct cte *next = cte->delete_node.next;
+        cte->delete_node.next = NULL;
+        cte->mdbnode.in_delete = false;
+        cte = next;
+    }
+    op->deletes.head = op->deletes.tail = NULL;
+}
+
+/**
+ * \brief Returns true if revoking 'cte' needs the agreement protocol between
+ * the monitors, because it is owned here and has copies or descendants on
+ * other cores.
+ */
+static inline bool revoke_needs_monitor(struct cte *cte)
+{
+    return !distcap_is_foreign(cte) &&
+           (cte->mdbnode.remote_copies || cte->mdbnode.remote_descs);
+}
+
+/**
+ * \brief Mark phase: delete up to 'budget' copies and descendants of the
+ * revoked cap, queueing the ones that need a delete step.
+ *
+ * The walk resumes after the last cte it passed, which need not be in the
+ * MDB anymore. Every cte passed is charged to the budget, including the ones
+ * left alone. If some were left because another operation held them, the
+ * range is walked once more for them.
+ *
+ * \returns SYS_ERR_OK once all copies and descendants have been handled,
+ *          SYS_ERR_REVOKE_IN_PROGRESS if the budget ran out,
+ *          SYS_ERR_RETRY_THROUGH_MONITOR if one of them has remote relations.
+ */
+static errval_t revoke_mark(struct revoke_op *op, size_t budget, size_t *done)
+{
+    struct capability *base = &op->base;
+    struct cte *next;
+
+    next = op->cursor ? mdb_find_after(&op->cursor_cap, op->cursor)
+                      : mdb_find_greater(base, true);
+    while (next && (is_copy(base, &next->cap) || is_ancestor(&next->cap, base)))
+    {
+        if (*done >= budget) {
+            return SYS_ERR_REVOKE_IN_PROGRESS;
+        }
+        (*done)++;
+
+        op->cursor = next;
+        op->cursor_cap = next->cap;
+
+        if (next == op->target || distcap_is_in_delete(next)) {
+            // stays in the MDB until its delete step
+        } else if (next->mdbnode.locked) {
+            // held by another operation, come back to it later
+            op->skipped = true;
+        } else if (revoke_needs_monitor(next)) {
+            return SYS_ERR_RETRY_THROUGH_MONITOR;
+        } else if (is_copy(base, &next->cap)) {
+            caps_mark_revoke_copy(next);
+        } else {
+            caps_mark_revoke_generic(next, &op->deletes);
+        }
+
+        if (next->cap.type != ObjType_Null) {
+            next = mdb_successor(next);
+        } else {
+            next = mdb_find_after(&op->cursor_cap, op->cursor);
+        }
+    }
+
+    op->cursor = NULL;
+    if (op->skipped) {
+        op->skipped = false;
+        return SYS_ERR_REVOKE_IN_PROGRESS;
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Delete phase: perform up to 'budget' delete steps on the revoke's
+ * delete list.
+ */
+static errval_t revoke_delete(struct revoke_op *op, size_t budget,
+                              size_t *done)
+{
+    errval_t err;
+
+    while (op->deletes.head) {
+        if (*done >= budget) {
+            return SYS_ERR_REVOKE_IN_PROGRESS;
+        }
+
+        struct cte *cte = op->deletes.head;
+        assert(cte->mdbnode.in_delete);
+        if (cte->mdbnode.locked) {
+            return SYS_ERR_REVOKE_IN_PROGRESS;
+        }
+
+        // Unlink first, deleting a CNode appends its slots to the list
+        op->deletes.head = cte->delete_node.next;
+        if (!op->deletes.head) {
+            op->deletes.tail = NULL;
+        }
+        cte->delete_node.next = NULL;
+
+        TRACE_CAP_MSG("performing revoke delete step", cte);
+        if (distcap_is_foreign(cte) || has_copies(cte)) {
+            err = cleanup_copy(cte);
+        } else if (cte->mdbnode.remote_copies) {
+            // The slot of a deleted CNode or dispatcher whose cap has copies
+            // on other cores. Those stay valid, but ownership cannot be
+            // handed to one of them without the monitors, so the object
+            // will not be reclaimed.
+            printk(LOG_WARN, "revoke: dropping owned cap with remote copies\n");
+            err = cleanup_copy(cte);
+        } else {
+            err = delete_last(cte, NULL, &op->deletes, &op->clears);
+        }
+
+        if (err_is_fail(err)) {
+            // put it back for the next attempt
+            cte->delete_node.next = op->deletes.head;
+            op->deletes.head = cte;
+            if (!op->deletes.tail) {
+                op->deletes.tail = cte;
+            }
+            if (err_no(err) == SYS_ERR_RETRY_THROUGH_MONITOR) {
+                // monitor channel full, cannot return RAM right now
+                return SYS_ERR_REVOKE_IN_PROGRESS;
+            }
+            return err;
+        }
+        (*done)++;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Clear phase: clean up to 'budget' CNodes and dispatchers on the
+ * revoke's clear list.
+ */
+static errval_t revoke_clear(struct revoke_op *op, size_t budget,
+                             size_t *done)
+{
+    errval_t err;
+
+    assert(!op->deletes.head);
+    while (op->clears.head) {
+        if (*done >= budget) {
+            return SYS_ERR_REVOKE_IN_PROGRESS;
+        }
+
+        struct cte *cte = op->clears.head, *after = cte->delete_node.next;
+        err = cleanup_last(cte, NULL);
+        if (err_no(err) == SYS_ERR_RETRY_THROUGH_MONITOR) {
+            return SYS_ERR_REVOKE_IN_PROGRESS;
+        } else if (err_is_fail(err)) {
+            return err;
+        }
+
+        op->clears.head = after;
+        if (!after) {
+            op->clears.tail = NULL;
+        }
+        (*done)++;
+    }
+
+    return SYS_ERR_OK;
+}
+
+static errval_t revoke_step(struct revoke_op *op, size_t budget)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t done = 0;
+
+    if (op->phase == REVOKE_PHASE_MARK) {
+        err = revoke_mark(op, budget, &done);
+        if (err_is_ok(err)) {
+            op->phase = REVOKE_PHASE_DELETE;
+        }
+    }
+    if (op->phase == REVOKE_PHASE_DELETE) {
+        err = revoke_delete(op, budget, &done);
+        if (err_is_ok(err)) {
+            op->phase = REVOKE_PHASE_CLEAR;
+        }
+    }
+    if (op->phase == REVOKE_PHASE_CLEAR) {
+        err = revoke_clear(op, budget, &done);
+    }
+
+    op->progress += done;
+    caps_revoke_stats[REVOKE_STAT_STEPS]++;
+    caps_revoke_stats[REVOKE_STAT_CTES] += done;
+
+    return err;
+}
+
+/**
+ * \brief Perform one step of a revoke and retire it when it is finished.
+ *
+ * A revoke that runs into remote relations during its mark phase is given up
+ * before anything is deleted that could not be undone: the caps it queued are
+ * left in place and the error is passed on. The ones it already deleted stay
+ * deleted.
+ */
+static errval_t revoke_op_run(struct revoke_op *op, size_t *ret_progress)
+{
+    errval_t err = revoke_step(op, CAPS_REVOKE_BUDGET);
+    if (ret_progress) {
+        *ret_progress = op->progress;
+    }
+
+    if (err_no(err) == SYS_ERR_RETRY_THROUGH_MONITOR) {
+        revoke_unqueue(op);
+        revoke_op_free(op);
+    } else if (err_is_ok(err)) {
+        caps_revoke_stats[REVOKE_STAT_COMPLETED]++;
+        revoke_op_free(op);
+    }
+    // otherwise the op stays, to be continued by the next invocation
+
+    return err;
+}
+
+/**
+ * \brief Hand the revokes started by a dispatcher that is being deleted over
+ * to the kernel.
+ *
+ * Revokes that have not deleted anything they cannot put back are given up.
+ * The others no longer hold their target and are finished by later revoke
+ * invocations of other dispatchers.
+ */
+void caps_revoke_orphan(struct dcb *dcb)
+{
+    for (int i = 0; i < CAPS_REVOKE_MAX; i++) {
+        struct revoke_op *op = &revoke_ops[i];
+        if (!op->used || op->owner != dcb) {
+            continue;
+        }
+
+        op->owner = NULL;
+        if (op->phase == REVOKE_PHASE_MARK) {
+            revoke_unqueue(op);
+            revoke_op_free(op);
+        } else {
+            op->target->mdbnode.locked = false;
+            op->target = NULL;
+        }
+    }
+}
+
+/**
+ * \brief Revoke a cap, or continue revoking it.
+ *
+ * Performs at most CAPS_REVOKE_BUDGET units of work and returns
+ * SYS_ERR_REVOKE_IN_PROGRESS if the revoke is not complete yet, in which
+ * case the caller invokes it again. Caps with remote relations, and revokes
+ * that run into such caps in their mark phase, fail with
+ * SYS_ERR_RETRY_THROUGH_MONITOR. Each invocation also advances one revoke
+ * whose caller has been deleted, if there is any.
+ *
+ * \param cte          Cap to revoke
+ * \param ret_progress Returns number of ctes processed by this revoke so far
+ */
+errval_t caps_revoke(struct cte *cte, size_t *ret_progress)
 {
     TRACE_CAP_MSG("revoking", cte);
 
-    if (cte->mdbnode.locked) {
-        return SYS_ERR_CAP_LOCKED;
+    for (int i = 0; i < CAPS_REVOKE_MAX; i++) {
+        if (revoke_ops[i].used && revoke_ops[i].owner == NULL) {
+            revoke_op_run(&revoke_ops[i], NULL);
+            break;
+        }
+    }
+
+    struct revoke_op *op = revoke_op_lookup(cte);
+    if (op == NULL) {
+        if (cte->mdbnode.locked || distcap_is_in_delete(cte)) {
+            return SYS_ERR_CAP_LOCKED;
+        }
+        for (int i = 0; i < CAPS_REVOKE_MAX; i++) {
+            // two revokes of the same object would wait for each other
+            if (revoke_ops[i].used && revoke_ops[i].target &&
+                is_copy(&revoke_ops[i].base, &cte->cap)) {
+                return SYS_ERR_CAP_LOCKED;
+            }
+        }
+        if (distcap_is_foreign(cte) || cte->mdbnode.remote_copies ||
+            cte->mdbnode.remote_descs || cte->mdbnode.remote_ancs) {
+            return SYS_ERR_RETRY_THROUGH_MONITOR;
+        }
+        op = revoke_op_alloc(cte);
+        if (op == NULL) {
+            return SYS_ERR_REVOKE_TOO_MANY;
+        }
     }
 
-    return SYS_ERR_RETRY_THROUGH_MONITOR;
+    return revoke_op_run(op, ret_progress);
 }
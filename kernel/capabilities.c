@@ -1622,9 +1622,7 @@ errval_t caps_retype(enum objtype type, gensize_t objsize, size_t count,
     }
 
     /* Handle mapping */
-    for (size_t i = 0; i < count; i++) {
-        mdb_insert(&dest_cte[i]);
-    }
+    mdb_insert_bulk(dest_cte, count);
 
 #ifdef TRACE_PMEM_CAPS
     for (size_t i = 0; i < count; i++) {
@@ -52,6 +52,9 @@ uint64_t context_switch_counter = 0;
 /// Current execution dispatcher (when in system call or exception)
 struct dcb *dcb_current = NULL;
 
+/// Generation of LMP receive slot cache entries, see struct lmp_recv_cache
+uint64_t lmp_recv_cache_epoch = 1;
+
 /// Remembered FPU-using DCB (NULL if none)
 struct dcb *fpu_dcb = NULL;
 
@@ -136,6 +139,13 @@ void __attribute__ ((noreturn)) dispatch(struct dcb *dcb)
     }
 #endif
 
+    // A donated timeslice ends as soon as the donee stops running
+    if (dcb_current != dcb && dcb_current != NULL
+        && dcb_current->lmp_donor != NULL) {
+        dcb_current->lmp_donor->lmp_donee = NULL;
+        dcb_current->lmp_donor = NULL;
+    }
+
     // XXX FIXME: Why is this null pointer check on the fast path ?
     // If we have nothing to do we should call something other than dispatch
     if (dcb == NULL) {
@@ -187,6 +197,101 @@ void __attribute__ ((noreturn)) dispatch(struct dcb *dcb)
     }
 } // end function: dispatch
 
+/**
+ * \brief Switch directly to the receiver of a synchronous LMP message.
+ *
+ * This is the fast path for a sender that blocks for a reply: instead of
+ * going through schedule(), the receiver runs on the remainder of the
+ * sender's timeslice. The sender becomes the receiver's donor, so that
+ * the reply (or the receiver yielding) switches straight back to it. A
+ * message to the donor ends the donation.
+ *
+ * \param send  Pointer to sending DCB (must be dcb_current).
+ * \param recv  Pointer to receiving DCB.
+ */
+void __attribute__ ((noreturn)) lmp_handoff(struct dcb *send, struct dcb *recv)
+{
+    assert(send == dcb_current);
+
+    if (send->lmp_donor == recv) {
+        // Reply to the call that donated our timeslice
+        lmp_donation_clear(send);
+    } else if (recv != send && recv->lmp_donor == NULL
+               && send->lmp_donee == NULL) {
+        recv->lmp_donor = send;
+        send->lmp_donee = recv;
+    }
+
+    scheduler_handoff(recv);
+    dispatch(recv);
+}
+
+/**
+ * \brief Resolve the slot an LMP endpoint receives caps in.
+ *
+ * The receive slot is named by the receiver in its endpoint buffer. The
+ * resolved cte is cached in the receiving DCB, so repeated transfers to the
+ * same slot skip the walk through the receiver's CSpace.
+ *
+ * \param recv      Pointer to receiving DCB.
+ * \param epoffset  Offset of the endpoint buffer in the dispatcher frame
+ * \param recv_ep   Endpoint buffer of the receiver
+ * \param ret_cte   Returns receive slot
+ *
+ * \return      Error code
+ */
+static errval_t lmp_lookup_recv_slot(struct dcb *recv, lvaddr_t epoffset,
+                                     struct lmp_endpoint_kern *recv_ep,
+                                     struct cte **ret_cte)
+{
+    errval_t err;
+
+    // The endpoint buffer is shared with the receiver, so read it only once
+    capaddr_t recv_cspc = recv_ep->recv_cspc;
+    capaddr_t recv_cptr = recv_ep->recv_cptr;
+
+    struct lmp_recv_cache *cache =
+        &recv->lmp_recv_cache[(epoffset / sizeof(uintptr_t)) % LMP_RECV_CACHE_SIZE];
+    if (cache->cte != NULL && cache->epoch == lmp_recv_cache_epoch &&
+        cache->cspc == recv_cspc && cache->cptr == recv_cptr) {
+        *ret_cte = cache->cte;
+        return SYS_ERR_OK;
+    }
+
+    // Lookup cspace root for receiving
+    struct capability *recv_cspace_cap;
+    // XXX: do we want a level into receiver's cspace here?
+    // printk(LOG_NOTE, "recv_cspace_ptr = %"PRIxCADDR"\n", recv_cspc);
+    err = caps_lookup_cap(&recv->cspace.cap, recv_cspc, 2,
+                          &recv_cspace_cap, CAPRIGHTS_READ_WRITE);
+    if (err_is_fail(err) || recv_cspace_cap->type != ObjType_L1CNode) {
+        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
+    }
+    // Check index into L1 cnode
+    capaddr_t l1index = recv_cptr >> L2_CNODE_BITS;
+    if (l1index >= cnode_get_slots(recv_cspace_cap)) {
+        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
+    }
+    // Get the cnode
+    struct cte *recv_cnode_cte = caps_locate_slot(get_address(recv_cspace_cap),
+                                                  l1index);
+    struct capability *recv_cnode_cap = &recv_cnode_cte->cap;
+    // Check for cnode type
+    if (recv_cnode_cap->type != ObjType_L2CNode) {
+        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
+    }
+    // The slot within the cnode
+    *ret_cte = caps_locate_slot(get_address(recv_cnode_cap),
+                                recv_cptr & MASK(L2_CNODE_BITS));
+
+    cache->cspc = recv_cspc;
+    cache->cptr = recv_cptr;
+    cache->epoch = lmp_recv_cache_epoch;
+    cache->cte = *ret_cte;
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Transfer cap from 'send' to 'ep', according to 'msg'.
  *
@@ -218,33 +323,12 @@ static errval_t lmp_transfer_cap(struct capability *ep, struct dcb *send,
     /* Look up the slot receiver can receive caps in */
     struct lmp_endpoint_kern *recv_ep
         = (void *)((uint8_t *)recv->disp + ep->u.endpoint.epoffset);
-
-    // Lookup cspace root for receiving
-    struct capability *recv_cspace_cap;
-    // XXX: do we want a level into receiver's cspace here?
-    // printk(LOG_NOTE, "recv_cspace_ptr = %"PRIxCADDR"\n", recv_ep->recv_cspc);
-    err = caps_lookup_cap(&recv->cspace.cap, recv_ep->recv_cspc, 2,
-                          &recv_cspace_cap, CAPRIGHTS_READ_WRITE);
-    if (err_is_fail(err) || recv_cspace_cap->type != ObjType_L1CNode) {
-        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
-    }
-    // Check index into L1 cnode
-    capaddr_t l1index = recv_ep->recv_cptr >> L2_CNODE_BITS;
-    if (l1index >= cnode_get_slots(recv_cspace_cap)) {
-        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
-    }
-    // Get the cnode
-    struct cte *recv_cnode_cte = caps_locate_slot(get_address(recv_cspace_cap),
-                                                  l1index);
-    struct capability *recv_cnode_cap = &recv_cnode_cte->cap;
-    // Check for cnode type
-    if (recv_cnode_cap->type != ObjType_L2CNode) {
-        return SYS_ERR_LMP_CAPTRANSFER_DST_CNODE_INVALID;
-    }
-    // The slot within the cnode
     struct cte *recv_cte;
-    recv_cte = caps_locate_slot(get_address(recv_cnode_cap),
-                                recv_ep->recv_cptr & MASK(L2_CNODE_BITS));
+    err = lmp_lookup_recv_slot(recv, ep->u.endpoint.epoffset, recv_ep,
+                               &recv_cte);
+    if (err_is_fail(err)) {
+        return err;
+    }
 
     /* Look up source slot in sender */
     struct cte *send_cte;
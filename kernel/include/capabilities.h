@@ -17,6 +17,7 @@
 #define CAPABILITIES_H
 
 #include <barrelfish_kpi/capabilities.h>
+#include <barrelfish_kpi/sys_debug.h>
 #include <mdb/mdb.h>
 #include <offsets.h>
 #include <cap_predicates.h>
@@ -31,6 +32,11 @@ struct delete_list {
     char padding[DELETE_LIST_SIZE - sizeof(struct cte*)];
 };
 
+/// List of ctes threaded through their delete_node
+struct delete_queue {
+    struct cte *head, *tail;
+};
+
 #ifndef ROUND_UP
 #define ROUND_UP(n, size)           ((((n) + (size) - 1)) & (~((size) - 1)))
 #endif
@@ -126,7 +132,16 @@ errval_t caps_mark_revoke(struct capability *base, struct cte *revoked);
 errval_t caps_delete_step(struct cte *ret_next);
 errval_t caps_clear_step(struct cte *ret_ram_cap);
 errval_t caps_delete(struct cte *cte);
-errval_t caps_revoke(struct cte *cte);
+errval_t caps_revoke(struct cte *cte, size_t *ret_progress);
+struct dcb;
+void caps_revoke_orphan(struct dcb *dcb);
+
+/// Maximum number of ctes processed per revoke invocation
+#define CAPS_REVOKE_BUDGET      64
+/// Maximum number of revokes in progress per core
+#define CAPS_REVOKE_MAX         8
+
+extern uint64_t caps_revoke_stats[REVOKE_STAT_COUNT];
 
 /*
  * Cap tracing
@@ -22,6 +22,23 @@
 
 extern uint64_t context_switch_counter;
 
+/// Number of cached LMP receive slots per dispatcher
+#define LMP_RECV_CACHE_SIZE     4
+
+/**
+ * \brief Cached resolution of an LMP endpoint's cap receive slot.
+ *
+ * An entry is only valid while its epoch matches lmp_recv_cache_epoch, which
+ * is bumped whenever a CNode cap is deleted.
+ */
+struct lmp_recv_cache {
+    capaddr_t           cspc, cptr;     ///< Receive slot this entry resolves
+    uint64_t            epoch;          ///< Value of lmp_recv_cache_epoch
+    struct cte          *cte;           ///< Receive slot, NULL if unused
+};
+
+extern uint64_t lmp_recv_cache_epoch;
+
 /**
  * \brief Structure to hold information regarding AMD SVM
  */
@@ -49,6 +66,10 @@ struct dcb {
     uint64_t            domain_id;      ///< ID of dispatcher's domain
     systime_t           wakeup_time;    ///< Time to wakeup this dispatcher
     struct dcb          *wakeup_prev, *wakeup_next; ///< Next/prev in timeout queue
+    /// Dispatcher running on our timeslice after a sync LMP call, and vice versa
+    struct dcb          *lmp_donee, *lmp_donor;
+    /// Receive slots of our endpoints, indexed by endpoint offset
+    struct lmp_recv_cache lmp_recv_cache[LMP_RECV_CACHE_SIZE];
 
     struct dcb          *next;          ///< Next DCB in schedule
     struct dcb          *prev;          ///< Previous DCB in schedule
@@ -88,6 +109,27 @@ errval_t lmp_deliver(struct capability *ep, struct dcb *send,
                      uintptr_t *payload, size_t payload_len,
                      capaddr_t send_cptr, uint8_t send_bits, bool give_away);
 
+void lmp_handoff(struct dcb *send, struct dcb *recv) __attribute__ ((noreturn));
+
+/// End the timeslice donation 'dcb' is part of, on either side
+static inline void lmp_donation_clear(struct dcb *dcb)
+{
+    if (dcb->lmp_donor != NULL) {
+        dcb->lmp_donor->lmp_donee = NULL;
+        dcb->lmp_donor = NULL;
+    }
+    if (dcb->lmp_donee != NULL) {
+        dcb->lmp_donee->lmp_donor = NULL;
+        dcb->lmp_donee = NULL;
+    }
+}
+
+/// Invalidate all cached LMP receive slots after a change to a CSpace
+static inline void lmp_recv_cache_invalidate(void)
+{
+    lmp_recv_cache_epoch++;
+}
+
 /// Deliver an empty LMP as a notification
 static inline errval_t lmp_deliver_notification(struct capability *ep)
 {
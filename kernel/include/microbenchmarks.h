@@ -10,9 +10,15 @@
 #ifndef __MICROBENCHMARKS_H
 #define __MICROBENCHMARKS_H
 
+#include <capabilities.h>
+
 // The number of times the benchmark should run each instruction
 #define MICROBENCH_ITERATIONS 64
 
+/// Size and alignment of the physical scratch region handed to the suite
+#define MICROBENCH_SCRATCH_BYTES    (2UL << 20)
+#define MICROBENCH_SCRATCH_ALIGN    (1UL << 20)
+
 struct microbench; // forward declaration
 
 /* function that executes a particular microbenchmark, storing its result
@@ -23,10 +29,47 @@ typedef int (* microbench_run_func)(struct microbench *);
 struct microbench {
     const char * NTS name;
     microbench_run_func run_func;
-    uint64_t result;
+    uint64_t result;            ///< Sum of all samples
+    uint64_t min, max;          ///< Fastest and slowest sample
+    size_t samples;             ///< Number of samples taken
 };
 
-void microbenchmarks_run_all(void);
+/**
+ * Slots in the benchmark L2 CNode. The fixtures are created once by
+ * microbenchmarks_run_all() and persist across benchmarks; the scratch
+ * slots are expected to be empty again when a benchmark returns.
+ */
+enum microbench_slot {
+    MICROBENCH_SLOT_RAM,        ///< RAM cap that retype benchmarks carve up
+    MICROBENCH_SLOT_FRAME,      ///< Small frame for copy/map benchmarks
+    MICROBENCH_SLOT_DISP_A,     ///< Dispatcher cap of fake dispatcher A
+    MICROBENCH_SLOT_DISP_B,     ///< Dispatcher cap of fake dispatcher B
+    MICROBENCH_SLOT_DISPFRAME_A,///< Dispatcher frame of A
+    MICROBENCH_SLOT_DISPFRAME_B,///< Dispatcher frame of B
+    MICROBENCH_SLOT_EP_A,       ///< Minted endpoint to A
+    MICROBENCH_SLOT_EP_B,       ///< Minted endpoint to B
+    MICROBENCH_SLOT_ROOTCN,     ///< Copy of the root CNode, for LMP cap receipt
+    MICROBENCH_SLOT_RECV,       ///< Slot LMP cap transfers are received in
+    MICROBENCH_SLOT_SCRATCH,    ///< Slot benchmarks may fill temporarily
+    MICROBENCH_SLOT_ARCH = 16,  ///< First slot for arch-specific fixtures
+};
+
+/// Offset and length (in words) of the LMP endpoint buffer in a fake dispatcher
+#define MICROBENCH_EP_OFFSET    BASE_PAGE_SIZE
+#define MICROBENCH_EP_BUFLEN    64
+
+void microbenchmarks_run_all(lpaddr_t scratch_base, size_t scratch_bytes);
+
+/* Helpers shared by the generic and architecture-specific benchmarks */
+uint64_t microbench_timestamp(void);
+void microbench_sample(struct microbench *mb, uint64_t ticks);
+struct cte *microbench_slot(cslot_t slot);
+struct capability *microbench_cnode(void);
+struct dcb *microbench_dcb(cslot_t disp_slot);
+lpaddr_t microbench_alloc(size_t bytes, size_t align);
+errval_t microbench_delete(struct cte *cte);
+int microbench_retype(struct microbench *mb, enum objtype type,
+                      gensize_t objsize);
 
 extern struct microbench arch_benchmarks[];
 extern size_t arch_benchmarks_size;
@@ -19,6 +19,8 @@ struct dcb *schedule(void);
 void make_runnable(struct dcb *dcb);
 void scheduler_remove(struct dcb *dcb);
 void scheduler_yield(struct dcb *dcb);
+void scheduler_handoff(struct dcb *dcb);
+bool scheduler_is_runnable(struct dcb *dcb);
 void scheduler_reset_time(void);
 void scheduler_convert(void);
 void scheduler_restore_state(void);
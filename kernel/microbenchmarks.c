@@ -2,10 +2,15 @@
  * \file
  * \brief Generic/base microbenchmark code.
  *
- * This file implements some (currently very primitive) services for
- * running and printing the results of a set of microbenchmarks.
- * Most of the benchmarks themselves are defined in the architecture-specific
- * part, in arch_microbenchmarks.c.
+ * This file implements the services for running and printing the results of
+ * a set of microbenchmarks, together with the benchmarks for the generic
+ * parts of the CPU driver: capability operations, retype and LMP delivery.
+ * Benchmarks that depend on the architecture (page tables, context switch)
+ * are defined in the architecture-specific part, in microbenchmarks.c in the
+ * arch directory.
+ *
+ * The benchmarks operate on a private set of kernel objects that is created
+ * from a scratch region of physical memory before init gets its RAM caps.
  */
 
 /*
@@ -20,9 +25,25 @@
 #include <kernel.h>
 #include <stdio.h>
 #include <string.h>
+#include <barrelfish_kpi/init.h>
+#include <barrelfish_kpi/lmp.h>
+#include <capabilities.h>
+#include <dispatch.h>
 #include <microbenchmarks.h>
 #include <misc.h>
 
+/// Slot of the benchmark L2 CNode in the benchmark root CNode
+#define MICROBENCH_L1_SLOT      1
+
+/// Size of the frame backing each fake dispatcher
+#define MICROBENCH_DISPFRAME_BYTES  (4 * BASE_PAGE_SIZE)
+
+/// Size of the RAM cap used by the retype benchmarks
+#define MICROBENCH_RAM_BYTES        (1UL << 20)
+
+static struct cte microbench_root;
+static lpaddr_t scratch_next, scratch_end;
+
 static uint64_t divide_round(uint64_t quotient, uint64_t divisor)
 {
     if ((quotient % divisor) * 2 >= divisor) {
@@ -33,10 +54,430 @@ static uint64_t divide_round(uint64_t quotient, uint64_t divisor)
     }
 }
 
+/**
+ * \brief Record one sample of a benchmark.
+ */
+void microbench_sample(struct microbench *mb, uint64_t ticks)
+{
+    mb->result += ticks;
+    mb->min = mb->samples == 0 ? ticks : min(mb->min, ticks);
+    mb->max = max(mb->max, ticks);
+    mb->samples++;
+}
+
+/**
+ * \brief Allocate physical memory from the scratch region.
+ */
+lpaddr_t microbench_alloc(size_t bytes, size_t align)
+{
+    lpaddr_t addr = ROUND_UP(scratch_next, align);
+    assert(addr + bytes <= scratch_end);
+    scratch_next = addr + bytes;
+    return addr;
+}
+
+/// Capability of the L2 CNode holding the benchmark fixtures
+struct capability *microbench_cnode(void)
+{
+    return &caps_locate_slot(get_address(&microbench_root.cap),
+                             MICROBENCH_L1_SLOT)->cap;
+}
+
+/// Cte of a slot in the benchmark L2 CNode
+struct cte *microbench_slot(cslot_t slot)
+{
+    assert(slot < L2_CNODE_SLOTS);
+    return caps_locate_slot(get_address(microbench_cnode()), slot);
+}
+
+/// DCB of one of the fake dispatchers
+struct dcb *microbench_dcb(cslot_t disp_slot)
+{
+    struct cte *cte = microbench_slot(disp_slot);
+    assert(cte->cap.type == ObjType_Dispatcher);
+    return cte->cap.u.dispatcher.dcb;
+}
+
+/// CSpace address of a slot in the benchmark L2 CNode
+static inline capaddr_t microbench_cptr(cslot_t slot)
+{
+    return ROOTCN_SLOT_ADDR(MICROBENCH_L1_SLOT) | slot;
+}
+
+/**
+ * \brief Delete a benchmark cap without going through the monitor.
+ *
+ * CNodes and dispatchers cannot be deleted with a simple delete, so run the
+ * delete/clear steps the monitor would normally drive.
+ */
+errval_t microbench_delete(struct cte *cte)
+{
+    errval_t err;
+
+    if (cte->cap.type != ObjType_L1CNode &&
+        cte->cap.type != ObjType_L2CNode &&
+        cte->cap.type != ObjType_Dispatcher) {
+        return caps_delete(cte);
+    }
+
+    err = caps_delete_last(cte, NULL);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    do {
+        err = caps_clear_step(NULL);
+    } while (err_is_ok(err));
+
+    return err_no(err) == SYS_ERR_CAP_NOT_FOUND ? SYS_ERR_OK : err;
+}
+
+static inline void microbench_lmp_consume(struct dcb *dcb)
+{
+    struct lmp_endpoint_kern *ep =
+        (void *)((uint8_t *)dcb->disp + MICROBENCH_EP_OFFSET);
+    ep->consumed = ep->delivered;
+}
+
+/*
+ * Fixtures
+ */
+
+static errval_t microbench_setup_dispatcher(cslot_t disp_slot,
+                                            cslot_t frame_slot,
+                                            cslot_t ep_slot)
+{
+    errval_t err;
+    struct cte *disp_cte = microbench_slot(disp_slot);
+    struct cte *frame_cte = microbench_slot(frame_slot);
+    struct cte *tmp_cte = microbench_slot(MICROBENCH_SLOT_SCRATCH);
+
+    err = caps_create_new(ObjType_Dispatcher,
+                          microbench_alloc(OBJSIZE_DISPATCHER,
+                                           OBJSIZE_DISPATCHER),
+                          OBJSIZE_DISPATCHER, 0, my_core_id, disp_cte);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = caps_create_new(ObjType_Frame,
+                          microbench_alloc(MICROBENCH_DISPFRAME_BYTES,
+                                           BASE_PAGE_SIZE),
+                          MICROBENCH_DISPFRAME_BYTES,
+                          MICROBENCH_DISPFRAME_BYTES, my_core_id, frame_cte);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct dcb *dcb = disp_cte->cap.u.dispatcher.dcb;
+    err = caps_copy_to_cte(&dcb->cspace, &microbench_root, false, 0, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = caps_copy_to_cte(&dcb->disp_cte, frame_cte, false, 0, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    dcb->disp = local_phys_to_mem(gen_phys_to_local_phys(
+                                      get_address(&frame_cte->cap)));
+
+    struct dispatcher_shared_generic *disp =
+        get_dispatcher_shared_generic(dcb->disp);
+    snprintf(disp->name, DISP_NAME_LEN, "mb_%c",
+             disp_slot == MICROBENCH_SLOT_DISP_A ? 'a' : 'b');
+
+    // Mint an endpoint with a buffer in the dispatcher frame
+    err = caps_retype(ObjType_EndPoint, 0, 1, microbench_cnode(),
+                      MICROBENCH_SLOT_SCRATCH, disp_cte, 0, false);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = caps_copy_to_cte(microbench_slot(ep_slot), tmp_cte, true,
+                           MICROBENCH_EP_OFFSET, MICROBENCH_EP_BUFLEN);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return caps_delete(tmp_cte);
+}
+
+static errval_t microbench_setup(lpaddr_t scratch_base, size_t scratch_bytes)
+{
+    errval_t err;
+
+    scratch_next = scratch_base;
+    scratch_end = scratch_base + scratch_bytes;
+
+    // The RAM cap comes first, so that it is aligned to its size
+    lpaddr_t ram_base = microbench_alloc(MICROBENCH_RAM_BYTES,
+                                         MICROBENCH_RAM_BYTES);
+
+    err = caps_create_new(ObjType_L1CNode,
+                          microbench_alloc(OBJSIZE_L2CNODE, BASE_PAGE_SIZE),
+                          OBJSIZE_L2CNODE, OBJSIZE_L2CNODE, my_core_id,
+                          &microbench_root);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = caps_create_new(ObjType_L2CNode,
+                          microbench_alloc(OBJSIZE_L2CNODE, BASE_PAGE_SIZE),
+                          OBJSIZE_L2CNODE, OBJSIZE_L2CNODE, my_core_id,
+                          caps_locate_slot(get_address(&microbench_root.cap),
+                                           MICROBENCH_L1_SLOT));
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = caps_create_new(ObjType_RAM, ram_base, MICROBENCH_RAM_BYTES,
+                          MICROBENCH_RAM_BYTES, my_core_id,
+                          microbench_slot(MICROBENCH_SLOT_RAM));
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = caps_create_new(ObjType_Frame,
+                          microbench_alloc(BASE_PAGE_SIZE, BASE_PAGE_SIZE),
+                          BASE_PAGE_SIZE, BASE_PAGE_SIZE, my_core_id,
+                          microbench_slot(MICROBENCH_SLOT_FRAME));
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = caps_copy_to_cte(microbench_slot(MICROBENCH_SLOT_ROOTCN),
+                           &microbench_root, false, 0, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = microbench_setup_dispatcher(MICROBENCH_SLOT_DISP_A,
+                                      MICROBENCH_SLOT_DISPFRAME_A,
+                                      MICROBENCH_SLOT_EP_A);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return microbench_setup_dispatcher(MICROBENCH_SLOT_DISP_B,
+                                       MICROBENCH_SLOT_DISPFRAME_B,
+                                       MICROBENCH_SLOT_EP_B);
+}
+
+/*
+ * Generic benchmarks
+ */
+
+static int cap_lookup_benchmark(struct microbench *mb)
+{
+    struct dcb *dcb = microbench_dcb(MICROBENCH_SLOT_DISP_A);
+    capaddr_t cptr = microbench_cptr(MICROBENCH_SLOT_FRAME);
+    struct cte *cte;
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_lookup_slot(&dcb->cspace.cap, cptr, 2, &cte,
+                                        CAPRIGHTS_READ);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int cap_copy_benchmark(struct microbench *mb)
+{
+    struct cte *src = microbench_slot(MICROBENCH_SLOT_FRAME);
+    struct cte *dest = microbench_slot(MICROBENCH_SLOT_SCRATCH);
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_copy_to_cte(dest, src, false, 0, 0);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err) || err_is_fail(caps_delete(dest))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int cap_mint_benchmark(struct microbench *mb)
+{
+    struct cte *src = microbench_slot(MICROBENCH_SLOT_EP_A);
+    struct cte *dest = microbench_slot(MICROBENCH_SLOT_SCRATCH);
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_copy_to_cte(dest, src, true, MICROBENCH_EP_OFFSET,
+                                        MICROBENCH_EP_BUFLEN);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err) || err_is_fail(caps_delete(dest))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int cap_delete_benchmark(struct microbench *mb)
+{
+    struct cte *src = microbench_slot(MICROBENCH_SLOT_FRAME);
+    struct cte *dest = microbench_slot(MICROBENCH_SLOT_SCRATCH);
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        if (err_is_fail(caps_copy_to_cte(dest, src, false, 0, 0))) {
+            return -1;
+        }
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_delete(dest);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * \brief Time retyping the benchmark RAM cap to one object of the given type.
+ *
+ * Only the retype is timed; the new object is deleted again afterwards.
+ */
+int microbench_retype(struct microbench *mb, enum objtype type,
+                      gensize_t objsize)
+{
+    struct cte *src = microbench_slot(MICROBENCH_SLOT_RAM);
+    struct cte *dest = microbench_slot(MICROBENCH_SLOT_SCRATCH);
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS; i++) {
+        uint64_t start = microbench_timestamp();
+        errval_t err = caps_retype(type, objsize, 1, microbench_cnode(),
+                                   MICROBENCH_SLOT_SCRATCH, src, 0, false);
+        microbench_sample(mb, microbench_timestamp() - start);
+        if (err_is_fail(err) || err_is_fail(microbench_delete(dest))) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+#define RETYPE_BENCHMARK(_fn, _type, _size) \
+static int _fn(struct microbench *mb) \
+{ \
+    return microbench_retype(mb, _type, _size); \
+}
+
+RETYPE_BENCHMARK(retype_ram_4k_benchmark, ObjType_RAM, BASE_PAGE_SIZE)
+RETYPE_BENCHMARK(retype_ram_64k_benchmark, ObjType_RAM, 16 * BASE_PAGE_SIZE)
+RETYPE_BENCHMARK(retype_frame_4k_benchmark, ObjType_Frame, BASE_PAGE_SIZE)
+RETYPE_BENCHMARK(retype_frame_64k_benchmark, ObjType_Frame, 16 * BASE_PAGE_SIZE)
+RETYPE_BENCHMARK(retype_frame_1m_benchmark, ObjType_Frame, MICROBENCH_RAM_BYTES)
+RETYPE_BENCHMARK(retype_l1cnode_benchmark, ObjType_L1CNode, OBJSIZE_L2CNODE)
+RETYPE_BENCHMARK(retype_l2cnode_benchmark, ObjType_L2CNode, OBJSIZE_L2CNODE)
+RETYPE_BENCHMARK(retype_dispatcher_benchmark, ObjType_Dispatcher,
+                 OBJSIZE_DISPATCHER)
+
+/**
+ * \brief LMP round trip: A sends a full message to B, B replies to A.
+ *
+ * Each side consumes its message straight away, as the user-level LMP
+ * channel code would.
+ */
+static int lmp_roundtrip_benchmark(struct microbench *mb)
+{
+    struct capability *ep_a = &microbench_slot(MICROBENCH_SLOT_EP_A)->cap;
+    struct capability *ep_b = &microbench_slot(MICROBENCH_SLOT_EP_B)->cap;
+    struct dcb *a = microbench_dcb(MICROBENCH_SLOT_DISP_A);
+    struct dcb *b = microbench_dcb(MICROBENCH_SLOT_DISP_B);
+    uintptr_t msg[LMP_MSG_LENGTH] = { 0 };
+    errval_t err = SYS_ERR_OK;
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS && err_is_ok(err); i++) {
+        uint64_t start = microbench_timestamp();
+        err = lmp_deliver(ep_b, a, msg, LMP_MSG_LENGTH, CPTR_NULL, 0, false);
+        if (err_is_ok(err)) {
+            microbench_lmp_consume(b);
+            err = lmp_deliver(ep_a, b, msg, LMP_MSG_LENGTH, CPTR_NULL, 0,
+                              false);
+            microbench_lmp_consume(a);
+        }
+        microbench_sample(mb, microbench_timestamp() - start);
+    }
+
+    // Delivery made the fake dispatchers runnable
+    scheduler_remove(a);
+    scheduler_remove(b);
+
+    return err_is_ok(err) ? 0 : -1;
+}
+
+/**
+ * \brief One-way LMP message from A to B that carries a copy of a frame cap.
+ *
+ * B receives into a fixed slot, as a dispatcher that has set its receive slot
+ * once would. The received copy is deleted outside the timed region.
+ */
+static int lmp_captransfer_benchmark(struct microbench *mb)
+{
+    struct capability *ep_b = &microbench_slot(MICROBENCH_SLOT_EP_B)->cap;
+    struct dcb *a = microbench_dcb(MICROBENCH_SLOT_DISP_A);
+    struct dcb *b = microbench_dcb(MICROBENCH_SLOT_DISP_B);
+    struct cte *recv = microbench_slot(MICROBENCH_SLOT_RECV);
+    struct lmp_endpoint_kern *ep =
+        (void *)((uint8_t *)b->disp + MICROBENCH_EP_OFFSET);
+    uintptr_t msg[LMP_MSG_LENGTH] = { 0 };
+    errval_t err = SYS_ERR_OK;
+
+    ep->recv_cspc = microbench_cptr(MICROBENCH_SLOT_ROOTCN);
+    ep->recv_cptr = microbench_cptr(MICROBENCH_SLOT_RECV);
+
+    for (int i = 0; i < MICROBENCH_ITERATIONS && err_is_ok(err); i++) {
+        uint64_t start = microbench_timestamp();
+        err = lmp_deliver(ep_b, a, msg, LMP_MSG_LENGTH,
+                          microbench_cptr(MICROBENCH_SLOT_FRAME), 2, false);
+        microbench_lmp_consume(b);
+        microbench_sample(mb, microbench_timestamp() - start);
+
+        if (err_is_ok(err)) {
+            err = caps_delete(recv);
+        }
+    }
+
+    scheduler_remove(b);
+
+    return err_is_ok(err) ? 0 : -1;
+}
+
+static struct microbench generic_benchmarks[] = {
+    { .name = "cap_lookup",         .run_func = cap_lookup_benchmark },
+    { .name = "cap_copy",           .run_func = cap_copy_benchmark },
+    { .name = "cap_mint",           .run_func = cap_mint_benchmark },
+    { .name = "cap_delete",         .run_func = cap_delete_benchmark },
+    { .name = "retype_ram_4k",      .run_func = retype_ram_4k_benchmark },
+    { .name = "retype_ram_64k",     .run_func = retype_ram_64k_benchmark },
+    { .name = "retype_frame_4k",    .run_func = retype_frame_4k_benchmark },
+    { .name = "retype_frame_64k",   .run_func = retype_frame_64k_benchmark },
+    { .name = "retype_frame_1m",    .run_func = retype_frame_1m_benchmark },
+    { .name = "retype_l1cnode_16k", .run_func = retype_l1cnode_benchmark },
+    { .name = "retype_l2cnode",     .run_func = retype_l2cnode_benchmark },
+    { .name = "retype_dispatcher",  .run_func = retype_dispatcher_benchmark },
+    { .name = "lmp_roundtrip",      .run_func = lmp_roundtrip_benchmark },
+    { .name = "lmp_captransfer",    .run_func = lmp_captransfer_benchmark },
+};
+
+/*
+ * Runner
+ */
+
 static int microbench_print(struct microbench *mb, char *buf, size_t len)
 {
+    if (mb->samples == 0) {
+        return snprintf(buf, len, "no samples");
+    }
     return snprintf(buf, len, "%" PRIu64 " ticks",
-                    divide_round(mb->result, MICROBENCH_ITERATIONS));
+                    divide_round(mb->result, mb->samples));
 }
 
 static int microbenchmarks_run(struct microbench *benchs, size_t nbenchs)
@@ -46,6 +487,8 @@ static int microbenchmarks_run(struct microbench *benchs, size_t nbenchs)
         struct microbench       *mb;
 
         mb = &benchs[i];
+        mb->result = mb->min = mb->max = 0;
+        mb->samples = 0;
         printk(LOG_NOTE, "Running benchmark %zu/%zu: %s\n", i + 1, nbenchs,
                mb->name);
         r = mb->run_func(mb);
@@ -78,11 +521,55 @@ static int microbenchmarks_print_all(struct microbench *benchs, size_t nbenchs)
     return 0;
 }
 
-void microbenchmarks_run_all(void)
+/**
+ * \brief Print one line per benchmark in a fixed, machine-parseable format.
+ *
+ *   microbench: core=<id> name=<name> iters=<n> avg=<t> min=<t> max=<t>
+ *
+ * All times are in ticks of microbench_timestamp().
+ */
+static void microbenchmarks_print_parseable(struct microbench *benchs,
+                                            size_t nbenchs)
+{
+    for (size_t i = 0; i < nbenchs; i++) {
+        struct microbench *mb = &benchs[i];
+        if (mb->samples == 0) {
+            continue;
+        }
+        printf("microbench: core=%d name=%s iters=%zu avg=%" PRIu64
+               " min=%" PRIu64 " max=%" PRIu64 "\n", my_core_id, mb->name,
+               mb->samples, divide_round(mb->result, mb->samples), mb->min,
+               mb->max);
+    }
+}
+
+/**
+ * \brief Run all benchmarks and print their results.
+ *
+ * \param scratch_base  Physical memory the benchmarks may use. It must be
+ *                      aligned to MICROBENCH_SCRATCH_ALIGN and must not be
+ *                      handed out to user space afterwards.
+ * \param scratch_bytes Size of the scratch region.
+ */
+void microbenchmarks_run_all(lpaddr_t scratch_base, size_t scratch_bytes)
 {
+    errval_t err = microbench_setup(scratch_base, scratch_bytes);
+    if (err_is_fail(err)) {
+        printk(LOG_ERR, "%s: failed to set up benchmark objects: %"PRIuERRV"\n",
+               __func__, err);
+        return;
+    }
+
+    microbenchmarks_run(generic_benchmarks, ARRAY_LENGTH(generic_benchmarks));
     microbenchmarks_run(arch_benchmarks, arch_benchmarks_size);
 
     printf("\n------------------------ Statistics ------------------------\n");
+    microbenchmarks_print_all(generic_benchmarks,
+                              ARRAY_LENGTH(generic_benchmarks));
     microbenchmarks_print_all(arch_benchmarks, arch_benchmarks_size);
     printf("------------------------------------------------------------\n\n");
+
+    microbenchmarks_print_parseable(generic_benchmarks,
+                                    ARRAY_LENGTH(generic_benchmarks));
+    microbenchmarks_print_parseable(arch_benchmarks, arch_benchmarks_size);
 }
@@ -544,6 +544,33 @@ void scheduler_yield(struct dcb *dcb)
     queue_insert(dcb);
 }
 
+/**
+ * \brief Account a direct switch to 'dcb' that bypasses schedule().
+ *
+ * 'dcb' runs on the timeslice of whoever schedule() picked last, which is
+ * charged for it until the next scheduling decision. If nobody is being
+ * accounted (because the last dispatcher yielded), 'dcb' pays for itself.
+ *
+ * \param dcb   Pointer to DCB that is about to be dispatched.
+ */
+void scheduler_handoff(struct dcb *dcb)
+{
+    if(lastdisp == NULL && in_queue(dcb) && dcb->release_time <= kernel_now) {
+        dcb->last_dispatch = kernel_now;
+        lastdisp = dcb;
+    }
+}
+
+/**
+ * \brief Returns whether 'dcb' is in the scheduling queue.
+ *
+ * \param dcb   Pointer to DCB to check.
+ */
+bool scheduler_is_runnable(struct dcb *dcb)
+{
+    return in_queue(dcb);
+}
+
 #ifndef SCHEDULER_SIMULATOR
 void scheduler_reset_time(void)
 {
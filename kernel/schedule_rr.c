@@ -117,6 +117,26 @@ void scheduler_yield(struct dcb *dcb)
     // No-op for the round-robin scheduler
 }
 
+/**
+ * \brief Account a direct switch to 'dcb' that bypasses schedule().
+ *
+ * \param dcb   Pointer to DCB that is about to be dispatched.
+ */
+void scheduler_handoff(struct dcb *dcb)
+{
+    // No-op: 'dcb' runs on the current timeslice until the next tick
+}
+
+/**
+ * \brief Returns whether 'dcb' is in the scheduler ring.
+ *
+ * \param dcb   Pointer to DCB to check.
+ */
+bool scheduler_is_runnable(struct dcb *dcb)
+{
+    return dcb->prev != NULL && dcb->next != NULL;
+}
+
 void scheduler_reset_time(void)
 {
     // No-Op in RR scheduler
@@ -97,6 +97,7 @@ sys_dispatcher_setup(struct capability *to, capaddr_t cptr, uint8_t level,
         debug(SUBSYS_CAPS, "caps_copy_to_cte for croot: %"PRIuERRV"\n", err);
         return SYSRET(err_push(err, SYS_ERR_DISP_CSPACE_ROOT));
     }
+    lmp_recv_cache_invalidate();
 
     /* 2. set vspace root */
     struct capability *vroot;
@@ -490,8 +491,9 @@ struct sysret sys_revoke(struct capability *root, capaddr_t cptr, uint8_t level)
         return SYSRET(err);
     }
 
-    err = caps_revoke(slot);
-    return SYSRET(err);
+    size_t progress = 0;
+    err = caps_revoke(slot, &progress);
+    return (struct sysret) { .error = err, .value = progress };
 }
 
 struct sysret sys_get_state(struct capability *root, capaddr_t cptr, uint8_t level)
@@ -658,8 +660,17 @@ struct sysret sys_yield(capaddr_t target)
             panic("invalid type in yield cap");
         }
 
+        lmp_donation_clear(dcb_current);
         make_runnable(target_dcb);
         dispatch(target_dcb);
+    } else if (dcb_current->lmp_donor != NULL
+               && scheduler_is_runnable(dcb_current->lmp_donor)) {
+        /* undirected yield on a donated timeslice: hand it back to the
+         * dispatcher that called us */
+        struct dcb *donor = dcb_current->lmp_donor;
+        lmp_donation_clear(dcb_current);
+        scheduler_handoff(donor);
+        dispatch(donor);
     } else {
 
         /* undirected yield */
@@ -13,6 +13,7 @@
  */
 
 #include <aos/aos_rpc.h>
+#include <barrelfish_kpi/domain_params.h>
 #include <string.h>
 
 
@@ -694,6 +695,153 @@ errval_t aos_rpc_process_spawn_args(struct aos_rpc *chan, char *name,
     return SYS_ERR_OK;
 }
 
+errval_t aos_rpc_args_frame_create(int argc, char *argv[], char *envp[],
+        struct capref *frame)
+{
+    size_t envc = 0;
+    size_t bytes = sizeof(struct spawn_domain_params);
+    for (int i = 0; i < argc; ++i) {
+        bytes += strlen(argv[i]) + 1;
+    }
+    while (envp != NULL && envp[envc] != NULL) {
+        bytes += strlen(envp[envc++]) + 1;
+    }
+    if (argc <= 0 || argc > MAX_CMDLINE_ARGS || envc > MAX_ENVIRON_VARS) {
+        return SPAWN_ERR_ARGSPG_OVERFLOW;
+    }
+
+    size_t retsize;
+    CHECK("aos_rpc.c#aos_rpc_args_frame_create: frame_alloc",
+            frame_alloc(frame, bytes, &retsize));
+
+    void* buf;
+    errval_t err = paging_map_frame(get_current_paging_state(), &buf, retsize,
+            *frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        cap_destroy(*frame);
+        return err;
+    }
+
+    // argv and envp hold offsets from the start of the frame, the spawning
+    // side turns them into pointers once it knows where the child maps it.
+    struct spawn_domain_params* params = (struct spawn_domain_params*) buf;
+    memset(params, 0, sizeof(*params));
+    char* strings = (char*) buf + sizeof(struct spawn_domain_params);
+
+    params->argc = argc;
+    for (int i = 0; i < argc; ++i) {
+        params->argv[i] = (const char*) (strings - (char*) buf);
+        strcpy(strings, argv[i]);
+        strings += strlen(argv[i]) + 1;
+    }
+    for (size_t i = 0; i < envc; ++i) {
+        params->envp[i] = (char*) (strings - (char*) buf);
+        strcpy(strings, envp[i]);
+        strings += strlen(envp[i]) + 1;
+    }
+
+    return paging_unmap(get_current_paging_state(), buf);
+}
+
+/**
+ * \brief Spawn from args frame request.
+ */
+errval_t aos_rpc_process_spawn_frame_send_handler(void* void_args)
+{
+    uintptr_t* args = (uintptr_t*) void_args;
+
+    struct aos_rpc* rpc = (struct aos_rpc*) args[0];
+    uint32_t* token = (uint32_t*) args[1];
+    struct capref* frame = (struct capref*) args[2];
+    coreid_t* core = (coreid_t*) args[5];
+
+    // Without a token we still need to identify ourselves; once we have one
+    // the frame takes the cap slot.
+    struct capref cap = *token == 0 ? rpc->lc.local_cap : *frame;
+
+    errval_t err;
+    size_t retries = 0;
+    do {
+        err = lmp_chan_send3(&rpc->lc, LMP_FLAG_SYNC, cap,
+                AOS_RPC_SPAWN_FRAME, *token, *core);
+        ++retries;
+    } while (err_is_fail(err) && retries < 5);
+    if (retries == 5) {
+        return err;
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Spawn from args frame response.
+ */
+errval_t aos_rpc_process_spawn_frame_recv_handler(void* void_args)
+{
+    uintptr_t* args = (uintptr_t*) void_args;
+
+    struct aos_rpc* rpc = (struct aos_rpc*) args[0];
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+
+    struct capref cap;
+    errval_t err = lmp_chan_recv(&rpc->lc, &msg, &cap);
+    if (err_is_fail(err) && lmp_err_is_transient(err)) {
+        // Reregister.
+        lmp_chan_register_recv(&rpc->lc, rpc->ws,
+                MKCLOSURE((void*) aos_rpc_process_spawn_frame_recv_handler,
+                        args));
+        return err;
+    }
+
+    // We should have received:
+    // 1) RPC code.
+    // 2) Server process error code.
+    // 3) Token to send the frame under, or PID of the new process.
+    *((errval_t*) args[4]) = (errval_t) msg.words[1];
+    *((uint32_t*) args[3]) = msg.words[2];
+
+    return (errval_t) msg.words[1];
+}
+
+errval_t aos_rpc_process_spawn_frame(struct aos_rpc *chan,
+        struct capref frame, coreid_t core, domainid_t *newpid)
+{
+    uint32_t token = 0;
+    uint32_t result;
+    errval_t server_err;
+
+    uintptr_t args[6];
+    args[0] = (uintptr_t) chan;
+    args[1] = (uintptr_t) &token;
+    args[2] = (uintptr_t) &frame;
+    args[3] = (uintptr_t) &result;
+    args[4] = (uintptr_t) &server_err;
+    args[5] = (uintptr_t) &core;
+
+    // 1. Get a token for the frame.
+    CHECK("aos_rpc.c#aos_rpc_process_spawn_frame: aos_rpc_send_and_receive",
+            aos_rpc_send_and_receive(args,
+                    aos_rpc_process_spawn_frame_send_handler,
+                    aos_rpc_process_spawn_frame_recv_handler));
+    if (err_is_fail(server_err)) {
+        return server_err;
+    }
+
+    // 2. Hand over the frame itself.
+    token = result;
+    CHECK("aos_rpc.c#aos_rpc_process_spawn_frame: aos_rpc_send_and_receive",
+            aos_rpc_send_and_receive(args,
+                    aos_rpc_process_spawn_frame_send_handler,
+                    aos_rpc_process_spawn_frame_recv_handler));
+    if (err_is_fail(server_err)) {
+        return server_err;
+    }
+
+    *newpid = result;
+
+    // init has copied the arguments out by now.
+    return cap_destroy(frame);
+}
+
 //TODO: Finnish implementing
 errval_t aos_rpc_process_get_name_send_handler(void* void_args)
 {
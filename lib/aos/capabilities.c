@@ -351,7 +351,20 @@ errval_t cap_revoke(struct capref cap)
     capaddr_t caddr = get_cap_addr(cap);
     enum cnode_type level = get_cap_level(cap);
 
-    err = invoke_cnode_revoke(croot, caddr, level);
+    // The kernel revokes local caps incrementally, keep invoking until done.
+    // If a step got nothing done, someone else holds the caps in our way:
+    // let them run rather than spinning on the lock.
+    size_t progress = 0, last_progress = 0;
+    do {
+        err = invoke_cnode_revoke(croot, caddr, level, &progress);
+        if (err_no(err) == SYS_ERR_REVOKE_TOO_MANY ||
+            (err_no(err) == SYS_ERR_REVOKE_IN_PROGRESS &&
+             progress == last_progress)) {
+            thread_yield();
+        }
+        last_progress = progress;
+    } while (err_no(err) == SYS_ERR_REVOKE_IN_PROGRESS ||
+             err_no(err) == SYS_ERR_REVOKE_TOO_MANY);
 
     if (err_no(err) == SYS_ERR_RETRY_THROUGH_MONITOR) {
         return cap_revoke_remote(croot, caddr, level);
@@ -791,6 +804,36 @@ errval_t frame_forge(struct capref dest, genpaddr_t base, gensize_t bytes,
                                      dest.slot, coreid);
 }
 
+/**
+ * \brief Create several Frame caps ab initio, with a single invocation.
+ *
+ * \param dest   Location of the first new Frame cap
+ * \param frames Base and size of each frame, in slot order
+ * \param count  Number of frames; they go into consecutive slots from dest
+ * \param coreid Which core should own the capabilities
+ *
+ * As for frame_forge, but for a whole batch.  Same warnings apply!
+ */
+errval_t frames_forge(struct capref dest, struct frame_identity *frames,
+                      size_t count, coreid_t coreid) {
+    struct capability *caps = calloc(count, sizeof(struct capability));
+    if (caps == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    for (size_t i = 0; i < count; i++) {
+        caps[i].type = ObjType_Frame;
+        caps[i].rights = CAPRIGHTS_READ_WRITE;
+        caps[i].u.frame.base = frames[i].base;
+        caps[i].u.frame.bytes = frames[i].bytes;
+    }
+
+    errval_t err = invoke_monitor_create_caps(caps, get_cnode_addr(dest),
+                                              get_cnode_level(dest),
+                                              dest.slot, coreid, count);
+    free(caps);
+    return err;
+}
+
 /**
  * \brief Create a Dispatcher in newly-allocated memory
  *
@@ -857,6 +900,58 @@ errval_t frame_alloc(struct capref *dest, size_t bytes, size_t *retbytes)
     return frame_create(*dest, bytes, retbytes);
 }
 
+/**
+ * \brief Create a Frame cap referring to newly-allocated RAM with the given
+ * physical alignment, in an allocated slot
+ *
+ * \param dest      Pointer to capref struct, filled-in with location of new cap
+ * \param bytes     Minimum size of frame to create
+ * \param alignment Physical alignment of the frame's base
+ * \param retbytes  If non-NULL, filled in with size of created frame
+ */
+errval_t frame_alloc_aligned(struct capref *dest, size_t bytes,
+                             size_t alignment, size_t *retbytes)
+{
+    assert(bytes > 0);
+    errval_t err = slot_alloc(dest);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_SLOT_ALLOC);
+    }
+
+    bytes = ROUND_UP(bytes, BASE_PAGE_SIZE);
+
+    struct capref ram;
+    err = ram_alloc_aligned(&ram, bytes, alignment);
+    if (err_is_fail(err)) {
+        slot_free(*dest);
+        // mm reports a request no free block can satisfy as LIB_ERR_RAM_ALLOC
+        if (err_no(err) == MM_ERR_NOT_FOUND ||
+            err_no(err) == LIB_ERR_RAM_ALLOC ||
+            err_no(err) == LIB_ERR_RAM_ALLOC_WRONG_SIZE) {
+            return err_push(err, LIB_ERR_RAM_ALLOC_MS_CONSTRAINTS);
+        }
+        return err_push(err, LIB_ERR_RAM_ALLOC);
+    }
+    err = cap_retype(*dest, ram, 0, ObjType_Frame, bytes, 1);
+    if (err_is_fail(err)) {
+        ram_free(ram, bytes);
+        cap_destroy(ram);
+        slot_free(*dest);
+        return err_push(err, LIB_ERR_CAP_RETYPE);
+    }
+
+    err = cap_destroy(ram);
+    if (err_is_fail(err)) {
+        return err_push(err, LIB_ERR_CAP_DESTROY);
+    }
+
+    if (retbytes != NULL) {
+        *retbytes = bytes;
+    }
+
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief Create a DevFrame cap by retyping out of given source PhysAddr cap
  *
@@ -156,16 +156,25 @@ static void handle_pagefault(int subtype,
         }
     }
 
+    // Map a few pages at once. Mapped pages are split off their claimed
+    // vregion, so stopping at its end never maps over a page already there.
+    size_t bytes = MIN(4 * BASE_PAGE_SIZE, paging_claimed_size(st, vaddr));
+
     struct capref frame;
     size_t retsize;
-    err = frame_alloc(&frame, 4 * BASE_PAGE_SIZE, &retsize);
+    err = frame_alloc(&frame, bytes, &retsize);
     if (err_is_fail(err)) {
         debug_printf("Pagefault handler erred during frame_alloc: %s\n",
                 err_getstring(err));
         thread_exit(THREAD_EXIT_PAGEFAULT);
     }
 
-    err = paging_map_fixed(get_current_paging_state(), vaddr, frame, retsize);
+    err = paging_map_fixed(st, vaddr, frame, bytes);
+    if (err_is_fail(err) && !is_vregion_claimed(st, vaddr)) {
+        // Another thread faulted on the same page and mapped it first.
+        cap_destroy(frame);
+        return;
+    }
     if (err_is_fail(err)) {
         debug_printf("Pagefault handler erred during paging_map_fixed: %s\n",
                 err_getstring(err));
@@ -0,0 +1,270 @@
+/**
+ * \file
+ * \brief Server side of shared-memory request rings
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetstr 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <aos/aos.h>
+#include <aos/waitset.h>
+#include <aos/lmp_ring.h>
+#include <nameserver_rpc.h>
+
+static const struct lmp_ring_service *ring_service;
+
+bool lmp_ring_conn_pop(struct lmp_ring_conn *conn, struct lmp_ring_queue *q,
+                       uint32_t *slot)
+{
+    uint32_t tail = q->tail;
+    if (conn->sq_head == tail) {
+        return false;
+    }
+    // the client can hold at most one entry per slot in the queue
+    if (tail - conn->sq_head > LMP_RING_QUEUE_SIZE) {
+        conn->broken = true;
+        return false;
+    }
+    __asm volatile ("dmb");
+
+    *slot = q->entries[conn->sq_head % LMP_RING_QUEUE_SIZE];
+    q->head = ++conn->sq_head;
+    if (*slot >= LMP_RING_QUEUE_SIZE) {
+        conn->broken = true;
+        return false;
+    }
+    return true;
+}
+
+void lmp_ring_conn_push(struct lmp_ring_conn *conn, struct lmp_ring_queue *q,
+                        uint32_t slot)
+{
+    q->entries[conn->cq_tail % LMP_RING_QUEUE_SIZE] = slot;
+    __asm volatile ("dmb");
+    q->tail = ++conn->cq_tail;
+}
+
+void lmp_ring_conn_kick(struct lmp_ring_conn *conn)
+{
+    // a kick that cannot be delivered means the client is gone
+    errval_t err = lmp_ring_kick(&conn->lc);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "kicking client");
+        conn->broken = true;
+    }
+}
+
+void lmp_ring_conn_drop(struct lmp_ring_conn *conn)
+{
+    if (conn->dropped) {
+        return;
+    }
+    conn->dropped = true;
+    lmp_chan_deregister_recv(&conn->lc);
+    conn->svc->drop(conn);
+}
+
+void lmp_ring_conn_free(struct lmp_ring_conn *conn)
+{
+    if (conn->ring != NULL) {
+        paging_unmap(get_current_paging_state(), conn->ring);
+        cap_destroy(conn->frame);
+    }
+
+    cap_destroy(conn->lc.remote_cap);
+    lmp_chan_destroy(&conn->lc);
+    free(conn);
+}
+
+static errval_t conn_setup(struct lmp_ring_conn *conn, struct capref frame,
+                           uintptr_t *ok_arg)
+{
+    if (conn->ring != NULL) {
+        return LIB_ERR_LMP_RING_PROTOCOL;
+    }
+
+    struct frame_identity fi;
+    errval_t err = frame_identify(frame, &fi);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (fi.bytes < conn->svc->frame_size) {
+        return LIB_ERR_LMP_RING_PROTOCOL;
+    }
+
+    err = paging_map_frame_attr(get_current_paging_state(), &conn->ring,
+                                conn->svc->frame_size, frame,
+                                conn->svc->map_flags, NULL, NULL);
+    if (err_is_fail(err)) {
+        conn->ring = NULL;
+        return err;
+    }
+    conn->frame = frame;
+    conn->ring_base = fi.base;
+
+    err = conn->svc->setup(conn, ok_arg);
+    if (err_is_fail(err)) {
+        paging_unmap(get_current_paging_state(), conn->ring);
+        conn->ring = NULL;
+        conn->frame = NULL_CAP;
+    }
+    return err;
+}
+
+static void conn_handler(void *arg)
+{
+    struct lmp_ring_conn *conn = arg;
+
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+    struct capref cap;
+    errval_t err;
+    while (err_is_ok(err = lmp_chan_recv(&conn->lc, &msg, &cap))) {
+        if (msg.buf.msglen < 1) {
+            continue;
+        }
+
+        switch (msg.words[0]) {
+        case LMP_RING_SETUP:
+        {
+            err = lmp_chan_alloc_recv_slot(&conn->lc);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "allocating receive slot");
+            }
+            uintptr_t ok_arg = 0;
+            err = conn_setup(conn, cap, &ok_arg);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "setting up client ring");
+                if (!capref_is_null(cap)) {
+                    cap_destroy(cap);
+                }
+                err = lmp_chan_send1(&conn->lc, LMP_FLAG_SYNC, NULL_CAP,
+                                     LMP_RING_FAIL);
+            } else {
+                err = lmp_chan_send2(&conn->lc, LMP_FLAG_SYNC, NULL_CAP,
+                                     LMP_RING_OK, ok_arg);
+            }
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "acknowledging client ring");
+            }
+            break;
+        }
+        case LMP_RING_KICK:
+            if (conn->ring != NULL) {
+                conn->svc->drain(conn);
+            }
+            break;
+        default:
+            debug_printf("lmp_ring: unexpected message %u\n", msg.words[0]);
+            break;
+        }
+        msg = (struct lmp_recv_msg) LMP_RECV_MSG_INIT;
+
+        if (conn->broken) {
+            debug_printf("lmp_ring: dropping client\n");
+            lmp_ring_conn_drop(conn);
+            return;
+        }
+    }
+
+    err = lmp_chan_register_recv(&conn->lc, get_default_waitset(),
+                                 MKCLOSURE(conn_handler, conn));
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "registering client channel");
+    }
+}
+
+/**
+ * @brief accepts connections on the endpoint registered with the nameserver
+ */
+static void listen_handler(void *arg)
+{
+    struct lmp_chan *lc = arg;
+
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+    struct capref cap;
+    errval_t err = lmp_chan_recv(lc, &msg, &cap);
+
+    lmp_chan_register_recv(lc, get_default_waitset(),
+                           MKCLOSURE(listen_handler, arg));
+
+    if (err_is_fail(err)) {
+        if (!lmp_err_is_transient(err)) {
+            DEBUG_ERR(err, "receiving on service endpoint");
+        }
+        return;
+    }
+    if (msg.buf.msglen < 1 || msg.words[0] != LMP_RING_CONNECT
+            || capref_is_null(cap)) {
+        return;
+    }
+
+    err = lmp_chan_alloc_recv_slot(lc);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "allocating receive slot");
+    }
+
+    struct lmp_ring_conn *conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) {
+        DEBUG_ERR(LIB_ERR_MALLOC_FAIL, "accepting client");
+        cap_destroy(cap);
+        return;
+    }
+    conn->svc = ring_service;
+
+    err = lmp_chan_accept(&conn->lc, DEFAULT_LMP_BUF_WORDS, cap);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "accepting client");
+        cap_destroy(cap);
+        free(conn);
+        return;
+    }
+    err = lmp_chan_alloc_recv_slot(&conn->lc);
+    if (err_is_ok(err)) {
+        err = lmp_chan_register_recv(&conn->lc, get_default_waitset(),
+                                     MKCLOSURE(conn_handler, conn));
+    }
+    if (err_is_ok(err)) {
+        err = lmp_chan_send1(&conn->lc, LMP_FLAG_SYNC, conn->lc.local_cap,
+                             LMP_RING_OK);
+    }
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "accepting client");
+        lmp_chan_deregister_recv(&conn->lc);
+        lmp_ring_conn_free(conn);
+    }
+}
+
+errval_t lmp_ring_serve(const char *service,
+                        const struct lmp_ring_service *svc)
+{
+    errval_t err;
+
+    // one nameserver channel, and so one service, per domain
+    static struct aos_ns_rpc ns;
+    static struct waitset ns_ws;
+    if (ring_service != NULL) {
+        return LIB_ERR_LMP_RING_PROTOCOL;
+    }
+    ring_service = svc;
+
+    waitset_init(&ns_ws);
+    err = aos_ns_init(&ns, &ns_ws);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = register_service(&ns, (char *)service);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // clients reach us through the endpoint the nameserver hands out,
+    // which is the local end of our nameserver channel
+    return lmp_chan_register_recv(&ns.lc, get_default_waitset(),
+                                  MKCLOSURE(listen_handler, &ns.lc));
+}
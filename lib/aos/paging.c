@@ -23,6 +23,10 @@
 
 static struct paging_state current;
 
+// Bounds of the lazy_bss section, defined by the linker if the binary has one.
+extern char __start_lazy_bss[] __attribute__((weak));
+extern char __stop_lazy_bss[] __attribute__((weak));
+
 static char heap[PAGING_HEAP_SIZE] = { 0 };
 static char* currp = heap;
 static char* endp = heap + PAGING_HEAP_SIZE;
@@ -65,6 +69,7 @@ errval_t paging_init_state(struct paging_state *st, lvaddr_t start_vaddr,
     debug_printf("paging_init_state %p\n", st);
 
     st->mapping_cb = NULL;
+    thread_mutex_init(&st->mutex);
 
     // M2:
     // Slot allocator.
@@ -79,6 +84,15 @@ errval_t paging_init_state(struct paging_state *st, lvaddr_t start_vaddr,
     }
     slab_grow(&st->slabs, paging_buf, 64 * sizeof(struct paging_node));
 
+    slab_init(&st->mapping_slabs, sizeof(struct paging_mapping),
+            slab_default_refill);
+    paging_buf = paging_heap_malloc(64 * sizeof(struct paging_mapping));
+    if (paging_buf == NULL) {
+        return LIB_ERR_VSPACE_INIT;
+    }
+    slab_grow(&st->mapping_slabs, paging_buf,
+            64 * sizeof(struct paging_mapping));
+
     // We don't have any L2 pagetables yet, thus make sure the flags are unset.
     for (int i = 0; i < L1_PAGETABLE_ENTRIES; ++i) {
         st->l2_pagetables[i].initialized = false;
@@ -90,7 +104,9 @@ errval_t paging_init_state(struct paging_state *st, lvaddr_t start_vaddr,
     st->head->base = start_vaddr;
     st->head->size = capacity;
     st->head->type = NodeType_Free;
+    st->head->mappings = NULL;
     st->head->prev = NULL;
+    st->head->next = NULL;
 
     // Default L1 pagetable.
     st->l1_pagetable = pdir;
@@ -119,6 +135,17 @@ errval_t paging_init(void)
             get_default_slot_allocator());
     set_current_paging_state(&current);
 
+    // Pages inside lazy_bss were left unmapped by spawn (see LAZY_BSS).
+    lvaddr_t lazy_base = ROUND_UP((lvaddr_t) __start_lazy_bss, BASE_PAGE_SIZE);
+    lvaddr_t lazy_end = ROUND_DOWN((lvaddr_t) __stop_lazy_bss, BASE_PAGE_SIZE);
+    if (lazy_end > lazy_base) {
+        errval_t err = paging_claim_fixed(&current, lazy_base,
+                lazy_end - lazy_base);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_VSPACE_INIT);
+        }
+    }
+
     // TODO (M4): initialize self-paging handler
     // TIP: use thread_set_exception_handler() to setup a page fault handler
     // TIP: Think about the fact that later on, you'll have to make sure that
@@ -305,9 +332,9 @@ bool paging_should_refill_slabs(struct paging_state *st)
  * \brief Find a bit of free virtual address space that is large enough to
  *        accomodate a buffer of size `bytes`.
  */
-errval_t paging_alloc(struct paging_state *st, void **buf, size_t bytes)
+static errval_t paging_alloc_locked(struct paging_state *st, void **buf,
+        size_t bytes)
 {
-    // TODO: M2 Implement this function
     struct paging_node *node = st->head;
     while (node != NULL) {
         if (node->type == NodeType_Free && node->size >= bytes) {
@@ -319,6 +346,7 @@ errval_t paging_alloc(struct paging_state *st, void **buf, size_t bytes)
                 // Split it.
                 struct paging_node *new_node = (struct paging_node*) slab_alloc(&st->slabs);
                 new_node->type = NodeType_Free;
+                new_node->mappings = NULL;
                 new_node->base = node->base + bytes;
                 new_node->size = node->size - bytes;
                 new_node->next = node->next;
@@ -338,6 +366,14 @@ errval_t paging_alloc(struct paging_state *st, void **buf, size_t bytes)
     return LIB_ERR_VREGION_NOT_FOUND;
 }
 
+errval_t paging_alloc(struct paging_state *st, void **buf, size_t bytes)
+{
+    thread_mutex_lock_nested(&st->mutex);
+    errval_t err = paging_alloc_locked(st, buf, bytes);
+    thread_mutex_unlock(&st->mutex);
+    return err;
+}
+
 errval_t paging_refill_slabs(struct paging_state* st)
 {
     return slab_refill_no_pagefault(&st->slabs, NULL_CAP, BASE_PAGE_SIZE);
@@ -351,15 +387,22 @@ errval_t paging_map_frame_attr(struct paging_state *st, void **buf,
                                size_t bytes, struct capref frame,
                                int flags, void *arg1, void *arg2)
 {
+    // Hold the lock across both steps so no other thread can observe the
+    // claimed but not yet mapped vregion.
+    thread_mutex_lock_nested(&st->mutex);
+    errval_t err = SYS_ERR_OK;
     if (paging_should_refill_slabs(st)) {
-        CHECK("paging_map_frame_attr: paging_refill_slabs",
-                paging_refill_slabs(st));
+        err = paging_refill_slabs(st);
     }
-    errval_t err = paging_alloc(st, buf, bytes);
-    if (err_is_fail(err)) {
-        return err;
+    if (err_is_ok(err)) {
+        err = paging_alloc(st, buf, bytes);
     }
-    return paging_map_fixed_attr(st, (lvaddr_t) (*buf), frame, bytes, flags);
+    if (err_is_ok(err)) {
+        err = paging_map_fixed_attr(st, (lvaddr_t) (*buf), frame, bytes,
+                flags);
+    }
+    thread_mutex_unlock(&st->mutex);
+    return err;
 }
 
 errval_t
@@ -390,13 +433,132 @@ bool is_vregion_claimed(struct paging_state* st, lvaddr_t vaddr)
     return false;
 }
 
+size_t paging_claimed_size(struct paging_state* st, lvaddr_t vaddr)
+{
+    struct paging_node* node = st->head;
+    while (node != NULL) {
+        if (node->base <= vaddr && node->base + node->size > vaddr) {
+            if (node->type != NodeType_Claimed) {
+                return 0;
+            }
+            return node->base + node->size - vaddr;
+        }
+        node = node->next;
+    }
+    return 0;
+}
+
+/**
+ * \brief Turn the part [vaddr, vaddr + bytes) of a free node into a claimed
+ * node of its own, splitting off what is left on either side.
+ */
+static errval_t paging_claim_free_node(struct paging_state *st,
+        struct paging_node *node, lvaddr_t vaddr, size_t bytes)
+{
+    if (node->base + node->size > vaddr + bytes) {
+        struct paging_node *right = (struct paging_node*)
+                slab_alloc(&st->slabs);
+        if (right == NULL) {
+            return LIB_ERR_SLAB_ALLOC_FAIL;
+        }
+        right->type = NodeType_Free;
+        right->mappings = NULL;
+        right->base = vaddr + bytes;
+        right->size = node->base + node->size - right->base;
+        right->next = node->next;
+        right->prev = node;
+        if (node->next != NULL) {
+            node->next->prev = right;
+        }
+        node->next = right;
+        node->size -= right->size;
+    }
+
+    if (vaddr > node->base) {
+        struct paging_node *left = (struct paging_node*)
+                slab_alloc(&st->slabs);
+        if (left == NULL) {
+            return LIB_ERR_SLAB_ALLOC_FAIL;
+        }
+        left->type = NodeType_Free;
+        left->mappings = NULL;
+        left->base = node->base;
+        left->size = vaddr - node->base;
+        left->next = node;
+        left->prev = node->prev;
+        if (node->prev != NULL) {
+            node->prev->next = left;
+        } else {
+            st->head = left;
+        }
+        node->prev = left;
+        node->base = vaddr;
+        node->size -= left->size;
+    }
+
+    node->type = NodeType_Claimed;
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief claim a vregion at a user provided VA without mapping it.
+ * The region must either lie inside a single free vregion of `st' or not
+ * overlap any vregion tracked in `st' at all.
+ */
+static errval_t paging_claim_fixed_locked(struct paging_state *st,
+        lvaddr_t vaddr, size_t bytes)
+{
+    struct paging_node *prev = NULL;
+    struct paging_node *next = st->head;
+    while (next != NULL && next->base < vaddr + bytes) {
+        if (next->base + next->size > vaddr) {
+            if (next->type == NodeType_Free && next->base <= vaddr
+                    && next->base + next->size >= vaddr + bytes) {
+                return paging_claim_free_node(st, next, vaddr, bytes);
+            }
+            return LIB_ERR_VREGION_MAP_FIXED;
+        }
+        prev = next;
+        next = next->next;
+    }
+
+    struct paging_node *node = (struct paging_node*) slab_alloc(&st->slabs);
+    if (node == NULL) {
+        return LIB_ERR_SLAB_ALLOC_FAIL;
+    }
+    node->type = NodeType_Claimed;
+    node->mappings = NULL;
+    node->base = vaddr;
+    node->size = bytes;
+    node->prev = prev;
+    node->next = next;
+    if (prev != NULL) {
+        prev->next = node;
+    } else {
+        st->head = node;
+    }
+    if (next != NULL) {
+        next->prev = node;
+    }
+    return SYS_ERR_OK;
+}
+
+errval_t paging_claim_fixed(struct paging_state *st, lvaddr_t vaddr,
+        size_t bytes)
+{
+    thread_mutex_lock_nested(&st->mutex);
+    errval_t err = paging_claim_fixed_locked(st, vaddr, bytes);
+    thread_mutex_unlock(&st->mutex);
+    return err;
+}
+
 /**
  * \brief map a user provided frame at user provided VA.
  * TODO(M1): Map a frame assuming all mappings will fit into one L2 pt
  * TODO(M2): General case
  */
-errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
-        struct capref frame, size_t bytes, int flags)
+static errval_t paging_map_fixed_attr_locked(struct paging_state *st,
+        lvaddr_t vaddr, struct capref frame, size_t bytes, int flags)
 {
     /* Step 1: Check if the virtual memory area wanted by the user is in fact
                free (check corresponding page_node). */
@@ -422,10 +584,12 @@ errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
         //       we should free the node & merge it back.
         enum nodetype old_type = node->type;
         node->type = NodeType_Allocated;
+        node->mappings = NULL;
         if (node->base + node->size > vaddr + bytes) {
             // Need new (free) node to the right;
             struct paging_node *right = (struct paging_node*) slab_alloc(&st->slabs);
             right->type = old_type;
+            right->mappings = NULL;
             right->base = vaddr + bytes;
             right->size = node->size - (vaddr - node->base) - bytes;
             right->next = node->next;
@@ -441,6 +605,7 @@ errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
             // Need new (free) node to the left.
             struct paging_node *left = (struct paging_node*) slab_alloc(&st->slabs);
             left->type = old_type;
+            left->mappings = NULL;
             left->base = node->base;
             left->size = vaddr - node->base;
             left->next = node;
@@ -460,11 +625,74 @@ errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
            sub-frames. */
         uint32_t mapped_size = 0;
         errval_t err;
+
+        // Frames with a 1MB-aligned physical base can have their whole
+        // megabytes mapped as sections, which saves the L2 tables, the
+        // per-chunk mapping caps and TLB entries.
+        bool frame_aligned = false;
+        if (bytes >= LARGE_PAGE_SIZE && LARGE_PAGE_OFFSET(vaddr) == 0) {
+            struct frame_identity fi;
+            frame_aligned = err_is_ok(frame_identify(frame, &fi))
+                    && LARGE_PAGE_OFFSET(fi.base) == 0;
+        }
+
         while (bytes > 0) {
             struct capref l2_cap;
             // Get index of next L2 pagetable to map into.
             uint16_t l2_index = ARM_L1_OFFSET(vaddr);
 
+            if (frame_aligned
+                    && LARGE_PAGE_OFFSET(vaddr) == 0
+                    && LARGE_PAGE_OFFSET(mapped_size) == 0
+                    && bytes >= LARGE_PAGE_SIZE
+                    && !st->l2_pagetables[l2_index].initialized) {
+                // Stop before the first megabyte that already has an L2.
+                size_t sections = 1;
+                while (sections < bytes / LARGE_PAGE_SIZE
+                        && !st->l2_pagetables[l2_index + sections].initialized) {
+                    ++sections;
+                }
+
+                struct capref section_to_l1;
+                err = st->slot_alloc->alloc(st->slot_alloc, &section_to_l1);
+                if (err_is_fail(err)) {
+                    DEBUG_ERR(err, "slot_alloc for mapping sections to L1\n");
+                    return err;
+                }
+                err = vnode_map(st->l1_pagetable, frame, l2_index, flags,
+                        mapped_size, sections, section_to_l1);
+                if (err_is_fail(err)) {
+                    DEBUG_ERR(err, "Mapping sections to L1");
+                    return err;
+                }
+                if (slab_freecount(&st->mapping_slabs) < 2) {
+                    err = slab_refill_no_pagefault(&st->mapping_slabs,
+                            NULL_CAP, BASE_PAGE_SIZE);
+                    if (err_is_fail(err)) {
+                        return err;
+                    }
+                }
+                struct paging_mapping *mapping = (struct paging_mapping*)
+                        slab_alloc(&st->mapping_slabs);
+                mapping->cap = section_to_l1;
+                mapping->l2_index = l2_index;
+                mapping->section = true;
+                mapping->next = node->mappings;
+                node->mappings = mapping;
+                if (st->mapping_cb) {
+                    err = st->mapping_cb(st->mapping_state, section_to_l1);
+                    if (err_is_fail(err)) {
+                        DEBUG_ERR(err, "Copying mapping section_to_l1 to child");
+                        return err;
+                    }
+                }
+
+                mapped_size += sections * LARGE_PAGE_SIZE;
+                bytes -= sections * LARGE_PAGE_SIZE;
+                vaddr += sections * LARGE_PAGE_SIZE;
+                continue;
+            }
+
             if (st->l2_pagetables[l2_index].initialized) {
                 l2_cap = st->l2_pagetables[l2_index].cap;
             } else {
@@ -525,6 +753,20 @@ errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
                 DEBUG_ERR(err, "Mapping frame to L2");  
                 return err;
             }
+            if (slab_freecount(&st->mapping_slabs) < 2) {
+                err = slab_refill_no_pagefault(&st->mapping_slabs, NULL_CAP,
+                        BASE_PAGE_SIZE);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+            struct paging_mapping *mapping = (struct paging_mapping*)
+                    slab_alloc(&st->mapping_slabs);
+            mapping->cap = frame_to_l2;
+            mapping->l2_index = l2_index;
+            mapping->section = false;
+            mapping->next = node->mappings;
+            node->mappings = mapping;
             if (st->mapping_cb) {
                 err = st->mapping_cb(st->mapping_state, frame_to_l2);
                 if (err_is_fail(err)) {
@@ -545,11 +787,110 @@ errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
     return SYS_ERR_OK;
 }
 
+errval_t paging_map_fixed_attr(struct paging_state *st, lvaddr_t vaddr,
+        struct capref frame, size_t bytes, int flags)
+{
+    thread_mutex_lock_nested(&st->mutex);
+    errval_t err = paging_map_fixed_attr_locked(st, vaddr, frame, bytes,
+            flags);
+    thread_mutex_unlock(&st->mutex);
+    return err;
+}
+
+/**
+ * \brief return `node' to the free list, merging it with free neighbours.
+ */
+static void paging_free_node_locked(struct paging_state *st,
+        struct paging_node *node)
+{
+    node->type = NodeType_Free;
+
+    struct paging_node *next = node->next;
+    if (next != NULL && next->type == NodeType_Free
+            && node->base + node->size == next->base) {
+        node->size += next->size;
+        node->next = next->next;
+        if (next->next != NULL) {
+            next->next->prev = node;
+        }
+        slab_free(&st->slabs, next);
+    }
+    struct paging_node *prev = node->prev;
+    if (prev != NULL && prev->type == NodeType_Free
+            && prev->base + prev->size == node->base) {
+        prev->size += node->size;
+        prev->next = node->next;
+        if (node->next != NULL) {
+            node->next->prev = prev;
+        }
+        slab_free(&st->slabs, node);
+    }
+}
+
+/**
+ * \brief return the claimed vregions lying inside [vaddr, vaddr + bytes) to
+ * the free list. Mapped vregions in the range are left alone.
+ */
+errval_t paging_unclaim(struct paging_state *st, lvaddr_t vaddr,
+        size_t bytes)
+{
+    thread_mutex_lock_nested(&st->mutex);
+    struct paging_node *node = st->head;
+    while (node != NULL && node->base < vaddr + bytes) {
+        if (node->type == NodeType_Claimed && node->base >= vaddr
+                && node->base + node->size <= vaddr + bytes) {
+            // merging frees neighbouring nodes, so start over
+            paging_free_node_locked(st, node);
+            node = st->head;
+            continue;
+        }
+        node = node->next;
+    }
+    thread_mutex_unlock(&st->mutex);
+    return SYS_ERR_OK;
+}
+
 /**
  * \brief unmap region starting at address `region`.
- * NOTE: Implementing this function is optional.
+ * The vregion is returned to the free list and merged with free neighbours.
  */
-errval_t paging_unmap(struct paging_state *st, const void *region)
+static errval_t paging_unmap_locked(struct paging_state *st,
+        const void *region)
 {
+    struct paging_node *node = st->head;
+    while (node != NULL && node->base != (lvaddr_t) region) {
+        node = node->next;
+    }
+    if (node == NULL || node->type != NodeType_Allocated) {
+        return LIB_ERR_VREGION_NOT_FOUND;
+    }
+
+    while (node->mappings != NULL) {
+        struct paging_mapping *mapping = node->mappings;
+        struct capref vnode = mapping->section
+                ? st->l1_pagetable
+                : st->l2_pagetables[mapping->l2_index].cap;
+        errval_t err = vnode_unmap(vnode, mapping->cap);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_VNODE_UNMAP);
+        }
+        err = cap_delete(mapping->cap);
+        if (err_is_fail(err)) {
+            return err_push(err, LIB_ERR_CAP_DELETE);
+        }
+        st->slot_alloc->free(st->slot_alloc, mapping->cap);
+        node->mappings = mapping->next;
+        slab_free(&st->mapping_slabs, mapping);
+    }
+    paging_free_node_locked(st, node);
+
     return SYS_ERR_OK;
 }
+
+errval_t paging_unmap(struct paging_state *st, const void *region)
+{
+    thread_mutex_lock_nested(&st->mutex);
+    errval_t err = paging_unmap_locked(st, region);
+    thread_mutex_unlock(&st->mutex);
+    return err;
+}
@@ -69,6 +69,13 @@ errval_t sys_debug_print_timeslice(void)
     return err;
 }
 
+errval_t sys_debug_revoke_stat_read(enum revoke_stat stat, uintptr_t *ret)
+{
+    struct sysret sr = syscall3(SYSCALL_DEBUG, DEBUG_REVOKE_STAT_READ, stat);
+    *ret = sr.value;
+    return sr.error;
+}
+
 errval_t sys_debug_flush_cache(void)
 {
     return syscall2(SYSCALL_DEBUG, DEBUG_FLUSH_CACHE).error;
@@ -0,0 +1,438 @@
+/**
+ * \file
+ * \brief Write-back block cache with read-ahead in front of a block device.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <aos/aos.h>
+
+#include <bdev/bdev.h>
+#include <bdev/bcache.h>
+
+/// Read-ahead window of a reader that has just turned sequential
+#define BCACHE_READAHEAD_MIN    8
+
+struct bcache_entry {
+    size_t lba;
+    bool dirty;
+    uint8_t *data;
+    struct bcache_entry *hnext;         ///< next in the hash bucket
+    struct bcache_entry *prev;          ///< LRU list, most recent first
+    struct bcache_entry *next;
+    struct bcache_entry *dnext;         ///< next on the dirty list
+};
+
+/**
+ * @brief a cache, serving requests synchronously from submit
+ */
+struct bcache {
+    struct bdev dev;
+    struct bdev *lower;
+
+    struct bcache_entry *entries;
+    size_t nentries;
+    size_t nused;                       ///< entries that have held a block
+    struct bcache_entry **buckets;      ///< entries by lba
+    size_t nbuckets;                    ///< a power of two
+    struct bcache_entry *lru_head;
+    struct bcache_entry *lru_tail;
+    struct bcache_entry *dirty;         ///< dirty entries, unordered
+    size_t ndirty;
+
+    size_t next_lba;                    ///< where a sequential read goes on
+    size_t readahead;                   ///< current read-ahead window
+
+    uint8_t *readbuf;                   ///< runs read from lower
+    uint8_t *writebuf;                  ///< runs written to lower
+    struct bcache_entry **sorted;       ///< dirty entries while flushing
+
+    struct bcache_stats stats;
+};
+
+static struct bcache_entry **bcache_bucket(struct bcache *c, size_t lba)
+{
+    return &c->buckets[lba & (c->nbuckets - 1)];
+}
+
+static struct bcache_entry *bcache_lookup(struct bcache *c, size_t lba)
+{
+    struct bcache_entry *e = *bcache_bucket(c, lba);
+    while (e != NULL && e->lba != lba) {
+        e = e->hnext;
+    }
+    return e;
+}
+
+static void lru_remove(struct bcache *c, struct bcache_entry *e)
+{
+    if (e->prev != NULL) {
+        e->prev->next = e->next;
+    } else {
+        c->lru_head = e->next;
+    }
+    if (e->next != NULL) {
+        e->next->prev = e->prev;
+    } else {
+        c->lru_tail = e->prev;
+    }
+}
+
+static void lru_push(struct bcache *c, struct bcache_entry *e)
+{
+    e->prev = NULL;
+    e->next = c->lru_head;
+    if (c->lru_head != NULL) {
+        c->lru_head->prev = e;
+    } else {
+        c->lru_tail = e;
+    }
+    c->lru_head = e;
+}
+
+static void bcache_touch(struct bcache *c, struct bcache_entry *e)
+{
+    if (c->lru_head != e) {
+        lru_remove(c, e);
+        lru_push(c, e);
+    }
+}
+
+static int compare_lba(const void *a, const void *b)
+{
+    const struct bcache_entry *ea = *(struct bcache_entry * const *)a;
+    const struct bcache_entry *eb = *(struct bcache_entry * const *)b;
+    return ea->lba < eb->lba ? -1 : ea->lba > eb->lba;
+}
+
+/**
+ * @brief writes all dirty blocks back, in runs of consecutive blocks
+ */
+static errval_t bcache_writeback(struct bcache *c)
+{
+    size_t n = 0;
+    for (struct bcache_entry *e = c->dirty; e != NULL; e = e->dnext) {
+        c->sorted[n++] = e;
+    }
+    assert(n == c->ndirty);
+    qsort(c->sorted, n, sizeof(*c->sorted), compare_lba);
+
+    for (size_t i = 0; i < n; ) {
+        size_t run = 1;
+        while (i + run < n && run < BCACHE_BATCH_BLOCKS
+                && c->sorted[i + run]->lba == c->sorted[i]->lba + run) {
+            run++;
+        }
+
+        for (size_t k = 0; k < run; k++) {
+            memcpy(c->writebuf + k * BDEV_BLOCK_SIZE, c->sorted[i + k]->data,
+                   BDEV_BLOCK_SIZE);
+        }
+        errval_t err = bdev_write(c->lower, c->sorted[i]->lba, run,
+                                  c->writebuf);
+        if (err_is_fail(err)) {
+            // the blocks not written yet stay dirty
+            c->dirty = NULL;
+            c->ndirty = 0;
+            for (size_t k = i; k < n; k++) {
+                c->sorted[k]->dnext = c->dirty;
+                c->dirty = c->sorted[k];
+                c->ndirty++;
+            }
+            return err;
+        }
+
+        for (size_t k = 0; k < run; k++) {
+            c->sorted[i + k]->dirty = false;
+        }
+        c->stats.writebacks += run;
+        c->stats.write_requests++;
+        i += run;
+    }
+
+    c->dirty = NULL;
+    c->ndirty = 0;
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief takes an entry for lba, which must not be cached yet
+ */
+static errval_t bcache_insert(struct bcache *c, size_t lba,
+                              struct bcache_entry **rete)
+{
+    struct bcache_entry *e;
+    if (c->nused < c->nentries) {
+        e = &c->entries[c->nused++];
+    } else {
+        e = c->lru_tail;
+        if (e->dirty) {
+            errval_t err = bcache_writeback(c);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+
+        struct bcache_entry **p = bcache_bucket(c, e->lba);
+        while (*p != e) {
+            p = &(*p)->hnext;
+        }
+        *p = e->hnext;
+        lru_remove(c, e);
+        c->stats.evictions++;
+    }
+
+    e->lba = lba;
+    e->dirty = false;
+    struct bcache_entry **bucket = bcache_bucket(c, lba);
+    e->hnext = *bucket;
+    *bucket = e;
+    lru_push(c, e);
+
+    *rete = e;
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief reads count uncached blocks from lower into the cache and readbuf
+ */
+static errval_t bcache_fetch(struct bcache *c, size_t lba, size_t count)
+{
+    errval_t err = bdev_read(c->lower, lba, count, c->readbuf);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        struct bcache_entry *e;
+        err = bcache_insert(c, lba + k, &e);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        memcpy(e->data, c->readbuf + k * BDEV_BLOCK_SIZE, BDEV_BLOCK_SIZE);
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief counts the uncached blocks from lba on, at most max of them
+ */
+static size_t bcache_uncached(struct bcache *c, size_t lba, size_t max)
+{
+    size_t n = 0;
+    while (n < max && lba + n < c->dev.nblocks
+            && bcache_lookup(c, lba + n) == NULL) {
+        n++;
+    }
+    return n;
+}
+
+static errval_t bcache_read(struct bcache *c, size_t lba, size_t count,
+                            uint8_t *buf)
+{
+    errval_t err;
+
+    if (lba == c->next_lba) {
+        c->readahead = MIN(MAX(2 * c->readahead, BCACHE_READAHEAD_MIN),
+                           BCACHE_READAHEAD_MAX);
+    } else {
+        c->readahead = 0;
+    }
+    c->next_lba = lba + count;
+
+    bool fetched_end = false;
+    for (size_t i = 0; i < count; ) {
+        struct bcache_entry *e = bcache_lookup(c, lba + i);
+        if (e != NULL) {
+            memcpy(buf + i * BDEV_BLOCK_SIZE, e->data, BDEV_BLOCK_SIZE);
+            bcache_touch(c, e);
+            c->stats.hits++;
+            i++;
+            continue;
+        }
+
+        size_t run = bcache_uncached(c, lba + i,
+                                     MIN(count - i, BCACHE_BATCH_BLOCKS));
+        size_t ahead = 0;
+        if (i + run == count) {
+            ahead = bcache_uncached(c, lba + count,
+                                    MIN(c->readahead,
+                                        BCACHE_BATCH_BLOCKS - run));
+            fetched_end = true;
+        }
+
+        err = bcache_fetch(c, lba + i, run + ahead);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        memcpy(buf + i * BDEV_BLOCK_SIZE, c->readbuf, run * BDEV_BLOCK_SIZE);
+        c->stats.misses += run;
+        c->stats.readahead += ahead;
+        i += run;
+    }
+
+    // keep a sequential reader that only hit ahead of itself
+    if (!fetched_end && c->readahead > 0) {
+        size_t ahead = bcache_uncached(c, lba + count,
+                                       MIN(c->readahead, BCACHE_BATCH_BLOCKS));
+        if (ahead > 0) {
+            err = bcache_fetch(c, lba + count, ahead);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            c->stats.readahead += ahead;
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+static errval_t bcache_write(struct bcache *c, size_t lba, size_t count,
+                             const uint8_t *buf)
+{
+    errval_t err;
+
+    for (size_t i = 0; i < count; i++) {
+        struct bcache_entry *e = bcache_lookup(c, lba + i);
+        if (e == NULL) {
+            err = bcache_insert(c, lba + i, &e);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        } else {
+            bcache_touch(c, e);
+        }
+
+        memcpy(e->data, buf + i * BDEV_BLOCK_SIZE, BDEV_BLOCK_SIZE);
+        if (!e->dirty) {
+            e->dirty = true;
+            e->dnext = c->dirty;
+            c->dirty = e;
+            c->ndirty++;
+        }
+    }
+
+    if (c->ndirty > c->nentries / 2) {
+        return bcache_writeback(c);
+    }
+    return SYS_ERR_OK;
+}
+
+static errval_t bcache_submit(struct bdev *dev, struct bdev_req *req)
+{
+    struct bcache *c = (struct bcache *)dev;
+
+    errval_t err;
+    if (req->op == BDEV_READ) {
+        err = bcache_read(c, req->lba, req->count, req->buf);
+    } else {
+        err = bcache_write(c, req->lba, req->count, req->buf);
+    }
+
+    req->issued = req->count;
+    req->pending = 1;
+    bdev_req_complete(dev, req, err);
+
+    return SYS_ERR_OK;
+}
+
+static errval_t bcache_poll(struct bdev *dev, bool block)
+{
+    // requests complete as they are submitted
+    return SYS_ERR_OK;
+}
+
+static errval_t bcache_flush(struct bdev *dev)
+{
+    struct bcache *c = (struct bcache *)dev;
+
+    errval_t err = bcache_writeback(c);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    return bdev_flush(c->lower);
+}
+
+static void bcache_close(struct bdev *dev)
+{
+    struct bcache *c = (struct bcache *)dev;
+
+    // the block data is one allocation, starting at the first entry's
+    free(c->entries[0].data);
+    free(c->entries);
+    free(c->buckets);
+    free(c->sorted);
+    free(c->readbuf);
+    free(c->writebuf);
+    free(c);
+}
+
+static const struct bdev_ops bcache_ops = {
+    .submit = bcache_submit,
+    .poll = bcache_poll,
+    .flush = bcache_flush,
+    .close = bcache_close,
+};
+
+errval_t bcache_create(struct bdev *lower, size_t nblocks,
+                       struct bdev **retdev)
+{
+    if (nblocks == 0) {
+        return BDEV_ERR_OUT_OF_RANGE;
+    }
+
+    struct bcache *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    c->dev.ops = &bcache_ops;
+    c->dev.nblocks = lower->nblocks;
+    c->lower = lower;
+    c->nentries = nblocks;
+    c->next_lba = SIZE_MAX;
+
+    c->nbuckets = 1;
+    while (c->nbuckets < nblocks) {
+        c->nbuckets *= 2;
+    }
+
+    c->entries = calloc(nblocks, sizeof(*c->entries));
+    c->buckets = calloc(c->nbuckets, sizeof(*c->buckets));
+    c->sorted = calloc(nblocks, sizeof(*c->sorted));
+    uint8_t *data = malloc(nblocks * BDEV_BLOCK_SIZE);
+    c->readbuf = malloc(BCACHE_BATCH_BLOCKS * BDEV_BLOCK_SIZE);
+    c->writebuf = malloc(BCACHE_BATCH_BLOCKS * BDEV_BLOCK_SIZE);
+    if (c->entries == NULL || c->buckets == NULL || c->sorted == NULL
+            || data == NULL || c->readbuf == NULL || c->writebuf == NULL) {
+        free(c->entries);
+        free(c->buckets);
+        free(c->sorted);
+        free(data);
+        free(c->readbuf);
+        free(c->writebuf);
+        free(c);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    for (size_t i = 0; i < nblocks; i++) {
+        c->entries[i].data = data + i * BDEV_BLOCK_SIZE;
+    }
+
+    *retdev = &c->dev;
+
+    return SYS_ERR_OK;
+}
+
+void bcache_get_stats(struct bdev *dev, struct bcache_stats *stats)
+{
+    *stats = ((struct bcache *)dev)->stats;
+}
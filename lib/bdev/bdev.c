@@ -0,0 +1,137 @@
+/**
+ * \file
+ * \brief Block device interface, independent of the backend.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <aos/aos.h>
+
+#include <bdev/bdev.h>
+
+errval_t bdev_submit(struct bdev *dev, struct bdev_req *req)
+{
+    if (req->lba > dev->nblocks || req->count > dev->nblocks - req->lba) {
+        return BDEV_ERR_OUT_OF_RANGE;
+    }
+
+    req->issued = 0;
+    req->pending = 0;
+    req->err = SYS_ERR_OK;
+    req->next = NULL;
+
+    if (req->count == 0) {
+        req->done(req, SYS_ERR_OK);
+        return SYS_ERR_OK;
+    }
+
+    dev->inflight++;
+    errval_t err = dev->ops->submit(dev, req);
+    if (err_is_fail(err)) {
+        dev->inflight--;
+    }
+    return err;
+}
+
+errval_t bdev_poll(struct bdev *dev, bool block)
+{
+    return dev->ops->poll(dev, block && dev->inflight > 0);
+}
+
+void bdev_req_complete(struct bdev *dev, struct bdev_req *req, errval_t err)
+{
+    assert(req->pending > 0);
+
+    if (err_is_fail(err) && err_is_ok(req->err)) {
+        req->err = err;
+    }
+
+    req->pending--;
+    if (req->pending == 0 && req->issued == req->count) {
+        dev->inflight--;
+        req->done(req, req->err);
+    }
+}
+
+struct bdev_sync {
+    bool done;
+    errval_t err;
+};
+
+static void bdev_sync_done(struct bdev_req *req, errval_t err)
+{
+    struct bdev_sync *sync = req->arg;
+    sync->err = err;
+    sync->done = true;
+}
+
+static errval_t bdev_sync(struct bdev *dev, enum bdev_op op, size_t lba,
+                          size_t count, void *buf)
+{
+    struct bdev_sync sync = { .done = false, .err = SYS_ERR_OK };
+    struct bdev_req req = {
+        .op = op,
+        .lba = lba,
+        .count = count,
+        .buf = buf,
+        .done = bdev_sync_done,
+        .arg = &sync,
+    };
+
+    errval_t err = bdev_submit(dev, &req);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    while (!sync.done) {
+        err = bdev_poll(dev, true);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    return sync.err;
+}
+
+errval_t bdev_read(struct bdev *dev, size_t lba, size_t count, void *buf)
+{
+    return bdev_sync(dev, BDEV_READ, lba, count, buf);
+}
+
+errval_t bdev_write(struct bdev *dev, size_t lba, size_t count,
+                    const void *buf)
+{
+    return bdev_sync(dev, BDEV_WRITE, lba, count, (void *)buf);
+}
+
+errval_t bdev_flush(struct bdev *dev)
+{
+    if (dev->ops->flush == NULL) {
+        return SYS_ERR_OK;
+    }
+    return dev->ops->flush(dev);
+}
+
+void bdev_close(struct bdev *dev)
+{
+    assert(dev->inflight == 0);
+    if (dev->ops->close != NULL) {
+        dev->ops->close(dev);
+    }
+}
+
+errval_t bdev_open(const char *name, struct bdev **retdev)
+{
+    if (strcmp(name, "ramdisk") == 0) {
+        return bdev_ramdisk_create(BDEV_RAMDISK_DEFAULT_BLOCKS, retdev);
+    }
+    return bdev_connect(name, retdev);
+}
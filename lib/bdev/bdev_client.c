@@ -0,0 +1,314 @@
+/**
+ * \file
+ * \brief Block device that forwards requests to a block device service.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <aos/aos.h>
+#include <aos/waitset.h>
+#include <nameserver_rpc.h>
+
+#include <bdev/bdev.h>
+#include <bdev/bdev_ring.h>
+
+/**
+ * @brief connection to a block device service
+ *
+ * Requests are split into parts of at most BDEV_RING_SLOT_BLOCKS blocks,
+ * one per ring slot. Requests that find no free slot wait on the queue and
+ * are issued as completions free up slots. Not thread-safe.
+ */
+struct bdev_client {
+    struct bdev dev;
+    struct lmp_chan lc;             ///< channel to the service
+    struct waitset ws;              ///< kicks from the service arrive here
+    struct bdev_ring *ring;         ///< ring shared with the service
+    struct capref frame;            ///< backs ring
+    uint32_t free;                  ///< free slots, by bit
+
+    struct bdev_req *slot_req[BDEV_RING_SLOTS];
+    size_t slot_offset[BDEV_RING_SLOTS];    ///< first block of the part
+
+    struct bdev_req *queue;         ///< requests with parts not yet issued
+    struct bdev_req *queue_tail;
+};
+
+static void bdev_client_wakeup(void *arg)
+{
+    // the waiter drains the endpoint itself
+}
+
+/**
+ * @brief receives a message from the service, blocking if block is set
+ */
+static errval_t bdev_client_recv(struct bdev_client *c, bool block,
+                                 struct lmp_recv_msg *msg, struct capref *cap)
+{
+    errval_t err;
+    while (true) {
+        err = lmp_chan_recv(&c->lc, msg, cap);
+        if (err_no(err) != LIB_ERR_NO_LMP_MSG || !block) {
+            return err;
+        }
+
+        err = lmp_chan_register_recv(&c->lc, &c->ws,
+                                     MKCLOSURE(bdev_client_wakeup, c));
+        if (err_is_fail(err)) {
+            return err;
+        }
+        err = event_dispatch(&c->ws);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+}
+
+static errval_t bdev_client_expect_ok(struct bdev_client *c,
+                                      struct lmp_recv_msg *msg,
+                                      struct capref *cap)
+{
+    errval_t err = bdev_client_recv(c, true, msg, cap);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (msg->buf.msglen < 1 || msg->words[0] != LMP_RING_OK) {
+        return BDEV_ERR_PROTOCOL;
+    }
+    return SYS_ERR_OK;
+}
+
+static errval_t bdev_client_send_cap(struct bdev_client *c, struct capref cap,
+                                     uintptr_t code)
+{
+    errval_t err;
+    do {
+        err = lmp_chan_send1(&c->lc, LMP_FLAG_SYNC, cap, code);
+    } while (lmp_err_is_transient(err));
+    return err;
+}
+
+/**
+ * @brief hands parts of queued requests to free slots
+ */
+static errval_t bdev_client_issue(struct bdev_client *c)
+{
+    bool issued = false;
+    while (c->free != 0 && c->queue != NULL) {
+        struct bdev_req *req = c->queue;
+        uint32_t slot = __builtin_ctz(c->free);
+        c->free &= ~(1u << slot);
+
+        size_t count = MIN(req->count - req->issued, BDEV_RING_SLOT_BLOCKS);
+        struct bdev_ring_slot *s = &c->ring->slots[slot];
+        s->op = req->op;
+        s->lba = req->lba + req->issued;
+        s->count = count;
+        if (req->op == BDEV_WRITE) {
+            memcpy(bdev_ring_data(c->ring, slot),
+                   (uint8_t *)req->buf + req->issued * BDEV_BLOCK_SIZE,
+                   count * BDEV_BLOCK_SIZE);
+        }
+
+        c->slot_req[slot] = req;
+        c->slot_offset[slot] = req->issued;
+        req->issued += count;
+        req->pending++;
+        if (req->issued == req->count) {
+            c->queue = req->next;
+            if (c->queue == NULL) {
+                c->queue_tail = NULL;
+            }
+        }
+
+        lmp_ring_push(&c->ring->sq, slot);
+        issued = true;
+    }
+
+    return issued ? lmp_ring_kick(&c->lc) : SYS_ERR_OK;
+}
+
+static errval_t bdev_client_submit(struct bdev *dev, struct bdev_req *req)
+{
+    struct bdev_client *c = (struct bdev_client *)dev;
+
+    if (c->queue_tail != NULL) {
+        c->queue_tail->next = req;
+    } else {
+        c->queue = req;
+    }
+    c->queue_tail = req;
+
+    return bdev_client_issue(c);
+}
+
+static errval_t bdev_client_poll(struct bdev *dev, bool block)
+{
+    struct bdev_client *c = (struct bdev_client *)dev;
+    errval_t err;
+
+    while (true) {
+        bool completed = false;
+        uint32_t slot;
+        while (lmp_ring_pop(&c->ring->cq, &slot)) {
+            if (slot >= BDEV_RING_SLOTS || (c->free & (1u << slot))) {
+                continue;
+            }
+            struct bdev_req *req = c->slot_req[slot];
+            struct bdev_ring_slot *s = &c->ring->slots[slot];
+            if (req->op == BDEV_READ && err_is_ok(s->err)) {
+                memcpy((uint8_t *)req->buf
+                            + c->slot_offset[slot] * BDEV_BLOCK_SIZE,
+                       bdev_ring_data(c->ring, slot),
+                       s->count * BDEV_BLOCK_SIZE);
+            }
+            c->free |= 1u << slot;
+            c->slot_req[slot] = NULL;
+            bdev_req_complete(dev, req, s->err);
+            completed = true;
+        }
+
+        if (completed) {
+            return bdev_client_issue(c);
+        }
+
+        // a kick, or nothing if we do not wait, then look at the ring again
+        struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+        err = bdev_client_recv(c, block, &msg, NULL);
+        if (err_no(err) == LIB_ERR_NO_LMP_MSG) {
+            return SYS_ERR_OK;
+        }
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+}
+
+static void bdev_client_close(struct bdev *dev)
+{
+    struct bdev_client *c = (struct bdev_client *)dev;
+
+    // the service drops us once it finds our endpoint gone
+    paging_unmap(get_current_paging_state(), c->ring);
+    cap_destroy(c->frame);
+    lmp_chan_deregister_recv(&c->lc);
+    cap_destroy(c->lc.remote_cap);
+    lmp_chan_destroy(&c->lc);
+    waitset_destroy(&c->ws);
+    free(c);
+}
+
+static const struct bdev_ops bdev_client_ops = {
+    .submit = bdev_client_submit,
+    .poll = bdev_client_poll,
+    .close = bdev_client_close,
+};
+
+errval_t bdev_connect(const char *service, struct bdev **retdev)
+{
+    errval_t err;
+
+    static struct aos_ns_rpc ns;
+    static struct waitset ns_ws;
+    static bool ns_connected = false;
+    if (!ns_connected) {
+        waitset_init(&ns_ws);
+        err = aos_ns_init(&ns, &ns_ws);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        ns_connected = true;
+    }
+
+    struct capref ep;
+    err = lookup(&ns, (char *)service, &ep);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct bdev_client *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    c->dev.ops = &bdev_client_ops;
+    c->free = (1u << BDEV_RING_SLOTS) - 1;
+    waitset_init(&c->ws);
+
+    err = lmp_chan_accept(&c->lc, DEFAULT_LMP_BUF_WORDS, ep);
+    if (err_is_fail(err)) {
+        goto out_free;
+    }
+    err = lmp_chan_alloc_recv_slot(&c->lc);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+
+    // the service answers with the endpoint of a channel for us alone
+    err = bdev_client_send_cap(c, c->lc.local_cap, LMP_RING_CONNECT);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+    struct capref service_ep;
+    err = bdev_client_expect_ok(c, &msg, &service_ep);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+    cap_destroy(c->lc.remote_cap);
+    c->lc.remote_cap = service_ep;
+
+    size_t retbytes;
+    err = frame_alloc(&c->frame, BDEV_RING_FRAME_SIZE, &retbytes);
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_FRAME_ALLOC);
+        goto out_chan;
+    }
+    err = paging_map_frame_attr(get_current_paging_state(), (void **)&c->ring,
+                                BDEV_RING_FRAME_SIZE, c->frame,
+                                VREGION_FLAGS_READ_WRITE_NOCACHE, NULL, NULL);
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_VSPACE_MAP);
+        goto out_frame;
+    }
+    memset(c->ring, 0, sizeof(*c->ring));
+
+    err = bdev_client_send_cap(c, c->frame, LMP_RING_SETUP);
+    if (err_is_fail(err)) {
+        goto out_unmap;
+    }
+    msg = (struct lmp_recv_msg) LMP_RECV_MSG_INIT;
+    err = bdev_client_expect_ok(c, &msg, NULL);
+    if (err_is_fail(err)) {
+        goto out_unmap;
+    }
+    if (msg.buf.msglen < 2) {
+        err = BDEV_ERR_PROTOCOL;
+        goto out_unmap;
+    }
+    c->dev.nblocks = msg.words[1];
+
+    *retdev = &c->dev;
+
+    return SYS_ERR_OK;
+
+out_unmap:
+    paging_unmap(get_current_paging_state(), c->ring);
+out_frame:
+    cap_destroy(c->frame);
+out_chan:
+    lmp_chan_deregister_recv(&c->lc);
+    cap_destroy(c->lc.remote_cap);
+    lmp_chan_destroy(&c->lc);
+out_free:
+    waitset_destroy(&c->ws);
+    free(c);
+    return err;
+}
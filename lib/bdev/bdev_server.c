@@ -0,0 +1,168 @@
+/**
+ * \file
+ * \brief Serves a block device to other domains over request rings.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <aos/aos.h>
+#include <aos/lmp_ring.h>
+
+#include <bdev/bdev.h>
+#include <bdev/bdev_ring.h>
+
+/**
+ * @brief the block device side of a connected client
+ */
+struct bdev_conn {
+    struct lmp_ring_conn *rc;
+    struct bdev *dev;
+    struct bdev_req reqs[BDEV_RING_SLOTS];  ///< request of each slot
+    bool busy[BDEV_RING_SLOTS];     ///< reqs[slot] is in flight
+    size_t inflight;
+    bool draining;                  ///< completions are kicked in one go
+    bool kick;                      ///< completions the client has not seen
+};
+
+static struct bdev *served_dev;
+
+static void conn_free(struct bdev_conn *conn)
+{
+    lmp_ring_conn_free(conn->rc);
+    free(conn);
+}
+
+static void conn_kick(struct bdev_conn *conn)
+{
+    conn->kick = false;
+    lmp_ring_conn_kick(conn->rc);
+}
+
+static void conn_req_done(struct bdev_req *req, errval_t err)
+{
+    struct bdev_conn *conn = req->arg;
+    struct lmp_ring_conn *rc = conn->rc;
+    uint32_t slot = req - conn->reqs;
+
+    conn->busy[slot] = false;
+    conn->inflight--;
+    if (rc->dropped) {
+        // the ring had to stay around until the device was done with it
+        if (conn->inflight == 0) {
+            conn_free(conn);
+        }
+        return;
+    }
+
+    struct bdev_ring *ring = rc->ring;
+    ring->slots[slot].err = err;
+    lmp_ring_conn_push(rc, &ring->cq, slot);
+
+    conn->kick = true;
+    if (!conn->draining) {
+        conn_kick(conn);
+        if (rc->broken) {
+            lmp_ring_conn_drop(rc);
+        }
+    }
+}
+
+/**
+ * @brief starts everything on the submission queue
+ */
+static void bdev_conn_drain(struct lmp_ring_conn *rc)
+{
+    struct bdev_conn *conn = rc->st;
+    struct bdev_ring *ring = rc->ring;
+    conn->draining = true;
+
+    uint32_t slot;
+    while (lmp_ring_conn_pop(rc, &ring->sq, &slot)) {
+        // a slot is the client's again only once it has been completed
+        if (conn->busy[slot]) {
+            rc->broken = true;
+            break;
+        }
+
+        // work on a copy, so the request cannot change while it is checked
+        struct bdev_ring_slot s = ring->slots[slot];
+        __asm volatile ("" ::: "memory");
+
+        struct bdev_req *req = &conn->reqs[slot];
+        req->op = s.op == BDEV_WRITE ? BDEV_WRITE : BDEV_READ;
+        req->lba = s.lba;
+        req->count = MIN(s.count, BDEV_RING_SLOT_BLOCKS);
+        req->buf = bdev_ring_data(ring, slot);
+        req->paddr = rc->ring_base + ((uint8_t *)req->buf - (uint8_t *)ring);
+        req->done = conn_req_done;
+        req->arg = conn;
+
+        conn->busy[slot] = true;
+        conn->inflight++;
+        errval_t err = bdev_submit(conn->dev, req);
+        if (err_is_fail(err)) {
+            conn_req_done(req, err);
+        }
+    }
+
+    // backends without completion interrupts finish their work here
+    errval_t err = bdev_poll(conn->dev, false);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "polling block device");
+    }
+
+    conn->draining = false;
+    if (conn->kick) {
+        conn_kick(conn);
+    }
+}
+
+static errval_t bdev_conn_setup(struct lmp_ring_conn *rc, uintptr_t *ok_arg)
+{
+    struct bdev_conn *conn = calloc(1, sizeof(*conn));
+    if (conn == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    conn->rc = rc;
+    conn->dev = served_dev;
+    rc->st = conn;
+
+    *ok_arg = served_dev->nblocks;
+    return SYS_ERR_OK;
+}
+
+static void bdev_conn_drop(struct lmp_ring_conn *rc)
+{
+    struct bdev_conn *conn = rc->st;
+    if (conn == NULL) {
+        lmp_ring_conn_free(rc);
+    } else if (conn->inflight == 0) {
+        conn_free(conn);
+    }
+}
+
+static const struct lmp_ring_service bdev_service = {
+    .frame_size = BDEV_RING_FRAME_SIZE,
+    .map_flags = VREGION_FLAGS_READ_WRITE_NOCACHE,
+    .setup = bdev_conn_setup,
+    .drain = bdev_conn_drain,
+    .drop = bdev_conn_drop,
+};
+
+errval_t bdev_serve(const char *service, struct bdev *dev)
+{
+    if (served_dev != NULL) {
+        return BDEV_ERR_PROTOCOL;
+    }
+    served_dev = dev;
+
+    return lmp_ring_serve(service, &bdev_service);
+}
@@ -0,0 +1,97 @@
+/**
+ * \file
+ * \brief Block device backed by memory of the calling domain.
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <string.h>
+#include <aos/aos.h>
+
+#include <bdev/bdev.h>
+
+struct ramdisk {
+    struct bdev dev;
+    uint8_t *data;
+    struct capref frame;
+};
+
+static errval_t ramdisk_submit(struct bdev *dev, struct bdev_req *req)
+{
+    struct ramdisk *rd = (struct ramdisk *)dev;
+
+    uint8_t *blocks = rd->data + req->lba * BDEV_BLOCK_SIZE;
+    size_t bytes = req->count * BDEV_BLOCK_SIZE;
+    if (req->op == BDEV_READ) {
+        memcpy(req->buf, blocks, bytes);
+    } else {
+        memcpy(blocks, req->buf, bytes);
+    }
+
+    req->issued = req->count;
+    req->pending = 1;
+    bdev_req_complete(dev, req, SYS_ERR_OK);
+
+    return SYS_ERR_OK;
+}
+
+static errval_t ramdisk_poll(struct bdev *dev, bool block)
+{
+    // requests complete as they are submitted
+    return SYS_ERR_OK;
+}
+
+static void ramdisk_close(struct bdev *dev)
+{
+    struct ramdisk *rd = (struct ramdisk *)dev;
+
+    paging_unmap(get_current_paging_state(), rd->data);
+    cap_destroy(rd->frame);
+    free(rd);
+}
+
+static const struct bdev_ops ramdisk_ops = {
+    .submit = ramdisk_submit,
+    .poll = ramdisk_poll,
+    .close = ramdisk_close,
+};
+
+errval_t bdev_ramdisk_create(size_t nblocks, struct bdev **retdev)
+{
+    errval_t err;
+
+    struct ramdisk *rd = calloc(1, sizeof(*rd));
+    if (rd == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    rd->dev.ops = &ramdisk_ops;
+    rd->dev.nblocks = nblocks;
+
+    size_t bytes = ROUND_UP(nblocks * BDEV_BLOCK_SIZE, BASE_PAGE_SIZE);
+    size_t retbytes;
+    err = frame_alloc(&rd->frame, bytes, &retbytes);
+    if (err_is_fail(err)) {
+        free(rd);
+        return err_push(err, LIB_ERR_FRAME_ALLOC);
+    }
+
+    err = paging_map_frame(get_current_paging_state(), (void **)&rd->data,
+                           bytes, rd->frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        cap_destroy(rd->frame);
+        free(rd);
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+    memset(rd->data, 0, bytes);
+
+    *retdev = &rd->dev;
+
+    return SYS_ERR_OK;
+}
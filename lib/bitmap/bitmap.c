@@ -57,7 +57,8 @@ struct bitmap
  */
 struct bitmap *bitmap_alloc(uint32_t nbits)
 {
-    struct bitmap *bm = calloc(1, sizeof(*bm) + BITMAP_DATA_SIZE(nbits));
+    struct bitmap *bm = calloc(1, sizeof(*bm) + BITMAP_DATA_SIZE(nbits)
+                                             * sizeof(bitmap_data_t));
     if (bm == NULL) {
         return 0;
     }
@@ -312,10 +313,16 @@ bitmap_bit_t bitmap_get_last(const struct bitmap *bm)
  */
 bitmap_bit_t bitmap_get_next(const struct bitmap *bm, bitmap_bit_t i)
 {
-    for (bitmap_bit_t k = i+1; k < bm->nbits; ++k) {
-        if (bitmap_is_bit_set(bm, k)) {
-            return k;
+    uint32_t k = i + 1;
+    while (k < bm->nbits) {
+        /* skip over clear elements as a whole */
+        bitmap_data_t data = bm->data[k / BITMAP_BITS_PER_ELEMENT]
+                                >> (k % BITMAP_BITS_PER_ELEMENT);
+        if (data) {
+            k += __builtin_ctz(data);
+            return (k < bm->nbits) ? k : BITMAP_BIT_NONE;
         }
+        k = (k / BITMAP_BITS_PER_ELEMENT + 1) * BITMAP_BITS_PER_ELEMENT;
     }
     return BITMAP_BIT_NONE;
 }
@@ -332,10 +339,16 @@ bitmap_bit_t bitmap_get_next(const struct bitmap *bm, bitmap_bit_t i)
 bitmap_bit_t bitmap_get_prev(const struct bitmap *bm, bitmap_bit_t i)
 {
     if (i < bm->nbits) {
-        for (bitmap_bit_t k = i-1; k >= 0; --k) {
-            if (bitmap_is_bit_set(bm, k)) {
-                return k;
+        bitmap_bit_t k = i - 1;
+        while (k >= 0) {
+            /* skip over clear elements as a whole */
+            bitmap_data_t data = bm->data[k / BITMAP_BITS_PER_ELEMENT]
+                        << (BITMAP_BITS_PER_ELEMENT - 1
+                            - k % BITMAP_BITS_PER_ELEMENT);
+            if (data) {
+                return k - __builtin_clz(data);
             }
+            k -= k % BITMAP_BITS_PER_ELEMENT + 1;
         }
     }
 
@@ -506,8 +519,21 @@ void bitmap_copy(struct bitmap *to, const struct bitmap *from)
     }
     memcpy(to->data, from->data, nbytes);
 
-    /* TODO: set the meta information */
-    assert(!"NYI? setting meta information");
+    /* drop the bits of the last element that are beyond either bitmap */
+    uint32_t nbits = (to->nbits < from->nbits) ? to->nbits : from->nbits;
+    if (nbits % BITMAP_BITS_PER_ELEMENT) {
+        to->data[nbits / BITMAP_BITS_PER_ELEMENT] &=
+                        (1UL << (nbits % BITMAP_BITS_PER_ELEMENT)) - 1;
+    }
+
+    for (uint32_t i = 0; i < BITMAP_DATA_SIZE(nbits); ++i) {
+        to->weight += __builtin_popcount(to->data[i]);
+    }
+    if (to->weight) {
+        to->first = bitmap_get_next(to, -1);
+        to->last = bitmap_is_bit_set(to, to->nbits - 1) ? to->nbits - 1
+                        : bitmap_get_prev(to, to->nbits - 1);
+    }
 }
 
 
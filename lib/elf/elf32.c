@@ -562,7 +562,10 @@ errval_t elf32_load(uint16_t em_machine, elf_allocator_fn allocate_func,
             if (err_is_fail(err)) {
                 return err_push(err, ELF_ERR_ALLOCATE);
             }
-            assert(dest != NULL);
+            if (dest == NULL) {
+                // Allocator supplied an already loaded (shared) segment
+                continue;
+            }
 
             // Copy file segment into memory
             memcpy(dest, (void *)(base + (uintptr_t)p->p_offset), p->p_filesz);
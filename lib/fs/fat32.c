@@ -0,0 +1,1941 @@
+/**
+ * \file fat32.c
+ * \brief FAT32 file system backend on a block device
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <aos/aos.h>
+
+#include <bdev/bdev.h>
+#include <fs/fs.h>
+#include <fs/fat32.h>
+
+#include "fs_internal.h"
+
+#define FAT_SECTOR_SIZE     BDEV_BLOCK_SIZE
+#define FAT_DIRENT_SIZE     32
+/// FAT entries of one FAT sector
+#define FAT_PER_SECTOR      (FAT_SECTOR_SIZE / sizeof(uint32_t))
+/// FAT32 entries are 28 bits, the top four are reserved
+#define FAT_ENTRY_MASK      0x0fffffff
+/// entries at or above this end a cluster chain
+#define FAT_EOC             0x0ffffff8
+/// what we end chains with
+#define FAT_EOC_MARK        0x0fffffff
+#define FAT_FIRST_CLUSTER   2
+
+#define FAT_ATTR_READ_ONLY  0x01
+#define FAT_ATTR_HIDDEN     0x02
+#define FAT_ATTR_SYSTEM     0x04
+#define FAT_ATTR_VOLUME_ID  0x08
+#define FAT_ATTR_DIRECTORY  0x10
+#define FAT_ATTR_ARCHIVE    0x20
+#define FAT_ATTR_LFN        0x0f
+
+/// flags in the NTRes byte telling that a short name is shown in lower case
+#define FAT_NTRES_LOWER_BASE 0x08
+#define FAT_NTRES_LOWER_EXT  0x10
+
+/// first name byte of an unused entry, and of the entry ending the directory
+#define FAT_DIRENT_FREE     0xe5
+#define FAT_DIRENT_END      0x00
+
+/// long name entries: last one flag, characters per entry, longest name
+#define FAT_LFN_LAST        0x40
+#define FAT_LFN_CHARS       13
+#define FAT_LFN_MAX_ENTRIES 20
+#define FAT_NAME_MAX        255
+
+/// timestamp of everything we create, as there is no clock: 2016-01-01
+#define FAT_DATE            (((2016 - 1980) << 9) | (1 << 5) | 1)
+
+/// blocks zeroed by one request when formatting
+#define FAT_FORMAT_BATCH    64
+
+/// where the characters of a long name entry are
+static const uint8_t lfn_char_offset[FAT_LFN_CHARS] = {
+    1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30
+};
+
+/**
+ * @brief consecutive clusters of a chain
+ */
+struct fat_run
+{
+    uint32_t index;                 ///< position of the first one in the chain
+    uint32_t cluster;               ///< first cluster of the run
+    uint32_t length;                ///< clusters in the run
+};
+
+/**
+ * @brief a file or directory of the volume
+ *
+ * Nodes are created as directories are read and stay until the file is
+ * removed, so looking a name up again does not touch the disk.
+ */
+struct fat_node
+{
+    char *name;                     ///< long name, or the short one
+    uint8_t shortname[11];          ///< name in the short entry, space padded
+    uint8_t attr;                   ///< FAT_ATTR_*
+    uint32_t cluster;               ///< first cluster, 0 for empty files
+    size_t size;                    ///< size of a file in bytes
+    size_t refcount;                ///< open handles
+    struct fat_node *parent;        ///< NULL for the root directory
+    size_t entry;                   ///< offset of the short entry in the parent
+    size_t nlfn;                    ///< long name entries in front of it
+
+    struct fat_node *next;          ///< next entry in the parent directory
+    struct fat_node *prev;          ///< previous entry in the parent directory
+
+    bool loaded;                    ///< children have been read in
+    struct fat_node *children;      ///< entries of a directory
+
+    /// cluster chain as runs, ordered by index, valid if chain_valid
+    struct fat_run *runs;
+    size_t nruns;                   ///< runs in use
+    size_t maxruns;                 ///< runs allocated
+    uint32_t nclusters;             ///< clusters in the chain
+    bool chain_valid;               ///< runs have been read from the FAT
+};
+
+/**
+ * @brief a handle to an open file or directory
+ */
+struct fat_handle
+{
+    struct fs_handle common;
+    bool isdir;
+    bool written;                   ///< to be synced on close
+    struct fat_node *node;
+    union {
+        off_t file_pos;
+        struct fat_node *dir_pos;
+    };
+};
+
+struct fat_mount
+{
+    struct bdev *dev;
+    size_t spc;                     ///< blocks per cluster
+    size_t cluster_bytes;
+    size_t fat_start;               ///< first block of the FAT in use
+    size_t fat_sectors;             ///< blocks per FAT
+    size_t nfats;                   ///< FATs to write, 1 if not mirrored
+    size_t data_start;              ///< first block of cluster 2
+    uint32_t nclusters;             ///< data clusters, numbered from 2
+    size_t fsinfo;                  ///< block of the FSInfo sector, 0 if none
+
+    uint32_t *fat;                  ///< the FAT, in memory
+    uint8_t *fat_dirty;             ///< per FAT sector, not yet written
+    bool dirty;                     ///< any of fat_dirty is set
+    uint32_t free_clusters;         ///< free entries in the FAT
+    uint32_t next_free;             ///< where to look for a free cluster
+
+    struct fat_node *root;
+    uint8_t *zero;                  ///< a cluster of zeroes
+    uint8_t block[FAT_SECTOR_SIZE]; ///< bounce buffer for partial blocks
+};
+
+static inline uint16_t get16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t get32(const uint8_t *p)
+{
+    return get16(p) | ((uint32_t)get16(p + 2) << 16);
+}
+
+static inline void put16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static inline void put32(uint8_t *p, uint32_t v)
+{
+    put16(p, v);
+    put16(p + 2, v >> 16);
+}
+
+/*
+ * The FAT
+ */
+
+static inline bool cluster_valid(struct fat_mount *m, uint32_t c)
+{
+    return c >= FAT_FIRST_CLUSTER && c < m->nclusters + FAT_FIRST_CLUSTER;
+}
+
+static inline size_t cluster_block(struct fat_mount *m, uint32_t c)
+{
+    return m->data_start + (size_t)(c - FAT_FIRST_CLUSTER) * m->spc;
+}
+
+static inline uint32_t fat_get(struct fat_mount *m, uint32_t c)
+{
+    return m->fat[c] & FAT_ENTRY_MASK;
+}
+
+static inline void fat_set(struct fat_mount *m, uint32_t c, uint32_t v)
+{
+    m->fat[c] = (m->fat[c] & ~FAT_ENTRY_MASK) | (v & FAT_ENTRY_MASK);
+    m->fat_dirty[c / FAT_PER_SECTOR] = 1;
+    m->dirty = true;
+}
+
+static errval_t cluster_alloc(struct fat_mount *m, uint32_t *ret)
+{
+    uint32_t c = m->next_free;
+    for (uint32_t i = 0; m->free_clusters > 0 && i < m->nclusters; i++, c++) {
+        if (!cluster_valid(m, c)) {
+            c = FAT_FIRST_CLUSTER;
+        }
+        if (fat_get(m, c) == 0) {
+            fat_set(m, c, FAT_EOC_MARK);
+            m->free_clusters--;
+            m->next_free = c + 1;
+            *ret = c;
+            return SYS_ERR_OK;
+        }
+    }
+    return FAT_ERR_FULL;
+}
+
+static void cluster_free(struct fat_mount *m, uint32_t c)
+{
+    fat_set(m, c, 0);
+    m->free_clusters++;
+    if (c < m->next_free) {
+        m->next_free = c;
+    }
+}
+
+/**
+ * @brief writes the FAT sectors that changed, to every FAT, and flushes
+ */
+static errval_t fat_sync(struct fat_mount *m)
+{
+    errval_t err;
+
+    if (m->dirty) {
+        size_t s = 0;
+        while (s < m->fat_sectors) {
+            if (!m->fat_dirty[s]) {
+                s++;
+                continue;
+            }
+            size_t e = s;
+            while (e < m->fat_sectors && m->fat_dirty[e]) {
+                e++;
+            }
+            for (size_t f = 0; f < m->nfats; f++) {
+                err = bdev_write(m->dev, m->fat_start + f * m->fat_sectors + s,
+                                 e - s, m->fat + s * FAT_PER_SECTOR);
+                if (err_is_fail(err)) {
+                    return err;
+                }
+            }
+            // only clean once every copy of the FAT has them
+            memset(m->fat_dirty + s, 0, e - s);
+            s = e;
+        }
+
+        if (m->fsinfo != 0) {
+            err = bdev_read(m->dev, m->fsinfo, 1, m->block);
+            if (err_is_fail(err)) {
+                return err;
+            }
+            put32(m->block + 488, m->free_clusters);
+            put32(m->block + 492, m->next_free);
+            err = bdev_write(m->dev, m->fsinfo, 1, m->block);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+        m->dirty = false;
+    }
+
+    return bdev_flush(m->dev);
+}
+
+/*
+ * Cluster chains
+ */
+
+static errval_t run_append(struct fat_node *n, uint32_t c)
+{
+    if (n->nruns > 0) {
+        struct fat_run *r = &n->runs[n->nruns - 1];
+        if (r->cluster + r->length == c) {
+            r->length++;
+            n->nclusters++;
+            return SYS_ERR_OK;
+        }
+    }
+
+    if (n->nruns == n->maxruns) {
+        size_t maxruns = n->maxruns ? n->maxruns * 2 : 4;
+        struct fat_run *runs = realloc(n->runs, maxruns * sizeof(*runs));
+        if (runs == NULL) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        n->runs = runs;
+        n->maxruns = maxruns;
+    }
+
+    n->runs[n->nruns++] = (struct fat_run) {
+        .index = n->nclusters,
+        .cluster = c,
+        .length = 1,
+    };
+    n->nclusters++;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief finds the run holding the idx-th cluster of the chain
+ */
+static struct fat_run *run_find(struct fat_node *n, uint32_t idx)
+{
+    if (idx >= n->nclusters) {
+        return NULL;
+    }
+
+    size_t lo = 0, hi = n->nruns;
+    while (hi - lo > 1) {
+        size_t mid = (lo + hi) / 2;
+        if (n->runs[mid].index <= idx) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return &n->runs[lo];
+}
+
+/**
+ * @brief reads the cluster chain of n from the FAT, unless already known
+ */
+static errval_t chain_load(struct fat_mount *m, struct fat_node *n)
+{
+    if (n->chain_valid) {
+        return SYS_ERR_OK;
+    }
+
+    n->nruns = 0;
+    n->nclusters = 0;
+
+    uint32_t c = n->cluster;
+    while (c != 0 && c < FAT_EOC) {
+        // a chain longer than the volume has a loop
+        if (!cluster_valid(m, c) || n->nclusters >= m->nclusters) {
+            return FAT_ERR_FAT_LOOKUP;
+        }
+        errval_t err = run_append(n, c);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        c = fat_get(m, c);
+    }
+
+    n->chain_valid = true;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief finds the block at offset in the chain of n, and how many blocks
+ * follow it on disk without a gap
+ */
+static errval_t chain_map(struct fat_mount *m, struct fat_node *n,
+                          size_t offset, size_t *ret_block, size_t *ret_count)
+{
+    errval_t err = chain_load(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint32_t idx = offset / m->cluster_bytes;
+    struct fat_run *r = run_find(n, idx);
+    if (r == NULL) {
+        return FAT_ERR_CLUSTER_BOUNDS;
+    }
+
+    size_t sector = (offset % m->cluster_bytes) / FAT_SECTOR_SIZE;
+    *ret_block = cluster_block(m, r->cluster + (idx - r->index)) + sector;
+    *ret_count = (size_t)(r->index + r->length - idx) * m->spc - sector;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief grows the chain of n to nclusters clusters, zeroing the new ones if
+ * zero is set
+ */
+static errval_t chain_reserve(struct fat_mount *m, struct fat_node *n,
+                              size_t nclusters, bool zero)
+{
+    errval_t err = chain_load(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    while (n->nclusters < nclusters) {
+        uint32_t c;
+        err = cluster_alloc(m, &c);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        if (zero) {
+            err = bdev_write(m->dev, cluster_block(m, c), m->spc, m->zero);
+            if (err_is_fail(err)) {
+                cluster_free(m, c);
+                return err;
+            }
+        }
+
+        uint32_t last = 0;
+        if (n->nruns > 0) {
+            struct fat_run *r = &n->runs[n->nruns - 1];
+            last = r->cluster + r->length - 1;
+        }
+
+        err = run_append(n, c);
+        if (err_is_fail(err)) {
+            cluster_free(m, c);
+            return err;
+        }
+
+        if (last == 0) {
+            n->cluster = c;
+        } else {
+            fat_set(m, last, c);
+        }
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief shrinks the chain of n to nclusters clusters, freeing the rest
+ */
+static errval_t chain_truncate(struct fat_mount *m, struct fat_node *n,
+                               size_t nclusters)
+{
+    errval_t err = chain_load(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (n->nclusters <= nclusters) {
+        return SYS_ERR_OK;
+    }
+
+    uint32_t c;
+    if (nclusters == 0) {
+        c = n->cluster;
+        n->cluster = 0;
+    } else {
+        struct fat_run *r = run_find(n, nclusters - 1);
+        uint32_t last = r->cluster + (nclusters - 1 - r->index);
+        c = fat_get(m, last);
+        fat_set(m, last, FAT_EOC_MARK);
+    }
+
+    while (cluster_valid(m, c)) {
+        uint32_t next = fat_get(m, c);
+        cluster_free(m, c);
+        c = next;
+    }
+
+    while (n->nruns > 0 && n->runs[n->nruns - 1].index >= nclusters) {
+        n->nruns--;
+    }
+    if (n->nruns > 0) {
+        struct fat_run *r = &n->runs[n->nruns - 1];
+        r->length = MIN(r->length, nclusters - r->index);
+    }
+    n->nclusters = nclusters;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief reads or writes the bytes at offset in the chain of n, which must
+ * already have clusters for all of them
+ *
+ * Whole blocks go straight between buf and the device, as many at a time as
+ * lie next to each other on disk; only partial blocks are bounced.
+ */
+static errval_t node_io(struct fat_mount *m, struct fat_node *n,
+                        enum bdev_op op, size_t offset, void *buf,
+                        size_t bytes)
+{
+    errval_t err;
+
+    uint8_t *p = buf;
+    while (bytes > 0) {
+        size_t block, count;
+        err = chain_map(m, n, offset, &block, &count);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        size_t inblock = offset % FAT_SECTOR_SIZE;
+        size_t chunk;
+        if (inblock != 0 || bytes < FAT_SECTOR_SIZE) {
+            chunk = MIN(FAT_SECTOR_SIZE - inblock, bytes);
+            err = bdev_read(m->dev, block, 1, m->block);
+            if (err_is_ok(err)) {
+                if (op == BDEV_READ) {
+                    memcpy(p, m->block + inblock, chunk);
+                } else {
+                    memcpy(m->block + inblock, p, chunk);
+                    err = bdev_write(m->dev, block, 1, m->block);
+                }
+            }
+        } else {
+            count = MIN(count, bytes / FAT_SECTOR_SIZE);
+            chunk = count * FAT_SECTOR_SIZE;
+            if (op == BDEV_READ) {
+                err = bdev_read(m->dev, block, count, p);
+            } else {
+                err = bdev_write(m->dev, block, count, p);
+            }
+        }
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        p += chunk;
+        offset += chunk;
+        bytes -= chunk;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/*
+ * Names
+ */
+
+static uint8_t shortname_checksum(const uint8_t *sn)
+{
+    uint8_t sum = 0;
+    for (size_t i = 0; i < 11; i++) {
+        sum = ((sum & 1) << 7) + (sum >> 1) + sn[i];
+    }
+    return sum;
+}
+
+static bool shortname_char(char c)
+{
+    return c > 0x20 && (unsigned char)c < 0x80
+           && (isalnum((unsigned char)c) || strchr("$%'-_@~`!(){}^#&", c));
+}
+
+/**
+ * @brief turns a short entry into "NAME.EXT", lowering the case as NTRes says
+ */
+static void shortname_format(const uint8_t *sn, uint8_t ntres, char *out)
+{
+    size_t len = 0;
+    for (size_t i = 0; i < 8 && sn[i] != ' '; i++) {
+        out[len++] = (ntres & FAT_NTRES_LOWER_BASE) ? tolower(sn[i]) : sn[i];
+    }
+    // 0xe5 starts free entries, names starting with it are stored as 0x05
+    if (len > 0 && out[0] == 0x05) {
+        out[0] = 0xe5;
+    }
+    if (sn[8] != ' ') {
+        out[len++] = '.';
+        for (size_t i = 8; i < 11 && sn[i] != ' '; i++) {
+            out[len++] = (ntres & FAT_NTRES_LOWER_EXT) ? tolower(sn[i]) : sn[i];
+        }
+    }
+    out[len] = '\0';
+}
+
+/**
+ * @brief whether name is a short name by itself, which is the case if it is
+ * 8.3 with base and extension each in one case
+ */
+static bool shortname_fits(const char *name, uint8_t *sn, uint8_t *ntres)
+{
+    memset(sn, ' ', 11);
+    *ntres = 0;
+
+    const char *dot = strrchr(name, '.');
+    size_t baselen = dot ? dot - name : strlen(name);
+    size_t extlen = dot ? strlen(dot + 1) : 0;
+    if (baselen == 0 || baselen > 8 || extlen > 3 || (dot && extlen == 0)) {
+        return false;
+    }
+
+    const char *part[2] = { name, dot ? dot + 1 : "" };
+    size_t len[2] = { baselen, extlen };
+    uint8_t lower_flag[2] = { FAT_NTRES_LOWER_BASE, FAT_NTRES_LOWER_EXT };
+    for (size_t i = 0; i < 2; i++) {
+        bool upper = false, lower = false;
+        for (size_t j = 0; j < len[i]; j++) {
+            char c = part[i][j];
+            if (!shortname_char(c)) {
+                return false;
+            }
+            upper |= isupper((unsigned char)c) != 0;
+            lower |= islower((unsigned char)c) != 0;
+            sn[i * 8 + j] = toupper((unsigned char)c);
+        }
+        if (upper && lower) {
+            return false;
+        }
+        if (lower) {
+            *ntres |= lower_flag[i];
+        }
+    }
+
+    return true;
+}
+
+static bool dir_has_shortname(struct fat_node *dir, const uint8_t *sn)
+{
+    for (struct fat_node *n = dir->children; n != NULL; n = n->next) {
+        if (memcmp(n->shortname, sn, 11) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief makes up a short name "BASE~N.EXT" for a long name that is unique
+ * in dir
+ */
+static errval_t shortname_generate(struct fat_node *dir, const char *name,
+                                   uint8_t *sn)
+{
+    uint8_t basis[8];
+    size_t baselen = 0;
+
+    const char *dot = strrchr(name, '.');
+    if (dot == name) {
+        dot = NULL;
+    }
+
+    memset(sn, ' ', 11);
+    for (const char *p = name; *p != '\0' && p != dot; p++) {
+        if (*p == ' ' || *p == '.') {
+            continue;
+        }
+        if (baselen < sizeof(basis)) {
+            basis[baselen++] = shortname_char(*p) ? toupper((unsigned char)*p)
+                                                  : '_';
+        }
+    }
+    if (baselen == 0) {
+        basis[baselen++] = '_';
+    }
+    if (dot != NULL) {
+        size_t extlen = 0;
+        for (const char *p = dot + 1; *p != '\0' && extlen < 3; p++) {
+            if (*p != ' ' && *p != '.') {
+                sn[8 + extlen++] = shortname_char(*p) ? toupper((unsigned char)*p)
+                                                      : '_';
+            }
+        }
+    }
+
+    for (unsigned n = 1; n < 1000000; n++) {
+        char tail[8];
+        size_t taillen = snprintf(tail, sizeof(tail), "~%u", n);
+        size_t keep = MIN(baselen, 8 - taillen);
+        memcpy(sn, basis, keep);
+        memcpy(sn + keep, tail, taillen);
+        memset(sn + keep + taillen, ' ', 8 - keep - taillen);
+        if (!dir_has_shortname(dir, sn)) {
+            return SYS_ERR_OK;
+        }
+    }
+
+    return FAT_ERR_BAD_FILENAME;
+}
+
+static bool name_valid(const char *name)
+{
+    size_t len = strlen(name);
+    if (len == 0 || len > FAT_NAME_MAX || strcmp(name, ".") == 0
+            || strcmp(name, "..") == 0) {
+        return false;
+    }
+    // trailing dots and spaces are dropped by other implementations
+    if (name[len - 1] == '.' || name[len - 1] == ' ') {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        if ((unsigned char)name[i] < 0x20 || strchr("\"*/:<>?\\|", name[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief long name being collected from the entries in front of a short one
+ */
+struct lfn_state
+{
+    char name[FAT_LFN_MAX_ENTRIES * FAT_LFN_CHARS + 1];
+    uint8_t checksum;               ///< of the short entry they belong to
+    int expect;                     ///< ordinal of the next entry, -1 if none
+    size_t count;                   ///< entries in the sequence
+};
+
+static void lfn_collect(struct lfn_state *s, const uint8_t *e)
+{
+    int ord = e[0] & ~FAT_LFN_LAST;
+
+    // the entries are stored last one first
+    if (e[0] & FAT_LFN_LAST) {
+        if (ord == 0 || ord > FAT_LFN_MAX_ENTRIES) {
+            s->expect = -1;
+            return;
+        }
+        s->expect = ord;
+        s->count = ord;
+        s->checksum = e[13];
+        s->name[ord * FAT_LFN_CHARS] = '\0';
+    }
+
+    if (s->expect <= 0 || ord != s->expect || e[13] != s->checksum) {
+        s->expect = -1;
+        return;
+    }
+
+    for (size_t i = 0; i < FAT_LFN_CHARS; i++) {
+        uint16_t c = get16(e + lfn_char_offset[i]);
+        size_t pos = (ord - 1) * FAT_LFN_CHARS + i;
+        if (c == 0) {
+            s->name[pos] = '\0';
+            break;
+        } else if (c == 0xffff) {
+            break;
+        }
+        // we only handle ASCII
+        s->name[pos] = c < 0x80 ? c : '?';
+    }
+
+    s->expect--;
+}
+
+/*
+ * Directories
+ */
+
+static struct fat_node *node_create(const char *name, const uint8_t *e)
+{
+    struct fat_node *n = calloc(1, sizeof(*n));
+    if (n == NULL) {
+        return NULL;
+    }
+
+    n->name = strdup(name);
+    if (n->name == NULL) {
+        free(n);
+        return NULL;
+    }
+
+    memcpy(n->shortname, e, 11);
+    n->attr = e[11];
+    n->cluster = ((uint32_t)get16(e + 20) << 16) | get16(e + 26);
+    n->size = (n->attr & FAT_ATTR_DIRECTORY) ? 0 : get32(e + 28);
+
+    return n;
+}
+
+static void node_free(struct fat_node *n)
+{
+    free(n->runs);
+    free(n->name);
+    free(n);
+}
+
+static inline bool node_is_dir(struct fat_node *n)
+{
+    return (n->attr & FAT_ATTR_DIRECTORY) != 0;
+}
+
+/**
+ * @brief reads the entries of dir into its children, the first time
+ */
+static errval_t dir_load(struct fat_mount *m, struct fat_node *dir)
+{
+    errval_t err;
+
+    if (dir->loaded) {
+        return SYS_ERR_OK;
+    }
+
+    err = chain_load(m, dir);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    size_t bytes = (size_t)dir->nclusters * m->cluster_bytes;
+    uint8_t *buf = malloc(bytes);
+    if (buf == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    err = node_io(m, dir, BDEV_READ, 0, buf, bytes);
+    if (err_is_fail(err)) {
+        free(buf);
+        return err;
+    }
+
+    struct lfn_state lfn = { .expect = -1 };
+    struct fat_node *tail = NULL;
+    for (size_t off = 0; off < bytes; off += FAT_DIRENT_SIZE) {
+        uint8_t *e = buf + off;
+        if (e[0] == FAT_DIRENT_END) {
+            break;
+        }
+        if (e[0] == FAT_DIRENT_FREE) {
+            lfn.expect = -1;
+            continue;
+        }
+        if ((e[11] & 0x3f) == FAT_ATTR_LFN) {
+            lfn_collect(&lfn, e);
+            continue;
+        }
+        if ((e[11] & FAT_ATTR_VOLUME_ID) || e[0] == '.') {
+            // the label, and the "." and ".." entries
+            lfn.expect = -1;
+            continue;
+        }
+
+        char shortname[13];
+        bool haslong = lfn.expect == 0
+                       && lfn.checksum == shortname_checksum(e);
+        if (!haslong) {
+            shortname_format(e, e[12], shortname);
+        }
+
+        struct fat_node *n = node_create(haslong ? lfn.name : shortname, e);
+        if (n == NULL) {
+            free(buf);
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        n->parent = dir;
+        n->entry = off;
+        n->nlfn = haslong ? lfn.count : 0;
+
+        n->prev = tail;
+        if (tail == NULL) {
+            dir->children = n;
+        } else {
+            tail->next = n;
+        }
+        tail = n;
+
+        lfn.expect = -1;
+    }
+
+    free(buf);
+    dir->loaded = true;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief finds nentries free entries in a row in dir, growing it if needed
+ */
+static errval_t dir_find_free(struct fat_mount *m, struct fat_node *dir,
+                              size_t nentries, size_t *ret_offset)
+{
+    errval_t err;
+
+    err = chain_load(m, dir);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint8_t *buf = malloc(m->cluster_bytes);
+    if (buf == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    size_t start = 0, found = 0;
+    size_t end = (size_t)dir->nclusters * m->cluster_bytes;
+    for (size_t off = 0; off < end && found < nentries;
+         off += m->cluster_bytes) {
+        err = node_io(m, dir, BDEV_READ, off, buf, m->cluster_bytes);
+        if (err_is_fail(err)) {
+            free(buf);
+            return err;
+        }
+        for (size_t i = 0; i < m->cluster_bytes && found < nentries;
+             i += FAT_DIRENT_SIZE) {
+            if (buf[i] == FAT_DIRENT_FREE || buf[i] == FAT_DIRENT_END) {
+                if (found++ == 0) {
+                    start = off + i;
+                }
+            } else {
+                found = 0;
+            }
+        }
+    }
+    free(buf);
+
+    if (found < nentries) {
+        // new clusters are zeroed, which makes them end-of-directory entries
+        if (found == 0) {
+            start = end;
+        }
+        size_t need = start + nentries * FAT_DIRENT_SIZE;
+        err = chain_reserve(m, dir, DIVIDE_ROUND_UP(need, m->cluster_bytes),
+                            true);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    *ret_offset = start;
+
+    return SYS_ERR_OK;
+}
+
+static void dirent_init(uint8_t *e, const uint8_t *sn, uint8_t ntres,
+                        uint8_t attr, uint32_t cluster)
+{
+    memset(e, 0, FAT_DIRENT_SIZE);
+    memcpy(e, sn, 11);
+    e[11] = attr;
+    e[12] = ntres;
+    put16(e + 16, FAT_DATE);
+    put16(e + 18, FAT_DATE);
+    put16(e + 20, cluster >> 16);
+    put16(e + 24, FAT_DATE);
+    put16(e + 26, cluster);
+}
+
+/**
+ * @brief writes the entries for a new file or directory into dir
+ */
+static errval_t dir_add(struct fat_mount *m, struct fat_node *dir,
+                        const char *name, uint8_t attr, uint32_t cluster,
+                        struct fat_node **ret)
+{
+    errval_t err;
+
+    if (!name_valid(name)) {
+        return FAT_ERR_BAD_FILENAME;
+    }
+
+    err = dir_load(m, dir);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint8_t sn[11];
+    uint8_t ntres = 0;
+    size_t nlfn = 0;
+    if (!shortname_fits(name, sn, &ntres) || dir_has_shortname(dir, sn)) {
+        ntres = 0;
+        err = shortname_generate(dir, name, sn);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        nlfn = DIVIDE_ROUND_UP(strlen(name), FAT_LFN_CHARS);
+    }
+
+    size_t offset;
+    err = dir_find_free(m, dir, nlfn + 1, &offset);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint8_t entries[(FAT_LFN_MAX_ENTRIES + 1) * FAT_DIRENT_SIZE];
+    uint8_t checksum = shortname_checksum(sn);
+    size_t namelen = strlen(name);
+    for (size_t i = 0; i < nlfn; i++) {
+        size_t ord = nlfn - i;
+        uint8_t *e = entries + i * FAT_DIRENT_SIZE;
+        memset(e, 0, FAT_DIRENT_SIZE);
+        e[0] = ord | (i == 0 ? FAT_LFN_LAST : 0);
+        e[11] = FAT_ATTR_LFN;
+        e[13] = checksum;
+        for (size_t j = 0; j < FAT_LFN_CHARS; j++) {
+            size_t pos = (ord - 1) * FAT_LFN_CHARS + j;
+            uint16_t c = pos < namelen ? (unsigned char)name[pos]
+                         : pos == namelen ? 0 : 0xffff;
+            put16(e + lfn_char_offset[j], c);
+        }
+    }
+    uint8_t *e = entries + nlfn * FAT_DIRENT_SIZE;
+    dirent_init(e, sn, ntres, attr, cluster);
+
+    err = node_io(m, dir, BDEV_WRITE, offset, entries,
+                  (nlfn + 1) * FAT_DIRENT_SIZE);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct fat_node *n = node_create(name, e);
+    if (n == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    n->parent = dir;
+    n->entry = offset + nlfn * FAT_DIRENT_SIZE;
+    n->nlfn = nlfn;
+
+    n->next = dir->children;
+    if (dir->children != NULL) {
+        dir->children->prev = n;
+    }
+    dir->children = n;
+
+    *ret = n;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief marks the entries of n free and drops the node
+ */
+static errval_t dir_remove(struct fat_mount *m, struct fat_node *n)
+{
+    errval_t err;
+
+    struct fat_node *dir = n->parent;
+    size_t offset = n->entry - n->nlfn * FAT_DIRENT_SIZE;
+    size_t bytes = (n->nlfn + 1) * FAT_DIRENT_SIZE;
+
+    uint8_t entries[(FAT_LFN_MAX_ENTRIES + 1) * FAT_DIRENT_SIZE];
+    err = node_io(m, dir, BDEV_READ, offset, entries, bytes);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    for (size_t i = 0; i < bytes; i += FAT_DIRENT_SIZE) {
+        entries[i] = FAT_DIRENT_FREE;
+    }
+    err = node_io(m, dir, BDEV_WRITE, offset, entries, bytes);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (n->prev == NULL) {
+        dir->children = n->next;
+    } else {
+        n->prev->next = n->next;
+    }
+    if (n->next != NULL) {
+        n->next->prev = n->prev;
+    }
+    node_free(n);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief writes size and first cluster of n back into its short entry
+ */
+static errval_t node_store(struct fat_mount *m, struct fat_node *n)
+{
+    errval_t err;
+
+    if (n->parent == NULL) {
+        return SYS_ERR_OK;
+    }
+
+    uint8_t e[FAT_DIRENT_SIZE];
+    err = node_io(m, n->parent, BDEV_READ, n->entry, e, sizeof(e));
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    e[11] |= n->attr & FAT_ATTR_ARCHIVE;
+    put16(e + 18, FAT_DATE);
+    put16(e + 20, n->cluster >> 16);
+    put16(e + 24, FAT_DATE);
+    put16(e + 26, n->cluster);
+    put32(e + 28, node_is_dir(n) ? 0 : n->size);
+
+    return node_io(m, n->parent, BDEV_WRITE, n->entry, e, sizeof(e));
+}
+
+static errval_t find_node(struct fat_mount *m, struct fat_node *dir,
+                          const char *name, size_t len,
+                          struct fat_node **ret)
+{
+    if (!node_is_dir(dir)) {
+        return FS_ERR_NOTDIR;
+    }
+
+    if (len == 1 && name[0] == '.') {
+        *ret = dir;
+        return SYS_ERR_OK;
+    }
+    if (len == 2 && name[0] == '.' && name[1] == '.') {
+        *ret = dir->parent ? dir->parent : dir;
+        return SYS_ERR_OK;
+    }
+
+    errval_t err = dir_load(m, dir);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // FAT names are case insensitive
+    for (struct fat_node *n = dir->children; n != NULL; n = n->next) {
+        if (strncasecmp(n->name, name, len) == 0 && n->name[len] == '\0') {
+            *ret = n;
+            return SYS_ERR_OK;
+        }
+    }
+
+    return FS_ERR_NOTFOUND;
+}
+
+static errval_t resolve_node(struct fat_mount *m, const char *path,
+                             size_t len, struct fat_node **ret)
+{
+    errval_t err;
+
+    struct fat_node *n = m->root;
+
+    size_t pos = 0;
+    while (pos < len) {
+        const char *nextsep = memchr(&path[pos], FS_PATH_SEP, len - pos);
+        size_t nextlen = nextsep ? nextsep - &path[pos] : len - pos;
+
+        if (nextlen > 0) {
+            err = find_node(m, n, &path[pos], nextlen, &n);
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+
+        pos += nextlen + 1;
+    }
+
+    if (len > 0 && path[len - 1] == FS_PATH_SEP && !node_is_dir(n)) {
+        return FS_ERR_NOTDIR;
+    }
+
+    *ret = n;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief finds the directory a new entry at path goes into, failing if the
+ * entry already exists
+ */
+static errval_t resolve_new(struct fat_mount *m, const char *path,
+                            struct fat_node **ret_parent,
+                            const char **ret_childname)
+{
+    errval_t err;
+
+    struct fat_node *parent = m->root;
+    const char *childname = path;
+
+    const char *lastsep = strrchr(path, FS_PATH_SEP);
+    if (lastsep != NULL) {
+        childname = lastsep + 1;
+        err = resolve_node(m, path, lastsep - path, &parent);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        if (!node_is_dir(parent)) {
+            return FS_ERR_NOTDIR;
+        }
+    }
+
+    struct fat_node *existing;
+    err = find_node(m, parent, childname, strlen(childname), &existing);
+    if (err_is_ok(err)) {
+        return FS_ERR_EXISTS;
+    } else if (err_no(err) != FS_ERR_NOTFOUND) {
+        return err;
+    }
+
+    *ret_parent = parent;
+    *ret_childname = childname;
+
+    return SYS_ERR_OK;
+}
+
+/*
+ * Files
+ */
+
+/**
+ * @brief sets the size of a file, zeroing what it grows by
+ */
+static errval_t file_resize(struct fat_mount *m, struct fat_node *n,
+                            size_t bytes)
+{
+    errval_t err;
+
+    size_t nclusters = DIVIDE_ROUND_UP(bytes, m->cluster_bytes);
+    if (bytes < n->size) {
+        err = chain_truncate(m, n, nclusters);
+    } else {
+        err = chain_reserve(m, n, nclusters, false);
+        for (size_t pos = n->size; err_is_ok(err) && pos < bytes; ) {
+            size_t chunk = MIN(bytes - pos,
+                               m->cluster_bytes - pos % m->cluster_bytes);
+            err = node_io(m, n, BDEV_WRITE, pos, m->zero, chunk);
+            pos += chunk;
+        }
+    }
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    n->size = bytes;
+    n->attr |= FAT_ATTR_ARCHIVE;
+
+    return node_store(m, n);
+}
+
+static struct fat_handle *handle_open(struct fat_node *n)
+{
+    struct fat_handle *h = calloc(1, sizeof(*h));
+    if (h == NULL) {
+        return NULL;
+    }
+
+    n->refcount++;
+    h->isdir = node_is_dir(n);
+    h->node = n;
+
+    return h;
+}
+
+static inline void handle_close(struct fat_handle *h)
+{
+    assert(h->node->refcount > 0);
+    h->node->refcount--;
+    free(h);
+}
+
+static errval_t fat32_open(void *st, const char *path, void **rethandle)
+{
+    struct fat_mount *m = st;
+
+    struct fat_node *n;
+    errval_t err = resolve_node(m, path, strlen(path), &n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (node_is_dir(n)) {
+        return FS_ERR_NOTFILE;
+    }
+
+    struct fat_handle *h = handle_open(n);
+    if (h == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    *rethandle = h;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_create(void *st, const char *path, void **rethandle)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+
+    struct fat_node *parent;
+    const char *childname;
+    err = resolve_new(m, path, &parent, &childname);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct fat_node *n;
+    err = dir_add(m, parent, childname, FAT_ATTR_ARCHIVE, 0, &n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = fat_sync(m);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (rethandle) {
+        struct fat_handle *h = handle_open(n);
+        if (h == NULL) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        *rethandle = h;
+    }
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_remove(void *st, const char *path)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+
+    struct fat_node *n;
+    err = resolve_node(m, path, strlen(path), &n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (node_is_dir(n)) {
+        return FS_ERR_NOTFILE;
+    }
+
+    if (n->refcount != 0) {
+        return FS_ERR_BUSY;
+    }
+
+    err = chain_truncate(m, n, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = dir_remove(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return fat_sync(m);
+}
+
+static errval_t fat32_read(void *st, void *handle, void *buffer, size_t bytes,
+                           size_t *bytes_read)
+{
+    struct fat_mount *m = st;
+    struct fat_handle *h = handle;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    assert(h->file_pos >= 0);
+
+    size_t pos = h->file_pos;
+    if (h->node->size <= pos) {
+        bytes = 0;
+    } else if (h->node->size < pos + bytes) {
+        bytes = h->node->size - pos;
+    }
+
+    errval_t err = node_io(m, h->node, BDEV_READ, pos, buffer, bytes);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    h->file_pos += bytes;
+
+    *bytes_read = bytes;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_write(void *st, void *handle, const void *buffer,
+                            size_t bytes, size_t *bytes_written)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+    struct fat_handle *h = handle;
+    struct fat_node *n = h->node;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    assert(h->file_pos >= 0);
+
+    size_t pos = h->file_pos;
+    h->written = true;
+
+    // FAT files have no holes
+    if (pos > n->size) {
+        err = file_resize(m, n, pos);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    uint32_t cluster = n->cluster;
+    err = chain_reserve(m, n, DIVIDE_ROUND_UP(pos + bytes, m->cluster_bytes),
+                        false);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = node_io(m, n, BDEV_WRITE, pos, (void *)buffer, bytes);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    h->file_pos += bytes;
+    if (bytes_written) {
+        *bytes_written = bytes;
+    }
+
+    if (n->size < pos + bytes || n->cluster != cluster
+            || !(n->attr & FAT_ATTR_ARCHIVE)) {
+        n->size = MAX(n->size, pos + bytes);
+        n->attr |= FAT_ATTR_ARCHIVE;
+        return node_store(m, n);
+    }
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_truncate(void *st, void *handle, size_t bytes)
+{
+    struct fat_mount *m = st;
+    struct fat_handle *h = handle;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    h->written = true;
+
+    return file_resize(m, h->node, bytes);
+}
+
+static errval_t fat32_tell(void *st, void *handle, size_t *pos)
+{
+    struct fat_handle *h = handle;
+    if (h->isdir) {
+        *pos = 0;
+    } else {
+        *pos = h->file_pos;
+    }
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_stat(void *st, void *handle, struct fs_fileinfo *info)
+{
+    struct fat_handle *h = handle;
+
+    assert(info != NULL);
+    info->type = h->isdir ? FS_DIRECTORY : FS_FILE;
+    info->size = h->node->size;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_seek(void *st, void *handle, enum fs_seekpos whence,
+                           off_t offset)
+{
+    struct fat_handle *h = handle;
+
+    // directories can only be rewound or skipped forward from the start
+    if (h->isdir && whence != FS_SEEK_SET) {
+        return FS_ERR_NOTFILE;
+    }
+
+    switch (whence) {
+    case FS_SEEK_SET:
+        if (offset < 0) {
+            return FS_ERR_INDEX_BOUNDS;
+        }
+        if (h->isdir) {
+            h->dir_pos = h->node->children;
+            for (off_t i = 0; i < offset && h->dir_pos != NULL; i++) {
+                h->dir_pos = h->dir_pos->next;
+            }
+        } else {
+            h->file_pos = offset;
+        }
+        break;
+
+    case FS_SEEK_CUR:
+        if (offset < 0 && -offset > h->file_pos) {
+            return FS_ERR_INDEX_BOUNDS;
+        }
+        h->file_pos += offset;
+        break;
+
+    case FS_SEEK_END:
+        if (offset < 0 && (size_t)-offset > h->node->size) {
+            return FS_ERR_INDEX_BOUNDS;
+        }
+        h->file_pos = h->node->size + offset;
+        break;
+
+    default:
+        return FS_ERR_INDEX_BOUNDS;
+    }
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_close(void *st, void *handle)
+{
+    struct fat_mount *m = st;
+    struct fat_handle *h = handle;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    errval_t err = SYS_ERR_OK;
+    if (h->written) {
+        err = fat_sync(m);
+    }
+
+    handle_close(h);
+
+    return err;
+}
+
+static errval_t fat32_opendir(void *st, const char *path, void **rethandle)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+
+    struct fat_node *n;
+    err = resolve_node(m, path, strlen(path), &n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (!node_is_dir(n)) {
+        return FS_ERR_NOTDIR;
+    }
+
+    err = dir_load(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct fat_handle *h = handle_open(n);
+    if (h == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    h->dir_pos = n->children;
+
+    *rethandle = h;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_dir_read_next(void *st, void *handle, char **retname,
+                                    struct fs_fileinfo *info)
+{
+    struct fat_handle *h = handle;
+
+    if (!h->isdir) {
+        return FS_ERR_NOTDIR;
+    }
+
+    struct fat_node *n = h->dir_pos;
+    if (n == NULL) {
+        return FS_ERR_INDEX_BOUNDS;
+    }
+
+    if (retname != NULL) {
+        *retname = strdup(n->name);
+    }
+
+    if (info != NULL) {
+        info->type = node_is_dir(n) ? FS_DIRECTORY : FS_FILE;
+        info->size = n->size;
+    }
+
+    h->dir_pos = n->next;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_closedir(void *st, void *handle)
+{
+    struct fat_handle *h = handle;
+    if (!h->isdir) {
+        return FS_ERR_NOTDIR;
+    }
+
+    handle_close(h);
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fat32_mkdir(void *st, const char *path)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+
+    struct fat_node *parent;
+    const char *childname;
+    err = resolve_new(m, path, &parent, &childname);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (!name_valid(childname)) {
+        return FAT_ERR_BAD_FILENAME;
+    }
+
+    uint32_t c;
+    err = cluster_alloc(m, &c);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // "." and "..", where the root directory is cluster 0
+    memset(m->block, 0, FAT_SECTOR_SIZE);
+    uint8_t dot[11] = ".          ";
+    dirent_init(m->block, dot, 0, FAT_ATTR_DIRECTORY, c);
+    dot[1] = '.';
+    dirent_init(m->block + FAT_DIRENT_SIZE, dot, 0, FAT_ATTR_DIRECTORY,
+                parent == m->root ? 0 : parent->cluster);
+
+    err = bdev_write(m->dev, cluster_block(m, c), 1, m->block);
+    if (err_is_ok(err) && m->spc > 1) {
+        err = bdev_write(m->dev, cluster_block(m, c) + 1, m->spc - 1, m->zero);
+    }
+
+    struct fat_node *n = NULL;
+    if (err_is_ok(err)) {
+        err = dir_add(m, parent, childname, FAT_ATTR_DIRECTORY, c, &n);
+    }
+    if (err_is_fail(err)) {
+        cluster_free(m, c);
+        return err;
+    }
+    n->loaded = true;
+
+    return fat_sync(m);
+}
+
+static errval_t fat32_rmdir(void *st, const char *path)
+{
+    errval_t err;
+
+    struct fat_mount *m = st;
+
+    struct fat_node *n;
+    err = resolve_node(m, path, strlen(path), &n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (!node_is_dir(n)) {
+        return FS_ERR_NOTDIR;
+    }
+
+    if (n->refcount != 0 || n == m->root) {
+        return FS_ERR_BUSY;
+    }
+
+    err = dir_load(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (n->children != NULL) {
+        return FS_ERR_NOTEMPTY;
+    }
+
+    err = chain_truncate(m, n, 0);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = dir_remove(m, n);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return fat_sync(m);
+}
+
+/*
+ * Mounting and formatting
+ */
+
+static bool bootsector_valid(const uint8_t *b)
+{
+    return (b[0] == 0xeb || b[0] == 0xe9)
+           && get16(b + 510) == 0xaa55
+           && get16(b + 11) == FAT_SECTOR_SIZE
+           && b[13] != 0 && (b[13] & (b[13] - 1)) == 0
+           && get16(b + 14) != 0
+           && b[16] != 0
+           && get16(b + 17) == 0        // no fixed root directory
+           && get16(b + 22) == 0        // no 16 bit FAT size
+           && get32(b + 36) != 0;
+}
+
+errval_t fat32_mount(struct bdev *dev, size_t partition, fat32_mount_t *retst)
+{
+    errval_t err;
+
+    struct fat_mount *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    m->dev = dev;
+
+    uint8_t *b = m->block;
+    size_t base = 0;
+    err = bdev_read(dev, 0, 1, b);
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    if (!bootsector_valid(b)) {
+        // take it as an MBR with FAT32 partitions of type 0x0b or 0x0c
+        const uint8_t *pe = b + 446 + 16 * partition;
+        if (partition >= 4 || get16(b + 510) != 0xaa55
+                || (pe[4] != 0x0b && pe[4] != 0x0c)) {
+            err = FAT_ERR_BAD_FS;
+            goto out;
+        }
+        base = get32(pe + 8);
+        err = bdev_read(dev, base, 1, b);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+        if (!bootsector_valid(b)) {
+            err = FAT_ERR_BAD_FS;
+            goto out;
+        }
+    } else if (partition != 0) {
+        err = FAT_ERR_BAD_FS;
+        goto out;
+    }
+
+    size_t reserved = get16(b + 14);
+    size_t total = get16(b + 19) ? get16(b + 19) : get32(b + 32);
+    uint16_t extflags = get16(b + 40);
+    uint32_t rootcluster = get32(b + 44);
+    m->spc = b[13];
+    m->cluster_bytes = m->spc * FAT_SECTOR_SIZE;
+    m->fat_sectors = get32(b + 36);
+    m->nfats = b[16];
+    m->data_start = base + reserved + m->nfats * m->fat_sectors;
+    m->fat_start = base + reserved;
+    m->fsinfo = get16(b + 48) ? base + get16(b + 48) : 0;
+
+    if (total > dev->nblocks - base || m->data_start >= base + total) {
+        err = FAT_ERR_BAD_FS;
+        goto out;
+    }
+    m->nclusters = MIN((base + total - m->data_start) / m->spc,
+                       m->fat_sectors * FAT_PER_SECTOR - FAT_FIRST_CLUSTER);
+
+    // with mirroring off, only the active FAT is used
+    if (extflags & 0x80) {
+        if ((extflags & 0xf) >= m->nfats) {
+            err = FAT_ERR_BAD_FS;
+            goto out;
+        }
+        m->fat_start += (extflags & 0xf) * m->fat_sectors;
+        m->nfats = 1;
+    }
+
+    if (!cluster_valid(m, rootcluster)) {
+        err = FAT_ERR_BAD_FS;
+        goto out;
+    }
+
+    m->fat = malloc(m->fat_sectors * FAT_SECTOR_SIZE);
+    m->fat_dirty = calloc(m->fat_sectors, 1);
+    m->zero = calloc(1, m->cluster_bytes);
+    m->root = calloc(1, sizeof(*m->root));
+    if (m->fat == NULL || m->fat_dirty == NULL || m->zero == NULL
+            || m->root == NULL) {
+        err = LIB_ERR_MALLOC_FAIL;
+        goto out;
+    }
+
+    err = bdev_read(dev, m->fat_start, m->fat_sectors, m->fat);
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    for (uint32_t c = FAT_FIRST_CLUSTER; cluster_valid(m, c); c++) {
+        if (fat_get(m, c) == 0) {
+            m->free_clusters++;
+        }
+    }
+    m->next_free = FAT_FIRST_CLUSTER;
+    if (m->fsinfo != 0) {
+        err = bdev_read(dev, m->fsinfo, 1, b);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+        if (get32(b) == 0x41615252 && cluster_valid(m, get32(b + 492))) {
+            m->next_free = get32(b + 492);
+        }
+    }
+
+    m->root->name = strdup("/");
+    m->root->attr = FAT_ATTR_DIRECTORY;
+    m->root->cluster = rootcluster;
+    if (m->root->name == NULL) {
+        err = LIB_ERR_MALLOC_FAIL;
+        goto out;
+    }
+
+    *retst = m;
+
+    return SYS_ERR_OK;
+
+out:
+    if (m->root != NULL) {
+        free(m->root->name);
+    }
+    free(m->root);
+    free(m->zero);
+    free(m->fat_dirty);
+    free(m->fat);
+    free(m);
+    return err;
+}
+
+errval_t fat32_format(struct bdev *dev, const char *label)
+{
+    errval_t err;
+
+    size_t total = MIN(dev->nblocks, 0xffffffff);
+
+    // cluster sizes as other formatters pick them; small volumes get fewer
+    // clusters than the specification asks of FAT32, which we do not mind
+    size_t spc = total <= 532480 ? 1
+               : total <= 16777216 ? 8
+               : total <= 33554432 ? 16
+               : total <= 67108864 ? 32 : 64;
+    size_t reserved = 32;
+    size_t nfats = 2;
+
+    // sized as if all blocks after the reserved ones were clusters
+    size_t fat_sectors = DIVIDE_ROUND_UP(((total - MIN(total, reserved)) / spc
+                                          + FAT_FIRST_CLUSTER) * 4,
+                                         FAT_SECTOR_SIZE);
+    size_t data_start = reserved + nfats * fat_sectors;
+    if (total < data_start + 2 * spc) {
+        return FAT_ERR_BLOCK_BOUNDS;
+    }
+    uint32_t nclusters = (total - data_start) / spc;
+
+    uint8_t *buf = calloc(FAT_FORMAT_BATCH, FAT_SECTOR_SIZE);
+    if (buf == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    // reserved blocks, FATs and the root directory cluster start out zeroed
+    for (size_t lba = 0; lba < data_start + spc; lba += FAT_FORMAT_BATCH) {
+        err = bdev_write(dev, lba, MIN(FAT_FORMAT_BATCH,
+                                       data_start + spc - lba), buf);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+    }
+
+    // boot sector, also written as backup to block 6
+    uint8_t *b = buf;
+    b[0] = 0xeb;
+    b[1] = 0x58;
+    b[2] = 0x90;
+    memcpy(b + 3, "AOS FAT ", 8);
+    put16(b + 11, FAT_SECTOR_SIZE);
+    b[13] = spc;
+    put16(b + 14, reserved);
+    b[16] = nfats;
+    b[21] = 0xf8;                   // fixed disk
+    put16(b + 24, 63);
+    put16(b + 26, 255);
+    put32(b + 32, total);
+    put32(b + 36, fat_sectors);
+    put32(b + 44, FAT_FIRST_CLUSTER);   // root directory
+    put16(b + 48, 1);                   // FSInfo
+    put16(b + 50, 6);                   // backup boot sector
+    b[64] = 0x80;
+    b[66] = 0x29;
+    put32(b + 67, 0x20160101);
+    memset(b + 71, ' ', 11);
+    memcpy(b + 71, label, MIN(strlen(label), 11));
+    memcpy(b + 82, "FAT32   ", 8);
+    put16(b + 510, 0xaa55);
+
+    // FSInfo, the root directory has the first cluster
+    uint8_t *fsinfo = buf + FAT_SECTOR_SIZE;
+    put32(fsinfo, 0x41615252);
+    put32(fsinfo + 484, 0x61417272);
+    put32(fsinfo + 488, nclusters - 1);
+    put32(fsinfo + 492, FAT_FIRST_CLUSTER + 1);
+    put32(fsinfo + 508, 0xaa550000);
+
+    err = bdev_write(dev, 0, 2, buf);
+    if (err_is_ok(err)) {
+        err = bdev_write(dev, 6, 2, buf);
+    }
+    if (err_is_fail(err)) {
+        goto out;
+    }
+
+    // media byte, reserved entry, and the root directory chain
+    memset(buf, 0, 2 * FAT_SECTOR_SIZE);
+    put32(buf, 0x0ffffff8);
+    put32(buf + 4, FAT_EOC_MARK);
+    put32(buf + 8, FAT_EOC_MARK);
+    for (size_t f = 0; f < nfats; f++) {
+        err = bdev_write(dev, reserved + f * fat_sectors, 1, buf);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+    }
+
+    err = bdev_flush(dev);
+
+out:
+    free(buf);
+    return err;
+}
+
+const struct fs_ops fat32_ops = {
+    .open = fat32_open,
+    .create = fat32_create,
+    .remove = fat32_remove,
+    .read = fat32_read,
+    .write = fat32_write,
+    .truncate = fat32_truncate,
+    .tell = fat32_tell,
+    .stat = fat32_stat,
+    .seek = fat32_seek,
+    .close = fat32_close,
+    .opendir = fat32_opendir,
+    .dir_read_next = fat32_dir_read_next,
+    .closedir = fat32_closedir,
+    .mkdir = fat32_mkdir,
+    .rmdir = fat32_rmdir,
+};
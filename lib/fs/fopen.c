@@ -15,7 +15,9 @@
 #include <stdio.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <sys/uio.h>
 #include <aos/aos.h>
+#include <bitmap.h>
 
 #include <fs/fs.h>
 #include <fs/dirent.h>
@@ -23,7 +25,84 @@
 #include "fs_internal.h"
 
 
-static void *mount;
+/*
+ * Mount table
+ */
+
+struct fs_mount {
+    char *path;                 ///< mount point, without trailing '/'
+    size_t pathlen;
+    const struct fs_ops *ops;
+    void *st;                   ///< backend state passed to the ops
+    struct fs_mount *next;
+};
+
+static struct fs_mount *mounts;
+
+errval_t fs_mount_add(const char *path, const struct fs_ops *ops, void *st)
+{
+    size_t len = strlen(path);
+    while (len > 0 && path[len - 1] == FS_PATH_SEP) {
+        len--;
+    }
+
+    for (struct fs_mount *m = mounts; m != NULL; m = m->next) {
+        if (m->pathlen == len && strncmp(m->path, path, len) == 0) {
+            return VFS_ERR_MOUNTPOINT_IN_USE;
+        }
+    }
+
+    struct fs_mount *m = malloc(sizeof(*m));
+    if (m == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    m->path = strndup(path, len);
+    if (m->path == NULL) {
+        free(m);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    m->pathlen = len;
+    m->ops = ops;
+    m->st = st;
+    m->next = mounts;
+    mounts = m;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief finds the mount with the longest mount point that is a prefix of
+ *        path, and returns the part of path below it in relpath
+ */
+static struct fs_mount *fs_mount_find(const char *path, const char **relpath)
+{
+    struct fs_mount *best = NULL;
+    for (struct fs_mount *m = mounts; m != NULL; m = m->next) {
+        if (strncmp(m->path, path, m->pathlen) != 0) {
+            continue;
+        }
+        char c = path[m->pathlen];
+        if (m->pathlen != 0 && c != FS_PATH_SEP && c != '\0') {
+            continue;
+        }
+        if (best == NULL || m->pathlen > best->pathlen) {
+            best = m;
+        }
+    }
+
+    if (best != NULL) {
+        *relpath = path + best->pathlen;
+        if (**relpath == '\0') {
+            *relpath = "/";
+        }
+    }
+    return best;
+}
+
+static inline struct fs_mount *handle_mount(void *handle)
+{
+    return ((struct fs_handle *)handle)->mount;
+}
 
 /*
  * FD table
@@ -33,35 +112,88 @@ static void *mount;
 #define STDOUT_FILENO   1       /* standard output file descriptor */
 #define STDERR_FILENO   2       /* standard error file descriptor */
 
-static struct fdtab_entry fdtab[MAX_FD] = {
-    [STDIN_FILENO] = {
-        .type = FDTAB_TYPE_STDIN,
-        .handle = NULL,
-    },
-    [STDOUT_FILENO] = {
-        .type = FDTAB_TYPE_STDOUT,
-        .handle = NULL,
-    },
-    [STDERR_FILENO] = {
-        .type = FDTAB_TYPE_STDERR,
-        .handle = NULL,
-    },
-};
+/// slots of the fd table when it is created, it doubles whenever it is full
+#define FDTAB_INITIAL_SIZE  64
+
+static struct fdtab_entry *fdtab;
+static size_t fdtab_size;
+/// set bits are available descriptors, the lowest one is handed out next
+static struct bitmap *fdtab_free_map;
+
+static int fdtab_init(void)
+{
+    fdtab = calloc(FDTAB_INITIAL_SIZE, sizeof(*fdtab));
+    fdtab_free_map = bitmap_alloc(FDTAB_INITIAL_SIZE);
+    if (fdtab == NULL || fdtab_free_map == NULL) {
+        free(fdtab);
+        bitmap_free(fdtab_free_map);
+        fdtab = NULL;
+        fdtab_free_map = NULL;
+        return -1;
+    }
+    fdtab_size = FDTAB_INITIAL_SIZE;
+
+    fdtab[STDIN_FILENO].type = FDTAB_TYPE_STDIN;
+    fdtab[STDOUT_FILENO].type = FDTAB_TYPE_STDOUT;
+    fdtab[STDERR_FILENO].type = FDTAB_TYPE_STDERR;
+    bitmap_set_range(fdtab_free_map, STDERR_FILENO + 1, fdtab_size - 1);
+
+    return 0;
+}
+
+/**
+ * @brief doubles the fd table, the new slots are available
+ */
+static int fdtab_grow(void)
+{
+    size_t newsize = 2 * fdtab_size;
+    if (newsize > INT32_MAX) {
+        return -1;
+    }
+
+    struct bitmap *map = bitmap_alloc(newsize);
+    if (map == NULL) {
+        return -1;
+    }
+    struct fdtab_entry *tab = realloc(fdtab, newsize * sizeof(*tab));
+    if (tab == NULL) {
+        bitmap_free(map);
+        return -1;
+    }
+    memset(tab + fdtab_size, 0, (newsize - fdtab_size) * sizeof(*tab));
+
+    bitmap_copy(map, fdtab_free_map);
+    bitmap_set_range(map, fdtab_size, newsize - 1);
+    bitmap_free(fdtab_free_map);
+
+    fdtab = tab;
+    fdtab_size = newsize;
+    fdtab_free_map = map;
+    return 0;
+}
 
 static int fdtab_alloc(struct fdtab_entry *h)
 {
-    for (int fd = MIN_FD; fd < MAX_FD; fd++) {
-        if (fdtab[fd].type == FDTAB_TYPE_AVAILABLE) {
-            fdtab[fd].inherited = 0; // Just precautionary
-            memcpy(&fdtab[fd], h, sizeof(struct fdtab_entry));
+    if (fdtab == NULL && fdtab_init() != 0) {
+        errno = EMFILE;
+        return -1;
+    }
 
-            return fd;
+    bitmap_bit_t fd = bitmap_get_first(fdtab_free_map);
+    if (fd == BITMAP_BIT_NONE) {
+        if (fdtab_grow() != 0) {
+            errno = EMFILE;
+            return -1;
         }
+        fd = bitmap_get_first(fdtab_free_map);
     }
+    assert(fdtab[fd].type == FDTAB_TYPE_AVAILABLE);
+
+    bitmap_clear_bit(fdtab_free_map, fd);
+    memcpy(&fdtab[fd], h, sizeof(struct fdtab_entry));
+    fdtab[fd].inherited = 0; // Just precautionary
 
-    // table full
-    errno = EMFILE;
-    return -1;
+    return fd;
 }
 
 static struct fdtab_entry *fdtab_get(int fd)
@@ -72,7 +204,7 @@ static struct fdtab_entry *fdtab_get(int fd)
         .inherited = 0,
     };
 
-    if (fd < MIN_FD || fd >= MAX_FD) {
+    if (fd < MIN_FD || (size_t)fd >= fdtab_size) {
         return &invalid;
     } else {
         return &fdtab[fd];
@@ -81,40 +213,352 @@ static struct fdtab_entry *fdtab_get(int fd)
 
 static void fdtab_free(int fd)
 {
-    assert(fd >= MIN_FD && fd < MAX_FD);
+    assert(fd >= MIN_FD && (size_t)fd < fdtab_size);
     assert(fdtab[fd].type != FDTAB_TYPE_AVAILABLE);
     fdtab[fd].type = FDTAB_TYPE_AVAILABLE;
     fdtab[fd].handle = NULL;
     fdtab[fd].fd = 0;
     fdtab[fd].inherited = 0;
+    fdtab[fd].buf = NULL;
+    bitmap_set_bit(fdtab_free_map, fd);
+}
+
+/*
+ * Buffered file I/O
+ */
+
+/**
+ * @brief position and buffer of an open file
+ *
+ * The buffer holds either data read from [start, start + len) or data written
+ * there that the backend has not seen yet, never both. The file position is
+ * kept here, so the backend handle is only seeked when a transfer does not
+ * start where the previous one ended.
+ */
+struct fs_fdbuf {
+    size_t pos;                 ///< file position of the descriptor
+    size_t backend_pos;         ///< file position of the backend handle
+    uint8_t *data;              ///< allocated on first use
+    size_t size;                ///< capacity of data, 0 to not buffer
+    size_t start;               ///< file offset of data[0]
+    size_t len;                 ///< bytes in data
+    bool dirty;                 ///< data holds writes
+};
+
+static errval_t fdbuf_seek(struct fs_mount *m, void *fh, struct fs_fdbuf *b,
+                           size_t pos)
+{
+    if (b->backend_pos == pos) {
+        return SYS_ERR_OK;
+    }
+
+    errval_t err = m->ops->seek(m->st, fh, FS_SEEK_SET, pos);
+    if (err_is_ok(err)) {
+        b->backend_pos = pos;
+    }
+    return err;
+}
+
+/**
+ * @brief passes buffered writes on to the backend
+ */
+static errval_t fdbuf_flush(struct fs_mount *m, void *fh, struct fs_fdbuf *b)
+{
+    if (!b->dirty) {
+        return SYS_ERR_OK;
+    }
+
+    errval_t err = fdbuf_seek(m, fh, b, b->start);
+    if (err_is_ok(err)) {
+        size_t written = 0;
+        err = m->ops->write(m->st, fh, b->data, b->len, &written);
+        b->backend_pos += written;
+    }
+
+    // the data is dropped even on failure, which is reported only once
+    b->len = 0;
+    b->dirty = false;
+
+    return err;
+}
+
+/**
+ * @brief reads len bytes at offset, through the buffer
+ */
+static errval_t fdbuf_read_at(struct fs_mount *m, void *fh, struct fs_fdbuf *b,
+                              size_t offset, void *buf, size_t len,
+                              size_t *retlen)
+{
+    errval_t err = fdbuf_flush(m, fh, b);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    uint8_t *dst = buf;
+    size_t done = 0;
+    if (offset >= b->start && offset < b->start + b->len) {
+        done = MIN(len, b->start + b->len - offset);
+        memcpy(dst, b->data + (offset - b->start), done);
+    }
+
+    if (done < len) {
+        size_t want = len - done;
+        size_t got = 0;
+
+        err = fdbuf_seek(m, fh, b, offset + done);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        if (want >= b->size) {
+            // large reads go to the caller's buffer directly
+            err = m->ops->read(m->st, fh, dst + done, want, &got);
+            b->backend_pos += got;
+            done += got;
+        } else {
+            if (b->data == NULL) {
+                b->data = malloc(b->size);
+                if (b->data == NULL) {
+                    return LIB_ERR_MALLOC_FAIL;
+                }
+            }
+            b->len = 0;
+            err = m->ops->read(m->st, fh, b->data, b->size, &got);
+            b->backend_pos += got;
+            b->start = offset + done;
+            b->len = got;
+            got = MIN(want, got);
+            memcpy(dst + done, b->data, got);
+            done += got;
+        }
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    *retlen = done;
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief writes len bytes at offset, through the buffer
+ */
+static errval_t fdbuf_write_at(struct fs_mount *m, void *fh,
+                               struct fs_fdbuf *b, size_t offset,
+                               const void *buf, size_t len, size_t *retlen)
+{
+    errval_t err;
+
+    // cheaper to drop read data than to patch it
+    if (!b->dirty) {
+        b->len = 0;
+    }
+
+    if (b->dirty && (offset != b->start + b->len || b->len + len > b->size
+                     || len >= b->size)) {
+        err = fdbuf_flush(m, fh, b);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    if (len >= b->size) {
+        err = fdbuf_seek(m, fh, b, offset);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        size_t written = 0;
+        err = m->ops->write(m->st, fh, buf, len, &written);
+        b->backend_pos += written;
+        *retlen = written;
+        return err;
+    }
+
+    if (b->data == NULL) {
+        b->data = malloc(b->size);
+        if (b->data == NULL) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+    }
+    if (b->len == 0) {
+        b->start = offset;
+    }
+    memcpy(b->data + b->len, buf, len);
+    b->len += len;
+    b->dirty = true;
+
+    *retlen = len;
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief reads or writes len bytes at offset, or at the file position if
+ *        offset is negative, which then moves past them
+ */
+static ssize_t fd_transfer(int fd, bool write, void *buf, size_t len,
+                           off_t offset)
+{
+    struct fdtab_entry *e = fdtab_get(fd);
+    if (e->type != FDTAB_TYPE_FILE) {
+        errno = EBADF;
+        return -1;
+    }
+
+    void *fh = e->handle;
+    struct fs_mount *m = handle_mount(fh);
+    struct fs_fdbuf *b = e->buf;
+    size_t pos = offset < 0 ? b->pos : offset;
+
+    size_t retlen = 0;
+    errval_t err;
+    if (write) {
+        err = fdbuf_write_at(m, fh, b, pos, buf, len, &retlen);
+    } else {
+        err = fdbuf_read_at(m, fh, b, pos, buf, len, &retlen);
+    }
+
+    if (offset < 0) {
+        b->pos += retlen;
+    }
+    if (err_is_fail(err) && retlen == 0) {
+        errno = EIO;
+        return -1;
+    }
+    return retlen;
+}
+
+/**
+ * @brief reads or writes the segments in turn, stopping at the first short
+ *        transfer; the descriptor's buffer merges small segments
+ */
+static ssize_t fd_transfer_iov(int fd, bool write, const struct iovec *iov,
+                               int iovcnt, off_t offset)
+{
+    if (iovcnt < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    ssize_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        ssize_t ret = fd_transfer(fd, write, iov[i].iov_base, iov[i].iov_len,
+                                  offset < 0 ? offset : offset + total);
+        if (ret < 0) {
+            // what was transferred before the error counts
+            return total > 0 ? total : ret;
+        }
+        total += ret;
+        if ((size_t)ret < iov[i].iov_len) {
+            break;
+        }
+    }
+    return total;
+}
+
+// as in <unistd.h>, which cannot be included next to <fs/dirent.h>
+ssize_t pread(int fd, void *buf, size_t nbytes, off_t offset);
+ssize_t pwrite(int fd, const void *buf, size_t nbytes, off_t offset);
+
+ssize_t pread(int fd, void *buf, size_t nbytes, off_t offset)
+{
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return fd_transfer(fd, false, buf, nbytes, offset);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t nbytes, off_t offset)
+{
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return fd_transfer(fd, true, (void *)buf, nbytes, offset);
+}
+
+ssize_t readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    return fd_transfer_iov(fd, false, iov, iovcnt, -1);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    return fd_transfer_iov(fd, true, iov, iovcnt, -1);
+}
+
+ssize_t preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return fd_transfer_iov(fd, false, iov, iovcnt, offset);
+}
+
+ssize_t pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    if (offset < 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    return fd_transfer_iov(fd, true, iov, iovcnt, offset);
+}
+
+errval_t fs_setbuf(int fd, size_t bytes)
+{
+    struct fdtab_entry *e = fdtab_get(fd);
+    if (e->type != FDTAB_TYPE_FILE) {
+        return FS_ERR_INVALID_FH;
+    }
+
+    struct fs_fdbuf *b = e->buf;
+    errval_t err = fdbuf_flush(handle_mount(e->handle), e->handle, b);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    free(b->data);
+    b->data = NULL;
+    b->len = 0;
+    b->size = bytes;
+
+    return SYS_ERR_OK;
 }
 
 //XXX: flags are ignored...
 static int fs_libc_open(char *path, int flags)
 {
-    ramfs_handle_t vh;
+    void *vh;
     errval_t err;
 
+    const char *relpath;
+    struct fs_mount *m = fs_mount_find(path, &relpath);
+    if (m == NULL) {
+        errno = ENOENT;
+        return -1;
+    }
+
     // If O_CREAT was given, we use ramfsfs_create()
     if(flags & O_CREAT) {
         // If O_EXCL was also given, we check whether we can open() first
         if(flags & O_EXCL) {
-            err = ramfs_open(mount, path, &vh);
+            err = m->ops->open(m->st, relpath, &vh);
             if(err_is_ok(err)) {
-                ramfs_close(mount, vh);
+                m->ops->close(m->st, vh);
                 errno = EEXIST;
                 return -1;
             }
             assert(err_no(err) == FS_ERR_NOTFOUND);
         }
 
-        err = ramfs_create(mount, path, &vh);
+        err = m->ops->create(m->st, relpath, &vh);
         if(err_is_fail(err) && err == FS_ERR_EXISTS) {
-            err = ramfs_open(mount, path, &vh);
+            err = m->ops->open(m->st, relpath, &vh);
         }
     } else {
         // Regular open()
-        err = ramfs_open(mount, path, &vh);
+        err = m->ops->open(m->st, relpath, &vh);
     }
 
     if (err_is_fail(err)) {
@@ -130,14 +574,26 @@ static int fs_libc_open(char *path, int flags)
         return -1;
     }
 
+    ((struct fs_handle *)vh)->mount = m;
+
+    struct fs_fdbuf *buf = calloc(1, sizeof(*buf));
+    if (buf == NULL) {
+        m->ops->close(m->st, vh);
+        errno = ENOMEM;
+        return -1;
+    }
+    buf->size = FS_FDBUF_DEFAULT_SIZE;
+
     struct fdtab_entry e = {
         .type = FDTAB_TYPE_FILE,
         .handle = vh,
         .epoll_fd = -1,
+        .buf = buf,
     };
     int fd = fdtab_alloc(&e);
     if (fd < 0) {
-        ramfs_close(mount, vh);
+        m->ops->close(m->st, vh);
+        free(buf);
         return -1;
     } else {
         return fd;
@@ -146,52 +602,12 @@ static int fs_libc_open(char *path, int flags)
 
 static int fs_libc_read(int fd, void *buf, size_t len)
 {
-    errval_t err;
-
-    struct fdtab_entry *e = fdtab_get(fd);
-    size_t retlen = 0;
-    switch(e->type) {
-    case FDTAB_TYPE_FILE:
-    {
-        ramfs_handle_t fh = e->handle;
-        assert(e->handle);
-        err = ramfs_read(mount, fh, buf, len, &retlen);
-        if (err_is_fail(err)) {
-            return -1;
-        }
-    }
-        break;
-    default :
-        return -1;
-    }
-
-    return retlen;
+    return fd_transfer(fd, false, buf, len, -1);
 }
 
 static int fs_libc_write(int fd, void *buf, size_t len)
 {
-    struct fdtab_entry *e = fdtab_get(fd);
-    if (e->type == FDTAB_TYPE_AVAILABLE) {
-        return -1;
-    }
-
-    size_t retlen = 0;
-
-    switch(e->type) {
-    case FDTAB_TYPE_FILE:
-    {
-        ramfs_handle_t fh = e->handle;
-        errval_t err = ramfs_write(mount, fh, buf, len, &retlen);
-        if (err_is_fail(err)) {
-            return -1;
-        }
-    }
-    break;
-    default :
-        return -1;
-    }
-
-    return retlen;
+    return fd_transfer(fd, true, buf, len, -1);
 }
 
 static int fs_libc_close(int fd)
@@ -202,61 +618,99 @@ static int fs_libc_close(int fd)
         return -1;
     }
 
-    ramfs_handle_t fh = e->handle;
+    void *fh = e->handle;
+    errval_t flush_err = SYS_ERR_OK;
     switch(e->type) {
     case FDTAB_TYPE_FILE:
-        err = ramfs_close(mount, fh);
+        flush_err = fdbuf_flush(handle_mount(fh), fh, e->buf);
+        err = handle_mount(fh)->ops->close(handle_mount(fh)->st, fh);
         if (err_is_fail(err)) {
             return -1;
         }
+        free(e->buf->data);
+        free(e->buf);
         break;
     default:
         return -1;
     }
 
     fdtab_free(fd);
+
+    if (err_is_fail(flush_err)) {
+        errno = EIO;
+        return -1;
+    }
     return 0;
 }
 
+/**
+ * @brief closes the files still open when the domain exits, so that their
+ *        buffered writes reach the backend
+ */
+static void fdtab_close_all(void)
+{
+    // stdio flushes its streams after the exit handlers, do it before
+    fflush(NULL);
+
+    for (size_t fd = MIN_FD; fd < fdtab_size; fd++) {
+        if (!bitmap_is_bit_set(fdtab_free_map, fd)
+            && fdtab[fd].type == FDTAB_TYPE_FILE) {
+            fs_libc_close(fd);
+        }
+    }
+}
+
 static off_t fs_libc_lseek(int fd, off_t offset, int whence)
 {
     struct fdtab_entry *e = fdtab_get(fd);
-    ramfs_handle_t fh = e->handle;
+    void *fh = e->handle;
     switch(e->type) {
     case FDTAB_TYPE_FILE:
     {
-        enum fs_seekpos fs_whence;
+        struct fs_mount *m = handle_mount(fh);
+        struct fs_fdbuf *b = e->buf;
         errval_t err;
         size_t retpos;
+        off_t pos;
 
+        // the position is ours, only the end of the file is the backend's
         switch(whence) {
         case SEEK_SET:
-            fs_whence = FS_SEEK_SET;
+            pos = offset;
             break;
 
         case SEEK_CUR:
-            fs_whence = FS_SEEK_CUR;
+            pos = b->pos + offset;
             break;
 
         case SEEK_END:
-            fs_whence = FS_SEEK_END;
+            err = fdbuf_flush(m, fh, b);
+            if (err_is_ok(err)) {
+                err = m->ops->seek(m->st, fh, FS_SEEK_END, offset);
+            }
+            if(err_is_fail(err)) {
+                DEBUG_ERR(err, "vfs_seek");
+                return -1;
+            }
+
+            err = m->ops->tell(m->st, fh, &retpos);
+            if(err_is_fail(err)) {
+                return -1;
+            }
+            b->backend_pos = retpos;
+            pos = retpos;
             break;
 
         default:
             return -1;
         }
 
-        err = ramfs_seek(mount, fh, fs_whence, offset);
-        if(err_is_fail(err)) {
-            DEBUG_ERR(err, "vfs_seek");
-            return -1;
-        }
-
-        err = ramfs_tell(mount, fh, &retpos);
-        if(err_is_fail(err)) {
+        if (pos < 0) {
+            errno = EINVAL;
             return -1;
         }
-        return retpos;
+        b->pos = pos;
+        return pos;
     }
     break;
 
@@ -265,13 +719,73 @@ static off_t fs_libc_lseek(int fd, off_t offset, int whence)
     }
 }
 
-static errval_t fs_mkdir(const char *path){ return ramfs_mkdir(mount, path);}
-static errval_t fs_rmdir(const char *path){ return ramfs_rmdir(mount, path); }
-static errval_t fs_rm(const char *path){ return ramfs_remove(mount, path); }
-static errval_t fs_opendir(const char *path, fs_dirhandle_t *h){ return ramfs_opendir(mount, path, h); }
-static errval_t fs_readdir(fs_dirhandle_t h, char **name) { return ramfs_dir_read_next(mount, h, name, NULL); }
-static errval_t fs_closedir(fs_dirhandle_t h) { return ramfs_closedir(mount, h); }
-static errval_t fs_fstat(fs_dirhandle_t h, struct fs_fileinfo *b) { return ramfs_stat(mount, h, b); }
+errval_t fs_mmap(int fd, size_t offset, size_t bytes, int flags,
+                 void **retbuf)
+{
+    struct fdtab_entry *e = fdtab_get(fd);
+    if (e->type != FDTAB_TYPE_FILE) {
+        return FS_ERR_INVALID_FH;
+    }
+
+    struct fs_mount *m = handle_mount(e->handle);
+    if (m->ops->mmap == NULL) {
+        return VFS_ERR_NOT_SUPPORTED;
+    }
+
+    // the mapping shows the file as the backend has it, and can change it
+    errval_t err = fdbuf_flush(m, e->handle, e->buf);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    e->buf->len = 0;
+
+    return m->ops->mmap(m->st, e->handle, offset, bytes, flags, retbuf);
+}
+
+errval_t fs_munmap(void *buf)
+{
+    // mappings do not remember their file, ask each backend that has them
+    for (struct fs_mount *m = mounts; m != NULL; m = m->next) {
+        if (m->ops->munmap == NULL) {
+            continue;
+        }
+        errval_t err = m->ops->munmap(m->st, buf);
+        if (err_no(err) != LIB_ERR_VREGION_NOT_FOUND) {
+            return err;
+        }
+    }
+    return LIB_ERR_VREGION_NOT_FOUND;
+}
+
+#define FS_PATH_OP(fn, path)                                        \
+    do {                                                            \
+        const char *relpath;                                        \
+        struct fs_mount *m = fs_mount_find(path, &relpath);         \
+        if (m == NULL) {                                            \
+            return FS_ERR_NOTFOUND;                                 \
+        }                                                           \
+        return m->ops->fn(m->st, relpath);                          \
+    } while (0)
+
+static errval_t fs_mkdir(const char *path){ FS_PATH_OP(mkdir, path); }
+static errval_t fs_rmdir(const char *path){ FS_PATH_OP(rmdir, path); }
+static errval_t fs_rm(const char *path){ FS_PATH_OP(remove, path); }
+static errval_t fs_opendir(const char *path, fs_dirhandle_t *h)
+{
+    const char *relpath;
+    struct fs_mount *m = fs_mount_find(path, &relpath);
+    if (m == NULL) {
+        return FS_ERR_NOTFOUND;
+    }
+    errval_t err = m->ops->opendir(m->st, relpath, h);
+    if (err_is_ok(err)) {
+        ((struct fs_handle *)*h)->mount = m;
+    }
+    return err;
+}
+static errval_t fs_readdir(fs_dirhandle_t h, char **name) { return handle_mount(h)->ops->dir_read_next(handle_mount(h)->st, h, name, NULL); }
+static errval_t fs_closedir(fs_dirhandle_t h) { return handle_mount(h)->ops->closedir(handle_mount(h)->st, h); }
+static errval_t fs_fstat(fs_dirhandle_t h, struct fs_fileinfo *b) { return handle_mount(h)->ops->stat(handle_mount(h)->st, h, b); }
 
 typedef int   fsopen_fn_t(char *, int);
 typedef int   fsread_fn_t(int, void *buf, size_t);
@@ -285,14 +799,16 @@ newlib_register_fsops__(fsopen_fn_t *open_fn,
                         fsclose_fn_t *close_fn,
                         fslseek_fn_t *lseek_fn);
 
-void fs_libc_init(void *fs_state)
+void fs_libc_init(void)
 {
+    if (fdtab == NULL && fdtab_init() == 0) {
+        atexit(fdtab_close_all);
+    }
+
     newlib_register_fsops__(fs_libc_open, fs_libc_read, fs_libc_write,
                             fs_libc_close, fs_libc_lseek);
 
     /* register directory operations */
     fs_register_dirops(fs_mkdir, fs_rmdir, fs_rm, fs_opendir,
                        fs_readdir, fs_closedir, fs_fstat);
-
-    mount = fs_state;
 }
@@ -3,10 +3,15 @@
  * \brief Filesystem support library
  */
 
+#include <string.h>
 #include <aos/aos.h>
 #include <fs/fs.h>
 #include <fs/dirent.h>
 #include <fs/ramfs.h>
+#include <fs/fat32.h>
+#include <fs/fs_ring.h>
+#include <bdev/bdev.h>
+#include <bdev/bcache.h>
 
 #include "fs_internal.h"
 
@@ -32,18 +37,78 @@ errval_t filesystem_init(void)
 {
     errval_t err;
 
-    /* TODO: Filesystem project: hook up your init code here */
+    // the root is the ramfs of the file system server init starts, so all
+    // domains see the same files; without it, fall back to a private one
+    err = filesystem_mount("/", FS_RING_SERVICE "://ramfs/");
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "mounting " FS_RING_SERVICE ", using a private ramfs");
+
+        ramfs_mount_t st = NULL;
+        err = ramfs_mount("/", &st);
+        if (err_is_fail(err)) {
+            return err;
+        }
+
+        err = fs_mount_add("/", &ramfs_ops, st);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+
+    /* register libc fopen/fread and friends */
+    fs_libc_init();
 
-    ramfs_mount_t st = NULL;
-    err = ramfs_mount("/", &st);
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief mounts the FAT32 file system on the block device service
+ *
+ * params is the partition number, 0 if empty. A RAM disk starts out blank
+ * and is formatted first.
+ */
+static errval_t mount_fat32(const char *service, const char *params,
+                            void **retst)
+{
+    errval_t err;
+
+    char *end;
+    size_t partition = strtoul(params, &end, 10);
+    if (*end != '\0' && *end != FS_PATH_SEP) {
+        return VFS_ERR_BAD_URI;
+    }
+
+    struct bdev *dev;
+    err = bdev_open(service, &dev);
     if (err_is_fail(err)) {
         return err;
     }
 
-    /* register libc fopen/fread and friends */
-    fs_libc_init(st);
+    if (strcmp(service, "ramdisk") == 0) {
+        err = fat32_format(dev, "RAMDISK");
+        if (err_is_fail(err)) {
+            goto out_dev;
+        }
+    }
+
+    struct bdev *cache;
+    err = bcache_create(dev, BCACHE_DEFAULT_BLOCKS, &cache);
+    if (err_is_fail(err)) {
+        goto out_dev;
+    }
+
+    err = fat32_mount(cache, partition, retst);
+    if (err_is_fail(err)) {
+        goto out_cache;
+    }
 
     return SYS_ERR_OK;
+
+out_cache:
+    bdev_close(cache);
+out_dev:
+    bdev_close(dev);
+    return err;
 }
 
 /**
@@ -61,5 +126,40 @@ errval_t filesystem_init(void)
  */
 errval_t filesystem_mount(const char *path, const char *uri)
 {
-    return LIB_ERR_NOT_IMPLEMENTED;
+    errval_t err;
+
+    const char *sep = strstr(uri, "://");
+    if (sep == NULL || sep == uri) {
+        return VFS_ERR_BAD_URI;
+    }
+
+    char service[sep - uri + 1];
+    memcpy(service, uri, sep - uri);
+    service[sep - uri] = '\0';
+
+    const char *fstype = sep + 3;
+    const char *params = strchr(fstype, FS_PATH_SEP);
+    size_t fstypelen = params ? params - fstype : strlen(fstype);
+    params = params ? params + 1 : "";
+
+    const struct fs_ops *ops;
+    void *st;
+    if (fstypelen == 5 && strncmp(fstype, "fat32", fstypelen) == 0) {
+        // a block device, opened in this domain
+        ops = &fat32_ops;
+        err = mount_fat32(service, params, &st);
+    } else if (strcmp(service, "ramfs") == 0) {
+        // a fresh ramfs private to this domain
+        ops = &ramfs_ops;
+        err = ramfs_mount(uri, &st);
+    } else {
+        // anything else is a file system server, looked up by name
+        ops = &fsclient_ops;
+        err = fsclient_mount(service, &st);
+    }
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    return fs_mount_add(path, ops, st);
 }
@@ -0,0 +1,531 @@
+/**
+ * \file fs_client.c
+ * \brief File system backend that forwards requests to the file system server
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <aos/aos.h>
+#include <aos/waitset.h>
+#include <nameserver_rpc.h>
+
+#include <fs/fs.h>
+#include <fs/fs_ring.h>
+#include "fs_internal.h"
+
+/**
+ * @brief connection to a file system server
+ *
+ * Requests are issued with the mutex held, so one thread at a time waits for
+ * completions; a single read or write keeps up to FS_RING_SLOTS requests in
+ * flight.
+ */
+struct fsclient
+{
+    struct lmp_chan lc;             ///< channel to the server
+    struct waitset ws;              ///< kicks from the server arrive here
+    struct fs_ring *ring;           ///< ring shared with the server
+    struct thread_mutex mutex;
+    uint32_t done;                  ///< completed slots, by bit
+};
+
+/**
+ * @brief a file or directory opened on the server
+ */
+struct fsclient_handle
+{
+    struct fs_handle common;
+    uint32_t id;                    ///< the server's handle
+    bool isdir;
+    size_t pos;                     ///< file position as last seen
+};
+
+static void fsclient_wakeup(void *arg)
+{
+    // the waiter drains the endpoint itself
+}
+
+/**
+ * @brief blocks until a message is on the channel and receives it
+ */
+static errval_t fsclient_recv(struct fsclient *c, struct lmp_recv_msg *msg,
+                              struct capref *cap)
+{
+    errval_t err;
+    while (true) {
+        err = lmp_chan_recv(&c->lc, msg, cap);
+        if (err_no(err) != LIB_ERR_NO_LMP_MSG) {
+            return err;
+        }
+
+        err = lmp_chan_register_recv(&c->lc, &c->ws,
+                                     MKCLOSURE(fsclient_wakeup, c));
+        if (err_is_fail(err)) {
+            return err;
+        }
+        err = event_dispatch(&c->ws);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+}
+
+static errval_t fsclient_expect_ok(struct fsclient *c, struct capref *cap)
+{
+    struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+    errval_t err = fsclient_recv(c, &msg, cap);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    if (msg.buf.msglen < 1 || msg.words[0] != LMP_RING_OK) {
+        return FS_ERR_SERVER;
+    }
+    return SYS_ERR_OK;
+}
+
+static errval_t fsclient_send_cap(struct fsclient *c, struct capref cap,
+                                  uintptr_t code)
+{
+    errval_t err;
+    do {
+        err = lmp_chan_send1(&c->lc, LMP_FLAG_SYNC, cap, code);
+    } while (lmp_err_is_transient(err));
+    return err;
+}
+
+errval_t fsclient_mount(const char *service, void **retst)
+{
+    errval_t err;
+
+    static struct aos_ns_rpc ns;
+    static struct waitset ns_ws;
+    static bool ns_connected = false;
+    if (!ns_connected) {
+        waitset_init(&ns_ws);
+        err = aos_ns_init(&ns, &ns_ws);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        ns_connected = true;
+    }
+
+    struct capref ep;
+    err = lookup(&ns, (char *)service, &ep);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct fsclient *c = calloc(1, sizeof(*c));
+    if (c == NULL) {
+        cap_destroy(ep);
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    waitset_init(&c->ws);
+    thread_mutex_init(&c->mutex);
+
+    struct capref server_ep;
+    struct capref frame;
+    size_t retbytes;
+
+    err = lmp_chan_accept(&c->lc, DEFAULT_LMP_BUF_WORDS, ep);
+    if (err_is_fail(err)) {
+        cap_destroy(ep);
+        goto out_free;
+    }
+    err = lmp_chan_alloc_recv_slot(&c->lc);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+
+    // the server answers with the endpoint of a channel for us alone
+    err = fsclient_send_cap(c, c->lc.local_cap, LMP_RING_CONNECT);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+    err = fsclient_expect_ok(c, &server_ep);
+    if (err_is_fail(err)) {
+        goto out_chan;
+    }
+    cap_destroy(ep);
+    c->lc.remote_cap = server_ep;
+
+    err = frame_alloc(&frame, FS_RING_FRAME_SIZE, &retbytes);
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_FRAME_ALLOC);
+        goto out_chan;
+    }
+    err = paging_map_frame(get_current_paging_state(), (void **)&c->ring,
+                           FS_RING_FRAME_SIZE, frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        err = err_push(err, LIB_ERR_VSPACE_MAP);
+        goto out_frame;
+    }
+    memset(c->ring, 0, sizeof(*c->ring));
+
+    err = fsclient_send_cap(c, frame, LMP_RING_SETUP);
+    if (err_is_fail(err)) {
+        goto out_unmap;
+    }
+    err = fsclient_expect_ok(c, NULL);
+    if (err_is_fail(err)) {
+        goto out_unmap;
+    }
+
+    *retst = c;
+
+    return SYS_ERR_OK;
+
+out_unmap:
+    paging_unmap(get_current_paging_state(), c->ring);
+out_frame:
+    cap_destroy(frame);
+out_chan:
+    lmp_chan_deregister_recv(&c->lc);
+    cap_destroy(c->lc.remote_cap);
+    lmp_chan_destroy(&c->lc);
+out_free:
+    waitset_destroy(&c->ws);
+    free(c);
+    return err;
+}
+
+/*
+ * Ring operations, called with the mutex held
+ */
+
+/**
+ * @brief fills in slot for a request, copying path to its data page
+ */
+static struct fs_ring_slot *fsclient_prepare(struct fsclient *c, uint32_t slot,
+                                             uint32_t op, uint32_t handle,
+                                             uint32_t arg0, uint32_t arg1,
+                                             const char *path)
+{
+    struct fs_ring_slot *s = &c->ring->slots[slot];
+    s->op = op;
+    s->handle = handle;
+    s->arg0 = arg0;
+    s->arg1 = arg1;
+    if (path != NULL) {
+        strncpy(fs_ring_data(c->ring, slot), path, FS_RING_DATA_SIZE - 1);
+        ((char *)fs_ring_data(c->ring, slot))[FS_RING_DATA_SIZE - 1] = '\0';
+    }
+    return s;
+}
+
+/**
+ * @brief blocks until the request in slot has completed
+ */
+static errval_t fsclient_wait(struct fsclient *c, uint32_t slot)
+{
+    while (!(c->done & (1u << slot))) {
+        uint32_t completed;
+        while (lmp_ring_pop(&c->ring->cq, &completed)) {
+            c->done |= 1u << completed;
+        }
+        if (c->done & (1u << slot)) {
+            break;
+        }
+
+        struct lmp_recv_msg msg = LMP_RECV_MSG_INIT;
+        errval_t err = fsclient_recv(c, &msg, NULL);
+        if (err_is_fail(err)) {
+            return err;
+        }
+    }
+    c->done &= ~(1u << slot);
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief issues a single request and waits for it
+ */
+static errval_t fsclient_call(struct fsclient *c, uint32_t op, uint32_t handle,
+                              uint32_t arg0, uint32_t arg1, const char *path,
+                              uint32_t *ret0, uint32_t *ret1, char **retname)
+{
+    thread_mutex_lock(&c->mutex);
+
+    struct fs_ring_slot *s = fsclient_prepare(c, 0, op, handle, arg0, arg1,
+                                              path);
+    lmp_ring_push(&c->ring->sq, 0);
+    errval_t err = lmp_ring_kick(&c->lc);
+    if (err_is_ok(err)) {
+        err = fsclient_wait(c, 0);
+    }
+    if (err_is_ok(err)) {
+        err = s->err;
+    }
+    if (err_is_ok(err)) {
+        if (ret0) {
+            *ret0 = s->ret0;
+        }
+        if (ret1) {
+            *ret1 = s->ret1;
+        }
+        if (retname) {
+            *retname = strdup(fs_ring_data(c->ring, 0));
+        }
+    }
+
+    thread_mutex_unlock(&c->mutex);
+    return err;
+}
+
+/*
+ * Backend operations
+ */
+
+static errval_t fsclient_open_op(void *st, uint32_t op, const char *path,
+                                 bool isdir, void **rethandle)
+{
+    struct fsclient_handle *h = calloc(1, sizeof(*h));
+    if (h == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    errval_t err = fsclient_call(st, op, 0, 0, 0, path, &h->id, NULL, NULL);
+    if (err_is_fail(err)) {
+        free(h);
+        return err;
+    }
+
+    h->isdir = isdir;
+    *rethandle = h;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t fsclient_open(void *st, const char *path, void **rethandle)
+{
+    return fsclient_open_op(st, FS_RING_OP_OPEN, path, false, rethandle);
+}
+
+static errval_t fsclient_create(void *st, const char *path, void **rethandle)
+{
+    return fsclient_open_op(st, FS_RING_OP_CREATE, path, false, rethandle);
+}
+
+static errval_t fsclient_opendir(void *st, const char *path, void **rethandle)
+{
+    return fsclient_open_op(st, FS_RING_OP_OPENDIR, path, true, rethandle);
+}
+
+static errval_t fsclient_remove(void *st, const char *path)
+{
+    return fsclient_call(st, FS_RING_OP_REMOVE, 0, 0, 0, path, NULL, NULL, NULL);
+}
+
+static errval_t fsclient_mkdir(void *st, const char *path)
+{
+    return fsclient_call(st, FS_RING_OP_MKDIR, 0, 0, 0, path, NULL, NULL, NULL);
+}
+
+static errval_t fsclient_rmdir(void *st, const char *path)
+{
+    return fsclient_call(st, FS_RING_OP_RMDIR, 0, 0, 0, path, NULL, NULL, NULL);
+}
+
+/**
+ * @brief reads or writes through as many slots as the transfer needs,
+ *        submitting them all before waiting for the first
+ */
+static errval_t fsclient_transfer(struct fsclient *c, struct fsclient_handle *h,
+                                  uint32_t op, uint8_t *buf, size_t bytes,
+                                  size_t *retbytes)
+{
+    errval_t err = SYS_ERR_OK;
+    size_t done = 0;
+
+    thread_mutex_lock(&c->mutex);
+
+    while (err_is_ok(err) && done < bytes) {
+        size_t nslots = MIN(DIVIDE_ROUND_UP(bytes - done, FS_RING_DATA_SIZE),
+                            FS_RING_SLOTS);
+        for (uint32_t i = 0; i < nslots; i++) {
+            size_t off = done + i * FS_RING_DATA_SIZE;
+            size_t len = MIN(bytes - off, FS_RING_DATA_SIZE);
+            // parts after the first are skipped once one before fails
+            fsclient_prepare(c, i, op, h->id, len, i > 0, NULL);
+            if (op == FS_RING_OP_WRITE) {
+                memcpy(fs_ring_data(c->ring, i), buf + off, len);
+            }
+            lmp_ring_push(&c->ring->sq, i);
+        }
+        err = lmp_ring_kick(&c->lc);
+        if (err_is_fail(err)) {
+            break;
+        }
+
+        // collect every slot, even past a short transfer, so none is reused
+        // while the server may still complete it
+        bool shortened = false;
+        for (uint32_t i = 0; i < nslots; i++) {
+            errval_t werr = fsclient_wait(c, i);
+            if (err_is_fail(werr)) {
+                err = werr;
+                break;
+            }
+            struct fs_ring_slot *s = &c->ring->slots[i];
+            if (shortened || err_is_fail(err)) {
+                continue;
+            }
+            if (err_is_fail(s->err)) {
+                err = s->err;
+                continue;
+            }
+            if (op == FS_RING_OP_READ) {
+                memcpy(buf + done, fs_ring_data(c->ring, i), s->ret0);
+            }
+            done += s->ret0;
+            shortened = s->ret0 < s->arg0;
+        }
+        if (shortened) {
+            break;
+        }
+    }
+
+    thread_mutex_unlock(&c->mutex);
+
+    h->pos += done;
+    *retbytes = done;
+    return err;
+}
+
+static errval_t fsclient_read(void *st, void *handle, void *buffer,
+                              size_t bytes, size_t *bytes_read)
+{
+    struct fsclient_handle *h = handle;
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+    return fsclient_transfer(st, h, FS_RING_OP_READ, buffer, bytes, bytes_read);
+}
+
+static errval_t fsclient_write(void *st, void *handle, const void *buffer,
+                               size_t bytes, size_t *bytes_written)
+{
+    struct fsclient_handle *h = handle;
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+    size_t written;
+    errval_t err = fsclient_transfer(st, h, FS_RING_OP_WRITE, (void *)buffer,
+                                     bytes, &written);
+    if (bytes_written) {
+        *bytes_written = written;
+    }
+    return err;
+}
+
+static errval_t fsclient_truncate(void *st, void *handle, size_t bytes)
+{
+    struct fsclient_handle *h = handle;
+    return fsclient_call(st, FS_RING_OP_TRUNCATE, h->id, bytes, 0, NULL,
+                         NULL, NULL, NULL);
+}
+
+static errval_t fsclient_seek(void *st, void *handle, enum fs_seekpos whence,
+                              off_t offset)
+{
+    struct fsclient_handle *h = handle;
+    uint32_t pos;
+    errval_t err = fsclient_call(st, FS_RING_OP_SEEK, h->id, whence, offset,
+                                 NULL, &pos, NULL, NULL);
+    if (err_is_ok(err)) {
+        h->pos = pos;
+    }
+    return err;
+}
+
+static errval_t fsclient_tell(void *st, void *handle, size_t *pos)
+{
+    struct fsclient_handle *h = handle;
+    *pos = h->pos;
+    return SYS_ERR_OK;
+}
+
+static errval_t fsclient_stat(void *st, void *handle, struct fs_fileinfo *info)
+{
+    struct fsclient_handle *h = handle;
+    uint32_t type, size;
+    errval_t err = fsclient_call(st, FS_RING_OP_STAT, h->id, 0, 0, NULL,
+                                 &type, &size, NULL);
+    if (err_is_ok(err)) {
+        info->type = type;
+        info->size = size;
+    }
+    return err;
+}
+
+static errval_t fsclient_close_op(void *st, void *handle, uint32_t op)
+{
+    struct fsclient_handle *h = handle;
+    errval_t err = fsclient_call(st, op, h->id, 0, 0, NULL, NULL, NULL, NULL);
+    if (err_is_ok(err)) {
+        free(h);
+    }
+    return err;
+}
+
+static errval_t fsclient_close(void *st, void *handle)
+{
+    return fsclient_close_op(st, handle, FS_RING_OP_CLOSE);
+}
+
+static errval_t fsclient_closedir(void *st, void *handle)
+{
+    return fsclient_close_op(st, handle, FS_RING_OP_CLOSEDIR);
+}
+
+static errval_t fsclient_dir_read_next(void *st, void *handle, char **retname,
+                                       struct fs_fileinfo *info)
+{
+    struct fsclient_handle *h = handle;
+    uint32_t type, size;
+    char *name;
+    errval_t err = fsclient_call(st, FS_RING_OP_READDIR, h->id, 0, 0, NULL,
+                                 &type, &size, &name);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    if (info) {
+        info->type = type;
+        info->size = size;
+    }
+    if (retname) {
+        *retname = name;
+    } else {
+        free(name);
+    }
+
+    return SYS_ERR_OK;
+}
+
+const struct fs_ops fsclient_ops = {
+    .open = fsclient_open,
+    .create = fsclient_create,
+    .remove = fsclient_remove,
+    .read = fsclient_read,
+    .write = fsclient_write,
+    .truncate = fsclient_truncate,
+    .tell = fsclient_tell,
+    .stat = fsclient_stat,
+    .seek = fsclient_seek,
+    .close = fsclient_close,
+    .opendir = fsclient_opendir,
+    .dir_read_next = fsclient_dir_read_next,
+    .closedir = fsclient_closedir,
+    .mkdir = fsclient_mkdir,
+    .rmdir = fsclient_rmdir,
+};
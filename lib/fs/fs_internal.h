@@ -10,21 +10,64 @@
 #ifndef FS_INTERNAL_H_
 #define FS_INTERNAL_H_
 
+#include <fs/fs.h>
+
 struct fs_mount;
 
 struct fs_handle {
     void *mount;
 };
 
+/*
+ * Operations of a file system backend. The functions take the state the
+ * backend was mounted with and paths relative to the mount point; the
+ * handles they return start with a struct fs_handle.
+ */
+struct fs_ops {
+    errval_t (*open)(void *st, const char *path, void **rethandle);
+    errval_t (*create)(void *st, const char *path, void **rethandle);
+    errval_t (*remove)(void *st, const char *path);
+    errval_t (*read)(void *st, void *handle, void *buffer, size_t bytes,
+                     size_t *bytes_read);
+    errval_t (*write)(void *st, void *handle, const void *buffer,
+                      size_t bytes, size_t *bytes_written);
+    errval_t (*truncate)(void *st, void *handle, size_t bytes);
+    errval_t (*tell)(void *st, void *handle, size_t *pos);
+    errval_t (*stat)(void *st, void *handle, struct fs_fileinfo *info);
+    errval_t (*seek)(void *st, void *handle, enum fs_seekpos whence,
+                     off_t offset);
+    errval_t (*close)(void *st, void *handle);
+    errval_t (*opendir)(void *st, const char *path, void **rethandle);
+    errval_t (*dir_read_next)(void *st, void *handle, char **retname,
+                              struct fs_fileinfo *info);
+    errval_t (*closedir)(void *st, void *handle);
+    errval_t (*mkdir)(void *st, const char *path);
+    errval_t (*rmdir)(void *st, const char *path);
+    /// optional, NULL if the backend cannot map file data
+    errval_t (*mmap)(void *st, void *handle, size_t offset, size_t bytes,
+                     int flags, void **retbuf);
+    errval_t (*munmap)(void *st, void *buf);
+};
+
+extern const struct fs_ops ramfs_ops;
+extern const struct fs_ops fsclient_ops;
+extern const struct fs_ops fat32_ops;
+
+/**
+ * @brief connects to the file system server registered as service
+ */
+errval_t fsclient_mount(const char *service, void **retst);
+
+/**
+ * @brief makes the backend st handle the paths below path
+ */
+errval_t fs_mount_add(const char *path, const struct fs_ops *ops, void *st);
+
 
 /*
  * fdtab
  */
 #define MIN_FD  0
-#ifndef MAX_FD
-//#define MAX_FD  132
-#define MAX_FD  4096
-#endif
 
 
 enum fdtab_type {
@@ -39,6 +82,8 @@ enum fdtab_type {
 #include <signal.h>
 #include <sys/epoll.h>
 
+struct fs_fdbuf;
+
 struct fdtab_entry {
     enum fdtab_type     type;
 //    union {
@@ -47,9 +92,10 @@ struct fdtab_entry {
         int             inherited;
 //    };
     int epoll_fd;
+    struct fs_fdbuf     *buf;       ///< position and buffer of a file
 };
 
 /* for the newlib glue code */
-void fs_libc_init(void *fs_state);
+void fs_libc_init(void);
 
 #endif
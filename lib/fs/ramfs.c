@@ -20,25 +20,60 @@
 #define BULK_BLOCK_SIZE     BULK_MEM_SIZE   // (it's RPC)
 
 
+/// Initial number of buckets in a directory's hash index
+#define RAMFS_DIR_MIN_BUCKETS   8
+/// Average entries per bucket at which a directory's index is doubled
+#define RAMFS_DIR_LOAD          2
+/// Slots in the (parent, name) lookup cache of a mount, a power of two
+#define RAMFS_DCACHE_SIZE       64
+/// File data is kept in pages of this size, each backed by its own frame
+#define RAMFS_PAGE_SIZE         BASE_PAGE_SIZE
+/// Initial length of a file's page table, which then doubles as needed
+#define RAMFS_MIN_PAGES         4
+
+/**
+ * @brief a page of file data
+ */
+struct ramfs_page
+{
+    struct capref frame;            ///< frame holding the data
+    void *vaddr;                    ///< where the frame is mapped
+    struct ramfs_page *next;        ///< next page in the mount's free list
+};
+
+/// what holes in sparse files read as
+static const uint8_t zero_page[RAMFS_PAGE_SIZE];
+
 /**
  * @brief an entry in the ramfs
  */
 struct ramfs_dirent
 {
     char *name;                     ///< name of the file or directoyr
+    size_t namelen;                 ///< length of the name
+    uint32_t hash;                  ///< hash of the name
     size_t size;                    ///< the size of the direntry in bytes or files
-    size_t refcount;                ///< reference count for open handles
+    size_t refcount;                ///< reference count for open handles and mappings
+    size_t nmaps;                   ///< number of mappings of the file data
     struct ramfs_dirent *parent;    ///< parent directory
 
-    struct ramfs_dirent *next;      ///< parent directory
-    struct ramfs_dirent *prev;      ///< parent directory
+    struct ramfs_dirent *next;      ///< next entry in the parent directory
+    struct ramfs_dirent *prev;      ///< previous entry in the parent directory
+    struct ramfs_dirent *hnext;     ///< next entry in the same parent bucket
 
     bool is_dir;                    ///< flag indicationg this is a dir
 
     union {
-        void *data;                 ///< file data pointer
+        struct {
+            struct ramfs_page **pages;  ///< file data, NULL entries are holes
+            size_t npages;              ///< length of the page table
+        };
         struct ramfs_dirent *dir;   ///< directory pointer
     };
+
+    struct ramfs_dirent **buckets;  ///< hash index over a directory's entries
+    size_t nbuckets;                ///< number of buckets, a power of two
+    size_t nentries;                ///< number of entries in a directory
 };
 
 /**
@@ -47,7 +82,6 @@ struct ramfs_dirent
 struct ramfs_handle
 {
     struct fs_handle common;
-    char *path;
     bool isdir;
     struct ramfs_dirent *dirent;
     union {
@@ -56,8 +90,25 @@ struct ramfs_handle
     };
 };
 
+/**
+ * @brief file data mapped into the vspace by ramfs_mmap()
+ */
+struct ramfs_mapping
+{
+    void *buf;                      ///< start of the mapping
+    size_t npages;                  ///< number of pages mapped
+    struct ramfs_dirent *dirent;    ///< file the pages belong to
+    struct ramfs_mapping *next;     ///< next mapping of the mount
+};
+
 struct ramfs_mount {
     struct ramfs_dirent *root;
+    /// recently looked up entries, by parent and name hash
+    struct ramfs_dirent *dcache[RAMFS_DCACHE_SIZE];
+    /// pages of removed or truncated files, kept as RAM cannot be returned
+    struct ramfs_page *free_pages;
+    /// live mappings of file data
+    struct ramfs_mapping *mappings;
 };
 
 static struct ramfs_handle *handle_open(struct ramfs_dirent *d)
@@ -78,12 +129,143 @@ static inline void handle_close(struct ramfs_handle *h)
 {
     assert(h->dirent->refcount > 0);
     h->dirent->refcount--;
-    free(h->path);
     free(h);
 }
 
+static errval_t page_alloc(struct ramfs_mount *mount,
+                           struct ramfs_page **ret_page)
+{
+    struct ramfs_page *p = mount->free_pages;
+    if (p != NULL) {
+        mount->free_pages = p->next;
+        memset(p->vaddr, 0, RAMFS_PAGE_SIZE);
+        *ret_page = p;
+        return SYS_ERR_OK;
+    }
+
+    p = calloc(1, sizeof(*p));
+    if (p == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    size_t retsize;
+    errval_t err = frame_alloc(&p->frame, RAMFS_PAGE_SIZE, &retsize);
+    if (err_is_fail(err)) {
+        free(p);
+        return err_push(err, LIB_ERR_FRAME_ALLOC);
+    }
 
-static void dirent_remove(struct ramfs_dirent *entry)
+    err = paging_map_frame(get_current_paging_state(), &p->vaddr,
+                           RAMFS_PAGE_SIZE, p->frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        cap_destroy(p->frame);
+        free(p);
+        return err_push(err, LIB_ERR_VSPACE_MAP);
+    }
+
+    *ret_page = p;
+    return SYS_ERR_OK;
+}
+
+static inline void page_free(struct ramfs_mount *mount, struct ramfs_page *p)
+{
+    p->next = mount->free_pages;
+    mount->free_pages = p;
+}
+
+/**
+ * @brief makes room for at least npages in the page table of a file
+ */
+static errval_t file_reserve(struct ramfs_dirent *f, size_t npages)
+{
+    if (npages <= f->npages) {
+        return SYS_ERR_OK;
+    }
+
+    size_t newlen = f->npages ? f->npages : RAMFS_MIN_PAGES;
+    while (newlen < npages) {
+        newlen *= 2;
+    }
+
+    struct ramfs_page **pages = realloc(f->pages, newlen * sizeof(*pages));
+    if (pages == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    memset(&pages[f->npages], 0, (newlen - f->npages) * sizeof(*pages));
+
+    f->pages = pages;
+    f->npages = newlen;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief releases the pages of a file from page index first on
+ */
+static void file_release(struct ramfs_mount *mount, struct ramfs_dirent *f,
+                         size_t first)
+{
+    for (size_t i = first; i < f->npages; i++) {
+        if (f->pages[i] != NULL) {
+            page_free(mount, f->pages[i]);
+            f->pages[i] = NULL;
+        }
+    }
+}
+
+static inline struct ramfs_page *file_page(struct ramfs_dirent *f, size_t idx)
+{
+    return idx < f->npages ? f->pages[idx] : NULL;
+}
+
+/* FNV-1a */
+static uint32_t name_hash(const char *name, size_t len)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (uint8_t)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static inline struct ramfs_dirent **dcache_slot(struct ramfs_mount *mount,
+                                                struct ramfs_dirent *parent,
+                                                uint32_t hash)
+{
+    uintptr_t key = hash ^ ((uintptr_t)parent >> 4);
+    return &mount->dcache[key & (RAMFS_DCACHE_SIZE - 1)];
+}
+
+static inline bool dirent_matches(struct ramfs_dirent *d, const char *name,
+                                  size_t len, uint32_t hash)
+{
+    return d->hash == hash && d->namelen == len
+            && memcmp(d->name, name, len) == 0;
+}
+
+static errval_t dir_index_grow(struct ramfs_dirent *dir)
+{
+    size_t nbuckets = dir->nbuckets ? dir->nbuckets * 2 : RAMFS_DIR_MIN_BUCKETS;
+    struct ramfs_dirent **buckets = calloc(nbuckets, sizeof(*buckets));
+    if (buckets == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    for (struct ramfs_dirent *d = dir->dir; d != NULL; d = d->next) {
+        struct ramfs_dirent **b = &buckets[d->hash & (nbuckets - 1)];
+        d->hnext = *b;
+        *b = d;
+    }
+
+    free(dir->buckets);
+    dir->buckets = buckets;
+    dir->nbuckets = nbuckets;
+
+    return SYS_ERR_OK;
+}
+
+static void dirent_remove(struct ramfs_mount *mount, struct ramfs_dirent *entry)
 {
     if (entry->prev == NULL) {
         /* entry was the first in list, update parent pointer */
@@ -100,25 +282,53 @@ static void dirent_remove(struct ramfs_dirent *entry)
         /* update prev pointer */
         entry->next->prev = entry->prev;
     }
+
+    struct ramfs_dirent *parent = entry->parent;
+    if (parent) {
+        struct ramfs_dirent **b =
+            &parent->buckets[entry->hash & (parent->nbuckets - 1)];
+        while (*b != entry) {
+            b = &(*b)->hnext;
+        }
+        *b = entry->hnext;
+        parent->nentries--;
+
+        struct ramfs_dirent **slot = dcache_slot(mount, parent, entry->hash);
+        if (*slot == entry) {
+            *slot = NULL;
+        }
+    }
 }
 
-static void dirent_remove_and_free(struct ramfs_dirent *entry)
+static void dirent_remove_and_free(struct ramfs_mount *mount,
+                                   struct ramfs_dirent *entry)
 {
-    dirent_remove(entry);
+    dirent_remove(mount, entry);
     free(entry->name);
     if (!entry->is_dir) {
-        free(entry->data);
+        file_release(mount, entry, 0);
+        free(entry->pages);
     }
+    free(entry->buckets);
 
     memset(entry, 0x00, sizeof(*entry));
     free(entry);
 }
 
-static void dirent_insert(struct ramfs_dirent *parent, struct ramfs_dirent *entry)
+static errval_t dirent_insert(struct ramfs_dirent *parent,
+                              struct ramfs_dirent *entry)
 {
     assert(parent);
     assert(parent->is_dir);
 
+    if (parent->nentries >= parent->nbuckets * RAMFS_DIR_LOAD) {
+        errval_t err = dir_index_grow(parent);
+        if (err_is_fail(err) && parent->nbuckets == 0) {
+            return err;
+        }
+        // otherwise keep using the smaller index
+    }
+
     entry->next = NULL;
     entry->prev = NULL;
     entry->parent = parent;
@@ -128,6 +338,13 @@ static void dirent_insert(struct ramfs_dirent *parent, struct ramfs_dirent *entr
     }
 
     parent->dir = entry;
+
+    struct ramfs_dirent **b = &parent->buckets[entry->hash & (parent->nbuckets - 1)];
+    entry->hnext = *b;
+    *b = entry;
+    parent->nentries++;
+
+    return SYS_ERR_OK;
 }
 
 static struct ramfs_dirent *dirent_create(const char *name, bool is_dir)
@@ -139,58 +356,80 @@ static struct ramfs_dirent *dirent_create(const char *name, bool is_dir)
 
     d->is_dir = is_dir;
     d->name = strdup(name);
+    if (d->name == NULL) {
+        free(d);
+        return NULL;
+    }
+    d->namelen = strlen(name);
+    d->hash = name_hash(name, d->namelen);
 
     return d;
 }
 
-static errval_t find_dirent(struct ramfs_dirent *root, const char *name,
+static errval_t find_dirent(struct ramfs_mount *mount, struct ramfs_dirent *root,
+                            const char *name, size_t len,
                             struct ramfs_dirent **ret_de)
 {
     if (!root->is_dir) {
         return FS_ERR_NOTDIR;
     }
 
-    struct ramfs_dirent *d = root->dir;
+    uint32_t hash = name_hash(name, len);
+
+    struct ramfs_dirent **slot = dcache_slot(mount, root, hash);
+    if (*slot != NULL && (*slot)->parent == root
+            && dirent_matches(*slot, name, len, hash)) {
+        *ret_de = *slot;
+        return SYS_ERR_OK;
+    }
+
+    if (root->nbuckets == 0) {
+        return FS_ERR_NOTFOUND;
+    }
+
+    struct ramfs_dirent *d = root->buckets[hash & (root->nbuckets - 1)];
 
     while(d) {
-        if (strcmp(d->name, name) == 0) {
+        if (dirent_matches(d, name, len, hash)) {
+            *slot = d;
             *ret_de = d;
             return SYS_ERR_OK;
         }
 
-        d = d->next;
+        d = d->hnext;
     }
 
     return FS_ERR_NOTFOUND;
 }
 
-static errval_t resolve_path(struct ramfs_dirent *root, const char *path,
-                             struct ramfs_handle **ret_fh)
+/**
+ * @brief resolves the first len characters of path
+ */
+static errval_t resolve_dirent(struct ramfs_mount *mount, const char *path,
+                               size_t len, struct ramfs_dirent **ret_de)
 {
     errval_t err;
 
+    struct ramfs_dirent *root = mount->root;
+
     // skip leading /
     size_t pos = 0;
-    if (path[0] == FS_PATH_SEP) {
+    if (len > 0 && path[0] == FS_PATH_SEP) {
         pos++;
     }
 
     struct ramfs_dirent *next_dirent;
 
-    while (path[pos] != '\0') {
-        char *nextsep = strchr(&path[pos], FS_PATH_SEP);
+    while (pos < len) {
+        const char *nextsep = memchr(&path[pos], FS_PATH_SEP, len - pos);
         size_t nextlen;
         if (nextsep == NULL) {
-            nextlen = strlen(&path[pos]);
+            nextlen = len - pos;
         } else {
             nextlen = nextsep - &path[pos];
         }
 
-        char pathbuf[nextlen + 1];
-        memcpy(pathbuf, &path[pos], nextlen);
-        pathbuf[nextlen] = '\0';
-
-        err = find_dirent(root, pathbuf, &next_dirent);
+        err = find_dirent(mount, root, &path[pos], nextlen, &next_dirent);
         if (err_is_fail(err)) {
             return err;
         }
@@ -207,20 +446,69 @@ static errval_t resolve_path(struct ramfs_dirent *root, const char *path,
         pos += nextlen + 1;
     }
 
+    *ret_de = root;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t resolve_path(struct ramfs_mount *mount, const char *path,
+                             struct ramfs_handle **ret_fh)
+{
+    struct ramfs_dirent *dirent;
+    errval_t err = resolve_dirent(mount, path, strlen(path), &dirent);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
     /* create the handle */
 
-    if (ret_fh) {
-        struct ramfs_handle *fh = handle_open(root);
-        if (fh == NULL) {
-            return LIB_ERR_MALLOC_FAIL;
-        }
+    struct ramfs_handle *fh = handle_open(dirent);
+    if (fh == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    //fh->common.mount = root;
+
+    *ret_fh = fh;
+
+    return SYS_ERR_OK;
+}
 
-        fh->path = strdup(path);
-        //fh->common.mount = root;
+/**
+ * @brief finds the directory a new entry at path goes into, failing if the
+ * entry already exists
+ */
+static errval_t resolve_new(struct ramfs_mount *mount, const char *path,
+                            struct ramfs_dirent **ret_parent,
+                            const char **ret_childname)
+{
+    errval_t err;
 
-        *ret_fh = fh;
+    struct ramfs_dirent *parent = mount->root;
+    const char *childname = path;
+
+    // find parent directory
+    char *lastsep = strrchr(path, FS_PATH_SEP);
+    if (lastsep != NULL) {
+        childname = lastsep + 1;
+
+        // resolve parent directory
+        err = resolve_dirent(mount, path, lastsep - path, &parent);
+        if (err_is_fail(err)) {
+            return err;
+        } else if (!parent->is_dir) {
+            return FS_ERR_NOTDIR; // parent is not a directory
+        }
+    }
+
+    struct ramfs_dirent *existing;
+    err = find_dirent(mount, parent, childname, strlen(childname), &existing);
+    if (err_is_ok(err)) {
+        return FS_ERR_EXISTS;
     }
 
+    *ret_parent = parent;
+    *ret_childname = childname;
+
     return SYS_ERR_OK;
 }
 
@@ -231,7 +519,7 @@ errval_t ramfs_open(void *st, const char *path, ramfs_handle_t *rethandle)
     struct ramfs_mount *mount = st;
 
     struct ramfs_handle *handle;
-    err = resolve_path(mount->root, path, &handle);
+    err = resolve_path(mount, path, &handle);
     if (err_is_fail(err)) {
         return err;
     }
@@ -252,33 +540,11 @@ errval_t ramfs_create(void *st, const char *path, ramfs_handle_t *rethandle)
 
     struct ramfs_mount *mount = st;
 
-    err = resolve_path(mount->root, path, NULL);
-    if (err_is_ok(err)) {
-        return FS_ERR_EXISTS;
-    }
-
-    struct ramfs_handle *parent = NULL;
+    struct ramfs_dirent *parent;
     const char *childname;
-
-    // find parent directory
-    char *lastsep = strrchr(path, FS_PATH_SEP);
-    if (lastsep != NULL) {
-        childname = lastsep + 1;
-
-        size_t pathlen = lastsep - path;
-        char pathbuf[pathlen + 1];
-        memcpy(pathbuf, path, pathlen);
-        pathbuf[pathlen] = '\0';
-
-        // resolve parent directory
-        err = resolve_path(mount->root, pathbuf, &parent);
-        if (err_is_fail(err)) {
-            return err;
-        } else if (!parent->isdir) {
-            return FS_ERR_NOTDIR; // parent is not a directory
-        }
-    } else {
-        childname = path;
+    err = resolve_new(mount, path, &parent, &childname);
+    if (err_is_fail(err)) {
+        return err;
     }
 
     struct ramfs_dirent *dirent = dirent_create(childname, false);
@@ -286,11 +552,11 @@ errval_t ramfs_create(void *st, const char *path, ramfs_handle_t *rethandle)
         return LIB_ERR_MALLOC_FAIL;
     }
 
-    if (parent) {
-        dirent_insert(parent->dirent, dirent);
-        handle_close(parent);
-    } else {
-        dirent_insert(mount->root, dirent);
+    err = dirent_insert(parent, dirent);
+    if (err_is_fail(err)) {
+        free(dirent->name);
+        free(dirent);
+        return err;
     }
 
     if (rethandle) {
@@ -298,7 +564,6 @@ errval_t ramfs_create(void *st, const char *path, ramfs_handle_t *rethandle)
         if (fh  == NULL) {
             return LIB_ERR_MALLOC_FAIL;
         }
-        fh->path = strdup(path);
         *rethandle = fh;
     }
 
@@ -311,24 +576,21 @@ errval_t ramfs_remove(void *st, const char *path)
 
     struct ramfs_mount *mount = st;
 
-    struct ramfs_handle *handle;
-    err = resolve_path(mount->root, path, &handle);
+    struct ramfs_dirent *dirent;
+    err = resolve_dirent(mount, path, strlen(path), &dirent);
     if (err_is_fail(err)) {
         return err;
     }
 
-    if (handle->isdir) {
+    if (dirent->is_dir) {
         return FS_ERR_NOTFILE;
     }
 
-    struct ramfs_dirent *dirent = handle->dirent;
-    if (dirent->    refcount != 1) {
-        handle_close(handle);
+    if (dirent->refcount != 0) {
         return FS_ERR_BUSY;
     }
 
-
-    dirent_remove_and_free(dirent);
+    dirent_remove_and_free(mount, dirent);
 
     return SYS_ERR_OK;
 }
@@ -344,16 +606,27 @@ errval_t ramfs_read(void *st, ramfs_handle_t handle, void *buffer, size_t bytes,
 
     assert(h->file_pos >= 0);
 
-    if (h->dirent->data == NULL) {
-        bytes = 0;
-    } else if (h->dirent->size < h->file_pos) {
+    size_t pos = h->file_pos;
+    if (h->dirent->size <= pos) {
         bytes = 0;
-    } else if (h->dirent->size < h->file_pos + bytes) {
-        bytes = h->dirent->size - h->file_pos;
-        assert(h->file_pos + bytes == h->dirent->size);
+    } else if (h->dirent->size < pos + bytes) {
+        bytes = h->dirent->size - pos;
     }
 
-    memcpy(buffer, h->dirent->data + h->file_pos, bytes);
+    uint8_t *dst = buffer;
+    size_t done = 0;
+    while (done < bytes) {
+        size_t offset = (pos + done) % RAMFS_PAGE_SIZE;
+        size_t chunk = MIN(RAMFS_PAGE_SIZE - offset, bytes - done);
+        struct ramfs_page *p = file_page(h->dirent,
+                                         (pos + done) / RAMFS_PAGE_SIZE);
+        if (p == NULL) {
+            memset(dst + done, 0, chunk);
+        } else {
+            memcpy(dst + done, (uint8_t *)p->vaddr + offset, chunk);
+        }
+        done += chunk;
+    }
 
     h->file_pos += bytes;
 
@@ -362,58 +635,238 @@ errval_t ramfs_read(void *st, ramfs_handle_t handle, void *buffer, size_t bytes,
     return SYS_ERR_OK;
 }
 
+errval_t ramfs_read_span(void *st, ramfs_handle_t handle, const void **retbuf,
+                         size_t *bytes_read)
+{
+    struct ramfs_handle *h = handle;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    assert(h->file_pos >= 0);
+
+    size_t pos = h->file_pos;
+    if (h->dirent->size <= pos) {
+        *retbuf = NULL;
+        *bytes_read = 0;
+        return SYS_ERR_OK;
+    }
+
+    size_t offset = pos % RAMFS_PAGE_SIZE;
+    size_t bytes = MIN(RAMFS_PAGE_SIZE - offset, h->dirent->size - pos);
+    struct ramfs_page *p = file_page(h->dirent, pos / RAMFS_PAGE_SIZE);
+
+    *retbuf = (p == NULL ? zero_page : (uint8_t *)p->vaddr) + offset;
+    *bytes_read = bytes;
+
+    h->file_pos += bytes;
+
+    return SYS_ERR_OK;
+}
+
 errval_t ramfs_write(void *st, ramfs_handle_t handle, const void *buffer,
                             size_t bytes, size_t *bytes_written)
 {
+    struct ramfs_mount *mount = st;
     struct ramfs_handle *h = handle;
     assert(h->file_pos >= 0);
 
-    size_t offset = h->file_pos;
+    size_t pos = h->file_pos;
 
     if (h->isdir) {
         return FS_ERR_NOTFILE;
     }
 
-    if (h->dirent->size < offset + bytes) {
-        /* need to realloc the buffer */
-        void *newbuf = realloc(h->dirent->data, offset + bytes);
-        if (newbuf == NULL) {
-            return LIB_ERR_MALLOC_FAIL;
-        }
-        h->dirent->data = newbuf;
+    errval_t err = file_reserve(h->dirent,
+                                DIVIDE_ROUND_UP(pos + bytes, RAMFS_PAGE_SIZE));
+    if (err_is_fail(err)) {
+        return err;
     }
 
-    memcpy(h->dirent->data + offset, buffer, bytes);
+    const uint8_t *src = buffer;
+    size_t done = 0;
+    while (done < bytes) {
+        size_t offset = (pos + done) % RAMFS_PAGE_SIZE;
+        size_t chunk = MIN(RAMFS_PAGE_SIZE - offset, bytes - done);
+        struct ramfs_page **p = &h->dirent->pages[(pos + done) / RAMFS_PAGE_SIZE];
+        if (*p == NULL) {
+            err = page_alloc(mount, p);
+            if (err_is_fail(err)) {
+                break;
+            }
+        }
+        memcpy((uint8_t *)(*p)->vaddr + offset, src + done, chunk);
+        done += chunk;
+    }
 
     if (bytes_written) {
-        *bytes_written = bytes;
+        *bytes_written = done;
     }
 
-    h->file_pos += bytes;
-    h->dirent->size += bytes;
+    h->file_pos += done;
+    if (h->dirent->size < pos + done) {
+        h->dirent->size = pos + done;
+    }
 
-    return SYS_ERR_OK;
+    return err;
 }
 
 
 errval_t ramfs_truncate(void *st, ramfs_handle_t handle, size_t bytes)
 {
+    struct ramfs_mount *mount = st;
     struct ramfs_handle *h = handle;
 
     if (h->isdir) {
         return FS_ERR_NOTFILE;
     }
 
-    void *newdata = realloc(h->dirent->data, bytes);
-    if (newdata == NULL) {
-        return LIB_ERR_MALLOC_FAIL;
+    if (bytes < h->dirent->size) {
+        if (h->dirent->nmaps != 0) {
+            return FS_ERR_BUSY;
+        }
+
+        file_release(mount, h->dirent, DIVIDE_ROUND_UP(bytes, RAMFS_PAGE_SIZE));
+
+        // growing the file again must not bring back the old tail
+        struct ramfs_page *p = file_page(h->dirent, bytes / RAMFS_PAGE_SIZE);
+        size_t offset = bytes % RAMFS_PAGE_SIZE;
+        if (p != NULL && offset != 0) {
+            memset((uint8_t *)p->vaddr + offset, 0, RAMFS_PAGE_SIZE - offset);
+        }
     }
-    h->dirent->data = newdata;
     h->dirent->size = bytes;
 
     return SYS_ERR_OK;
 }
 
+/**
+ * @brief unmaps the first npages pages of a mapping
+ */
+static errval_t mapping_unmap_pages(void *buf, size_t npages)
+{
+    errval_t err = SYS_ERR_OK;
+    for (size_t i = 0; i < npages; i++) {
+        errval_t e = paging_unmap(get_current_paging_state(),
+                                  (uint8_t *)buf + i * RAMFS_PAGE_SIZE);
+        if (err_is_fail(e)) {
+            err = e;
+        }
+    }
+    return err;
+}
+
+errval_t ramfs_mmap(void *st, ramfs_handle_t handle, size_t offset,
+                    size_t bytes, int flags, void **retbuf)
+{
+    errval_t err;
+
+    struct ramfs_mount *mount = st;
+    struct ramfs_handle *h = handle;
+
+    if (h->isdir) {
+        return FS_ERR_NOTFILE;
+    }
+
+    if (offset % RAMFS_PAGE_SIZE) {
+        return FS_ERR_UNALIGNED;
+    }
+
+    struct ramfs_dirent *f = h->dirent;
+    if (bytes == 0 || offset + bytes > ROUND_UP(f->size, RAMFS_PAGE_SIZE)) {
+        return FS_ERR_INDEX_BOUNDS;
+    }
+
+    size_t first = offset / RAMFS_PAGE_SIZE;
+    size_t npages = DIVIDE_ROUND_UP(bytes, RAMFS_PAGE_SIZE);
+
+    struct ramfs_mapping *m = calloc(1, sizeof(*m));
+    if (m == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+
+    // every mapped page needs a frame, so back the holes first
+    err = file_reserve(f, first + npages);
+    if (err_is_fail(err)) {
+        goto out_free;
+    }
+    for (size_t i = first; i < first + npages; i++) {
+        if (f->pages[i] == NULL) {
+            err = page_alloc(mount, &f->pages[i]);
+            if (err_is_fail(err)) {
+                goto out_free;
+            }
+        }
+    }
+
+    struct paging_state *ps = get_current_paging_state();
+    err = paging_alloc(ps, &m->buf, npages * RAMFS_PAGE_SIZE);
+    if (err_is_fail(err)) {
+        goto out_free;
+    }
+
+    for (size_t i = 0; i < npages; i++) {
+        err = paging_map_fixed_attr(ps, (lvaddr_t)m->buf + i * RAMFS_PAGE_SIZE,
+                                    f->pages[first + i]->frame,
+                                    RAMFS_PAGE_SIZE, flags);
+        if (err_is_fail(err)) {
+            // page i may be half mapped, and the pages after it are still
+            // claimed: give the whole range back
+            mapping_unmap_pages(m->buf, i + 1);
+            paging_unclaim(ps, (lvaddr_t)m->buf, npages * RAMFS_PAGE_SIZE);
+            err = err_push(err, LIB_ERR_VSPACE_MAP);
+            goto out_free;
+        }
+    }
+
+    // pin the file like an open handle does, so it cannot be removed
+    f->refcount++;
+    f->nmaps++;
+
+    m->npages = npages;
+    m->dirent = f;
+    m->next = mount->mappings;
+    mount->mappings = m;
+
+    *retbuf = m->buf;
+
+    return SYS_ERR_OK;
+
+out_free:
+    free(m);
+    return err;
+}
+
+errval_t ramfs_munmap(void *st, void *buf)
+{
+    struct ramfs_mount *mount = st;
+
+    struct ramfs_mapping **mp = &mount->mappings;
+    while (*mp != NULL && (*mp)->buf != buf) {
+        mp = &(*mp)->next;
+    }
+
+    struct ramfs_mapping *m = *mp;
+    if (m == NULL) {
+        return LIB_ERR_VREGION_NOT_FOUND;
+    }
+
+    errval_t err = mapping_unmap_pages(m->buf, m->npages);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    *mp = m->next;
+
+    assert(m->dirent->refcount > 0 && m->dirent->nmaps > 0);
+    m->dirent->refcount--;
+    m->dirent->nmaps--;
+    free(m);
+
+    return SYS_ERR_OK;
+}
+
 errval_t ramfs_tell(void *st, ramfs_handle_t handle, size_t *pos)
 {
     struct ramfs_handle *h = handle;
@@ -443,12 +896,19 @@ errval_t ramfs_seek(void *st, ramfs_handle_t handle, enum fs_seekpos whence,
     struct fs_fileinfo info;
     errval_t err;
 
+    // directories can only be rewound or skipped forward from the start
+    if (h->isdir && whence != FS_SEEK_SET) {
+        return FS_ERR_NOTFILE;
+    }
+
     switch (whence) {
     case FS_SEEK_SET:
-        assert(offset >= 0);
+        if (offset < 0) {
+            return FS_ERR_INDEX_BOUNDS;
+        }
         if (h->isdir) {
-            h->dir_pos = h->dirent->parent->dir;
-            for (size_t i = 0; i < offset; i++) {
+            h->dir_pos = h->dirent->dir;
+            for (off_t i = 0; i < offset; i++) {
                 if (h->dir_pos  == NULL) {
                     break;
                 }
@@ -460,30 +920,25 @@ errval_t ramfs_seek(void *st, ramfs_handle_t handle, enum fs_seekpos whence,
         break;
 
     case FS_SEEK_CUR:
-        if (h->isdir) {
-            assert(!"NYI");
-        } else {
-            assert(offset >= 0 || -offset <= h->file_pos);
-            h->file_pos += offset;
+        if (offset < 0 && -offset > h->file_pos) {
+            return FS_ERR_INDEX_BOUNDS;
         }
-
+        h->file_pos += offset;
         break;
 
     case FS_SEEK_END:
-        if (h->isdir) {
-            assert(!"NYI");
-        } else {
-            err = ramfs_stat(st, handle, &info);
-            if (err_is_fail(err)) {
-                return err;
-            }
-            assert(offset >= 0 || -offset <= info.size);
-            h->file_pos = info.size + offset;
+        err = ramfs_stat(st, handle, &info);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        if (offset < 0 && (size_t)-offset > info.size) {
+            return FS_ERR_INDEX_BOUNDS;
         }
+        h->file_pos = info.size + offset;
         break;
 
     default:
-        USER_PANIC("invalid whence argument to ramfs seek");
+        return FS_ERR_INDEX_BOUNDS;
     }
 
     return SYS_ERR_OK;
@@ -506,7 +961,7 @@ errval_t ramfs_opendir(void *st, const char *path, ramfs_handle_t *rethandle)
     struct ramfs_mount *mount = st;
 
     struct ramfs_handle *handle;
-    err = resolve_path(mount->root, path, &handle);
+    err = resolve_path(mount, path, &handle);
     if (err_is_fail(err)) {
         return err;
     }
@@ -559,8 +1014,7 @@ errval_t ramfs_closedir(void *st, ramfs_handle_t dhandle)
         return FS_ERR_NOTDIR;
     }
 
-    free(handle->path);
-    free(handle);
+    handle_close(handle);
 
     return SYS_ERR_OK;
 }
@@ -572,36 +1026,11 @@ errval_t ramfs_mkdir(void *st, const char *path)
 
     struct ramfs_mount *mount = st;
 
-    err = resolve_path(mount->root, path, NULL);
-    if (err_is_ok(err)) {
-        return FS_ERR_EXISTS;
-    }
-
-
-    struct ramfs_handle *parent  = NULL;
+    struct ramfs_dirent *parent;
     const char *childname;
-
-    // find parent directory
-    char *lastsep = strrchr(path, FS_PATH_SEP);
-    if (lastsep != NULL) {
-        childname = lastsep + 1;
-
-        size_t pathlen = lastsep - path;
-        char pathbuf[pathlen + 1];
-        memcpy(pathbuf, path, pathlen);
-        pathbuf[pathlen] = '\0';
-
-        // resolve parent directory
-        err = resolve_path(mount->root, pathbuf, &parent);
-        if (err_is_fail(err)) {
-            handle_close(parent);
-            return err;
-        } else if (!parent->isdir) {
-            handle_close(parent);
-            return FS_ERR_NOTDIR; // parent is not a directory
-        }
-    } else {
-        childname = path;
+    err = resolve_new(mount, path, &parent, &childname);
+    if (err_is_fail(err)) {
+        return err;
     }
 
     struct ramfs_dirent *dirent = dirent_create(childname, true);
@@ -609,11 +1038,11 @@ errval_t ramfs_mkdir(void *st, const char *path)
         return LIB_ERR_MALLOC_FAIL;
     }
 
-    if (parent) {
-        dirent_insert(parent->dirent, dirent);
-        handle_close(parent);
-    } else {
-        dirent_insert(mount->root, dirent);
+    err = dirent_insert(parent, dirent);
+    if (err_is_fail(err)) {
+        free(dirent->name);
+        free(dirent);
+        return err;
     }
 
     return SYS_ERR_OK;
@@ -627,35 +1056,27 @@ errval_t ramfs_rmdir(void *st, const char *path)
 
     struct ramfs_mount *mount = st;
 
-    struct ramfs_handle *handle;
-    err = resolve_path(mount->root, path, &handle);
+    struct ramfs_dirent *dirent;
+    err = resolve_dirent(mount, path, strlen(path), &dirent);
     if (err_is_fail(err)) {
         return err;
     }
 
-    if (!handle->isdir) {
-        goto out;
-        err =  FS_ERR_NOTDIR;
+    if (!dirent->is_dir) {
+        return FS_ERR_NOTDIR;
     }
 
-    if (handle->dirent->refcount != 1) {
-        handle_close(handle);
+    if (dirent->refcount != 0 || dirent == mount->root) {
         return FS_ERR_BUSY;
     }
 
-    assert(handle->dirent->is_dir);
-
-    if (handle->dirent->dir) {
-        err = FS_ERR_NOTEMPTY;
-        goto out;
+    if (dirent->dir) {
+        return FS_ERR_NOTEMPTY;
     }
 
-    dirent_remove_and_free(handle->dirent);
+    dirent_remove_and_free(mount, dirent);
 
-    out:
-    free(handle);
-
-    return err;
+    return SYS_ERR_OK;
 }
 
 
@@ -674,13 +1095,14 @@ errval_t ramfs_mount(const char *uri, ramfs_mount_t *retst)
 
     ramfs_root = calloc(1, sizeof(*ramfs_root));
     if (ramfs_root == NULL) {
-        free(ramfs_mount);
+        free(mount);
         return LIB_ERR_MALLOC_FAIL;
     }
 
     ramfs_root->size = 0;
     ramfs_root->is_dir = true;
     ramfs_root->name = "/";
+    ramfs_root->namelen = 1;
     ramfs_root->parent = NULL;
 
     mount->root = ramfs_root;
@@ -689,3 +1111,23 @@ errval_t ramfs_mount(const char *uri, ramfs_mount_t *retst)
 
     return SYS_ERR_OK;
 }
+
+const struct fs_ops ramfs_ops = {
+    .open = ramfs_open,
+    .create = ramfs_create,
+    .remove = ramfs_remove,
+    .read = ramfs_read,
+    .write = ramfs_write,
+    .truncate = ramfs_truncate,
+    .tell = ramfs_tell,
+    .stat = ramfs_stat,
+    .seek = ramfs_seek,
+    .close = ramfs_close,
+    .opendir = ramfs_opendir,
+    .dir_read_next = ramfs_dir_read_next,
+    .closedir = ramfs_closedir,
+    .mkdir = ramfs_mkdir,
+    .rmdir = ramfs_rmdir,
+    .mmap = ramfs_mmap,
+    .munmap = ramfs_munmap,
+};
@@ -209,7 +209,22 @@ static int ht_remove(struct dictionary *dict, char *key, size_t key_len)
     return 1;
 }
 
-// XXX implement destructors
+/**
+ * \brief free a hashtable and its entries, but not the keys or values
+ */
+void hashtable_destroy(struct hashtable *ht)
+{
+    for (int i = 0; i < ht->table_length; i++) {
+        struct _ht_entry *_e = ht->entries[i];
+        while (NULL != _e) {
+            struct _ht_entry *_next = _e->next;
+            free(_e);
+            _e = _next;
+        }
+    }
+    free(ht->entries);
+    free(ht);
+}
 
 /**
  * \brief create an empty hashtable with a given capacity and load factor
@@ -121,6 +121,45 @@ static void set_root(struct cte *new_root)
 #endif
 }
 
+/*
+ * Lookup cache for mdb_find_cap_for_address().
+ *
+ * Remembers the most recent results whose cap has no descendants, so that
+ * every address inside the cap resolves to it. Inserting or removing a cap
+ * drops the entries it overlaps with.
+ */
+#define MDB_LOOKUP_CACHE_SIZE 4
+
+struct mdb_lookup_cache_entry {
+    genpaddr_t base, limit;     ///< Address range of the cached cap
+    struct cte *cte;            ///< Cached cap, NULL if unused
+};
+
+static struct mdb_lookup_cache_entry mdb_lookup_cache[MDB_LOOKUP_CACHE_SIZE];
+static unsigned mdb_lookup_cache_next;
+
+static void
+mdb_lookup_cache_flush(void)
+{
+    for (int i = 0; i < MDB_LOOKUP_CACHE_SIZE; i++) {
+        mdb_lookup_cache[i].cte = NULL;
+    }
+}
+
+static void
+mdb_lookup_cache_invalidate(struct cte *cte)
+{
+    genpaddr_t base = get_address(C(cte));
+    genpaddr_t limit = base + get_size(C(cte));
+    for (int i = 0; i < MDB_LOOKUP_CACHE_SIZE; i++) {
+        struct mdb_lookup_cache_entry *e = &mdb_lookup_cache[i];
+        if (e->cte == cte ||
+            (e->cte && base < e->limit && limit > e->base)) {
+            e->cte = NULL;
+        }
+    }
+}
+
 /*
  * (re)initialization
  */
@@ -145,6 +184,7 @@ mdb_init(struct kcb *k)
 #endif
     // set root
     mdb_root = (struct cte *)k->mdb_root;
+    mdb_lookup_cache_flush();
 
 #if 0
     // always check invariants here
@@ -621,10 +661,118 @@ mdb_insert(struct cte *new_node)
 #endif
 #endif
     errval_t ret = mdb_sub_insert(new_node, &mdb_root);
+    if (err_is_ok(ret)) {
+        mdb_lookup_cache_invalidate(new_node);
+    }
     CHECK_INVARIANTS(mdb_root, new_node, true);
     MDB_TRACE_LEAVE_SUB_RET("%"PRIuPTR, ret, mdb_root);
 }
 
+/*
+ * Bulk insertion.
+ */
+
+// Flatten a subtree into an ascending list linked through the right
+// pointers. Returns the link to store the list's successor in.
+static struct cte **
+mdb_flatten(struct cte *cte, struct cte **link)
+{
+    if (!cte) {
+        return link;
+    }
+    struct cte *right = N(cte)->right;
+    link = mdb_flatten(N(cte)->left, link);
+    *link = cte;
+    link = &N(cte)->right;
+    return mdb_flatten(right, link);
+}
+
+// Build a balanced tree from the first count nodes of a list linked through
+// the right pointers, advancing *list past them. The left subtree is never
+// larger than the right one, so giving each node its left child's level plus
+// one satisfies the AA-tree invariants.
+static struct cte *
+mdb_build(struct cte **list, size_t count)
+{
+    if (count == 0) {
+        return NULL;
+    }
+    size_t left_count = (count - 1) / 2;
+    struct cte *left = mdb_build(list, left_count);
+    struct cte *node = *list;
+    *list = N(node)->right;
+    N(node)->left = left;
+    N(node)->right = mdb_build(list, count - 1 - left_count);
+    N(node)->level = left ? N(left)->level + 1 : 0;
+    mdb_update_end(node);
+    return node;
+}
+
+errval_t
+mdb_insert_bulk(struct cte *nodes, size_t count)
+{
+    errval_t err = SYS_ERR_OK;
+
+    if (count == 0) {
+        return SYS_ERR_OK;
+    }
+    MDB_TRACE_ENTER(mdb_root, "%p, %zu", nodes, count);
+
+    bool sorted = true;
+    for (size_t i = 1; i < count && sorted; i++) {
+        sorted = compare_caps(C(&nodes[i - 1]), C(&nodes[i]), true) < 0;
+    }
+
+    // Rebuilding costs O(n), inserting one by one O(count * log n); the level
+    // of the root approximates log n.
+    size_t height = mdb_root ? N(mdb_root)->level + 1 : 0;
+    if (!sorted || (height < 8 * sizeof(size_t) &&
+                    count * height < ((size_t)1 << height))) {
+        for (size_t i = 0; i < count; i++) {
+            errval_t ins_err = mdb_insert(&nodes[i]);
+            if (err_is_fail(ins_err)) {
+                err = ins_err;
+            }
+        }
+        MDB_TRACE_LEAVE_SUB_RET("%"PRIuPTR, err, mdb_root);
+    }
+
+    struct cte *list = NULL;
+    *mdb_flatten(mdb_root, &list) = NULL;
+
+    // Merge the run into the list of existing nodes
+    struct cte *merged = NULL, **link = &merged;
+    size_t total = 0, i = 0;
+    while (list || i < count) {
+        int compare = !list ? -1 : i == count ? 1
+                    : compare_caps(C(&nodes[i]), C(list), true);
+        struct cte *next;
+        if (compare == 0) {
+            // already in the tree, mdb_insert() would refuse it as well
+            err = CAPS_ERR_MDB_DUPLICATE_ENTRY;
+            i++;
+            continue;
+        }
+        else if (compare < 0) {
+            next = &nodes[i++];
+        }
+        else {
+            next = list;
+            list = N(list)->right;
+        }
+        *link = next;
+        link = &N(next)->right;
+        total++;
+    }
+    *link = NULL;
+
+    set_root(mdb_build(&merged, total));
+    mdb_lookup_cache_flush();
+
+    CHECK_INVARIANTS(mdb_root, &nodes[0], true);
+    MDB_TRACE_LEAVE_SUB_RET("%"PRIuPTR, err, mdb_root);
+}
+
 static void
 mdb_exchange_child(struct cte *first, struct cte *first_parent,
                    struct cte *second)
@@ -851,6 +999,9 @@ mdb_remove(struct cte *target)
 #endif
 #endif
     errval_t err = mdb_subtree_remove(target, &mdb_root, NULL);
+    if (err_is_ok(err)) {
+        mdb_lookup_cache_invalidate(target);
+    }
     CHECK_INVARIANTS(mdb_root, target, false);
     MDB_TRACE_LEAVE_SUB_RET("%"PRIuPTR, err, mdb_root);
 }
@@ -968,6 +1119,33 @@ mdb_find_greater(struct capability *cap, bool equal_ok)
     return mdb_sub_find_greater(cap, mdb_root, equal_ok, false);
 }
 
+static struct cte*
+mdb_sub_find_after(struct capability *cap, struct cte *pos,
+                   struct cte *current)
+{
+    if (!current) {
+        return NULL;
+    }
+    int compare = compare_caps(cap, C(current), false);
+    if (compare == 0) {
+        // break the tie like compare_caps does, by address
+        compare = (pos < current) ? -1 : 1;
+    }
+    if (compare < 0) {
+        struct cte *res = mdb_sub_find_after(cap, pos, N(current)->left);
+        return res ? res : current;
+    }
+    else {
+        return mdb_sub_find_after(cap, pos, N(current)->right);
+    }
+}
+
+struct cte*
+mdb_find_after(struct capability *cap, struct cte *pos)
+{
+    return mdb_sub_find_after(cap, pos, mdb_root);
+}
+
 struct cte*
 mdb_predecessor(struct cte *current)
 {
@@ -1277,6 +1455,15 @@ mdb_find_cap_for_address(genpaddr_t address, struct cte **ret_node)
 {
     int result;
     errval_t err;
+
+    for (int i = 0; i < MDB_LOOKUP_CACHE_SIZE; i++) {
+        struct mdb_lookup_cache_entry *e = &mdb_lookup_cache[i];
+        if (e->cte && address >= e->base && address < e->limit) {
+            *ret_node = e->cte;
+            return SYS_ERR_OK;
+        }
+    }
+
     // query for size 1 to get the smallest cap that includes the byte at the
     // given address
     err = mdb_find_range(get_type_root(ObjType_RAM), address,
@@ -1287,6 +1474,15 @@ mdb_find_cap_for_address(genpaddr_t address, struct cte **ret_node)
     if (result != MDB_RANGE_FOUND_SURROUNDING) {
         return SYS_ERR_CAP_NOT_FOUND;
     }
+
+    // Without descendants, no smaller cap covers any other address in it
+    if (!has_descendants(*ret_node)) {
+        struct mdb_lookup_cache_entry *e =
+            &mdb_lookup_cache[mdb_lookup_cache_next++ % MDB_LOOKUP_CACHE_SIZE];
+        e->base = get_address(C(*ret_node));
+        e->limit = e->base + get_size(C(*ret_node));
+        e->cte = *ret_node;
+    }
     return SYS_ERR_OK;
 }
 
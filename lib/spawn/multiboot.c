@@ -4,14 +4,51 @@
 #include <string.h>
 
 #include <spawn/multiboot.h>
+#include <hashtable/hashtable.h>
 
 static char * multiboot_strings;
+static struct thread_mutex multiboot_strings_mutex = THREAD_MUTEX_INITIALIZER;
 
-const char *multiboot_module_opts(struct mem_region *module)
+/// A module line from menu.lst, parsed once when the module index is built
+struct module_entry {
+    struct module_entry *next;  // Next module with the same basename
+    struct mem_region *region;
+    char *name;                 // Path of the binary, without arguments
+    size_t name_len;
+    const char *opts;           // Module line starting at the basename
+};
+
+static struct bootinfo *module_bi;              // bootinfo that is indexed
+static struct module_entry *module_entries;     // Indexed like bi->regions
+static struct hashtable *module_index;          // Basename -> module_entry
+static struct thread_mutex module_index_mutex = THREAD_MUTEX_INITIALIZER;
+
+/// A module frame mapped in my vspace, shared by all its current users
+struct module_mapping {
+    struct module_mapping *next;
+    struct mem_region *module;
+    void *vaddr;
+    size_t bytes;
+    size_t refcount;
+};
+
+static struct module_mapping *module_mappings = NULL;
+static struct thread_mutex module_mappings_mutex = THREAD_MUTEX_INITIALIZER;
+
+/// Returns the index entry of region, NULL if the index does not cover it
+static struct module_entry *module_entry_of(struct mem_region *region)
 {
-    assert(module != NULL);
-    assert(module->mr_type == RegionType_Module);
+    struct bootinfo *bi = __atomic_load_n(&module_bi, __ATOMIC_ACQUIRE);
+    if (bi == NULL || region < bi->regions
+            || region >= bi->regions + bi->regions_length) {
+        return NULL;
+    }
+    struct module_entry *entry = &module_entries[region - bi->regions];
+    return entry->name ? entry : NULL;
+}
 
+static const char *module_opts_parse(struct mem_region *module)
+{
     const char *optstring = multiboot_module_rawstring(module);
 
     // find the first space (or end of string if there is none)
@@ -29,21 +66,46 @@ const char *multiboot_module_opts(struct mem_region *module)
 
     return optstring;
 }
-/// Returns a raw pointer to the modules string area string
-const char *multiboot_module_rawstring(struct mem_region *region)
+
+const char *multiboot_module_opts(struct mem_region *module)
+{
+    assert(module != NULL);
+    assert(module->mr_type == RegionType_Module);
+
+    struct module_entry *entry = module_entry_of(module);
+    if (entry != NULL) {
+        return entry->opts;
+    }
+    return module_opts_parse(module);
+}
+/// Map in the multiboot module strings area, once
+static errval_t multiboot_strings_map(void)
 {
+    errval_t err = SYS_ERR_OK;
+    thread_mutex_lock(&multiboot_strings_mutex);
     if (multiboot_strings == NULL) {
-        errval_t err;
-        /* Map in multiboot module strings area */
         struct capref mmstrings_cap = {
             .cnode = cnode_module,
             .slot = 0
         };
 
+        char *strings;
         err = paging_map_frame_attr(get_current_paging_state(),
-            (void **)&multiboot_strings, BASE_PAGE_SIZE, mmstrings_cap,
+            (void **)&strings, BASE_PAGE_SIZE, mmstrings_cap,
             VREGION_FLAGS_READ, NULL, NULL);
+        if (err_is_ok(err)) {
+            multiboot_strings = strings;
+        }
+    }
+    thread_mutex_unlock(&multiboot_strings_mutex);
+    return err;
+}
 
+/// Returns a raw pointer to the modules string area string
+const char *multiboot_module_rawstring(struct mem_region *region)
+{
+    if (multiboot_strings == NULL) {
+        errval_t err = multiboot_strings_map();
         if (err_is_fail(err)) {
             DEBUG_ERR(err, "vspace_map failed");
 	        return NULL;
@@ -65,10 +127,16 @@ const char *multiboot_module_rawstring(struct mem_region *region)
     return multiboot_strings + region->mrmod_data;
 }
 
-/// returns the basename without arguments of a multiboot module
-// XXX: returns pointer to static buffer. NOT THREAD SAFE
+/// returns the path without arguments of a multiboot module
+// XXX: for modules not covered by the module index, returns pointer to
+// static buffer. NOT THREAD SAFE
 const char *multiboot_module_name(struct mem_region *region)
 {
+    struct module_entry *entry = module_entry_of(region);
+    if (entry != NULL) {
+        return entry->name;
+    }
+
     const char *str = multiboot_module_rawstring(region);
     if (str == NULL) {
 	return NULL;
@@ -88,19 +156,222 @@ const char *multiboot_module_name(struct mem_region *region)
     return buf;
 }
 
+static const char *path_basename(const char *path)
+{
+    const char *base = strrchr(path, '/');
+    return base ? base + 1 : path;
+}
+
+/// Whether name matches path[0..len) as a suffix of whole path components
+static bool path_matches(const char *path, size_t len, const char *name,
+        size_t name_len)
+{
+    if (len < name_len
+            || strncmp(path + len - name_len, name, name_len) != 0) {
+        return false;
+    }
+    return len == name_len || name[0] == '/'
+            || path[len - name_len - 1] == '/';
+}
+
+/// Free what multiboot_index_build() got done before it failed
+static void multiboot_index_free(struct bootinfo *bi)
+{
+    if (module_entries != NULL) {
+        for (size_t i = 0; i < bi->regions_length; i++) {
+            free(module_entries[i].name);
+        }
+        free(module_entries);
+        module_entries = NULL;
+    }
+    if (module_index != NULL) {
+        hashtable_destroy(module_index);
+        module_index = NULL;
+    }
+}
+
+/// Parse all module lines of bi and index them by basename
+static errval_t multiboot_index_build(struct bootinfo *bi)
+{
+    errval_t err;
+
+    module_entries = calloc(bi->regions_length, sizeof(struct module_entry));
+    module_index = create_hashtable();
+    if (module_entries == NULL || module_index == NULL) {
+        err = LIB_ERR_MALLOC_FAIL;
+        goto out_free;
+    }
+
+    // Walk backwards so chains keep the regions' order.
+    for (size_t i = bi->regions_length; i-- > 0;) {
+        struct mem_region *region = &bi->regions[i];
+        if (region->mr_type != RegionType_Module) {
+            continue;
+        }
+        const char *str = multiboot_module_rawstring(region);
+        if (str == NULL) {
+            err = SPAWN_ERR_GET_CMDLINE_ARGS;
+            goto out_free;
+        }
+
+        struct module_entry *entry = &module_entries[i];
+        const char *args = strchr(str, ' ');
+        entry->region = region;
+        entry->name_len = args ? (size_t) (args - str) : strlen(str);
+        entry->name = strndup(str, entry->name_len);
+        if (entry->name == NULL) {
+            err = LIB_ERR_MALLOC_FAIL;
+            goto out_free;
+        }
+        entry->opts = module_opts_parse(region);
+
+        const char *base = path_basename(entry->name);
+        struct dictionary *d = &module_index->d;
+        void *head;
+        if (d->get(d, base, strlen(base), &head) == TYPE_WORD) {
+            d->remove(d, (char*) base, strlen(base));
+        }
+        entry->next = head;
+        if (d->put_word(d, base, strlen(base), (uintptr_t) entry) != 0) {
+            err = LIB_ERR_MALLOC_FAIL;
+            goto out_free;
+        }
+    }
+
+    return SYS_ERR_OK;
+
+out_free:
+    multiboot_index_free(bi);
+    return err;
+}
+
 struct mem_region *multiboot_find_module(struct bootinfo *bi, const char *name)
 {
     // printf("address of bootinfo: %p\n", bi);
+    // The index is published by a release store once it is complete, so
+    // whoever sees module_bi set also sees the index behind it.
+    struct bootinfo *indexed = __atomic_load_n(&module_bi, __ATOMIC_ACQUIRE);
+    if (indexed == NULL) {
+        thread_mutex_lock(&module_index_mutex);
+        indexed = module_bi;
+        if (indexed == NULL) {
+            errval_t err = multiboot_index_build(bi);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "building multiboot module index");
+            } else {
+                indexed = bi;
+                __atomic_store_n(&module_bi, bi, __ATOMIC_RELEASE);
+            }
+        }
+        thread_mutex_unlock(&module_index_mutex);
+    }
+
+    size_t name_len = strlen(name);
+    if (bi == indexed) {
+        const char *base = path_basename(name);
+        struct module_entry *entry;
+        module_index->d.get(&module_index->d, base, strlen(base),
+                (void**) &entry);
+        for (; entry != NULL; entry = entry->next) {
+            if (path_matches(entry->name, entry->name_len, name, name_len)) {
+                return entry->region;
+            }
+        }
+        return NULL;
+    }
+
     for(size_t i = 0; i < bi->regions_length; i++) {
         struct mem_region *region = &bi->regions[i];
-        assert(region != NULL);
-        const char *modname = multiboot_module_name(region);
-        if (modname != NULL &&
-            strncmp(modname + strlen(modname) - strlen(name),
-                    name, strlen(name)) == 0) {
+        if (region->mr_type != RegionType_Module) {
+            continue;
+        }
+        const char *str = multiboot_module_rawstring(region);
+        if (str == NULL) {
+            continue;
+        }
+        const char *args = strchr(str, ' ');
+        size_t len = args ? (size_t) (args - str) : strlen(str);
+        if (path_matches(str, len, name, name_len)) {
             return region;
         }
     }
 
     return NULL;
 }
+
+errval_t multiboot_module_map(struct mem_region *module, void **ret_vaddr,
+                              size_t *ret_bytes)
+{
+    assert(module != NULL);
+    assert(module->mr_type == RegionType_Module);
+
+    errval_t err = SYS_ERR_OK;
+    thread_mutex_lock(&module_mappings_mutex);
+
+    struct module_mapping *map = module_mappings;
+    while (map != NULL && map->module != module) {
+        map = map->next;
+    }
+
+    if (map == NULL) {
+        struct capref frame = {
+            .cnode = cnode_module,
+            .slot = module->mrmod_slot,
+        };
+        struct frame_identity id;
+        err = frame_identify(frame, &id);
+        if (err_is_fail(err)) {
+            goto out;
+        }
+
+        map = malloc(sizeof(*map));
+        if (map == NULL) {
+            err = LIB_ERR_MALLOC_FAIL;
+            goto out;
+        }
+        err = paging_map_frame_attr(get_current_paging_state(), &map->vaddr,
+                id.bytes, frame, VREGION_FLAGS_READ, NULL, NULL);
+        if (err_is_fail(err)) {
+            free(map);
+            goto out;
+        }
+        map->module = module;
+        map->bytes = id.bytes;
+        map->refcount = 0;
+        map->next = module_mappings;
+        module_mappings = map;
+    }
+
+    map->refcount++;
+    *ret_vaddr = map->vaddr;
+    if (ret_bytes != NULL) {
+        *ret_bytes = map->bytes;
+    }
+
+out:
+    thread_mutex_unlock(&module_mappings_mutex);
+    return err;
+}
+
+errval_t multiboot_module_unmap(struct mem_region *module)
+{
+    errval_t err = SYS_ERR_OK;
+    thread_mutex_lock(&module_mappings_mutex);
+
+    struct module_mapping **prev = &module_mappings;
+    while (*prev != NULL && (*prev)->module != module) {
+        prev = &(*prev)->next;
+    }
+
+    struct module_mapping *map = *prev;
+    if (map == NULL) {
+        err = LIB_ERR_VREGION_NOT_FOUND;
+    } else if (--map->refcount == 0) {
+        *prev = map->next;
+        err = paging_unmap(get_current_paging_state(), map->vaddr);
+        free(map);
+    }
+
+    thread_mutex_unlock(&module_mappings_mutex);
+    return err;
+}
@@ -9,6 +9,183 @@
 
 extern struct bootinfo *bi;
 
+/// A loaded ELF segment of a template, page-aligned in the child's vspace
+struct spawn_segment {
+    genvaddr_t base;
+    size_t bytes;
+    int flags;                  // VREGION flags to map the segment with
+    struct capref frame;        // Loaded contents, shared if read-only
+    void *image;                // frame in my vspace, writable data only
+};
+
+/**
+ * An ELF image loaded and relocated once, stamped out for every instance.
+ * Templates stay cached for as long as we run: children map the read-only
+ * frames directly, and deleting them would unmap their text.
+ */
+struct spawn_template {
+    struct spawn_template *next;
+    struct mem_region *module;
+    lvaddr_t elf_image;         // module mapping in my vspace, while loading
+    genvaddr_t entry_point;
+    genvaddr_t got_ubase;
+    // Pages of lazy_bss left for the child to fault in, empty if none.
+    genvaddr_t lazy_base;
+    genvaddr_t lazy_end;
+    size_t segment_count;
+    struct spawn_segment segments[SPAWN_TEMPLATE_SEGMENTS];
+};
+
+static struct spawn_template *templates = NULL;
+static struct thread_mutex templates_mutex = THREAD_MUTEX_INITIALIZER;
+
+static inline int elf_to_vregion_flags(uint32_t flags)
+{
+    return ((flags & PF_R) ? VREGION_FLAGS_READ : 0)
+            | ((flags & PF_W) ? VREGION_FLAGS_WRITE : 0)
+            | ((flags & PF_X) ? VREGION_FLAGS_EXECUTE : 0);
+}
+
+/**
+ * \brief Allocates the frame backing a segment at "base". Segments covering a
+ * whole, aligned megabyte get a 1MB-aligned frame, so that paging can map
+ * them with sections instead of L2 tables.
+ */
+static errval_t segment_frame_alloc(genvaddr_t base, size_t bytes,
+        struct capref *frame)
+{
+    size_t retsize;
+    if (LARGE_PAGE_OFFSET(base) == 0 && bytes >= LARGE_PAGE_SIZE) {
+        errval_t err = frame_alloc_aligned(frame, bytes, LARGE_PAGE_SIZE,
+                &retsize);
+        if (err_no(err) != LIB_ERR_RAM_ALLOC_MS_CONSTRAINTS) {
+            return err;
+        }
+        // No aligned block left, fall back to pages.
+    }
+    return frame_alloc(frame, bytes, &retsize);
+}
+
+static errval_t template_add_segment(struct spawn_template *tmpl,
+        genvaddr_t base, size_t bytes, int flags, bool zero_fill,
+        struct spawn_segment **ret)
+{
+    if (tmpl->segment_count == SPAWN_TEMPLATE_SEGMENTS) {
+        return SPAWN_ERR_ELF_MAP;
+    }
+    struct spawn_segment *seg = &tmpl->segments[tmpl->segment_count];
+    seg->base = base;
+    seg->bytes = bytes;
+    seg->flags = flags;
+    seg->frame = NULL_CAP;
+    seg->image = NULL;
+    if (!zero_fill) {
+        CHECK("elf section frame alloc",
+                segment_frame_alloc(base, bytes, &seg->frame));
+        errval_t err = paging_map_frame(get_current_paging_state(),
+                &seg->image, bytes, seg->frame, NULL, NULL);
+        if (err_is_fail(err)) {
+            cap_destroy(seg->frame);
+            seg->frame = NULL_CAP;
+            seg->image = NULL;
+            DEBUG_ERR(err, "map elf section to my vspace");
+            return err;
+        }
+    }
+    tmpl->segment_count++;
+    *ret = seg;
+    return SYS_ERR_OK;
+}
+
+/// Unmap a segment from my vspace and drop its frame.
+static void segment_release(struct spawn_segment *seg)
+{
+    if (seg->image) {
+        errval_t err = paging_unmap(get_current_paging_state(), seg->image);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "unmapping elf section");
+        }
+        seg->image = NULL;
+    }
+    if (!capref_is_null(seg->frame)) {
+        cap_destroy(seg->frame);
+        seg->frame = NULL_CAP;
+    }
+}
+
+/// Free a template that never made it into the cache.
+static void spawn_template_free(struct spawn_template *tmpl)
+{
+    for (size_t i = 0; i < tmpl->segment_count; ++i) {
+        segment_release(&tmpl->segments[i]);
+    }
+    free(tmpl);
+}
+
+static bool page_is_zero(const void *page)
+{
+    const uint32_t *word = page;
+    for (size_t i = 0; i < BASE_PAGE_SIZE / sizeof(*word); ++i) {
+        if (word[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * \brief Cut a loaded template down to what instances need from it.
+ *
+ * Read-only segments are mapped straight from their frames, so my mapping
+ * of them goes. Trailing pages of writable segments that are still zero
+ * after loading (.bss) become zero-fill, so only initialised data is kept.
+ */
+static errval_t spawn_template_trim(struct spawn_template *tmpl)
+{
+    size_t count = tmpl->segment_count;
+    for (size_t i = 0; i < count; ++i) {
+        struct spawn_segment *seg = &tmpl->segments[i];
+        if (!(seg->flags & VREGION_FLAGS_WRITE)) {
+            CHECK("unmap shared elf section",
+                    paging_unmap(get_current_paging_state(), seg->image));
+            seg->image = NULL;
+            continue;
+        }
+
+        size_t keep = seg->bytes;
+        while (keep > 0
+                && page_is_zero((char*) seg->image + keep - BASE_PAGE_SIZE)) {
+            keep -= BASE_PAGE_SIZE;
+        }
+        if (keep == seg->bytes) {
+            continue;
+        }
+        if (keep == 0) {
+            segment_release(seg);
+            continue;
+        }
+
+        struct spawn_segment *tail;
+        if (err_is_fail(template_add_segment(tmpl, seg->base + keep,
+                seg->bytes - keep, seg->flags, true, &tail))) {
+            // No room to split, keep the whole segment.
+            continue;
+        }
+        struct spawn_segment *head;
+        errval_t err = template_add_segment(tmpl, seg->base, keep, seg->flags,
+                false, &head);
+        if (err_is_fail(err)) {
+            tmpl->segment_count--;
+            continue;
+        }
+        memcpy(head->image, seg->image, keep);
+        segment_release(seg);
+        *seg = *head;
+        tmpl->segment_count--;
+    }
+    return SYS_ERR_OK;
+}
+
 // void setup_cspace(struct spawninfo *si) {
 //     errval_t err;
 //     err = cnode_create_l1(&(si->l1_cap), &(si->l1_cnoderef));
@@ -431,21 +608,96 @@ errval_t setup_vspace(struct spawninfo* si)
     return SYS_ERR_OK;
 }
 
-errval_t setup_elf(struct spawninfo* si, lvaddr_t vaddr, size_t bytes)
+/**
+ * \brief Map a template's segments into the child's vspace.
+ *
+ * Read-only segments are mapped directly, writable ones copied from the
+ * template and zero-fill ones backed by fresh (zeroed) frames. The pages of
+ * lazy_bss are only claimed, the child backs them on first touch.
+ */
+errval_t setup_elf(struct spawninfo* si, struct spawn_template* tmpl)
 {
-    CHECK("elf_load",
-            elf_load(EM_ARM,
-                    elf_alloc_section,
-                    (void*) si,
-                    vaddr,
-                    bytes,
-                    &si->entry_point));
-    struct Elf32_Shdr *got = elf32_find_section_header_name(
-            vaddr, bytes, ".got");
-    if (!got) {
-        return SPAWN_ERR_LOAD;
+    for (size_t i = 0; i < tmpl->segment_count; ++i) {
+        struct spawn_segment *seg = &tmpl->segments[i];
+        if (!(seg->flags & VREGION_FLAGS_WRITE)) {
+            CHECK("map shared elf section to child vspace",
+                    paging_map_fixed_attr(&si->pg_state, seg->base,
+                            seg->frame, seg->bytes, seg->flags));
+            continue;
+        }
+
+        struct capref frame;
+        CHECK("elf section frame alloc",
+                segment_frame_alloc(seg->base, seg->bytes, &frame));
+        CHECK("map elf section to child vspace",
+                paging_map_fixed_attr(&si->pg_state, seg->base, frame,
+                        seg->bytes, seg->flags));
+        if (seg->image) {
+            void *dest;
+            CHECK("map elf section to my vspace",
+                    paging_map_frame(get_current_paging_state(), &dest,
+                            seg->bytes, frame, NULL, NULL));
+            memcpy(dest, seg->image, seg->bytes);
+            CHECK("unmap elf section from my vspace",
+                    paging_unmap(get_current_paging_state(), dest));
+        }
+    }
+
+    // The child claims lazy_bss in its own paging_init(), keep the dispatcher
+    // and the arguments page out of it meanwhile.
+    if (tmpl->lazy_end > tmpl->lazy_base) {
+        CHECK("claim lazy_bss in child vspace",
+                paging_claim_fixed(&si->pg_state, tmpl->lazy_base,
+                        tmpl->lazy_end - tmpl->lazy_base));
+    }
+
+    si->entry_point = tmpl->entry_point;
+    si->got_ubase = tmpl->got_ubase;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Load a segment containing lazy_bss, leaving those pages out.
+ *
+ * The file-backed head is copied here and the zero-filled tail after
+ * lazy_bss recorded as zero-fill.
+ */
+static errval_t elf_alloc_lazy_section(struct spawn_template* tmpl,
+        genvaddr_t base, size_t bytes, uint32_t flags)
+{
+    struct Elf32_Ehdr *head = (struct Elf32_Ehdr*) tmpl->elf_image;
+    struct Elf32_Phdr *phead = (struct Elf32_Phdr*) (tmpl->elf_image
+            + head->e_phoff);
+    struct Elf32_Phdr *p = NULL;
+    for (size_t i = 0; i < head->e_phnum; ++i) {
+        if (phead[i].p_type == PT_LOAD && phead[i].p_vaddr == base) {
+            p = &phead[i];
+            break;
+        }
+    }
+    if (!p || p->p_vaddr + p->p_filesz > tmpl->lazy_base) {
+        return SPAWN_ERR_ELF_MAP;
+    }
+
+    genvaddr_t start = ROUND_DOWN(base, BASE_PAGE_SIZE);
+    genvaddr_t end = ROUND_UP(base + bytes, BASE_PAGE_SIZE);
+    int vflags = elf_to_vregion_flags(flags);
+    struct spawn_segment *seg;
+
+    if (tmpl->lazy_base > start) {
+        CHECK("elf section head",
+                template_add_segment(tmpl, start, tmpl->lazy_base - start,
+                        vflags, false, &seg));
+        memcpy(seg->image + (base - start),
+                (void*) (tmpl->elf_image + p->p_offset), p->p_filesz);
+    }
+
+    if (end > tmpl->lazy_end) {
+        CHECK("elf section tail",
+                template_add_segment(tmpl, tmpl->lazy_end,
+                        end - tmpl->lazy_end, vflags, true, &seg));
     }
-    si->got_ubase = got->sh_addr;
 
     return SYS_ERR_OK;
 }
@@ -453,32 +705,133 @@ errval_t setup_elf(struct spawninfo* si, lvaddr_t vaddr, size_t bytes)
 errval_t elf_alloc_section(void* state, genvaddr_t base, size_t bytes,
         uint32_t flags, void** ret)
 {
-    struct spawninfo* si = (struct spawninfo*) state;
+    struct spawn_template* tmpl = (struct spawn_template*) state;
+
+    if (tmpl->lazy_end > tmpl->lazy_base && base <= tmpl->lazy_base
+            && base + bytes >= tmpl->lazy_end) {
+        *ret = NULL;
+        return elf_alloc_lazy_section(tmpl, base, bytes, flags);
+    }
 
     // 1. Make sure base and size are properly alligned.
     size_t offset = BASE_PAGE_OFFSET(base);
     base -= offset;
     bytes = ROUND_UP(bytes + offset, BASE_PAGE_SIZE);
 
-    // 2. Allocate frame for current section.
-    struct capref frame;
-    size_t retsize;
-    CHECK("elf section frame alloc", frame_alloc(&frame, bytes, &retsize));
+    // 2. Allocate a frame and map it in my vspace, the children get theirs
+    //    in setup_elf().
+    struct spawn_segment *seg;
+    CHECK("elf section",
+            template_add_segment(tmpl, base, bytes,
+                    elf_to_vregion_flags(flags), false, &seg));
+    *ret = seg->image + offset;
 
-    // 3. Map in child's vspace @ given base.
-    CHECK("map elf section to child vspace",
-            paging_map_fixed_attr(&si->pg_state, base, frame, bytes, flags));
+    return SYS_ERR_OK;
+}
 
-    // 4. Map in my vspace, wherever there's free memory.
-    CHECK("map elf section to my vspace",
-            paging_map_frame(get_current_paging_state(),
-                    ret,
-                    bytes,
-                    frame,
-                    NULL, NULL));
-    *ret += offset;
+/// Load the ELF image of module, mapped at mapped_elf, into a new template.
+static errval_t spawn_template_load(struct mem_region *module,
+        lvaddr_t mapped_elf, size_t elf_bytes, struct spawn_template **ret)
+{
+    DPRINT("ELF header: %0x %c %c %c", ((char*)mapped_elf)[0], ((char*)mapped_elf)[1], ((char*)mapped_elf)[2], ((char*)mapped_elf)[3]);
+
+    // this gets checked twice (second time in elf_load)... so what :D
+    struct Elf32_Ehdr *elf_header = (void*)mapped_elf;
+    if (!IS_ELF(*elf_header)) {
+        DPRINT("Module %s is not an ELF executable",
+               multiboot_module_name(module));
+        return ELF_ERR_HEADER;
+    }
+
+    struct spawn_template *tmpl = calloc(1, sizeof(*tmpl));
+    if (!tmpl) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    tmpl->module = module;
+    tmpl->elf_image = mapped_elf;
+
+    // Pages wholly inside lazy_bss are populated by the child on first touch
+    // (see LAZY_BSS). Relocated binaries are always loaded eagerly.
+    struct Elf32_Shdr *shead = (struct Elf32_Shdr*) (mapped_elf
+            + elf_header->e_shoff);
+    struct Elf32_Shdr *lazy = elf32_find_section_header_name(
+            mapped_elf, elf_bytes, LAZY_BSS_SECTION);
+    if (lazy && lazy->sh_type == SHT_NOBITS
+            && !elf32_find_section_header_type(shead, elf_header->e_shnum,
+                    SHT_REL)) {
+        tmpl->lazy_base = ROUND_UP(lazy->sh_addr, BASE_PAGE_SIZE);
+        tmpl->lazy_end = ROUND_DOWN(lazy->sh_addr + lazy->sh_size,
+                BASE_PAGE_SIZE);
+    }
+
+    errval_t err = elf_load(EM_ARM, elf_alloc_section, (void*) tmpl,
+            mapped_elf, elf_bytes, &tmpl->entry_point);
+    if (err_is_ok(err)) {
+        err = spawn_template_trim(tmpl);
+    }
+    if (err_is_fail(err)) {
+        spawn_template_free(tmpl);
+        return err;
+    }
+
+    struct Elf32_Shdr *got = elf32_find_section_header_name(
+            mapped_elf, elf_bytes, ".got");
+    if (!got) {
+        spawn_template_free(tmpl);
+        return SPAWN_ERR_LOAD;
+    }
+    tmpl->got_ubase = got->sh_addr;
 
-    return SYS_ERR_OK; 
+    *ret = tmpl;
+    return SYS_ERR_OK;
+}
+
+/// Load the ELF image of module into a new template.
+static errval_t spawn_template_create(struct mem_region *module,
+        struct spawn_template **ret)
+{
+    // - Map multiboot module in your address space, only while loading it.
+    lvaddr_t mapped_elf;
+    size_t elf_bytes;
+    errval_t err = multiboot_module_map(module, (void**)&mapped_elf,
+            &elf_bytes);
+    if (err_is_fail(err)) {
+        return err_push(err, SPAWN_ERR_ELF_MAP);
+    }
+    err = spawn_template_load(module, mapped_elf, elf_bytes, ret);
+    errval_t unmap_err = multiboot_module_unmap(module);
+    if (err_is_ok(err) && err_is_fail(unmap_err)) {
+        DEBUG_ERR(unmap_err, "unmapping module");
+    }
+    return err;
+}
+
+errval_t spawn_template_get(const char *binary_name,
+        struct spawn_template **ret)
+{
+    struct mem_region *module = multiboot_find_module(bi, binary_name);
+    if (!module) {
+        DPRINT("Module %s not found", binary_name);
+        return SPAWN_ERR_FIND_MODULE;
+    }
+
+    errval_t err = SYS_ERR_OK;
+    thread_mutex_lock(&templates_mutex);
+    struct spawn_template *tmpl = templates;
+    while (tmpl && tmpl->module != module) {
+        tmpl = tmpl->next;
+    }
+    if (!tmpl) {
+        err = spawn_template_create(module, &tmpl);
+        if (err_is_ok(err)) {
+            tmpl->next = templates;
+            templates = tmpl;
+        }
+    }
+    thread_mutex_unlock(&templates_mutex);
+
+    *ret = tmpl;
+    return err;
 }
 
 errval_t setup_dispatcher(struct spawninfo* si, coreid_t core_id)
@@ -741,64 +1094,187 @@ errval_t setup_args_extra(struct spawninfo* si, struct mem_region* mr, char* ext
     return SYS_ERR_OK;
 }
 
-// TODO(M2): Implement this function such that it starts a new process
-// TODO(M4): Build and pass a messaging channel to your child process
-errval_t spawn_load_by_name(void * binary_name, struct spawninfo * si,
-        coreid_t core_id)
+/**
+ * \brief Checks a client-built argument block and returns the number of
+ * environment strings in it, and optionally how many bytes it really uses.
+ *
+ * argv and envp entries hold offsets from the start of the block; each must
+ * point past the parameter block at a string terminated inside the block.
+ */
+static errval_t args_frame_check(struct spawn_domain_params* params,
+        size_t bytes, size_t* envc, size_t* used)
 {
+    if (bytes < sizeof(struct spawn_domain_params)) {
+        return SPAWN_ERR_GET_CMDLINE_ARGS;
+    }
+    if (params->argc <= 0 || params->argc > MAX_CMDLINE_ARGS
+            || params->argv[params->argc] != NULL) {
+        return SPAWN_ERR_GET_CMDLINE_ARGS;
+    }
+    char* base = (char*) params;
+    size_t end = sizeof(struct spawn_domain_params);
+    for (int i = 0; i < params->argc; ++i) {
+        lvaddr_t offset = (lvaddr_t) params->argv[i];
+        char* nul;
+        if (offset < sizeof(struct spawn_domain_params) || offset >= bytes
+                || (nul = memchr(base + offset, '\0', bytes - offset)) == NULL) {
+            return SPAWN_ERR_GET_CMDLINE_ARGS;
+        }
+        end = MAX(end, (size_t) (nul - base) + 1);
+    }
 
-    DPRINT("loading and starting: %s", binary_name);
+    size_t n = 0;
+    while (params->envp[n] != NULL) {
+        lvaddr_t offset = (lvaddr_t) params->envp[n];
+        char* nul;
+        if (offset < sizeof(struct spawn_domain_params) || offset >= bytes
+                || (nul = memchr(base + offset, '\0', bytes - offset)) == NULL) {
+            return SPAWN_ERR_SETUP_ENV;
+        }
+        end = MAX(end, (size_t) (nul - base) + 1);
+        if (++n > MAX_ENVIRON_VARS) {
+            return SPAWN_ERR_ARGSPG_OVERFLOW;
+        }
+    }
+    *envc = n;
+    if (used != NULL) {
+        *used = end;
+    }
 
-    // Init spawninfo
-    memset(si, 0, sizeof(*si));
-    si->binary_name = binary_name;
+    return SYS_ERR_OK;
+}
 
-    // - Get the binary from multiboot image
+errval_t spawn_args_copy(const void* src, size_t bytes,
+        struct spawn_args* args)
+{
+    args->frame = NULL_CAP;
+    args->params = NULL;
+    if (bytes < sizeof(struct spawn_domain_params)) {
+        return SPAWN_ERR_GET_CMDLINE_ARGS;
+    }
 
-    struct mem_region *module = multiboot_find_module(bi, binary_name);
-    if (!module) {
-        DPRINT("Module %s not found", binary_name);
-        return SPAWN_ERR_FIND_MODULE;
+    // 1. A fresh frame for the child's arguments page, the only copy made.
+    struct capref frame;
+    size_t retsize;
+    CHECK("args frame_alloc", frame_alloc(&frame, bytes, &retsize));
+    void* buf;
+    errval_t err = paging_map_frame(get_current_paging_state(), &buf, retsize,
+            frame, NULL, NULL);
+    if (err_is_fail(err)) {
+        cap_destroy(frame);
+        return err;
+    }
+    args->frame = frame;
+    args->params = (struct spawn_domain_params*) buf;
+    memcpy(buf, src, bytes);
+
+    // 2. The client cannot touch this copy, so check it here.
+    err = args_frame_check(args->params, bytes, &args->envc, &args->bytes);
+    if (err_is_fail(err)) {
+        spawn_args_free(args);
+        return err;
     }
 
-    struct capref child_frame = {
-        .cnode = cnode_module,
-        .slot = module->mrmod_slot,
-    };
+    return SYS_ERR_OK;
+}
+
+void spawn_args_free(struct spawn_args* args)
+{
+    if (args->params != NULL) {
+        errval_t err = paging_unmap(get_current_paging_state(),
+                args->params);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "unmapping args frame");
+        }
+        args->params = NULL;
+    }
+    if (!capref_is_null(args->frame)) {
+        cap_destroy(args->frame);
+        args->frame = NULL_CAP;
+    }
+}
 
-    // - Map multiboot module in your address space
-    struct frame_identity child_frame_id;
-    CHECK("identifying frame",
-          frame_identify(child_frame, &child_frame_id));
+errval_t setup_args_frame(struct spawninfo* si, struct spawn_args* args)
+{
+    // 1. Args into child's cspace.
+    struct capref frame_child = {
+        .cnode = si->l2_cnodes[ROOTCN_SLOT_TASKCN],
+        .slot = TASKCN_SLOT_ARGSPAGE
+    };
+    CHECK("copy args to child cspace", cap_copy(frame_child, args->frame));
 
-    lvaddr_t mapped_elf;
-    CHECK("mapping frame",
-          paging_map_frame(get_current_paging_state(), (void**)&mapped_elf,
-                           child_frame_id.bytes, child_frame, NULL, NULL));
-    DPRINT("ELF header: %0x %c %c %c", ((char*)mapped_elf)[0], ((char*)mapped_elf)[1], ((char*)mapped_elf)[2], ((char*)mapped_elf)[3]);
+    // 2. Args into child's vspace.
+    struct frame_identity fi;
+    CHECK("identifying args frame", frame_identify(args->frame, &fi));
+    void* args_vaddr_child;
+    CHECK("args to child's vspace",
+            paging_map_frame(&si->pg_state,
+                    &args_vaddr_child,
+                    fi.bytes,
+                    args->frame,
+                    NULL, NULL));
 
-    // this gets checked twice (second time in elf_load)... so what :D
-    struct Elf32_Ehdr *elf_header = (void*)mapped_elf;
-    if (!IS_ELF(*elf_header)) {
-        DPRINT("Module %s is not an ELF executable", binary_name);
-        return ELF_ERR_HEADER;
+    // 3. Turn the block's offsets into pointers in the child's vspace.
+    struct spawn_domain_params* child_params = args->params;
+    lvaddr_t base_addr_child = (lvaddr_t) args_vaddr_child;
+    for (int i = 0; i < child_params->argc; ++i) {
+        child_params->argv[i] = (const char*) (base_addr_child
+                + (lvaddr_t) child_params->argv[i]);
+    }
+    for (size_t i = 0; i < args->envc; ++i) {
+        child_params->envp[i] = (char*) (base_addr_child
+                + (lvaddr_t) child_params->envp[i]);
     }
 
+    // 4. Everything else defaults to 0.
+    child_params->vspace_buf = NULL;
+    child_params->vspace_buf_len = 0;
+    child_params->tls_init_base = NULL;
+    child_params->tls_init_len = 0;
+    child_params->tls_total_len = 0;
+    child_params->pagesize = 0;
+
+    // The child has the block now, it is not ours to free anymore.
+    CHECK("unmap args from my vspace",
+            paging_unmap(get_current_paging_state(), args->params));
+    args->params = NULL;
+    args->frame = NULL_CAP;
+
+    // 5. Complete the address of child's dispatcher.
+    si->enabled_area->named.r0 = (uint32_t) args_vaddr_child;
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Builds everything but the arguments page of a new instance.
+ */
+static errval_t spawn_clone_image(struct spawn_template *tmpl,
+        struct spawninfo *si, coreid_t core_id)
+{
     // - Setup child's cspace.
     CHECK("setup_cspace", setup_cspace(si));
 
     // - Setup child's vspace.
     CHECK("setup_vspace", setup_vspace(si));
 
-    // - Load the ELF binary.
-    CHECK("setup_elf", setup_elf(si, mapped_elf, child_frame_id.bytes));
+    // - Map the loaded ELF image.
+    CHECK("setup_elf", setup_elf(si, tmpl));
 
     // - Setup dispatcher.
     CHECK("setup_dispatcher", setup_dispatcher(si, core_id));
 
-    // - Setup environment
-    // get arguments from menu.lst
-    CHECK("setup_args", setup_args(si, module));
+    return SYS_ERR_OK;
+}
+
+static errval_t spawn_run(struct spawninfo *si)
+{
+    // - The dispatcher is filled in, drop my mapping of it
+    CHECK("unmap dispatcher from my vspace",
+            paging_unmap(get_current_paging_state(),
+                    (void*) si->disp_handle));
+    si->disp_handle = 0;
+    si->enabled_area = NULL;
 
     // - Make dispatcher runnable
     struct capref dispatcher_frame_child = {
@@ -813,6 +1289,26 @@ errval_t spawn_load_by_name(void * binary_name, struct spawninfo * si,
     return SYS_ERR_OK;
 }
 
+errval_t spawn_clone_template(struct spawn_template *tmpl,
+        struct spawninfo *si, coreid_t core_id, char *extra_args)
+{
+    CHECK("spawn_clone_image", spawn_clone_image(tmpl, si, core_id));
+
+    // - Setup environment
+    // get arguments from menu.lst
+    CHECK("setup_args", setup_args_extra(si, tmpl->module, extra_args));
+
+    return spawn_run(si);
+}
+
+// TODO(M2): Implement this function such that it starts a new process
+// TODO(M4): Build and pass a messaging channel to your child process
+errval_t spawn_load_by_name(void * binary_name, struct spawninfo * si,
+        coreid_t core_id)
+{
+    return spawn_load_by_name_args(binary_name, si, core_id, NULL);
+}
+
 errval_t spawn_load_by_name_args(void * binary_name, struct spawninfo * si,
         coreid_t core_id, char* extra_args)
 {
@@ -823,62 +1319,36 @@ errval_t spawn_load_by_name_args(void * binary_name, struct spawninfo * si,
     memset(si, 0, sizeof(*si));
     si->binary_name = binary_name;
 
-    // - Get the binary from multiboot image
-
-    struct mem_region *module = multiboot_find_module(bi, binary_name);
-    if (!module) {
-        DPRINT("Module %s not found", binary_name);
-        return SPAWN_ERR_FIND_MODULE;
-    }
-
-    struct capref child_frame = {
-        .cnode = cnode_module,
-        .slot = module->mrmod_slot,
-    };
+    // - Get the loaded binary, loading it from the multiboot image once.
+    struct spawn_template *tmpl;
+    CHECK("spawn_template_get", spawn_template_get(binary_name, &tmpl));
+    si->module = tmpl->module;
 
-    // - Map multiboot module in your address space
-    struct frame_identity child_frame_id;
-    CHECK("identifying frame",
-          frame_identify(child_frame, &child_frame_id));
+    return spawn_clone_template(tmpl, si, core_id, extra_args);
+}
 
-    lvaddr_t mapped_elf;
-    CHECK("mapping frame",
-          paging_map_frame(get_current_paging_state(), (void**)&mapped_elf,
-                           child_frame_id.bytes, child_frame, NULL, NULL));
-    DPRINT("ELF header: %0x %c %c %c", ((char*)mapped_elf)[0], ((char*)mapped_elf)[1], ((char*)mapped_elf)[2], ((char*)mapped_elf)[3]);
+errval_t spawn_load_args(struct spawn_args* args, struct spawninfo * si,
+        coreid_t core_id)
+{
+    // Init spawninfo
+    memset(si, 0, sizeof(*si));
 
-    // this gets checked twice (second time in elf_load)... so what :D
-    struct Elf32_Ehdr *elf_header = (void*)mapped_elf;
-    if (!IS_ELF(*elf_header)) {
-        DPRINT("Module %s is not an ELF executable", binary_name);
-        return ELF_ERR_HEADER;
+    // The block was checked when it was copied, argv[0] is still an offset.
+    si->binary_name = strdup((char*) args->params
+            + (lvaddr_t) args->params->argv[0]);
+    if (si->binary_name == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
     }
 
-    // - Setup child's cspace.
-    CHECK("setup_cspace", setup_cspace(si));
+    DPRINT("loading and starting: %s", si->binary_name);
 
-    // - Setup child's vspace.
-    CHECK("setup_vspace", setup_vspace(si));
+    // - Get the loaded binary, loading it from the multiboot image once.
+    struct spawn_template *tmpl;
+    CHECK("spawn_template_get", spawn_template_get(si->binary_name, &tmpl));
+    si->module = tmpl->module;
 
-    // - Load the ELF binary.
-    CHECK("setup_elf", setup_elf(si, mapped_elf, child_frame_id.bytes));
-
-    // - Setup dispatcher.
-    CHECK("setup_dispatcher", setup_dispatcher(si, core_id));
+    CHECK("spawn_clone_image", spawn_clone_image(tmpl, si, core_id));
+    CHECK("setup_args_frame", setup_args_frame(si, args));
 
-    // - Setup environment
-    // get arguments from menu.lst
-    CHECK("setup_args", setup_args_extra(si, module, extra_args));
-
-    // - Make dispatcher runnable
-    struct capref dispatcher_frame_child = {
-        .cnode = si->l2_cnodes[ROOTCN_SLOT_TASKCN],
-        .slot = TASKCN_SLOT_DISPFRAME
-    };
-    CHECK("invoking dispatcher",
-          invoke_dispatcher(si->dispatcher, cap_dispatcher,
-          si->l1_cnode_cap, si->l1_pagetable_child,
-          dispatcher_frame_child, true));
-
-    return SYS_ERR_OK;
+    return spawn_run(si);
 }
@@ -355,20 +355,75 @@ static errval_t private_cd(char *name)
 	return SYS_ERR_OK;
 }
 
+// Maps the whole of an open file read-only, so it can be scanned in place
+// instead of being copied out through fgetc. Mounts that cannot map files get
+// it read into a heap buffer instead; *mapped says which to undo. Empty files
+// yield a NULL buffer.
+static errval_t map_file(FILE *fp, const char **buf, size_t *size, bool *mapped)
+{
+	fseek(fp, 0, SEEK_END);
+	long end = ftell(fp);
+	rewind(fp);
+	if(end < 0) {
+		return FS_ERR_READ;
+	}
+
+	*size = end;
+	*buf = NULL;
+	*mapped = false;
+	if(*size == 0) {
+		return SYS_ERR_OK;
+	}
+	errval_t err = fs_mmap(fileno(fp), 0, *size, VREGION_FLAGS_READ,
+			(void **)buf);
+	if(err_is_ok(err)) {
+		*mapped = true;
+		return SYS_ERR_OK;
+	}
+	if(err_no(err) != VFS_ERR_NOT_SUPPORTED) {
+		return err;
+	}
+
+	char *copy = malloc(*size);
+	if(copy == NULL) {
+		return LIB_ERR_MALLOC_FAIL;
+	}
+	*size = fread(copy, 1, *size, fp);
+	if(ferror(fp)) {
+		free(copy);
+		return FS_ERR_READ;
+	}
+	*buf = copy;
+	return SYS_ERR_OK;
+}
+
+static void unmap_file(const char *buf, bool mapped)
+{
+	if(mapped) {
+		fs_munmap((void *)buf);
+	} else {
+		free((void *)buf);
+	}
+}
+
 errval_t handle_cat(char *argc[], int argv)
 {
 	FILE *fp;
-	int c = 0;
 	fp = fopen(argc[1], "r");
 	if(fp == NULL) {
 		printf("No file named %s\n", argc[1]);
 		return BASH_ERR_FILE_NOT_FOUND;
 	}
-	while ((c = fgetc(fp)) != EOF) { 
-		SHELL_PRINTF(fout, "%c", c);
+	const char *buf;
+	size_t size;
+	bool mapped;
+	errval_t err = map_file(fp, &buf, &size, &mapped);
+	if(err_is_ok(err)) {
+		fwrite(buf, 1, size, fout);
+		unmap_file(buf, mapped);
 	}
 	fclose(fp);
-	return SYS_ERR_OK;
+	return err;
 }
 
 errval_t handle_wc(char *argc[], int argv)
@@ -383,13 +438,22 @@ errval_t handle_wc(char *argc[], int argv)
 		printf("No file named %s\n", argc[1]);
 		return BASH_ERR_FILE_NOT_FOUND;
 	}
+	const char *buf;
+	size_t size;
+	bool mapped;
+	errval_t err = map_file(fp, &buf, &size, &mapped);
+	if(err_is_fail(err)) {
+		fclose(fp);
+		return err;
+	}
 	int tot_chars = 0;     /* total characters */
 	int tot_lines = 0;     /* total lines */
 	int tot_words = 0;     /* total words */
 	int in_space = 1;
 	int c, last = '\n';
 
-	while ((c = fgetc(fp)) != EOF) {
+	for (size_t i = 0; i < size; i++) {
+		c = (unsigned char)buf[i];
 		last = c;
 		tot_chars++;
 		if (is_space(c)) {
@@ -409,6 +473,7 @@ errval_t handle_wc(char *argc[], int argv)
 
 	SHELL_PRINTF(fout, "Lines, Words, Characters\n");
 	SHELL_PRINTF(fout, "%3d    %3d     %3d\n", tot_lines, tot_words, tot_chars);
+	unmap_file(buf, mapped);
 	fclose(fp);
 	return SYS_ERR_OK;
 }
@@ -422,10 +487,20 @@ int grep(char *regexp, FILE *f, char *name)
 {
 	int n, nmatch;
 	char buf[1024];
+	const char *data;
+	size_t size;
+	bool mapped;
+
+	if (err_is_fail(map_file(f, &data, &size, &mapped)))
+		return 0;
 
 	nmatch = 0;
-	while (fgets(buf, sizeof buf, f) != NULL) {
-		n = strlen(buf);
+	for (size_t pos = 0; pos < size; pos += n) {
+		/* same 1023-byte line chunks as fgets, cut from the mapping */
+		const char *nl = memchr(data + pos, '\n', size - pos);
+		n = MIN((nl ? nl + 1 - data : size) - pos, sizeof buf - 1);
+		memcpy(buf, data + pos, n);
+		buf[n] = '\0';
 		if (n > 0 && buf[n-1] == '\n')
 			buf[n-1] = '\0';
 		if (match(regexp, buf)) {
@@ -435,6 +510,7 @@ int grep(char *regexp, FILE *f, char *name)
 			SHELL_PRINTF(fout, "%s\n", buf);
 		}
 	}
+	unmap_file(data, mapped);
 	return nmatch;
 }
 
@@ -514,34 +590,35 @@ errval_t handle_grep(char *argc[], int argv)
 	return SYS_ERR_OK;
 }
 
+// Spawns from a prebuilt args frame, so the whole argument vector travels as
+// one cap instead of 24-byte messages.
+static errval_t spawn_with_frame(char *argc[], int argv, coreid_t core,
+		domainid_t *newpid)
+{
+	struct capref frame;
+	errval_t err = aos_rpc_args_frame_create(argv, argc, NULL, &frame);
+	if(err_is_fail(err)) {
+		return err;
+	}
+	err = aos_rpc_process_spawn_frame(get_init_rpc(), frame, core, newpid);
+	if(err_is_fail(err)) {
+		cap_destroy(frame);
+	}
+	return err;
+}
+
 errval_t handle_oncore(char *argc[], int argv)
 {
 	domainid_t newpid;
 	if(argv <= 2) {
 		printf("Correct Syntax for oncore is oncore <coreid> <proc_name> <proc_args>\n");
 		return BASH_ERR_SYNTAX;
-	}else if(argv == 3) {
-		coreid_t core = atoi(argc[1]);
-		CHECK("Trying to spawn with arguments",
-			aos_rpc_process_spawn(get_init_rpc(), argc[2], core, &newpid));
-	}else {
-		coreid_t core = atoi(argc[1]);
-		uint32_t all_args = 0;
-		for(int i=2; i<argv; i++) {
-			all_args += strlen(argc[i]);
-		}
-		char *proc_name = malloc(all_args+(argv-1));
-		memset(proc_name, 0, all_args+(argv-1));
-		strncpy(proc_name, argc[2], strlen(argc[2]));
-		strcat(proc_name, " ");
-		for(int i=3; i<argv; i++) {
-			strcat(proc_name, argc[i]);
-			strcat(proc_name, " ");
-		}
-
-		CHECK("Trying to spawn with arguments",
-			aos_rpc_process_spawn_args(get_init_rpc(), proc_name, core, &newpid));
-		free(proc_name);
+	}
+	coreid_t core = atoi(argc[1]);
+	errval_t err = spawn_with_frame(argc + 2, argv - 2, core, &newpid);
+	if(err_is_fail(err)) {
+		DEBUG_ERR(err, "Trying to spawn with arguments");
+		return err;
 	}
 	return SYS_ERR_OK;
 }
@@ -549,28 +626,10 @@ errval_t handle_oncore(char *argc[], int argv)
 errval_t handle_spawn(char *argc[], int argv)
 {
 	domainid_t newpid;
-	if(argv == 1) {
-		coreid_t core = 0;
-		CHECK("Trying to spawn with arguments",
-			aos_rpc_process_spawn(get_init_rpc(), argc[0], core, &newpid));
-	}else {
-		coreid_t core = 0;
-		uint32_t all_args = 0;
-		for(int i=1; i<argv; i++) {
-			all_args += strlen(argc[i]);
-		}
-		char *proc_name = malloc(all_args+(argv-1));
-		memset(proc_name, 0, all_args+(argv-1));
-		strncpy(proc_name, argc[0], strlen(argc[0]));
-		strcat(proc_name, " ");
-		for(int i=1; i<argv; i++) {
-			strcat(proc_name, argc[i]);
-			strcat(proc_name, " ");
-		}
-
-		CHECK("Trying to spawn with arguments",
-			aos_rpc_process_spawn_args(get_init_rpc(), proc_name, core, &newpid));
-		free(proc_name);
+	errval_t err = spawn_with_frame(argc, argv, 0, &newpid);
+	if(err_is_fail(err)) {
+		DEBUG_ERR(err, "Trying to spawn with arguments");
+		return err;
 	}
 	return SYS_ERR_OK;
 }
@@ -12,12 +12,19 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <aos/aos_rpc.h>
 #include <driverkit/driverkit.h>
 #include "mmchs.h"
 
 int main(int argc, char **argv)
 {
+    // "mmchs ramdisk" serves a RAM disk instead, for machines without a card
+    if (argc > 1 && strcmp(argv[1], "ramdisk") == 0) {
+        init_service(true);
+        return 0;
+    }
+
     cm2_init();
     ti_twl6030_init();
     ctrlmod_init();
@@ -26,7 +33,7 @@ int main(int argc, char **argv)
 
     mmchs_init();
 
-    init_service();
+    init_service(false);
 
     return 0;
 }
@@ -12,6 +12,7 @@
  */
 
 #include <aos/aos.h>
+#include <aos/aos_rpc.h>
 #include <aos/inthandler.h>
 #include <omap44xx_map.h>
 #include <driverkit/driverkit.h>
@@ -26,6 +27,40 @@ static char dbuf[DBUF_SIZE];
 
 static omap44xx_mmchs1_t mmchs;
 
+/// Interrupt of MMC1, see TRM rev Z, Table 17-2
+#define MMCHS_IRQ           (32 + 83)
+
+/// Register polls before falling back to waiting in between
+#define MMCHS_SPIN          10000
+
+/// Bytes moved by one ADMA2 descriptor at most, below its 16-bit length limit
+#define ADMA_DESC_BYTES     (32 * 1024)
+#define ADMA_ATTR_VALID     (1 << 0)
+#define ADMA_ATTR_END       (1 << 1)
+#define ADMA_ATTR_TRAN      (2 << 4)
+
+/**
+ * \brief ADMA2 descriptor, see SD Host Controller Simplified Spec 3.00,
+ * Section 1.13.
+ */
+struct adma_desc {
+    uint16_t attr;
+    uint16_t length;
+    uint32_t address;
+};
+
+STATIC_ASSERT(MMCHS_MAX_BLOCKS * MMCHS_BLOCK_SIZE / ADMA_DESC_BYTES
+                * sizeof(struct adma_desc) <= BASE_PAGE_SIZE,
+              "ADMA descriptors of a transfer must fit in one page");
+
+/// ADMA2 descriptor table, mapped uncached as the controller reads it
+static volatile struct adma_desc *adma_table;
+static genpaddr_t adma_table_base;
+static bool dma_available;
+
+/// Capacity of the card in blocks, from its CSD register
+static size_t card_blocks;
+
 static void mmchs_soft_reset(void)
 {
     MMCHS_DEBUG("%s:%d\n", __FUNCTION__, __LINE__);
@@ -137,7 +172,8 @@ static void wait_msec(long msec)
 /**
  * \see TRM rev Z, Section 24.5.1.2.1.7.1
  */
-static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
+static void send_command_blocks(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg,
+                                size_t nblk, bool dma)
 {
     MMCHS_DEBUG("%s:%d: cmd = 0x%x arg=0x%x\n", __FUNCTION__, __LINE__, cmd, arg);
 
@@ -154,7 +190,7 @@ static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
     omap44xx_mmchs1_mmchs_csre_rawwr(&mmchs, 0x0);
 
     omap44xx_mmchs1_mmchs_blk_blen_wrf(&mmchs, 512);
-    omap44xx_mmchs1_mmchs_blk_nblk_wrf(&mmchs, 0x1);
+    omap44xx_mmchs1_mmchs_blk_nblk_wrf(&mmchs, nblk);
 
     omap44xx_mmchs1_mmchs_sysctl_dto_wrf(&mmchs, 0xE); // omapconf
 
@@ -166,6 +202,12 @@ static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
 
     omap44xx_mmchs1_mmchs_cmd_t cmdreg = omap44xx_mmchs1_mmchs_cmd_default;
 
+    if (cmd == omap44xx_mmchs1_INDX_18 || cmd == omap44xx_mmchs1_INDX_25) {
+        cmdreg = omap44xx_mmchs1_mmchs_cmd_msbs_insert(cmdreg, 0x1);
+        cmdreg = omap44xx_mmchs1_mmchs_cmd_bce_insert(cmdreg, 0x1);
+    }
+    cmdreg = omap44xx_mmchs1_mmchs_cmd_de_insert(cmdreg, dma);
+
     // see TRM rev Z, Table 24-4
     // and Physical Layer Simplified Spec 3.01, Section 4.7.4
     switch (cmd) {
@@ -177,8 +219,10 @@ static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
         break;
         // R1, R6, R5, R7
     case omap44xx_mmchs1_INDX_17:
+    case omap44xx_mmchs1_INDX_18:
         cmdreg = omap44xx_mmchs1_mmchs_cmd_ddir_insert(cmdreg, 0x1);
     case omap44xx_mmchs1_INDX_24:
+    case omap44xx_mmchs1_INDX_25:
         cmdreg = omap44xx_mmchs1_mmchs_cmd_dp_insert(cmdreg, 0x1);
         cmdreg = omap44xx_mmchs1_mmchs_cmd_acen_insert(cmdreg, 0x1);
         // Fallthrough desired!
@@ -227,12 +271,15 @@ static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
             return;
         }
 
-        if (i++ > 1000) {
+        if (i++ > MMCHS_SPIN + 1000) {
             omap44xx_mmchs1_mmchs_stat_pr(dbuf, DBUF_SIZE, &mmchs);
             MMCHS_DEBUG("%s:%d: %s\n", __FUNCTION__, __LINE__, dbuf);
             USER_PANIC("Command not Ackd?");
         }
-        wait_msec(1);
+        // commands complete within microseconds
+        if (i > MMCHS_SPIN) {
+            wait_msec(1);
+        }
     } while (cc != 0x1);
 
 
@@ -255,6 +302,37 @@ static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
     }
 }
 
+static void send_command(omap44xx_mmchs1_indx_status_t cmd, uint32_t arg)
+{
+    send_command_blocks(cmd, arg, 1, false);
+}
+
+
+/**
+ * \brief Computes the capacity of the card from the CSD in the response
+ * registers, after CMD9.
+ *
+ * \see Physical Layer Simplified Spec 3.01, Sections 5.3.2 and 5.3.3
+ */
+static size_t csd_card_blocks(void)
+{
+    uint32_t rsp32 = omap44xx_mmchs1_mmchs_rsp32_rd(&mmchs);
+    uint32_t rsp54 = omap44xx_mmchs1_mmchs_rsp54_rd(&mmchs);
+    uint32_t rsp76 = omap44xx_mmchs1_mmchs_rsp76_rd(&mmchs);
+
+    if ((rsp76 >> 30) == 0x1) {
+        // CSD version 2.0: C_SIZE in bits [69:48], units of 512KB
+        uint32_t c_size = (rsp32 >> 16) | ((rsp54 & 0x3f) << 16);
+        return ((size_t)c_size + 1) * 1024;
+    }
+
+    // CSD version 1.0: C_SIZE in [73:62], C_SIZE_MULT in [49:47],
+    // READ_BL_LEN in [83:80]
+    uint32_t c_size = (rsp32 >> 30) | ((rsp54 & 0x3ff) << 2);
+    uint32_t c_size_mult = (rsp32 >> 15) & 0x7;
+    uint32_t read_bl_len = (rsp54 >> 16) & 0xf;
+    return ((size_t)c_size + 1) << (c_size_mult + 2 + read_bl_len - 9);
+}
 
 /**
  * \see TRM rev Z, Figure 24-38
@@ -311,6 +389,8 @@ static void mmchs_identify_card(void)
 
     MMCHS_DEBUG("%s:%d: CMD9\n", __FUNCTION__, __LINE__);
     send_command(9, rca << 16);
+    card_blocks = csd_card_blocks();
+    MMCHS_DEBUG("Card blocks: %zu\n", card_blocks);
 
     MMCHS_DEBUG("%s:%d: CMD7\n", __FUNCTION__, __LINE__);
     send_command(7, rca << 16);
@@ -319,67 +399,206 @@ static void mmchs_identify_card(void)
     send_command(16, 512);
 }
 
+/**
+ * \brief Acknowledges the status bits set in stat.
+ */
+static void ack_status(omap44xx_mmchs1_mmchs_stat_t stat)
+{
+    // status bits are cleared by writing ones
+    omap44xx_mmchs1_mmchs_stat_wr(&mmchs, stat);
+}
+
+/**
+ * \brief Checks whether the current data transfer has finished.
+ *
+ * \retval true with *reterr set if it has, false if it is still running.
+ */
+static bool check_card_transaction(errval_t *reterr)
+{
+    omap44xx_mmchs1_mmchs_stat_t stat = omap44xx_mmchs1_mmchs_stat_rd(&mmchs);
+
+    bool deb = omap44xx_mmchs1_mmchs_stat_deb_extract(stat);
+    bool dcrc = omap44xx_mmchs1_mmchs_stat_dcrc_extract(stat);
+    bool dto = omap44xx_mmchs1_mmchs_stat_dto_extract(stat);
+    bool admae = omap44xx_mmchs1_mmchs_stat_admae_extract(stat);
+    if (deb || dcrc || dto || admae) {
+        MMCHS_DEBUG("%s:%d: Error interrupt during transfer: deb=%d dcrc=%d dto=%d admae=%d.\n",
+                    __FUNCTION__, __LINE__, deb, dcrc, dto, admae);
+        ack_status(stat);
+        dat_line_reset();
+        *reterr = MMC_ERR_TRANSFER;
+        return true;
+    }
+
+    if (omap44xx_mmchs1_mmchs_stat_tc_extract(stat)) {
+        // auto CMD12 ends multi-block transfers before this is set
+        ack_status(stat);
+        *reterr = SYS_ERR_OK;
+        return true;
+    }
+
+    return false;
+}
+
 static errval_t complete_card_transaction(void)
 {
     size_t i = 0;
     do {
-        if ( omap44xx_mmchs1_mmchs_stat_tc_rdf(&mmchs) == 0x1 )  {
-            //send_command(12, 0);
-            return SYS_ERR_OK; // Fine as long as we support only finite transfers
-        } else {
-            bool deb = omap44xx_mmchs1_mmchs_stat_deb_rdf(&mmchs);
-            bool dcrc = omap44xx_mmchs1_mmchs_stat_dcrc_rdf(&mmchs);
-            bool dto = omap44xx_mmchs1_mmchs_stat_dto_rdf(&mmchs);
-
-            if (deb || dcrc || dto) {
-                MMCHS_DEBUG("%s:%d: Error interrupt during transfer: deb=%d dcrc=%d dto=%d.\n",
-                            __FUNCTION__, __LINE__, deb, dcrc, dto);
-                dat_line_reset();
-                return MMC_ERR_TRANSFER;
-            }
+        errval_t err;
+        if (check_card_transaction(&err)) {
+            return err;
         }
 
-        wait_msec(10);
-    } while (i++ < 1000);
+        if (i > MMCHS_SPIN) {
+            wait_msec(10);
+        }
+    } while (i++ < MMCHS_SPIN + 1000);
 
     MMCHS_DEBUG("%s:%d: No transfer complete interrupt?\n", __FUNCTION__, __LINE__);
     return MMC_ERR_TRANSFER;
 }
 
 /**
- * \brief Reads a 512-byte block on the card.
+ * \brief Waits until the data lines are free for a new transfer.
+ */
+static errval_t wait_data_lines(errval_t timeout_err)
+{
+    MMCHS_DEBUG("%s:%d: Wait for free data lines.\n", __FUNCTION__, __LINE__);
+    for (size_t i = 0; i < MMCHS_SPIN + 1000; i++) {
+        if (omap44xx_mmchs1_mmchs_pstate_dati_rdf(&mmchs) == 0x0) {
+            return SYS_ERR_OK;
+        }
+        if (i > MMCHS_SPIN) {
+            wait_msec(1);
+        }
+    }
+    return timeout_err;
+}
+
+/**
+ * \brief Waits until the controller's buffer holds a block to read or has
+ * room for one to write, and claims it.
+ */
+static errval_t wait_buffer_ready(bool write)
+{
+    for (size_t i = 0; i < MMCHS_SPIN + 1000; i++) {
+        omap44xx_mmchs1_mmchs_stat_t stat = omap44xx_mmchs1_mmchs_stat_rd(&mmchs);
+        bool ready = write ? omap44xx_mmchs1_mmchs_stat_bwr_extract(stat)
+                           : omap44xx_mmchs1_mmchs_stat_brr_extract(stat);
+        if (ready) {
+            // each block sets it again
+            omap44xx_mmchs1_mmchs_stat_t ack = 0x0;
+            if (write) {
+                ack = omap44xx_mmchs1_mmchs_stat_bwr_insert(ack, 0x1);
+            } else {
+                ack = omap44xx_mmchs1_mmchs_stat_brr_insert(ack, 0x1);
+            }
+            ack_status(ack);
+            return SYS_ERR_OK;
+        }
+        if (omap44xx_mmchs1_mmchs_stat_erri_extract(stat)) {
+            break;
+        }
+        if (i > MMCHS_SPIN) {
+            wait_msec(1);
+        }
+    }
+    return write ? MMC_ERR_WRITE_READY : MMC_ERR_READ_READY;
+}
+
+/**
+ * \brief Reads consecutive 512-byte blocks from the card with a single
+ * command, moving the data through the controller's buffer.
  *
- * \param block_nr Index number of block to read.
- * \param buffer Non-null buffer with a size of at least 512 bytes.
+ * \param block_nr Index number of the first block to read.
+ * \param count Number of blocks, at most MMCHS_MAX_BLOCKS.
+ * \param buffer Non-null buffer with a size of at least count * 512 bytes.
  *
- * \retval SYS_ERR_OK Block successfully written in buffer.
+ * \retval SYS_ERR_OK Blocks successfully written in buffer.
  * \retval MMC_ERR_TRANSFER Error interrupt or no transfer complete interrupt.
  * \retval MMC_ERR_READ_READY Card not ready to read.
  */
-errval_t mmchs_read_block(size_t block_nr, void *buffer)
+errval_t mmchs_read_blocks(size_t block_nr, size_t count, void *buffer)
 {
-    MMCHS_DEBUG("%s:%d: Wait for free data lines.\n", __FUNCTION__, __LINE__);
-    while (omap44xx_mmchs1_mmchs_pstate_dati_rdf(&mmchs) != 0x0);
+    assert(count > 0 && count <= MMCHS_MAX_BLOCKS);
 
-    // Send data command
-    send_command(17, block_nr);
-    // TODO(gz): Check for errors
+    errval_t err = wait_data_lines(MMC_ERR_READ_READY);
+    if (err_is_fail(err)) {
+        return err;
+    }
 
-    for (size_t i = 0; i < (omap44xx_mmchs1_mmchs_blk_blen_rdf(&mmchs) + 3) / 4; i++) {
-        size_t timeout = 1000;
-        while (omap44xx_mmchs1_mmchs_stat_brr_rdf(&mmchs) == 0x0 && timeout--) {
-            wait_msec(1);
+    // Send data command
+    send_command_blocks(count > 1 ? 18 : 17, block_nr, count, false);
+
+    uint32_t *words = buffer;
+    for (size_t b = 0; b < count; b++) {
+        err = wait_buffer_ready(false);
+        if (err_is_fail(err)) {
+            dat_line_reset();
+            return err;
         }
-        if (timeout == 0) {
-            return MMC_ERR_READ_READY;
+        for (size_t i = 0; i < MMCHS_BLOCK_SIZE / sizeof(uint32_t); i++) {
+            *words++ = omap44xx_mmchs1_mmchs_data_rd(&mmchs);
         }
+    }
 
-        ((uint32_t *) buffer)[i] = omap44xx_mmchs1_mmchs_data_rd(&mmchs);
+    return complete_card_transaction();
+}
+
+/**
+ * \brief Writes consecutive 512-byte blocks to the card with a single
+ * command, moving the data through the controller's buffer.
+ *
+ * \param block_nr Index number of the first block to write.
+ * \param count Number of blocks, at most MMCHS_MAX_BLOCKS.
+ * \param buffer Data to write, count * 512 bytes.
+ *
+ * \retval SYS_ERR_OK Blocks written to card.
+ * \retval MMC_ERR_TRANSFER Error interrupt or no transfer complete interrupt.
+ * \retval MMC_ERR_WRITE_READY Card not ready to write.
+ */
+errval_t mmchs_write_blocks(size_t block_nr, size_t count, const void *buffer)
+{
+    assert(count > 0 && count <= MMCHS_MAX_BLOCKS);
+
+    errval_t err = wait_data_lines(MMC_ERR_WRITE_READY);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    // Send data command
+    send_command_blocks(count > 1 ? 25 : 24, block_nr, count, false);
+
+    const uint32_t *words = buffer;
+    for (size_t b = 0; b < count; b++) {
+        err = wait_buffer_ready(true);
+        if (err_is_fail(err)) {
+            dat_line_reset();
+            return err;
+        }
+        for (size_t i = 0; i < MMCHS_BLOCK_SIZE / sizeof(uint32_t); i++) {
+            omap44xx_mmchs1_mmchs_data_wr(&mmchs, *words++);
+        }
     }
 
     return complete_card_transaction();
 }
 
+/**
+ * \brief Reads a 512-byte block on the card.
+ *
+ * \param block_nr Index number of block to read.
+ * \param buffer Non-null buffer with a size of at least 512 bytes.
+ *
+ * \retval SYS_ERR_OK Block successfully written in buffer.
+ * \retval MMC_ERR_TRANSFER Error interrupt or no transfer complete interrupt.
+ * \retval MMC_ERR_READ_READY Card not ready to read.
+ */
+errval_t mmchs_read_block(size_t block_nr, void *buffer)
+{
+    return mmchs_read_blocks(block_nr, 1, buffer);
+}
+
 /**
  * \brief Write a 512-byte block in the card.
  *
@@ -392,25 +611,131 @@ errval_t mmchs_read_block(size_t block_nr, void *buffer)
  */
 errval_t mmchs_write_block(size_t block_nr, void *buffer)
 {
-    MMCHS_DEBUG("%s:%d: Wait for free data lines.\n", __FUNCTION__, __LINE__);
-    size_t timeout = 1000;
-    while (omap44xx_mmchs1_mmchs_pstate_dati_rdf(&mmchs) != 0x0 && timeout--) {
-        wait_msec(1);
+    return mmchs_write_blocks(block_nr, 1, buffer);
+}
+
+/**
+ * \brief Whether the controller can move data itself, see mmchs_dma_start().
+ */
+bool mmchs_dma_available(void)
+{
+    return dma_available;
+}
+
+/**
+ * \brief Starts a transfer of consecutive blocks that the controller moves
+ * from or to physical memory by ADMA2, without the CPU. Completes once
+ * mmchs_dma_poll() says so; the controller signals MMCHS_IRQ by then if
+ * mmchs_irq_init() has been called.
+ *
+ * \param write Whether to write to the card rather than read.
+ * \param block_nr Index number of the first block.
+ * \param count Number of blocks, at most MMCHS_MAX_BLOCKS.
+ * \param base Physical address of the contiguous, word-aligned buffer.
+ */
+errval_t mmchs_dma_start(bool write, size_t block_nr, size_t count,
+                         genpaddr_t base)
+{
+    assert(dma_available);
+    assert(count > 0 && count <= MMCHS_MAX_BLOCKS);
+    assert((base & 0x3) == 0 && base + count * MMCHS_BLOCK_SIZE <= 0x100000000ULL);
+
+    errval_t err = wait_data_lines(write ? MMC_ERR_WRITE_READY
+                                         : MMC_ERR_READ_READY);
+    if (err_is_fail(err)) {
+        return err;
     }
-    if (timeout == 0) {
-        return MMC_ERR_WRITE_READY;
+
+    size_t bytes = count * MMCHS_BLOCK_SIZE;
+    size_t n = 0;
+    for (size_t offset = 0; offset < bytes; offset += ADMA_DESC_BYTES, n++) {
+        adma_table[n].address = base + offset;
+        adma_table[n].length = MIN(bytes - offset, ADMA_DESC_BYTES);
+        adma_table[n].attr = ADMA_ATTR_VALID | ADMA_ATTR_TRAN;
     }
+    adma_table[n - 1].attr |= ADMA_ATTR_END;
+    __asm volatile ("dmb");
 
-    // Send data command
-    send_command(24, block_nr);
-    // TODO(gz): Check for errors
+    omap44xx_mmchs1_mmchs_admasal_wr(&mmchs, adma_table_base);
+    send_command_blocks(write ? (count > 1 ? 25 : 24) : (count > 1 ? 18 : 17),
+                        block_nr, count, true);
 
-    for (size_t i = 0; i < (omap44xx_mmchs1_mmchs_blk_blen_rdf(&mmchs) + 3) / 4; i++) {
-        while (omap44xx_mmchs1_mmchs_stat_bwr_rdf(&mmchs) == 0x0);
-        omap44xx_mmchs1_mmchs_data_wr(&mmchs, ((uint32_t *) buffer)[i]);
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Checks whether the transfer started by mmchs_dma_start() has
+ * finished and acknowledges its interrupt.
+ *
+ * \retval true with *reterr set if it has, false if it is still running.
+ */
+bool mmchs_dma_poll(errval_t *reterr)
+{
+    return check_card_transaction(reterr);
+}
+
+/**
+ * \brief Has handler called on the default waitset when a data transfer
+ * completes or fails, instead of polling for it.
+ */
+errval_t mmchs_irq_init(interrupt_handler_fn handler, void *arg)
+{
+    errval_t err = aos_rpc_get_irq_cap(get_init_rpc(), &cap_irq);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    err = inthandler_setup_arm(handler, arg, MMCHS_IRQ);
+    if (err_is_fail(err)) {
+        return err;
     }
 
-    return complete_card_transaction();
+    // command completion is still polled, as it is quick
+    omap44xx_mmchs1_mmchs_ise_t ise = 0x0;
+    ise = omap44xx_mmchs1_mmchs_ise_tc_sigen_insert(ise, 0x1);
+    ise = omap44xx_mmchs1_mmchs_ise_deb_sigen_insert(ise, 0x1);
+    ise = omap44xx_mmchs1_mmchs_ise_dcrc_sigen_insert(ise, 0x1);
+    ise = omap44xx_mmchs1_mmchs_ise_dto_sigen_insert(ise, 0x1);
+    ise = omap44xx_mmchs1_mmchs_ise_admae_sigen_insert(ise, 0x1);
+    omap44xx_mmchs1_mmchs_ise_wr(&mmchs, ise);
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief Sets up ADMA2 if the controller has it, see TRM rev Z,
+ * Section 24.5.1.2.1.8.
+ */
+static void mmchs_dma_init(void)
+{
+    if (!omap44xx_mmchs1_mmchs_hl_hwinfo_madma_en_rdf(&mmchs)) {
+        MMCHS_DEBUG("%s:%d: No master DMA.\n", __FUNCTION__, __LINE__);
+        return;
+    }
+
+    struct capref frame;
+    size_t retbytes;
+    errval_t err = frame_alloc(&frame, BASE_PAGE_SIZE, &retbytes);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "allocating ADMA descriptor table");
+        return;
+    }
+    struct frame_identity fi;
+    err = frame_identify(frame, &fi);
+    if (err_is_ok(err)) {
+        err = paging_map_frame_attr(get_current_paging_state(),
+                                    (void **)&adma_table, BASE_PAGE_SIZE, frame,
+                                    VREGION_FLAGS_READ_WRITE_NOCACHE, NULL, NULL);
+    }
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "mapping ADMA descriptor table");
+        cap_destroy(frame);
+        return;
+    }
+    adma_table_base = fi.base;
+
+    omap44xx_mmchs1_mmchs_con_dma_mns_wrf(&mmchs, 0x1);
+    omap44xx_mmchs1_mmchs_hctl_dmas_wrf(&mmchs, 0x2);
+    dma_available = true;
 }
 
 /**
@@ -421,6 +746,14 @@ errval_t mmchs_write_block(size_t block_nr, void *buffer)
 
 
 
+/**
+ * \brief Returns the capacity of the card in 512-byte blocks.
+ */
+size_t mmchs_card_blocks(void)
+{
+    return card_blocks;
+}
+
 void mmchs_init(void)
 {
     lvaddr_t mmchs_vaddr;
@@ -436,4 +769,5 @@ void mmchs_init(void)
     mmc_host_and_bus_configuration();
 
     mmchs_identify_card();
+    mmchs_dma_init();
 }
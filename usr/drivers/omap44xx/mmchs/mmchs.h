@@ -11,6 +11,7 @@
 #define MMCHS2_H
 
 #include <aos/aos.h>
+#include <aos/inthandler.h>
 
 #include "mmchs_debug.h"
 #include "omap44xx_cm2.h"
@@ -19,10 +20,24 @@
 #include "twl6030.h"
 
 
+/// Size of a block on the card
+#define MMCHS_BLOCK_SIZE    512
+/// Blocks moved by one multi-block transfer at most
+#define MMCHS_MAX_BLOCKS    1024
+
 void mmchs_init(void);
 errval_t mmchs_read_block(size_t block_nr, void *buffer);
 errval_t mmchs_write_block(size_t block_nr, void *buffer);
+errval_t mmchs_read_blocks(size_t block_nr, size_t count, void *buffer);
+errval_t mmchs_write_blocks(size_t block_nr, size_t count, const void *buffer);
+size_t mmchs_card_blocks(void);
+
+bool mmchs_dma_available(void);
+errval_t mmchs_dma_start(bool write, size_t block_nr, size_t count,
+                         genpaddr_t base);
+bool mmchs_dma_poll(errval_t *reterr);
+errval_t mmchs_irq_init(interrupt_handler_fn handler, void *arg);
 
-void init_service(void);
+void init_service(bool ramdisk);
 
 #endif // MMCHS2_H
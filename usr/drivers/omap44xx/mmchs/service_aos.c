@@ -1,6 +1,6 @@
 /**
  * \file
- * \brief Hello world application
+ * \brief Block device service for the SD card
  */
 
 /*
@@ -16,14 +16,171 @@
 
 #include <stdio.h>
 #include <aos/aos.h>
+#include <aos/waitset.h>
+#include <bdev/bdev.h>
 
 #include "mmchs.h"
 
+/// Name the service registers with the nameserver
+#define MMCHS_SERVICE   "mmchs"
 
-void init_service(void)
+/*
+ * Requests are queued and split into transfers of at most MMCHS_MAX_BLOCKS
+ * blocks, one on the card at a time. Requests with a physical address are
+ * moved by DMA and completed from the transfer interrupt, or if there is none
+ * by polling from the dispatch loop; the others are moved by the CPU right
+ * away.
+ */
+static struct bdev_req *queue;          ///< requests not yet fully started
+static struct bdev_req *queue_tail;
+static struct bdev_req *current;        ///< request of the DMA transfer
+static bool irq_enabled;
+
+static struct bdev mmchs_bdev;
+
+static void mmchs_bdev_start(void)
 {
+    while (current == NULL && queue != NULL) {
+        struct bdev_req *req = queue;
+        size_t count = MIN(req->count - req->issued, MMCHS_MAX_BLOCKS);
+        size_t lba = req->lba + req->issued;
+        size_t offset = req->issued * BDEV_BLOCK_SIZE;
+
+        req->issued += count;
+        req->pending++;
+        if (req->issued == req->count) {
+            queue = req->next;
+            if (queue == NULL) {
+                queue_tail = NULL;
+            }
+        }
+
+        errval_t err;
+        if (req->paddr != 0 && mmchs_dma_available()) {
+            err = mmchs_dma_start(req->op == BDEV_WRITE, lba, count,
+                                  req->paddr + offset);
+            if (err_is_ok(err)) {
+                current = req;
+                return;
+            }
+        } else if (req->op == BDEV_READ) {
+            err = mmchs_read_blocks(lba, count, (uint8_t *)req->buf + offset);
+        } else {
+            err = mmchs_write_blocks(lba, count, (uint8_t *)req->buf + offset);
+        }
+        bdev_req_complete(&mmchs_bdev, req, err);
+    }
+}
+
+/**
+ * \brief Completes the DMA transfer if it has finished and starts the next.
+ */
+static void mmchs_bdev_finish(void)
+{
+    errval_t err;
+    if (current == NULL || !mmchs_dma_poll(&err)) {
+        return;
+    }
+
+    struct bdev_req *req = current;
+    current = NULL;
+    bdev_req_complete(&mmchs_bdev, req, err);
+    mmchs_bdev_start();
+}
+
+static void mmchs_bdev_interrupt(void *arg)
+{
+    mmchs_bdev_finish();
+}
+
+static errval_t mmchs_bdev_submit(struct bdev *dev, struct bdev_req *req)
+{
+    if (queue_tail != NULL) {
+        queue_tail->next = req;
+    } else {
+        queue = req;
+    }
+    queue_tail = req;
+
+    mmchs_bdev_start();
+    return SYS_ERR_OK;
+}
+
+static errval_t mmchs_bdev_poll(struct bdev *dev, bool block)
+{
+    size_t inflight = dev->inflight;
+
+    mmchs_bdev_finish();
+    while (block && dev->inflight == inflight && current != NULL) {
+        if (irq_enabled) {
+            errval_t err = event_dispatch(get_default_waitset());
+            if (err_is_fail(err)) {
+                return err;
+            }
+        }
+        mmchs_bdev_finish();
+    }
+
+    return SYS_ERR_OK;
+}
+
+static const struct bdev_ops mmchs_bdev_ops = {
+    .submit = mmchs_bdev_submit,
+    .poll = mmchs_bdev_poll,
+};
+
+static struct bdev mmchs_bdev = {
+    .ops = &mmchs_bdev_ops,
+};
+
+/**
+ * \brief Serves the card, or a RAM disk in its place, as block device service
+ * MMCHS_SERVICE. Does not return.
+ */
+void init_service(bool ramdisk)
+{
+    errval_t err;
+
+    struct bdev *dev = &mmchs_bdev;
+    if (ramdisk) {
+        // no card on QEMU, so file systems are tried on a RAM disk
+        err = bdev_ramdisk_create(BDEV_RAMDISK_DEFAULT_BLOCKS, &dev);
+        if (err_is_fail(err)) {
+            USER_PANIC_ERR(err, "creating RAM disk");
+        }
+    } else {
+        mmchs_bdev.nblocks = mmchs_card_blocks();
+        if (mmchs_dma_available()) {
+            err = mmchs_irq_init(mmchs_bdev_interrupt, NULL);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "setting up transfer interrupt, polling instead");
+            }
+            irq_enabled = err_is_ok(err);
+        }
+    }
+
+    err = bdev_serve(MMCHS_SERVICE, dev);
+    if (err_is_fail(err)) {
+        USER_PANIC_ERR(err, "serving " MMCHS_SERVICE);
+    }
+    debug_printf("serving %zu blocks as " MMCHS_SERVICE "\n", dev->nblocks);
 
-    /* initialize the service setup */
+    struct waitset *default_ws = get_default_waitset();
+    while (true) {
+        // without the transfer interrupt no event finishes a DMA transfer,
+        // so see them all through before waiting for the next kick
+        while (!irq_enabled && current != NULL) {
+            err = bdev_poll(dev, true);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "polling " MMCHS_SERVICE);
+                abort();
+            }
+        }
 
-    USER_PANIC("NYI: Implement RPC service!");
+        err = event_dispatch(default_ws);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "in event_dispatch");
+            abort();
+        }
+    }
 }
@@ -0,0 +1,284 @@
+/**
+ * \file
+ * \brief File system server, sharing one ramfs between processes
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, CAB F.78, Universitaetstr. 6, CH-8092 Zurich,
+ * Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <aos/aos.h>
+#include <aos/waitset.h>
+#include <aos/lmp_ring.h>
+
+#include <fs/fs.h>
+#include <fs/ramfs.h>
+#include <fs/fs_ring.h>
+
+/**
+ * @brief the file system side of a connected client
+ */
+struct fs_conn {
+    bool chain_broken;              ///< last transfer part failed or was short
+    ramfs_handle_t *handles;        ///< open handles, indexed by handle id
+    size_t nhandles;
+};
+
+static ramfs_mount_t fs;
+
+static errval_t handle_alloc(struct fs_conn *conn, ramfs_handle_t h,
+                             uint32_t *retid)
+{
+    size_t id = 0;
+    while (id < conn->nhandles && conn->handles[id] != NULL) {
+        id++;
+    }
+
+    if (id == conn->nhandles) {
+        size_t n = conn->nhandles ? 2 * conn->nhandles : 8;
+        ramfs_handle_t *handles = realloc(conn->handles, n * sizeof(*handles));
+        if (handles == NULL) {
+            return LIB_ERR_MALLOC_FAIL;
+        }
+        memset(&handles[conn->nhandles], 0,
+               (n - conn->nhandles) * sizeof(*handles));
+        conn->handles = handles;
+        conn->nhandles = n;
+    }
+
+    conn->handles[id] = h;
+    *retid = id;
+
+    return SYS_ERR_OK;
+}
+
+static ramfs_handle_t handle_get(struct fs_conn *conn, uint32_t id)
+{
+    return id < conn->nhandles ? conn->handles[id] : NULL;
+}
+
+/**
+ * @brief opens path with op and hands out a handle id for it
+ */
+static errval_t serve_open(struct fs_conn *conn, struct fs_ring_slot *s,
+                           const char *path)
+{
+    errval_t err;
+    ramfs_handle_t h;
+
+    switch (s->op) {
+    case FS_RING_OP_OPEN:
+        err = ramfs_open(fs, path, &h);
+        break;
+    case FS_RING_OP_CREATE:
+        err = ramfs_create(fs, path, &h);
+        break;
+    default:
+        err = ramfs_opendir(fs, path, &h);
+        break;
+    }
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    err = handle_alloc(conn, h, &s->ret0);
+    if (err_is_fail(err)) {
+        if (s->op == FS_RING_OP_OPENDIR) {
+            ramfs_closedir(fs, h);
+        } else {
+            ramfs_close(fs, h);
+        }
+    }
+    return err;
+}
+
+/**
+ * @brief serves the request in s, a private copy of a slot whose data page
+ *        is data
+ */
+static errval_t serve(struct fs_conn *conn, struct fs_ring_slot *s,
+                      char *data)
+{
+    errval_t err;
+
+    // the client can change the data page at any time, so paths are copied
+    // out and terminated before they are looked at
+    static char path[FS_RING_DATA_SIZE];
+    switch (s->op) {
+    case FS_RING_OP_OPEN:
+    case FS_RING_OP_CREATE:
+    case FS_RING_OP_OPENDIR:
+    case FS_RING_OP_REMOVE:
+    case FS_RING_OP_MKDIR:
+    case FS_RING_OP_RMDIR:
+        memcpy(path, data, FS_RING_DATA_SIZE - 1);
+        path[FS_RING_DATA_SIZE - 1] = '\0';
+        break;
+    }
+
+    switch (s->op) {
+    case FS_RING_OP_OPEN:
+    case FS_RING_OP_CREATE:
+    case FS_RING_OP_OPENDIR:
+        return serve_open(conn, s, path);
+    case FS_RING_OP_REMOVE:
+        return ramfs_remove(fs, path);
+    case FS_RING_OP_MKDIR:
+        return ramfs_mkdir(fs, path);
+    case FS_RING_OP_RMDIR:
+        return ramfs_rmdir(fs, path);
+    }
+
+    ramfs_handle_t h = handle_get(conn, s->handle);
+    if (h == NULL) {
+        return FS_ERR_INVALID_FH;
+    }
+
+    size_t bytes = MIN(s->arg0, FS_RING_DATA_SIZE);
+    size_t ret;
+    struct fs_fileinfo info;
+
+    switch (s->op) {
+    case FS_RING_OP_READ:
+    case FS_RING_OP_WRITE:
+        if (s->arg1 && conn->chain_broken) {
+            return FS_ERR_SKIPPED;
+        }
+        err = s->op == FS_RING_OP_READ ? ramfs_read(fs, h, data, bytes, &ret)
+                                       : ramfs_write(fs, h, data, bytes, &ret);
+        s->ret0 = ret;
+        conn->chain_broken = err_is_fail(err) || ret < bytes;
+        return err;
+    case FS_RING_OP_TRUNCATE:
+        return ramfs_truncate(fs, h, s->arg0);
+    case FS_RING_OP_SEEK:
+        // ramfs_seek checks whence, the handle type and the new position
+        err = ramfs_seek(fs, h, s->arg0, (off_t)s->arg1);
+        if (err_is_ok(err)) {
+            err = ramfs_tell(fs, h, &ret);
+            s->ret0 = ret;
+        }
+        return err;
+    case FS_RING_OP_STAT:
+        err = ramfs_stat(fs, h, &info);
+        s->ret0 = info.type;
+        s->ret1 = info.size;
+        return err;
+    case FS_RING_OP_READDIR:
+    {
+        char *name;
+        err = ramfs_dir_read_next(fs, h, &name, &info);
+        if (err_is_fail(err)) {
+            return err;
+        }
+        strncpy(data, name, FS_RING_DATA_SIZE - 1);
+        free(name);
+        s->ret0 = info.type;
+        s->ret1 = info.size;
+        return SYS_ERR_OK;
+    }
+    case FS_RING_OP_CLOSE:
+    case FS_RING_OP_CLOSEDIR:
+        err = s->op == FS_RING_OP_CLOSE ? ramfs_close(fs, h)
+                                        : ramfs_closedir(fs, h);
+        if (err_is_ok(err)) {
+            conn->handles[s->handle] = NULL;
+        }
+        return err;
+    default:
+        return FS_ERR_SERVER;
+    }
+}
+
+/**
+ * @brief serves everything on the submission queue
+ */
+static void fs_conn_drain(struct lmp_ring_conn *rc)
+{
+    struct fs_conn *conn = rc->st;
+    struct fs_ring *ring = rc->ring;
+
+    bool completed = false;
+    uint32_t slot;
+    while (lmp_ring_conn_pop(rc, &ring->sq, &slot)) {
+        // work on a copy, so the request cannot change while it is served
+        struct fs_ring_slot s = ring->slots[slot];
+        __asm volatile ("" ::: "memory");
+        errval_t err = serve(conn, &s, fs_ring_data(ring, slot));
+
+        ring->slots[slot].err = err;
+        ring->slots[slot].ret0 = s.ret0;
+        ring->slots[slot].ret1 = s.ret1;
+        lmp_ring_conn_push(rc, &ring->cq, slot);
+        completed = true;
+    }
+
+    if (completed) {
+        lmp_ring_conn_kick(rc);
+    }
+}
+
+static errval_t fs_conn_setup(struct lmp_ring_conn *rc, uintptr_t *ok_arg)
+{
+    rc->st = calloc(1, sizeof(struct fs_conn));
+    if (rc->st == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    return SYS_ERR_OK;
+}
+
+/**
+ * @brief closes whatever a dropped client left open
+ */
+static void fs_conn_drop(struct lmp_ring_conn *rc)
+{
+    struct fs_conn *conn = rc->st;
+    if (conn != NULL) {
+        for (size_t id = 0; id < conn->nhandles; id++) {
+            ramfs_handle_t h = conn->handles[id];
+            if (h != NULL && err_no(ramfs_close(fs, h)) == FS_ERR_NOTFILE) {
+                ramfs_closedir(fs, h);
+            }
+        }
+        free(conn->handles);
+        free(conn);
+    }
+    lmp_ring_conn_free(rc);
+}
+
+static const struct lmp_ring_service fs_service = {
+    .frame_size = FS_RING_FRAME_SIZE,
+    .map_flags = VREGION_FLAGS_READ_WRITE,
+    .setup = fs_conn_setup,
+    .drain = fs_conn_drain,
+    .drop = fs_conn_drop,
+};
+
+int main(int argc, char *argv[])
+{
+    errval_t err;
+
+    CHECK("mounting ramfs", ramfs_mount("/", &fs));
+
+    CHECK("serving " FS_RING_SERVICE,
+            lmp_ring_serve(FS_RING_SERVICE, &fs_service));
+
+    struct waitset *default_ws = get_default_waitset();
+    while (true) {
+        err = event_dispatch(default_ws);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "in event_dispatch");
+            abort();
+        }
+    }
+
+    return 0;
+}
@@ -27,63 +27,93 @@ errval_t map_urpc_frame_to_vspace(void** ret, coreid_t my_core_id) {
             NULL, NULL);
 }
 
-void write_to_urpc(void* urpc_buf, genpaddr_t base, gensize_t size,
+// Cycle count when start_core kicked off the other core, for the benchmark.
+static uint32_t boot_start_cycles;
+
+errval_t write_to_urpc(void* urpc_buf, genpaddr_t base, gensize_t size,
         struct bootinfo* bi, coreid_t my_core_id)
 {
     if (my_core_id != 0) {
-        return;
+        return SYS_ERR_OK;
     }
 
-    *((genpaddr_t*) urpc_buf) = base;
-    urpc_buf += sizeof(genpaddr_t);
-    *((gensize_t*) urpc_buf) = size;
-
-    urpc_buf += sizeof(gensize_t);
-    *((struct bootinfo*) urpc_buf) = *bi;
+    // mmstrings cap at slot 0, plus every module's first slot.
+    size_t modules_count = 1;
+    for (size_t i = 0; i < bi->regions_length; ++i) {
+        if (bi->regions[i].mrmod_slot != 0) {
+            ++modules_count;
+        }
+    }
 
-    urpc_buf = (void*) ROUND_UP((uintptr_t) urpc_buf + sizeof(struct bootinfo), 4);
-    memcpy(urpc_buf, bi->regions, bi->regions_length * sizeof(struct mem_region));
+    struct boot_record* record = (struct boot_record*) urpc_buf;
+    size_t bootinfo_size = sizeof(struct bootinfo)
+            + bi->regions_length * sizeof(struct mem_region);
+    size_t bootinfo_offset = ROUND_UP(sizeof(struct boot_record), 8);
+    size_t modules_offset = ROUND_UP(bootinfo_offset + bootinfo_size, 8);
+    size_t total_size = modules_offset
+            + modules_count * sizeof(struct boot_record_module);
+    if (total_size > 2u * BASE_PAGE_SIZE) {
+        return INIT_ERR_BOOT_RECORD_SIZE;
+    }
 
-    // mmstrings cap, for reading up modules.
-    struct capref mmstrings_cap = {
+    record->version = BOOT_RECORD_VERSION;
+    record->header_size = sizeof(struct boot_record);
+    record->total_size = total_size;
+    record->ready = 0;
+    record->ram_base = base;
+    record->ram_bytes = size;
+    record->bootinfo_offset = bootinfo_offset;
+    record->bootinfo_size = bootinfo_size;
+    record->modules_offset = modules_offset;
+    record->modules_count = modules_count;
+
+    memcpy(urpc_buf + bootinfo_offset, bi, bootinfo_size);
+
+    struct boot_record_module* modules =
+            (struct boot_record_module*) (urpc_buf + modules_offset);
+    struct capref module = {
         .cnode = cnode_module,
         .slot = 0
     };
-    struct frame_identity mmstrings_id;
-    frame_identify(mmstrings_cap, &mmstrings_id);
-
-    urpc_buf = (void*) ROUND_UP((uintptr_t) urpc_buf + bi->regions_length * sizeof(struct mem_region), 4);
-    *((genpaddr_t*) urpc_buf) = mmstrings_id.base;
-    urpc_buf += sizeof(genpaddr_t);
-    *((gensize_t*) urpc_buf) = mmstrings_id.bytes;
+    struct frame_identity module_id;
+    CHECK("identifying mmstrings cap", frame_identify(module, &module_id));
+    modules[0].slot = 0;
+    modules[0].base = module_id.base;
+    modules[0].bytes = module_id.bytes;
 
-    size_t non_zero_slot_count = 0;
+    size_t m = 1;
     for (size_t i = 0; i < bi->regions_length; ++i) {
-        if (bi->regions[i].mrmod_slot != 0) {
-            ++non_zero_slot_count;
+        if (bi->regions[i].mrmod_slot == 0) {
+            continue;
         }
+        module.slot = bi->regions[i].mrmod_slot;
+        CHECK("identifying module cap", frame_identify(module, &module_id));
+        modules[m].slot = module.slot;
+        modules[m].base = module_id.base;
+        modules[m].bytes = module_id.bytes;
+        ++m;
     }
-    urpc_buf += sizeof(gensize_t);
-    *((size_t*) urpc_buf) = non_zero_slot_count;
-    urpc_buf += sizeof(size_t);
-    
-    for (size_t i = 0; i < bi->regions_length; ++i) {
-        if (bi->regions[i].mrmod_slot != 0) {
-            struct capref module = {
-                .cnode = cnode_module,
-                .slot = bi->regions[i].mrmod_slot
-            };
-            struct frame_identity module_id;
-            frame_identify(module, &module_id);
-
-            *((cslot_t*) urpc_buf) = module.slot;
-            urpc_buf += sizeof(cslot_t);
-            *((genpaddr_t*) urpc_buf) = module_id.base;
-            urpc_buf += sizeof(genpaddr_t);
-            *((gensize_t*) urpc_buf) = module_id.bytes;
-            urpc_buf += sizeof(gensize_t);
-        }
+
+    // Publish the record only once it is complete.
+    dmb();
+    record->magic = BOOT_RECORD_MAGIC;
+
+    return SYS_ERR_OK;
+}
+
+static errval_t boot_record_check(struct boot_record* record)
+{
+    if (record->magic != BOOT_RECORD_MAGIC
+            || record->version != BOOT_RECORD_VERSION
+            || record->header_size < sizeof(struct boot_record)
+            || record->total_size > 2u * BASE_PAGE_SIZE
+            || record->bootinfo_offset + record->bootinfo_size
+                    > record->total_size
+            || record->modules_offset + record->modules_count
+                    * sizeof(struct boot_record_module) > record->total_size) {
+        return INIT_ERR_BOOT_RECORD;
     }
+    return SYS_ERR_OK;
 }
 
 errval_t read_from_urpc(void* urpc_buf, struct bootinfo** bi,
@@ -93,37 +123,27 @@ errval_t read_from_urpc(void* urpc_buf, struct bootinfo** bi,
         return SYS_ERR_OK;
     }
 
-    genpaddr_t* base = (genpaddr_t*) urpc_buf;
-    urpc_buf += sizeof(genpaddr_t);
-    gensize_t* size = (gensize_t*) urpc_buf;
+    struct boot_record* record = (struct boot_record*) urpc_buf;
+    errval_t err = boot_record_check(record);
+    if (err_is_fail(err)) {
+        return err;
+    }
+    dmb();
 
     struct capref mem_cap = {
         .cnode = cnode_super,
         .slot = 0,
     };
-    CHECK("forging RAM cap", ram_forge(mem_cap, *base, *size, my_core_id));
-
-    // mmstrings cap, for reading up modules.
-    // urpc_buf += sizeof(gensize_t);
-    // genpaddr_t* mmstrings_base = (genpaddr_t*) urpc_buf;
-    // urpc_buf += sizeof(genpaddr_t);
-    // gensize_t* mmstrings_size = (gensize_t*) urpc_buf;
-
-    // struct capref mmstrings_cap = {
-    //     .cnode = cnode_module,
-    //     .slot = 0
-    // };
-    // CHECK("creating mmstrings L2Cnode",
-    //         cnode_create_l2(&mmstrings_cap, &mmstrings_cap.cnode));
-    // CHECK("forging mmstrings cap",
-    //         frame_forge(mmstrings_cap, *mmstrings_base, *mmstrings_size,
-    //                 my_core_id));
-
-    urpc_buf += sizeof(gensize_t);
-    *bi = (struct bootinfo*) urpc_buf;
-
-    urpc_buf = (void*) ROUND_UP((uintptr_t) urpc_buf + sizeof(struct bootinfo), 4);
-    memcpy((*bi)->regions, urpc_buf, (*bi)->regions_length * sizeof(struct mem_region));
+    CHECK("forging RAM cap",
+            ram_forge(mem_cap, record->ram_base, record->ram_bytes,
+                    my_core_id));
+
+    // The URPC frame is reused for messaging once we're up, so keep a copy.
+    // We don't have a RAM allocator yet, hence the static buffer.
+    static uint64_t bootinfo_copy[2u * BASE_PAGE_SIZE / sizeof(uint64_t)];
+    memcpy(bootinfo_copy, urpc_buf + record->bootinfo_offset,
+            record->bootinfo_size);
+    *bi = (struct bootinfo*) bootinfo_copy;
 
     return SYS_ERR_OK;
 }
@@ -135,6 +155,8 @@ errval_t start_core(coreid_t core_to_start, coreid_t my_core_id,
         return SYS_ERR_OK;
     }
 
+    boot_start_cycles = get_cycle_count();
+
     // 1. Get an arm_core_data instance from a KCB cap.
     // Get a KCB cap.
     struct capref ram;
@@ -223,25 +245,20 @@ errval_t start_core(coreid_t core_to_start, coreid_t my_core_id,
         return SPAWN_ERR_FIND_MODULE;
     }
 
-    struct capref cpu_driver_frame = {
-        .cnode = cnode_module,
-        .slot = cpu_driver_module->mrmod_slot,
-    };
-
     // Map multiboot module in my address space.
-    struct frame_identity cpu_driver_frame_id;
-    CHECK("identifying elf frame",
-          frame_identify(cpu_driver_frame, &cpu_driver_frame_id));
-
     void* elf_addr;
-    CHECK("mapping elf frame",
-            paging_map_frame(get_current_paging_state(), &elf_addr,
-                    cpu_driver_frame_id.bytes, cpu_driver_frame, NULL, NULL));
+    size_t elf_bytes;
+    errval_t err = multiboot_module_map(cpu_driver_module, &elf_addr,
+            &elf_bytes);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "mapping elf frame");
+        return err;
+    }
 
     // 3. Allocate & map frame for relocated segment.
     struct capref rel_seg_frame;
     CHECK("allocating relocated segment frame",
-            frame_alloc(&rel_seg_frame, cpu_driver_frame_id.bytes, &retsize));
+            frame_alloc(&rel_seg_frame, elf_bytes, &retsize));
     struct frame_identity rel_seg_frame_id;
     CHECK("identifying relocated segment frame",
             frame_identify(rel_seg_frame, &rel_seg_frame_id));
@@ -258,6 +275,7 @@ errval_t start_core(coreid_t core_to_start, coreid_t my_core_id,
                     rel_seg_frame_id.base,// + KERNEL_WINDOW,
                     core_data->kernel_load_base,
                     &core_data->got_base));
+    CHECK("unmapping elf frame", multiboot_module_unmap(cpu_driver_module));
 
     // 4. Clean & invalidate cache.
     // sys_armv7_cache_invalidate((void*) (uint32_t) core_data_frame_id.base,
@@ -280,21 +298,12 @@ errval_t read_modules(void* urpc_buf, struct bootinfo* bi,
     if (my_core_id == 0) {
         return SYS_ERR_OK;
     }
-    
-    // mmstrings cap, for reading up modules.
-    urpc_buf += sizeof(genpaddr_t);
-    urpc_buf += sizeof(gensize_t);
-    urpc_buf = (void*) ROUND_UP((uintptr_t) urpc_buf + sizeof(struct bootinfo), 4);
-    urpc_buf = (void*) ROUND_UP((uintptr_t) urpc_buf + bi->regions_length * sizeof(struct mem_region), 4);
 
-    genpaddr_t* mmstrings_base = (genpaddr_t*) urpc_buf;
-    urpc_buf += sizeof(genpaddr_t);
-    gensize_t* mmstrings_size = (gensize_t*) urpc_buf;
-
-    struct capref mmstrings_cap = {
-        .cnode = cnode_module,
-        .slot = 0
-    };
+    struct boot_record* record = (struct boot_record*) urpc_buf;
+    errval_t err = boot_record_check(record);
+    if (err_is_fail(err)) {
+        return err;
+    }
 
     struct capref l1cnode = {
         .cnode = cnode_task,
@@ -304,33 +313,56 @@ errval_t read_modules(void* urpc_buf, struct bootinfo* bi,
     CHECK("creating foreign mmstrings L2Cnode",
             cnode_create_foreign_l2(l1cnode, ROOTCN_SLOT_MODULECN,
                              &cnode_module));
-    debug_printf("cnode_module: root: %u, cnode: %u, level: %u\n",
-            cnode_module.croot, cnode_module.cnode >> 8, cnode_module.level);
-    CHECK("forging mmstrings cap",
-            frame_forge(mmstrings_cap, *mmstrings_base, *mmstrings_size,
-                    my_core_id));
 
-    urpc_buf += sizeof(gensize_t);
-    size_t* non_zero_slot_count = (size_t*) urpc_buf;
-    urpc_buf += sizeof(size_t);
+    struct boot_record_module* modules =
+            (struct boot_record_module*) (urpc_buf + record->modules_offset);
+    struct frame_identity* frames = (struct frame_identity*) malloc(
+            record->modules_count * sizeof(struct frame_identity));
+    if (frames == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
 
-    for (size_t i = 0; i < *non_zero_slot_count; ++i) {
-        // Read slot, base and size & forge cap.
-        cslot_t* module_slot = (cslot_t*) urpc_buf;
-        urpc_buf += sizeof(cslot_t);
-        genpaddr_t* module_base = (genpaddr_t*) urpc_buf;
-        urpc_buf += sizeof(genpaddr_t);
-        gensize_t* module_size = (gensize_t*) urpc_buf;
-        urpc_buf += sizeof(gensize_t);
+    // Forge each run of consecutive slots with one invocation; normally the
+    // mmstrings and all modules form a single run.
+    size_t run = 0;
+    for (size_t i = 0; i < record->modules_count; ++i) {
+        frames[i].base = modules[i].base;
+        frames[i].bytes = modules[i].bytes;
+        if (i + 1 < record->modules_count
+                && modules[i + 1].slot == modules[i].slot + 1) {
+            continue;
+        }
 
-        struct capref module_cap = {
+        struct capref first = {
             .cnode = cnode_module,
-            .slot = *module_slot
+            .slot = modules[run].slot
         };
-        CHECK("forging module cap",
-                frame_forge(module_cap, *module_base, *module_size,
-                        my_core_id));
+        err = frames_forge(first, &frames[run], i + 1 - run, my_core_id);
+        if (err_is_fail(err)) {
+            free(frames);
+            return err;
+        }
+        run = i + 1;
     }
+    free(frames);
 
     return SYS_ERR_OK;
-}
\ No newline at end of file
+}
+
+void boot_record_ready(void* urpc_buf, coreid_t my_core_id)
+{
+    struct boot_record* record = (struct boot_record*) urpc_buf;
+    if (my_core_id != 0) {
+        dmb();
+        record->ready = 1;
+        return;
+    }
+
+#if COREBOOT_BENCHMARK
+    while (record->ready == 0) {
+        // Spin; the record lives in the shared URPC frame.
+    }
+    debug_printf("coreboot: core 1 ready %u cycles after start_core\n",
+            get_cycle_count() - boot_start_cycles);
+#endif
+}
@@ -18,8 +18,47 @@
 #include <aos/aos.h>
 #include <aos/coreboot.h>
 #include <aos/kernel_cap_invocations.h>
+#include <barrelfish_kpi/asm_inlines_arch.h>
 #include <spawn/multiboot.h>
 
+/// Print the cycles from start_core until the new core's init is ready.
+#define COREBOOT_BENCHMARK 0
+
+#define BOOT_RECORD_MAGIC   0x424f4f54  // "BOOT"
+#define BOOT_RECORD_VERSION 1
+
+/**
+ * \brief A module cap the booting core has to forge, in cnode_module.
+ */
+struct boot_record_module {
+    cslot_t slot;
+    genpaddr_t base;
+    gensize_t bytes;
+};
+
+/**
+ * \brief Header of the boot record that the BSP init writes at the start of the
+ * URPC frame for a booting core. The tables follow the header; every table is
+ * located by its offset from the start of the record, so readers don't depend
+ * on the writer's struct layout beyond this header.
+ */
+struct boot_record {
+    uint32_t magic;            // BOOT_RECORD_MAGIC
+    uint16_t version;          // BOOT_RECORD_VERSION
+    uint16_t header_size;      // sizeof(struct boot_record) of the writer
+    uint32_t total_size;       // header and all tables, in bytes
+    volatile uint32_t ready;   // set by the booted core once its init is up
+
+    genpaddr_t ram_base;       // RAM the booted core manages on its own
+    gensize_t ram_bytes;
+
+    uint32_t bootinfo_offset;  // struct bootinfo, regions included
+    uint32_t bootinfo_size;
+
+    uint32_t modules_offset;   // struct boot_record_module[], by slot
+    uint32_t modules_count;    // includes the multiboot strings at slot 0
+};
+
 /**
  * \brief Maps the frame under cap_urpc to vspace. If "my_core_id" is 0, then
  * this will first allocate a frame of size BASE_PAGE_SIZE before mapping.
@@ -27,15 +66,15 @@
 errval_t map_urpc_frame_to_vspace(void** ret, coreid_t my_core_id);
 
 /**
- * \brief Writes the given RAM base and size and struct bootinfo into the shared
- * URPC frame mapped at the given urpc_buf
+ * \brief Writes a boot record with the given RAM base and size, struct bootinfo
+ * and module table into the shared URPC frame mapped at the given urpc_buf
  */
-void write_to_urpc(void* urpc_buf, genpaddr_t base, gensize_t size,
+errval_t write_to_urpc(void* urpc_buf, genpaddr_t base, gensize_t size,
 		struct bootinfo* bi, coreid_t my_core_id);
 
 /**
- * \brief Read memory data from URPC frame and forg a cap to it; also read the
- * bootinfo structure.
+ * \brief Validates the boot record in the URPC frame, forges a cap to its RAM
+ * and returns a private copy of the bootinfo structure.
  */
 errval_t read_from_urpc(void* urpc_buf, struct bootinfo** bi,
 		coreid_t my_core_id);
@@ -47,9 +86,15 @@ errval_t start_core(coreid_t core_to_start, coreid_t my_core_id,
 		struct bootinfo *bi);
 
 /**
- * \brief Reads module RAM data from URPC and forges appropriate caps.
+ * \brief Reads the module table from the boot record and forges the module
+ * caps, one invocation per run of consecutive slots.
  */
 errval_t read_modules(void* urpc_buf, struct bootinfo* bi,
         coreid_t my_core_id);
 
+/**
+ * \brief Marks the boot record as consumed; on the BSP, waits for that.
+ */
+void boot_record_ready(void* urpc_buf, coreid_t my_core_id);
+
 #endif /* _INIT_CORE_BOOT_H_ */
\ No newline at end of file
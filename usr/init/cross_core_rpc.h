@@ -23,6 +23,10 @@
 #define RPC_STATUS_CONSUMED 0  // Response consumed, nothing pending.
 #define RPC_STATUS_PRODUCED 1  // Client has produced new pending request.
 
+// Room for a request or response payload in a c- or s-frame.
+#define CROSS_CORE_RPC_MSG_MAX \
+        (BASE_PAGE_SIZE - 2 * sizeof(uint32_t) - sizeof(size_t))
+
 /**
  * \brief Initializes an RPC buffer for inter-core communication by mapping the
  * c- and s-frames into vspace and setting the status to RPC_STATUS_CONSUMED.
@@ -29,6 +29,7 @@
 #include "mem_alloc.h"
 #include "scheduler.h"
 #include "rpc_server.h"
+#include "spawn_pool.h"
 
 coreid_t my_core_id;
 struct bootinfo *bi;
@@ -96,8 +97,9 @@ int main(int argc, char *argv[])
     CHECK("mapping URPC frame into vspace",
             map_urpc_frame_to_vspace(&urpc_buf, my_core_id));
 
-    write_to_urpc(urpc_buf, remaining_mem_base, remaining_mem_size, bi,
-            my_core_id);
+    CHECK("writing boot record to URPC frame",
+            write_to_urpc(urpc_buf, remaining_mem_base, remaining_mem_size, bi,
+                    my_core_id));
     CHECK("forging RAM cap & retrieving bi from URPC frame",
             read_from_urpc(urpc_buf, &bi, my_core_id));
     CHECK("start core 1", start_core(1, my_core_id, bi));
@@ -111,6 +113,7 @@ int main(int argc, char *argv[])
         CHECK("reading modules from URPC",
                 read_modules(urpc_buf, bi, my_core_id));
     }
+    boot_record_ready(urpc_buf, my_core_id);
     // Initialize URPC for subsequent inter-core communication attempts.
     urpc_init(urpc_buf, my_core_id);
 
@@ -147,6 +150,11 @@ int main(int argc, char *argv[])
         }
         CHECK("creating slot for subsequent LMP", lmp_chan_alloc_recv_slot(lc));
 
+        CHECK("spawning fsserver",
+                spawn_load_by_name("fsserver",
+                        (struct spawninfo*) malloc(sizeof(struct spawninfo)),
+                        my_core_id));
+
         CHECK("spawning sdma",
                 spawn_load_by_name(
                         "sdma",
@@ -162,6 +170,7 @@ int main(int argc, char *argv[])
 
         add_process_ps_list("init");
         add_process_ps_list("nameserver");
+        add_process_ps_list("fsserver");
         add_process_ps_list("sdma");
         add_process_ps_list("net");
     } else {
@@ -176,6 +185,8 @@ int main(int argc, char *argv[])
     if (my_core_id == 1) { // let's give something to do to core 1 too :D
     }
 
+    CHECK("starting spawn workers", spawn_pool_init());
+
     debug_printf("Message handler loop\n");
     scheduler_start(&sc, lc);
     // // Hang around
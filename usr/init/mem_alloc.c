@@ -9,10 +9,15 @@
 
 /// MM allocator instance data
 struct mm aos_mm;
+/// Serializes aos_mm between init's threads; nested, as slot refills recurse.
+static struct thread_mutex aos_mm_mutex = THREAD_MUTEX_INITIALIZER;
 
 static errval_t aos_ram_alloc_aligned(struct capref *ret, size_t size, size_t alignment)
 {
-    return mm_alloc_aligned(&aos_mm, size, alignment, ret);
+    thread_mutex_lock_nested(&aos_mm_mutex);
+    errval_t err = mm_alloc_aligned(&aos_mm, size, alignment, ret);
+    thread_mutex_unlock(&aos_mm_mutex);
+    return err;
 }
 
 errval_t aos_ram_free(struct capref cap, size_t bytes)
@@ -23,7 +28,10 @@ errval_t aos_ram_free(struct capref cap, size_t bytes)
     if (bytes > fi.bytes) {
         bytes = fi.bytes;
     }
-    return mm_free(&aos_mm, cap, fi.base, bytes);
+    thread_mutex_lock_nested(&aos_mm_mutex);
+    err = mm_free(&aos_mm, cap, fi.base, bytes);
+    thread_mutex_unlock(&aos_mm_mutex);
+    return err;
 }
 
 /**
@@ -12,14 +12,23 @@
  * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
  */
 
+#include <aos/sys_debug.h>
+#include <barrelfish_kpi/asm_inlines_arch.h>
+
 #include "rpc_server.h"
+#include "spawn_pool.h"
 
 extern coreid_t my_core_id;
 extern struct bootinfo *bi;
 static domainid_t last_issued_pid = 1;
+// Protects ps and last_issued_pid, which the spawn pool workers update.
+static struct thread_mutex ps_mutex = THREAD_MUTEX_INITIALIZER;
 
 static size_t n_requests = 0;
 
+// Generator state for args frame tokens; only touched by the RPC loop.
+static uint64_t args_token_state = 0;
+
 struct system_ps* ps = NULL;
 
 struct client_state* identify_client(struct capref* cap,
@@ -100,6 +109,11 @@ errval_t serve_locally(struct lmp_recv_msg* msg, struct capref* cap,
             response = (void*) send_pid;
             response_args = process_local_spawn_args_request(msg, cap, *clients);
             break;
+        case AOS_RPC_SPAWN_FRAME:
+            response = (void*) send_pid;
+            response_args = process_local_spawn_frame_request(msg, cap,
+                    *clients);
+            break;
         case AOS_RPC_GET_PNAME:
             response = (void*) send_process_name;
             response_args = process_local_get_process_name_request(
@@ -129,6 +143,12 @@ errval_t serve_locally(struct lmp_recv_msg* msg, struct capref* cap,
             return 1;  // TODO: More meaning plz
     }
 
+    if (response_args == NULL) {
+        // Nothing to answer (yet): the request was dropped or handed off to
+        // a worker which registers the response itself.
+        return SYS_ERR_OK;
+    }
+
     struct lmp_chan* out = (struct lmp_chan*) response_args;
     CHECK("lmp_chan_register_send parent",
             lmp_chan_register_send(out, get_default_waitset(),
@@ -163,6 +183,10 @@ void* process_local_handshake_request(struct capref* request_cap,
     new_client->ram = 0;
     new_client->str_buf = NULL;
     new_client->str_buf_idx = 0;
+    new_client->args_token = 0;
+    new_client->args_frame = NULL_CAP;
+    new_client->args_buf = NULL;
+    new_client->args_bytes = 0;
     
     *clients = new_client;
 
@@ -388,9 +412,15 @@ void* process_local_string_request(struct lmp_recv_msg* msg,
     return (void*) &client->lc;
 }
 
-void add_process_ps_list(char *name) {
+static domainid_t ps_list_add(const char* name, size_t len)
+{
     struct system_ps* new_ps = (struct system_ps*) malloc(
             sizeof(struct system_ps));
+    new_ps->name = (char*) malloc(len + 1);
+    memcpy(new_ps->name, name, len);
+    new_ps->name[len] = '\0';
+
+    thread_mutex_lock(&ps_mutex);
     if (ps == NULL) {
         new_ps->next = new_ps->prev = NULL;
         new_ps->curr_size = 1;
@@ -403,10 +433,16 @@ void add_process_ps_list(char *name) {
 
     //Set process pid
     new_ps->pid = last_issued_pid++;
-    new_ps->name = (char*) malloc(strlen(name) * sizeof(char));
-    strcpy(new_ps->name, name);
     //Add process to process list
     ps = new_ps;
+    domainid_t pid = new_ps->pid;
+    thread_mutex_unlock(&ps_mutex);
+
+    return pid;
+}
+
+void add_process_ps_list(char *name) {
+    ps_list_add(name, strlen(name));
 }
 
 errval_t rpc_spawn(char* name, domainid_t* pid)
@@ -416,34 +452,14 @@ errval_t rpc_spawn(char* name, domainid_t* pid)
     }
 
     debug_printf("Name of the process is: %s\n", name);
-    struct system_ps* new_ps = (struct system_ps*) malloc(
-            sizeof(struct system_ps));
-    if (ps == NULL) {
-        new_ps->next = new_ps->prev = NULL;
-        new_ps->curr_size = 1;
-    } else {
-        ps->prev = new_ps;
-        new_ps->curr_size = ps->curr_size+1;
-        new_ps->next = ps;
-        new_ps->prev = NULL;
-    }
-
-    //Set process pid
-    new_ps->pid = last_issued_pid++;
 
     //Spawn process and fill spawinfo
     CHECK("RPC spawning process",
             spawn_load_by_name(name,
                     (struct spawninfo*) malloc(sizeof(struct spawninfo)),
                     my_core_id));
-    
-    //ps->process = process_local_info;
-    new_ps->name = (char*) malloc(strlen(name) * sizeof(char));
-    strcpy(new_ps->name, name);
-    //Add process to process list
-    ps = new_ps;
 
-    *pid = new_ps->pid;
+    *pid = ps_list_add(name, strlen(name));
 
     return SYS_ERR_OK;
 }
@@ -454,45 +470,87 @@ errval_t rpc_spawn_args(char *name, domainid_t* pid)
         return SPAWN_ERR_FIND_SPAWNDS;
     }
 
-    struct system_ps* new_ps = (struct system_ps*) malloc(
-            sizeof(struct system_ps));
-    if (ps == NULL) {
-        new_ps->next = new_ps->prev = NULL;
-        new_ps->curr_size = 1;
-    } else {
-        ps->prev = new_ps;
-        new_ps->curr_size = ps->curr_size+1;
-        new_ps->next = ps;
-        new_ps->prev = NULL;
-    }
-
-    //Set process pid
-    new_ps->pid = last_issued_pid++;
-
     //Spawn process and fill spawinfo
     uint32_t space = 0;
-    while(name[space] != ' ') {
+    while(name[space] != ' ' && name[space] != '\0') {
         space++;
     }
-    char *proc_name = malloc(space);
+    char *proc_name = malloc(space + 1);
     memcpy(proc_name, name, space);
-    //proc_name[space] = '\0';
-    CHECK("RPC spawning process",
-            spawn_load_by_name_args(proc_name,
-                    (struct spawninfo*) malloc(sizeof(struct spawninfo)),
-                    my_core_id, (name+space+1)));
-    
-    //ps->process = process_local_info;
-    new_ps->name = (char *) malloc(space);
-    strcpy(new_ps->name, proc_name);
-    //Add process to process list
-    ps = new_ps;
+    proc_name[space] = '\0';
+    char *args = name[space] == ' ' ? name + space + 1 : name + space;
+    errval_t err = spawn_load_by_name_args(proc_name,
+            (struct spawninfo*) malloc(sizeof(struct spawninfo)),
+            my_core_id, args);
+    free(proc_name);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "RPC spawning process");
+        return err;
+    }
 
-    *pid = new_ps->pid;
+    *pid = ps_list_add(name, space);
 
     return SYS_ERR_OK;
 }
 
+errval_t rpc_spawn_params(struct spawn_args* args, domainid_t* pid)
+{
+    struct spawninfo* si = (struct spawninfo*) malloc(
+            sizeof(struct spawninfo));
+    if (si == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    errval_t err = spawn_load_args(args, si, my_core_id);
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "RPC spawning process from args frame");
+        free(si->binary_name);
+        free(si);
+        return err;
+    }
+
+    *pid = ps_list_add(si->binary_name, strlen(si->binary_name));
+
+    return SYS_ERR_OK;
+}
+
+// Allocates send_pid's arguments, with the error code and PID to be filled
+// in by spawn_reply_lmp once the spawn has finished.
+static void* spawn_reply_args(struct lmp_chan* lc)
+{
+    size_t args_size = ROUND_UP(sizeof(struct lmp_chan), 4)
+        + ROUND_UP(sizeof(errval_t), 4)
+        + ROUND_UP(sizeof(domainid_t), 4);
+
+    void* args = malloc(args_size);
+
+    // 1. Channel to send down.
+    *((struct lmp_chan*) args) = *lc;
+
+    return args;
+}
+
+static void spawn_reply_lmp(void* arg, errval_t err, domainid_t pid)
+{
+    void* args = arg;
+
+    // 2. Error code from spawn process.
+    args = (void*) ROUND_UP((uintptr_t) args + sizeof(struct lmp_chan), 4);
+    *((errval_t*) args) = err;
+
+    // 3. PID of the new process.
+    args = (void*) ROUND_UP((uintptr_t) args + sizeof(errval_t), 4);
+    *((domainid_t*) args) = pid;
+
+    // Usually runs on a spawn pool worker; the RPC loop polls the default
+    // waitset and will pick up send_pid from there.
+    err = lmp_chan_register_send((struct lmp_chan*) arg,
+            get_default_waitset(), MKCLOSURE((void*) send_pid, arg));
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "registering send_pid");
+        free(arg);
+    }
+}
+
 void* process_local_spawn_args_request(struct lmp_recv_msg* msg,
     struct capref* request_cap, struct client_state* clients)
 {
@@ -528,31 +586,21 @@ void* process_local_spawn_args_request(struct lmp_recv_msg* msg,
 
     remaining -= stop;
     if (remaining == 0) {
-        domainid_t pid;
-        errval_t err = rpc_spawn_args(client->spawn_buf, &pid);
-        
-        size_t args_size = ROUND_UP(sizeof(struct lmp_chan), 4)
-            + ROUND_UP(sizeof(errval_t), 4)
-            + ROUND_UP(sizeof(domainid_t), 4);
-
-        void* args = malloc(args_size);
-        void *return_args = args;
-        
-        // 1. Channel to send down.
-        *((struct lmp_chan*) args) = client->lc;
-        
-        // 2. Error code fromm spawn process.
-        args = (void*) ROUND_UP((uintptr_t) args + sizeof(struct lmp_chan), 4);
-        *((errval_t*) args) = err;
+        // The spawn pool owns the buffer from here on and answers the client
+        // once the process is up, so the RPC loop can keep serving others.
+        void* reply = spawn_reply_args(&client->lc);
+        errval_t err = spawn_pool_submit(client->spawn_buf, true,
+                spawn_reply_lmp, reply);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "queueing spawn request");
+            free(client->spawn_buf);
+            free(reply);
+        }
 
-        args = (void*) ROUND_UP((uintptr_t) args + sizeof(errval_t), 4);
-        *((domainid_t*) args) = pid;
-        
         client->spawn_buf_idx = 0;
-        free(client->spawn_buf);
         client->spawn_buf = NULL;
 
-        return return_args;
+        return NULL;
 
     } else {
         size_t args_size = ROUND_UP(sizeof(struct lmp_chan), 4);
@@ -611,31 +659,21 @@ void* process_local_spawn_request(struct lmp_recv_msg* msg,
 
     remaining -= stop;
     if (remaining == 0) {
-        domainid_t pid;
-        errval_t err = rpc_spawn(client->spawn_buf, &pid);
-        
-        size_t args_size = ROUND_UP(sizeof(struct lmp_chan), 4)
-            + ROUND_UP(sizeof(errval_t), 4)
-            + ROUND_UP(sizeof(domainid_t), 4);
-
-        void* args = malloc(args_size);
-        void *return_args = args;
-        
-        // 1. Channel to send down.
-        *((struct lmp_chan*) args) = client->lc;
-        
-        // 2. Error code fromm spawn process.
-        args = (void*) ROUND_UP((uintptr_t) args + sizeof(struct lmp_chan), 4);
-        *((errval_t*) args) = err;
+        // The spawn pool owns the buffer from here on and answers the client
+        // once the process is up, so the RPC loop can keep serving others.
+        void* reply = spawn_reply_args(&client->lc);
+        errval_t err = spawn_pool_submit(client->spawn_buf, false,
+                spawn_reply_lmp, reply);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "queueing spawn request");
+            free(client->spawn_buf);
+            free(reply);
+        }
 
-        args = (void*) ROUND_UP((uintptr_t) args + sizeof(errval_t), 4);
-        *((domainid_t*) args) = pid;
-        
         client->spawn_buf_idx = 0;
-        // free(client->spawn_buf);
         client->spawn_buf = NULL;
 
-        return return_args;
+        return NULL;
 
     } else {
         size_t args_size = ROUND_UP(sizeof(struct lmp_chan), 4);
@@ -660,17 +698,155 @@ void* process_local_spawn_request(struct lmp_recv_msg* msg,
     //return (void*) &client->lc;
 }
 
+// Draws a fresh args frame token: nonzero and held by no other client. The
+// token is all that ties an args frame to the client it was handed to, so
+// it must not be guessable; xorshift64* stirred with the timers on every
+// draw will do for that.
+static uint32_t args_token_new(struct client_state* clients)
+{
+    uintptr_t timer = 0;
+    sys_debug_hardware_timer_read(&timer);
+    args_token_state ^= ((uint64_t) timer << 32) | get_cycle_count();
+    if (args_token_state == 0) {
+        args_token_state = 0x9e3779b97f4a7c15ULL;
+    }
+
+    while (true) {
+        args_token_state ^= args_token_state >> 12;
+        args_token_state ^= args_token_state << 25;
+        args_token_state ^= args_token_state >> 27;
+        uint32_t token = (args_token_state * 0x2545f4914f6cdd1dULL) >> 32;
+        if (token == 0) {
+            continue;
+        }
+
+        struct client_state* client = clients;
+        while (client != NULL && client->args_token != token) {
+            client = client->next;
+        }
+        if (client == NULL) {
+            return token;
+        }
+    }
+}
+
+struct client_state* rpc_claim_args_frame(uint32_t token,
+        struct capref frame, size_t max_bytes, struct client_state* clients)
+{
+    struct client_state* client = clients;
+    while (client != NULL && (token == 0 || client->args_token != token)) {
+        client = client->next;
+    }
+    if (client == NULL) {
+        debug_printf("rpc_claim_args_frame: unknown token %u\n", token);
+        cap_destroy(frame);
+        return NULL;
+    }
+    // Tokens are single use, and so are frames: drop one still unsent.
+    client->args_token = 0;
+    rpc_release_args_frame(client);
+
+    // The client keeps its own mapping of the frame; whoever copies it out
+    // checks the copy only.
+    struct frame_identity fi;
+    errval_t err = frame_identify(frame, &fi);
+    if (err_is_ok(err)) {
+        client->args_bytes = MIN(fi.bytes, max_bytes);
+        err = paging_map_frame(get_current_paging_state(), &client->args_buf,
+                ROUND_UP(client->args_bytes, BASE_PAGE_SIZE), frame, NULL,
+                NULL);
+    }
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "mapping args frame");
+        client->args_buf = NULL;
+        client->args_bytes = 0;
+        cap_destroy(frame);
+        spawn_reply_lmp(spawn_reply_args(&client->lc), err, 0);
+        return NULL;
+    }
+    client->args_frame = frame;
+
+    return client;
+}
+
+void rpc_release_args_frame(struct client_state* client)
+{
+    if (client->args_buf != NULL) {
+        errval_t err = paging_unmap(get_current_paging_state(),
+                client->args_buf);
+        if (err_is_fail(err)) {
+            DEBUG_ERR(err, "unmapping args frame");
+        }
+        client->args_buf = NULL;
+    }
+    if (!capref_is_null(client->args_frame)) {
+        cap_destroy(client->args_frame);
+        client->args_frame = NULL_CAP;
+    }
+    client->args_bytes = 0;
+}
+
+void* process_local_spawn_frame_request(struct lmp_recv_msg* msg,
+    struct capref* request_cap, struct client_state* clients)
+{
+    uint32_t token = msg->words[1];
+
+    if (token == 0) {
+        // First message: carries the client's endpoint like any other
+        // request. Answer with a token to send the frame itself under, since
+        // that message has no room left to identify the client.
+        struct client_state* client = identify_client(request_cap, clients);
+        if (client == NULL) {
+            debug_printf("process_local_spawn_frame_request: could not find "
+                    "client\n");
+            return NULL;
+        }
+        client->args_token = args_token_new(clients);
+        spawn_reply_lmp(spawn_reply_args(&client->lc), SYS_ERR_OK,
+                client->args_token);
+        return NULL;
+    }
+
+    // Second message: carries the frame, copied straight into the child's
+    // arguments page.
+    struct client_state* client = rpc_claim_args_frame(token, *request_cap,
+            SPAWN_ARGS_FRAME_MAX, clients);
+    if (client == NULL) {
+        return NULL;
+    }
+    struct spawn_args args;
+    errval_t err = spawn_args_copy(client->args_buf, client->args_bytes,
+            &args);
+    rpc_release_args_frame(client);
+
+    void* reply = spawn_reply_args(&client->lc);
+    if (err_is_ok(err)) {
+        err = spawn_pool_submit_args(&args, spawn_reply_lmp, reply);
+        if (err_is_fail(err)) {
+            spawn_args_free(&args);
+        }
+    }
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "queueing spawn request");
+        spawn_reply_lmp(reply, err, 0);
+    }
+
+    return NULL;
+}
+
 char* rpc_process_name(domainid_t pid, size_t* len)
 {
     struct system_ps* aux;
     char* process_name;
     *len = 0;
+    thread_mutex_lock(&ps_mutex);
     for (aux = ps; aux != NULL; aux = aux->next) {
         if (aux->pid == pid) {
             break;
         }
     }
     if (aux == NULL) {
+        thread_mutex_unlock(&ps_mutex);
         debug_printf("Unable to find process with PID %u\n", pid);
         return NULL;
     }
@@ -678,6 +854,7 @@ char* rpc_process_name(domainid_t pid, size_t* len)
     *len = strlen(aux->name);
     process_name = (char*) malloc(*len * sizeof(char));
     strncpy(process_name, aux->name, *len);
+    thread_mutex_unlock(&ps_mutex);
 
     return process_name;
 }
@@ -716,6 +893,7 @@ void* process_local_get_process_name_request(struct lmp_recv_msg* msg,
 
 domainid_t* rpc_process_list(size_t* len)
 {
+    thread_mutex_lock(&ps_mutex);
     struct system_ps* aux = ps;
     *len = ps->curr_size;
     domainid_t* pids = (domainid_t*) malloc(*len * sizeof(domainid_t));
@@ -724,6 +902,7 @@ domainid_t* rpc_process_list(size_t* len)
         pids[i] = aux->pid;
         aux = aux->next;
     }
+    thread_mutex_unlock(&ps_mutex);
 
     return pids;
 }
@@ -43,6 +43,10 @@ struct client_state {
 
     char* spawn_buf;       // buffer for process spawn messages.
     size_t spawn_buf_idx;  // current index in process spawn buffer.
+    uint32_t args_token;   // token its next args frame is sent under, or 0.
+    struct capref args_frame;  // frame claimed under the token, until copied,
+    void* args_buf;            // mapped here,
+    size_t args_bytes;         // at most this much of it.
 
     struct EndPoint remote_ep;  // Used to identify clients.
 
@@ -179,6 +183,24 @@ errval_t rpc_spawn(char* name, domainid_t* pid);
  * \brief Spawns a new process, returning its PID.
  */
 errval_t rpc_spawn_args(char* name , domainid_t* pid);
+/**
+ * \brief Spawns a new process from an argument block copied out of a client's
+ * frame by spawn_args_copy, returning its PID.
+ */
+errval_t rpc_spawn_params(struct spawn_args* args, domainid_t* pid);
+/**
+ * \brief Finds the client an args frame token was handed to and maps the
+ * frame sent under it, at most max_bytes of it, at client->args_buf. Consumes
+ * the token, and the frame cap unless it is kept in client->args_frame.
+ * Returns NULL, after answering the client if there is one, when the frame
+ * cannot be used.
+ */
+struct client_state* rpc_claim_args_frame(uint32_t token,
+        struct capref frame, size_t max_bytes, struct client_state* clients);
+/**
+ * \brief Unmaps and drops the args frame claimed by client.
+ */
+void rpc_release_args_frame(struct client_state* client);
 /**
  * \brief Returns the name of the process with the given PID.
  */
@@ -250,6 +272,11 @@ void* process_local_spawn_request(struct lmp_recv_msg* msg,
  */
 void* process_local_spawn_args_request(struct lmp_recv_msg* msg,
         struct capref* request_cap, struct client_state* clients);
+/**
+ * \brief Processes a same-core spawn request whose arguments come in a frame.
+ */
+void* process_local_spawn_frame_request(struct lmp_recv_msg* msg,
+        struct capref* request_cap, struct client_state* clients);
 /**
  * \brief Processes a same-core get process name for PID request.
  */
@@ -16,6 +16,66 @@
 
 #include "rpc_server.h"
 #include "scheduler.h"
+#include "spawn_pool.h"
+
+// Where a spawn pool worker should post the answer to a cross-core spawn.
+struct urpc_spawn_reply {
+    void* server_buf;  // s-frame of the remote client that asked.
+    uint32_t code;     // AOS_RPC_SPAWN or AOS_RPC_SPAWN_ARGS.
+    errval_t err;      // Outcome of the spawn, once done.
+    domainid_t pid;
+    struct urpc_spawn_reply* next;
+};
+
+// Finished cross-core spawns whose answer is not on the s-frame yet, written
+// by the RPC loop (see flush_spawn_replies), protected by spawn_replies_mutex.
+static struct urpc_spawn_reply* spawn_replies = NULL;
+static struct thread_mutex spawn_replies_mutex = THREAD_MUTEX_INITIALIZER;
+
+static void spawn_reply_urpc(void* arg, errval_t err, domainid_t pid)
+{
+    struct urpc_spawn_reply* reply = (struct urpc_spawn_reply*) arg;
+    reply->err = err;
+    reply->pid = pid;
+
+    thread_mutex_lock(&spawn_replies_mutex);
+    reply->next = spawn_replies;
+    spawn_replies = reply;
+    thread_mutex_unlock(&spawn_replies_mutex);
+}
+
+/**
+ * \brief Writes the answers of finished cross-core spawns. A reply whose
+ * s-frame still holds an unconsumed response stays queued for the next round.
+ */
+static errval_t write_spawn_reply(void* server_buf, uint32_t code,
+        errval_t spawn_err, domainid_t pid)
+{
+    // Same layout as process_rpc_request's spawn responses.
+    uint8_t resp[sizeof(errval_t) + sizeof(domainid_t)];
+    memcpy(resp, &spawn_err, sizeof(errval_t));
+    memcpy(resp + sizeof(errval_t), &pid, sizeof(domainid_t));
+
+    return cross_core_rpc_write_response(server_buf, code, sizeof(resp), resp);
+}
+
+static void flush_spawn_replies(void)
+{
+    thread_mutex_lock(&spawn_replies_mutex);
+    struct urpc_spawn_reply** prev = &spawn_replies;
+    while (*prev != NULL) {
+        struct urpc_spawn_reply* reply = *prev;
+        errval_t err = write_spawn_reply(reply->server_buf, reply->code,
+                reply->err, reply->pid);
+        if (err_is_fail(err)) {
+            prev = &reply->next;
+            continue;
+        }
+        *prev = reply->next;
+        free(reply);
+    }
+    thread_mutex_unlock(&spawn_replies_mutex);
+}
 
 errval_t process_urpc_task(struct scheduler* sc, struct urpc_task* task)
 {
@@ -90,10 +150,22 @@ errval_t process_rpc_task(struct scheduler* sc, struct rpc_task* task)
             return SYS_ERR_OK;
         }
 
-        struct client_state* client = identify_client(&client_cap,
-                sc->local_clients);
-        if (client == NULL) {
-            return INIT_ERR_RPC_CANNOT_SERVE;
+        struct client_state* client;
+        if (task->msg.words[0] == AOS_RPC_SPAWN_FRAME) {
+            // The cap is the args frame, sent under the token the client got
+            // for it. It goes over to the other core by value, copied
+            // straight from the frame into the c-frame.
+            client = rpc_claim_args_frame(task->msg.words[1], client_cap,
+                    CROSS_CORE_RPC_MSG_MAX, sc->local_clients);
+            if (client == NULL) {
+                // Dropped, or already answered.
+                return SYS_ERR_OK;
+            }
+        } else {
+            client = identify_client(&client_cap, sc->local_clients);
+            if (client == NULL) {
+                return INIT_ERR_RPC_CANNOT_SERVE;
+            }
         }
         task->client = client;
 
@@ -280,6 +352,15 @@ errval_t process_rpc_task(struct scheduler* sc, struct rpc_task* task)
                     return SYS_ERR_OK;
                 }
                 break;
+            case AOS_RPC_SPAWN_FRAME:
+                err = cross_core_rpc_write_request(
+                        task->client->client_frame->addr,
+                        AOS_RPC_SPAWN_FRAME, task->client->args_bytes,
+                        task->client->args_buf);
+                if (err_is_ok(err)) {
+                    rpc_release_args_frame(task->client);
+                }
+                break;
             case AOS_RPC_GET_PNAME:
                 err = cross_core_rpc_write_request(
                         task->client->client_frame->addr,
@@ -798,6 +879,7 @@ errval_t process_rpc_response(struct scheduler* sc, uint32_t code,
             *local_response_fn = (void*) send_pid;
             break;
         case AOS_RPC_SPAWN_ARGS:
+        case AOS_RPC_SPAWN_FRAME:
             args_size = ROUND_UP(sizeof(struct lmp_chan), 4)
                     + ROUND_UP(sizeof(errval_t), 4)
                     + ROUND_UP(sizeof(domainid_t), 4);
@@ -880,7 +962,50 @@ errval_t check_task_rpc(struct scheduler* sc)
                 &req_len,
                 &req);
 
-        if (err_is_ok(err)) {
+        if (err_is_ok(err) && req != NULL
+                && (code == AOS_RPC_SPAWN || code == AOS_RPC_SPAWN_ARGS
+                        || code == AOS_RPC_SPAWN_FRAME)) {
+            // Load the image here, on the target core, but off the RPC loop;
+            // the worker answers through the s-frame once it is done.
+            struct urpc_spawn_reply* reply = (struct urpc_spawn_reply*) malloc(
+                    sizeof(struct urpc_spawn_reply));
+            if (reply == NULL) {
+                // Nowhere to queue the answer, refuse the spawn right away.
+                free(req);
+                err = write_spawn_reply(remote_client->server_frame->addr,
+                        code, LIB_ERR_MALLOC_FAIL, 0);
+                if (err_is_fail(err)) {
+                    DEBUG_ERR(err, "refusing cross-core spawn");
+                }
+                remote_client = remote_client->next;
+                continue;
+            }
+            reply->server_buf = remote_client->server_frame->addr;
+            reply->code = code;
+            if (code == AOS_RPC_SPAWN_FRAME) {
+                // Straight from the request into the child's arguments page.
+                struct spawn_args args;
+                err = spawn_args_copy(req, req_len, &args);
+                free(req);
+                if (err_is_ok(err)) {
+                    err = spawn_pool_submit_args(&args, spawn_reply_urpc,
+                            reply);
+                    if (err_is_fail(err)) {
+                        spawn_args_free(&args);
+                    }
+                }
+            } else {
+                err = spawn_pool_submit((char*) req,
+                        code == AOS_RPC_SPAWN_ARGS, spawn_reply_urpc, reply);
+                if (err_is_fail(err)) {
+                    free(req);
+                }
+            }
+            if (err_is_fail(err)) {
+                // The pool did not take the request, answer with the error.
+                spawn_reply_urpc(reply, err, 0);
+            }
+        } else if (err_is_ok(err)) {
             // Got a new request, try to serve it.
             size_t resp_len;
             void* resp;
@@ -898,6 +1023,9 @@ errval_t check_task_rpc(struct scheduler* sc)
         remote_client = remote_client->next;
     }
 
+    // 1.1 Answer cross-core spawns the pool has finished since.
+    flush_spawn_replies();
+
     // 2. Check if any cross-core requests performed by local clients have been
     // responded to by the other core.
     struct client_state* local_client = sc->local_clients;
@@ -993,6 +1121,13 @@ bool try_serving_locally(struct scheduler* sc, struct rpc_task* task,
         case AOS_RPC_SDMA_EP:
             // These are always core-local.
             break;
+        case AOS_RPC_SPAWN_FRAME:
+            // Asking for a token is always core-local; the frame itself is
+            // sent along with the core to spawn on.
+            if (msg->words[1] != 0 && sc->my_core_id != msg->words[2]) {
+                return false;
+            }
+            break;
         case AOS_RPC_MEMORY:
         case AOS_RPC_STRING:
         case AOS_RPC_PUTCHAR:
@@ -0,0 +1,133 @@
+/**
+ * \file
+ * \brief Worker pool that runs same-core spawn requests off the RPC loop.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#include "spawn_pool.h"
+#include "rpc_server.h"
+
+struct spawn_job {
+    char* cmdline;       // heap-allocated, freed once the job is done.
+    bool with_args;      // whether to go through rpc_spawn_args.
+    bool from_args;      // whether to spawn from args instead of cmdline.
+    struct spawn_args args;  // freed if the spawn fails.
+    spawn_pool_done_fn done;
+    void* arg;
+
+    struct spawn_job* next;
+};
+
+// FIFO of pending jobs, protected by pool_mutex.
+static struct spawn_job* pool_head = NULL;
+static struct spawn_job* pool_tail = NULL;
+static struct thread_mutex pool_mutex = THREAD_MUTEX_INITIALIZER;
+static struct thread_cond pool_cond = THREAD_COND_INITIALIZER;
+
+static struct spawn_job* spawn_pool_pop(void)
+{
+    thread_mutex_lock(&pool_mutex);
+    while (pool_head == NULL) {
+        thread_cond_wait(&pool_cond, &pool_mutex);
+    }
+    struct spawn_job* job = pool_head;
+    pool_head = job->next;
+    if (pool_head == NULL) {
+        pool_tail = NULL;
+    }
+    thread_mutex_unlock(&pool_mutex);
+    return job;
+}
+
+static int spawn_pool_worker(void* arg)
+{
+    while (true) {
+        struct spawn_job* job = spawn_pool_pop();
+
+        domainid_t pid = 0;
+        errval_t err;
+        if (job->from_args) {
+            err = rpc_spawn_params(&job->args, &pid);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "spawn pool: spawning from args frame");
+                spawn_args_free(&job->args);
+            }
+        } else {
+            err = job->with_args
+                    ? rpc_spawn_args(job->cmdline, &pid)
+                    : rpc_spawn(job->cmdline, &pid);
+            if (err_is_fail(err)) {
+                DEBUG_ERR(err, "spawn pool: spawning %s", job->cmdline);
+            }
+        }
+
+        job->done(job->arg, err, pid);
+
+        free(job->cmdline);
+        free(job);
+    }
+    return 0;
+}
+
+errval_t spawn_pool_init(void)
+{
+    for (size_t i = 0; i < SPAWN_POOL_WORKERS; ++i) {
+        struct thread* t = thread_create(spawn_pool_worker, NULL);
+        if (t == NULL) {
+            return INIT_ERR_SPAWN_POOL;
+        }
+        thread_detach(t);
+    }
+    return SYS_ERR_OK;
+}
+
+static errval_t spawn_pool_push(char* cmdline, bool with_args,
+        struct spawn_args* args, spawn_pool_done_fn done, void* arg)
+{
+    struct spawn_job* job = (struct spawn_job*) malloc(
+            sizeof(struct spawn_job));
+    if (job == NULL) {
+        return LIB_ERR_MALLOC_FAIL;
+    }
+    job->cmdline = cmdline;
+    job->with_args = with_args;
+    job->from_args = args != NULL;
+    if (args != NULL) {
+        job->args = *args;
+    }
+    job->done = done;
+    job->arg = arg;
+    job->next = NULL;
+
+    thread_mutex_lock(&pool_mutex);
+    if (pool_tail == NULL) {
+        pool_head = job;
+    } else {
+        pool_tail->next = job;
+    }
+    pool_tail = job;
+    thread_cond_signal(&pool_cond);
+    thread_mutex_unlock(&pool_mutex);
+
+    return SYS_ERR_OK;
+}
+
+errval_t spawn_pool_submit(char* cmdline, bool with_args,
+        spawn_pool_done_fn done, void* arg)
+{
+    return spawn_pool_push(cmdline, with_args, NULL, done, arg);
+}
+
+errval_t spawn_pool_submit_args(struct spawn_args* args,
+        spawn_pool_done_fn done, void* arg)
+{
+    return spawn_pool_push(NULL, false, args, done, arg);
+}
@@ -0,0 +1,54 @@
+/**
+ * \file
+ * \brief Worker pool that runs same-core spawn requests off the RPC loop.
+ */
+
+/*
+ * Copyright (c) 2016, ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, Universitaetsstrasse 6, CH-8092 Zurich. Attn: Systems Group.
+ */
+
+#ifndef _INIT_SPAWN_POOL_H_
+#define _INIT_SPAWN_POOL_H_
+
+#include <aos/aos.h>
+#include <spawn/spawn.h>
+
+#define SPAWN_POOL_WORKERS 2
+
+/**
+ * \brief Called on a worker thread once a queued spawn has finished, with the
+ * spawn's error code and, on success, the PID of the new process.
+ */
+typedef void (*spawn_pool_done_fn)(void* arg, errval_t err, domainid_t pid);
+
+/**
+ * \brief Starts the spawn worker threads. Must be called once, before the
+ * RPC loop starts handing requests to spawn_pool_submit.
+ */
+errval_t spawn_pool_init(void);
+
+/**
+ * \brief Queues a spawn of the given command line. The pool takes ownership
+ * of "cmdline" (which must be heap-allocated) and calls "done" with "arg"
+ * once the process has been spawned.
+ *
+ * If "with_args" is set, everything after the first space in "cmdline" is
+ * passed as the new process' arguments.
+ */
+errval_t spawn_pool_submit(char* cmdline, bool with_args,
+        spawn_pool_done_fn done, void* arg);
+
+/**
+ * \brief Queues a spawn from an argument block copied out of a client's frame
+ * by spawn_args_copy. Unless this fails, the pool takes over "args" and frees
+ * it if the spawn does not use it.
+ */
+errval_t spawn_pool_submit_args(struct spawn_args* args,
+        spawn_pool_done_fn done, void* arg);
+
+#endif /* _INIT_SPAWN_POOL_H_ */
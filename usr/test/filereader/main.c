@@ -15,10 +15,13 @@
 
 
 #include <stdio.h>
+#include <string.h>
 
 #include <aos/aos.h>
 #include <fs/fs.h>
 #include <fs/dirent.h>
+#include <bdev/bdev.h>
+#include <bdev/bcache.h>
 #include <omap_timer/timer.h>
 
 #define ENABLE_LONG_FILENAME_TEST 1
@@ -33,6 +36,11 @@
 #define LONGFILENAME2  "/mylongfilenamefilesecond.txt"
 #define FILE_NOT_EXIST "/not-exist.txt"
 
+/* block device throughput */
+#define BENCH_DEVICE   "mmchs"
+#define BENCH_BYTES    (4 * 1024 * 1024)
+#define BENCH_ASYNC_BLOCKS 32
+
 #define TEST_PREAMBLE(arg) \
     printf("\n-------------------------------\n"); \
     printf("%s(%s)\n", __FUNCTION__, arg);
@@ -166,6 +174,182 @@ static errval_t test_fread(char *file)
     return SYS_ERR_OK;
 }
 
+static errval_t write_file(const char *path, const char *text)
+{
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return FS_ERR_OPEN;
+    }
+
+    size_t written = fwrite(text, 1, strlen(text), f);
+    if (fclose(f) || written != strlen(text)) {
+        return FS_ERR_WRITE;
+    }
+
+    return SYS_ERR_OK;
+}
+
+/**
+ * \brief creates the files the other tests read, on a blank volume
+ */
+static errval_t test_populate(char *mountpoint)
+{
+    errval_t err;
+
+    TEST_PREAMBLE(mountpoint)
+
+    err = mkdir(MOUNTPOINT SUBDIR);
+    if (err_is_ok(err)) {
+        err = mkdir(MOUNTPOINT SUBDIR_LONG);
+    }
+    if (err_is_ok(err)) {
+        err = write_file(MOUNTPOINT FILENAME, "Hello from the SD card!\n");
+    }
+    if (err_is_ok(err)) {
+        err = write_file(MOUNTPOINT SUBDIR LONGFILENAME,
+                         "A file with a long name.\n");
+    }
+    if (err_is_ok(err)) {
+        err = write_file(MOUNTPOINT SUBDIR LONGFILENAME2,
+                         "Another file with a long name.\n");
+    }
+
+    return err;
+}
+
+static void print_throughput(const char *what, size_t blocks_per_req,
+                             size_t bytes, uint64_t ms)
+{
+    printf("%s, %4zu blocks per request: %zu bytes in %" PRIu64 " ms, "
+           "%" PRIu64 " KB/s\n", what, blocks_per_req, bytes, ms,
+           ms ? (uint64_t)bytes * 1000 / 1024 / ms : 0);
+}
+
+static void bench_done(struct bdev_req *req, errval_t err)
+{
+    size_t *completed = req->arg;
+    (*completed)++;
+    if (err_is_fail(err)) {
+        DEBUG_ERR(err, "asynchronous read");
+    }
+}
+
+/**
+ * \brief reads the start of a block device, with requests of growing size
+ *        and then with many requests in flight at once
+ */
+static errval_t test_bdev_throughput(char *device)
+{
+    errval_t err;
+    uint64_t tstart, tend;
+
+    TEST_PREAMBLE(device)
+
+    struct bdev *dev;
+    err = bdev_open(device, &dev);
+    if (err_is_fail(err)) {
+        return err;
+    }
+
+    struct bdev *cache = NULL;
+    struct bdev_req *reqs = NULL;
+    size_t submitted = 0, completed = 0;
+
+    size_t blocks = MIN(BENCH_BYTES / BDEV_BLOCK_SIZE, dev->nblocks);
+    size_t bytes = blocks * BDEV_BLOCK_SIZE;
+    uint8_t *buf = malloc(bytes);
+    if (buf == NULL) {
+        err = LIB_ERR_MALLOC_FAIL;
+        goto out;
+    }
+
+    static const size_t sizes[] = { 1, 8, 32, 128, 512 };
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        tstart = omap_timer_read();
+        for (size_t lba = 0; lba < blocks; lba += sizes[i]) {
+            err = bdev_read(dev, lba, MIN(sizes[i], blocks - lba),
+                            buf + lba * BDEV_BLOCK_SIZE);
+            if (err_is_fail(err)) {
+                goto out;
+            }
+        }
+        tend = omap_timer_read();
+        print_throughput("sync ", sizes[i], bytes,
+                         omap_timer_to_ms(tend - tstart));
+    }
+
+    size_t nreqs = DIVIDE_ROUND_UP(blocks, BENCH_ASYNC_BLOCKS);
+    reqs = calloc(nreqs, sizeof(*reqs));
+    if (reqs == NULL) {
+        err = LIB_ERR_MALLOC_FAIL;
+        goto out;
+    }
+
+    tstart = omap_timer_read();
+    for (; submitted < nreqs; submitted++) {
+        size_t lba = submitted * BENCH_ASYNC_BLOCKS;
+        reqs[submitted] = (struct bdev_req) {
+            .op = BDEV_READ,
+            .lba = lba,
+            .count = MIN(BENCH_ASYNC_BLOCKS, blocks - lba),
+            .buf = buf + lba * BDEV_BLOCK_SIZE,
+            .done = bench_done,
+            .arg = &completed,
+        };
+        err = bdev_submit(dev, &reqs[submitted]);
+        if (err_is_fail(err)) {
+            break;
+        }
+    }
+    while (err_is_ok(err) && completed < nreqs) {
+        err = bdev_poll(dev, true);
+    }
+    tend = omap_timer_read();
+    if (err_is_fail(err)) {
+        goto out;
+    }
+    print_throughput("async", BENCH_ASYNC_BLOCKS, bytes,
+                     omap_timer_to_ms(tend - tstart));
+
+    // single blocks through a cache that holds them all, cold and warm
+    err = bcache_create(dev, blocks, &cache);
+    if (err_is_fail(err)) {
+        cache = NULL;
+        goto out;
+    }
+    for (int pass = 0; pass < 2; pass++) {
+        tstart = omap_timer_read();
+        for (size_t lba = 0; lba < blocks; lba++) {
+            err = bdev_read(cache, lba, 1, buf + lba * BDEV_BLOCK_SIZE);
+            if (err_is_fail(err)) {
+                goto out;
+            }
+        }
+        tend = omap_timer_read();
+        print_throughput(pass ? "warm " : "cold ", 1, bytes,
+                         omap_timer_to_ms(tend - tstart));
+    }
+
+    struct bcache_stats stats;
+    bcache_get_stats(cache, &stats);
+    printf("cache: %zu hits, %zu misses, %zu blocks read ahead\n",
+           stats.hits, stats.misses, stats.readahead);
+out:
+    if (cache != NULL) {
+        bdev_close(cache);
+    }
+    // wait for what was submitted before a failure, it points into buf
+    while (completed < submitted && err_is_ok(bdev_poll(dev, true))) {
+    }
+    if (completed < submitted) {
+        // still in flight, the device and the buffers have to stay
+        return err;
+    }
+    free(reqs);
+    free(buf);
+    bdev_close(dev);
+    return err;
+}
 
 int main(int argc, char *argv[])
 {
@@ -184,14 +368,34 @@ int main(int argc, char *argv[])
     err = filesystem_init();
     EXPECT_SUCCESS(err, "failure during fs init", 0);
 
-    err = filesystem_mount("/sdcard", "mmchs://fat32/0");
+    // "filereader ramdisk" works on a private, freshly formatted RAM disk
+    bool ramdisk = argc > 1 && strcmp(argv[1], "ramdisk") == 0;
+
+    err = filesystem_mount(MOUNTPOINT, ramdisk ? "ramdisk://fat32/"
+                                               : "mmchs://fat32/0");
     EXPECT_SUCCESS(err, "failure during fs mount", 0);
 
+    if (ramdisk) {
+        run_test(test_populate, MOUNTPOINT);
+    }
+
     run_test(test_read_dir, MOUNTPOINT "/");
 
+    run_test(test_read_dir, MOUNTPOINT SUBDIR);
+
     run_test_fail(test_read_dir, DIR_NOT_EXIST);
 
     run_test(test_fread, MOUNTPOINT FILENAME);
 
+#if ENABLE_LONG_FILENAME_TEST
+    run_test(test_fread, MOUNTPOINT SUBDIR LONGFILENAME);
+
+    run_test(test_fread, MOUNTPOINT SUBDIR LONGFILENAME2);
+#endif
+
+    run_test_fail(test_fread, MOUNTPOINT FILE_NOT_EXIST);
+
+    run_test(test_bdev_throughput, BENCH_DEVICE);
+
     return EXIT_SUCCESS;
 }
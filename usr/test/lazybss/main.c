@@ -0,0 +1,108 @@
+/**
+ * \file
+ * \brief Checks that LAZY_BSS objects are only backed by memory once touched
+ */
+
+/*
+ * Copyright (c) 2016 ETH Zurich.
+ * All rights reserved.
+ *
+ * This file is distributed under the terms in the attached LICENSE file.
+ * If you do not find this file, copies can be found by writing to:
+ * ETH Zurich D-INFK, CAB F.78, Universitaetstr. 6, CH-8092 Zurich,
+ * Attn: Systems Group.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <aos/aos.h>
+#include <aos/paging.h>
+
+#define LAZY_PAGES     1024
+/// Pages the page-fault handler maps per fault, at most
+#define FAULT_BATCH    4
+
+static uint8_t lazy[LAZY_PAGES * BASE_PAGE_SIZE]
+        __attribute__((aligned(BASE_PAGE_SIZE))) LAZY_BSS;
+
+/// Number of pages of lazy that are not backed by memory yet.
+static size_t untouched_pages(void)
+{
+    struct paging_state *st = get_current_paging_state();
+    size_t n = 0;
+    for (size_t i = 0; i < LAZY_PAGES; i++) {
+        if (is_vregion_claimed(st, (lvaddr_t) &lazy[i * BASE_PAGE_SIZE])) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static bool touch_page(size_t page, uint8_t value)
+{
+    uint8_t *p = &lazy[page * BASE_PAGE_SIZE];
+    if (p[0] != 0 || p[BASE_PAGE_SIZE - 1] != 0) {
+        printf("lazybss: page %u not zeroed\n", (unsigned) page);
+        return false;
+    }
+    p[0] = value;
+    p[BASE_PAGE_SIZE - 1] = value;
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    bool ok = true;
+
+    size_t before = untouched_pages();
+    printf("lazybss: %u of %u pages unbacked at start\n", (unsigned) before,
+           LAZY_PAGES);
+    if (before != LAZY_PAGES) {
+        printf("lazybss: FAIL, lazy_bss was backed before it was touched\n");
+        return EXIT_FAILURE;
+    }
+
+    // one page in the middle: only its fault batch gets backed
+    size_t mid = LAZY_PAGES / 2;
+    ok = touch_page(mid, 0xa5) && ok;
+    size_t after = untouched_pages();
+    printf("lazybss: %u pages unbacked after touching one\n",
+           (unsigned) after);
+    if (is_vregion_claimed(get_current_paging_state(),
+                           (lvaddr_t) &lazy[mid * BASE_PAGE_SIZE])
+            || after >= before || after < before - FAULT_BATCH) {
+        printf("lazybss: FAIL, touching one page backed %u\n",
+               (unsigned) (before - after));
+        ok = false;
+    }
+
+    // every 16th page, the pages in between stay unbacked
+    before = after;
+    size_t touched = 0;
+    for (size_t i = 0; i < LAZY_PAGES; i += 16) {
+        if (is_vregion_claimed(get_current_paging_state(),
+                               (lvaddr_t) &lazy[i * BASE_PAGE_SIZE])) {
+            ok = touch_page(i, (uint8_t) i) && ok;
+            touched++;
+        }
+    }
+    after = untouched_pages();
+    printf("lazybss: %u pages unbacked after touching %u more\n",
+           (unsigned) after, (unsigned) touched);
+    if (after < before - touched * FAULT_BATCH) {
+        printf("lazybss: FAIL, %u touches backed %u pages\n",
+               (unsigned) touched, (unsigned) (before - after));
+        ok = false;
+    }
+
+    // what was written stays
+    if (lazy[mid * BASE_PAGE_SIZE] != 0xa5
+            || lazy[16 * BASE_PAGE_SIZE + BASE_PAGE_SIZE - 1] != 16) {
+        printf("lazybss: FAIL, lost a write to lazy_bss\n");
+        ok = false;
+    }
+
+    printf("lazybss: %s\n", ok ? "PASS" : "FAIL");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}